@@ -19,49 +19,77 @@ bool breakpoint::operator== (const breakpoint & other)
     }
     return false;
 }
+bool processCodePatcher::read (uint64_t address, void * buffer, size_t size)
+{
+	SIZE_T bytesRead = 0;
+	return ReadProcessMemory (processHandle, (LPCVOID) address, buffer, size, &bytesRead) && bytesRead == size;
+}
+bool processCodePatcher::write (uint64_t address, const void * buffer, size_t size)
+{
+	SIZE_T bytesWritten = 0;
+	return WriteProcessMemory (processHandle, (LPVOID) address, buffer, size, &bytesWritten) && bytesWritten == size;
+}
+void processCodePatcher::flush (uint64_t address, size_t size)
+{
+	FlushInstructionCache (processHandle, (LPCVOID) address, size);
+}
 bool breakpoint::set (HANDLE procHandle)
+{
+	processCodePatcher patcher (procHandle);
+	return set (patcher);
+}
+bool breakpoint::setAgain (HANDLE procHandle)
+{
+	processCodePatcher patcher (procHandle);
+	return setAgain (patcher);
+}
+bool breakpoint::restore (HANDLE procHandle)
+{
+	processCodePatcher patcher (procHandle);
+	return restore (patcher);
+}
+bool breakpoint::set (codePatcher & patcher)
 {
 	if (type == breakpointType::SOFTWARE_TYPE)
 	{
     	uint8_t int3Byte = 0xcc;
-    	if (!ReadProcessMemory (procHandle, (LPCVOID) address, &originalByte, 1, NULL))
+    	if (!patcher.read ((uint64_t) address, &originalByte, 1))
     	{
     	    return false;
     	}
-    	if (!WriteProcessMemory (procHandle, (LPVOID) address, &int3Byte, 1, NULL))
+    	if (!patcher.write ((uint64_t) address, &int3Byte, 1))
     	{
     	    return false;
     	}
-    	FlushInstructionCache(procHandle, (LPVOID) address, 1);
+    	patcher.flush ((uint64_t) address, 1);
     	return true;
 	}
-	else if (type == breakpointType::HARDWARE_TYPE)
-	{
-
-	}
+	return false;
 }
-bool breakpoint::setAgain (HANDLE procHandle)
+bool breakpoint::setAgain (codePatcher & patcher)
 {
 	if (type == breakpointType::SOFTWARE_TYPE)
 	{
 		uint8_t int3Byte = 0xCC;
-        if (WriteProcessMemory (procHandle, (LPVOID) address, &int3Byte, 1, NULL) == 0) // restore stolen byte
+        if (!patcher.write ((uint64_t) address, &int3Byte, 1)) // restore stolen byte
         {
             return false;
         }
-        FlushInstructionCache(procHandle, (LPVOID) address, 1);
+        patcher.flush ((uint64_t) address, 1);
         return true;
 	}
+	return false;
 }
-bool breakpoint::restore (HANDLE procHandle)
+bool breakpoint::restore (codePatcher & patcher)
 {
 	if (type == breakpointType::SOFTWARE_TYPE)
 	{
-        if (WriteProcessMemory (procHandle, (LPVOID) address, &originalByte, 1, NULL) == 0) // restore stolen byte
+        if (!patcher.write ((uint64_t) address, &originalByte, 1)) // restore stolen byte
         {
             return false;
         }
-        FlushInstructionCache(procHandle, (LPVOID) address, 1);
+        patcher.flush ((uint64_t) address, 1);
         return true;
 	}
+	return false;
 }
\ No newline at end of file
@@ -3,10 +3,30 @@
 #include <inttypes.h>
 #include <stdio.h>
 
+class codePatcher // code of debugged process as breakpoints change it, implemented by fake target too
+{
+	public:
+		virtual ~codePatcher () = default;
+		virtual bool read (uint64_t address, void * buffer, size_t size) = 0;
+		virtual bool write (uint64_t address, const void * buffer, size_t size) = 0;
+		virtual void flush (uint64_t address, size_t size) = 0; // instruction cache
+};
+
+class processCodePatcher : public codePatcher
+{
+	private:
+		HANDLE processHandle;
+	public:
+		processCodePatcher (HANDLE processHandle) : processHandle (processHandle) {}
+		bool read (uint64_t, void *, size_t) override;
+		bool write (uint64_t, const void *, size_t) override;
+		void flush (uint64_t, size_t) override;
+};
+
 enum class breakpointType
 {
 	SOFTWARE_TYPE = 0,
-	HARDWARE_TYPE = 1,
+	HARDWARE_TYPE = 1, // debug registers of every thread, allocated by debugRegisters
 };
 
 class breakpoint 
@@ -17,17 +37,24 @@ class breakpoint
 		uint64_t hitCount = 0;
 		uint8_t originalByte;
 		breakpointType type;
+		uint32_t id = 0; // stable, given by breakpointTable
 	public:
 		breakpoint (void *, breakpointType, bool);
 		bool set (HANDLE);
 		bool restore (HANDLE);
 		bool setAgain (HANDLE);
+		bool set (codePatcher &);
+		bool restore (codePatcher &);
+		bool setAgain (codePatcher &);
 		void incrementHitCount ();
-		void * getAddress () { return address; }
-		uint8_t getOriginalByte () { return originalByte; }
-		breakpointType getType () { return type; }
-		bool getIsOneHit () { return isOneHit; }
-		uint64_t getHitCount () { return hitCount; } 
+		void * getAddress () const { return address; }
+		uint8_t getOriginalByte () const { return originalByte; }
+		void setOriginalByte (uint8_t byte) { originalByte = byte; } // int3 was written by batch
+		breakpointType getType () const { return type; }
+		bool getIsOneHit () const { return isOneHit; }
+		uint64_t getHitCount () const { return hitCount; }
+		uint32_t getId () const { return id; }
+		void setId (uint32_t newId) { id = newId; }
 		bool operator== (const breakpoint & other);
 
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "breakpointBatch.h"
+#include <algorithm>
+
+namespace
+{
+	constexpr uint64_t PAGE_SIZE = 0x1000;
+	constexpr uint8_t INT3 = 0xCC;
+
+	uint64_t addressOf (const breakpoint & bp) { return (uint64_t) bp.getAddress(); }
+	uint64_t addressOf (const std::shared_ptr <breakpoint> & bp) { return (uint64_t) bp->getAddress(); }
+
+	template <typename T> void sortByAddress (std::vector <T> & items)
+	{
+		std::sort (items.begin(), items.end(), [] (const T & a, const T & b) { return addressOf (a) < addressOf (b); });
+	}
+
+	// items are sorted by address, span of every page holds bytes from its first to its last breakpoint,
+	// patchPage (first, last, spanAddress, span) changes it before it is written back, done (first, last, ok) gets result of page
+	template <typename T, typename P, typename D> void patchPages (codePatcher & patcher, const std::vector <T> & items, patchStats & stats, P patchPage, D done)
+	{
+		std::vector <uint8_t> span;
+		for (size_t first = 0, last = 0; first < items.size(); first = last)
+		{
+			uint64_t page = addressOf (items[first]) & ~(PAGE_SIZE - 1);
+			for (last = first; last < items.size() && (addressOf (items[last]) & ~(PAGE_SIZE - 1)) == page; last++);
+
+			uint64_t begin = addressOf (items[first]);
+			span.resize (addressOf (items[last - 1]) - begin + 1);
+			stats.pages++;
+			stats.reads++;
+			bool ok = patcher.read (begin, span.data(), span.size());
+			if (ok)
+			{
+				patchPage (first, last, begin, span.data());
+				stats.writes++;
+				ok = patcher.write (begin, span.data(), span.size());
+			}
+			if (ok)
+			{
+				stats.flushes++;
+				patcher.flush (begin, span.size());
+			}
+			else
+			{
+				stats.failed += last - first;
+			}
+			done (first, last, ok);
+		}
+	}
+}
+
+void breakpointBatch::install (codePatcher & patcher, std::vector <breakpoint> & breakpoints, patchStats & stats)
+{
+	sortByAddress (breakpoints);
+	auto duplicates = std::unique (breakpoints.begin(), breakpoints.end(), [] (const breakpoint & a, const breakpoint & b) { return addressOf (a) == addressOf (b); });
+	stats.failed += breakpoints.end() - duplicates; // second int3 at the same address would be saved as original byte
+	breakpoints.erase (duplicates, breakpoints.end());
+
+	std::vector <breakpoint> installed;
+	installed.reserve (breakpoints.size());
+	patchPages (patcher, breakpoints, stats, [&] (size_t first, size_t last, uint64_t begin, uint8_t * span)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			uint8_t & byte = span[addressOf (breakpoints[i]) - begin];
+			breakpoints[i].setOriginalByte (byte);
+			byte = INT3;
+		}
+	},
+	[&] (size_t first, size_t last, bool ok)
+	{
+		if (ok)
+		{
+			installed.insert (installed.end(), breakpoints.begin() + first, breakpoints.begin() + last);
+		}
+	});
+	breakpoints.swap (installed);
+}
+void breakpointBatch::remove (codePatcher & patcher, std::vector <std::shared_ptr <breakpoint> > & breakpoints, patchStats & stats)
+{
+	sortByAddress (breakpoints);
+	patchPages (patcher, breakpoints, stats, [&] (size_t first, size_t last, uint64_t begin, uint8_t * span)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			span[addressOf (breakpoints[i]) - begin] = breakpoints[i]->getOriginalByte();
+		}
+	},
+	[] (size_t, size_t, bool) {});
+}
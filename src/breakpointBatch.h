@@ -0,0 +1,29 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+#include <vector>
+#include <memory>
+
+#include "breakpoint.h"
+
+// Software breakpoints installed and removed many at a time. Breakpoints are grouped by page, every page is read once
+// (only span from first to last breakpoint in it), all int3 or original bytes are patched into the copy, span is written
+// once and instruction cache flushed once, instead of read, write and flush for every breakpoint.
+
+struct patchStats
+{
+	size_t pages = 0;
+	size_t reads = 0;
+	size_t writes = 0;
+	size_t flushes = 0;
+	size_t failed = 0; // breakpoints left as they were
+};
+
+class breakpointBatch
+{
+	public:
+		// breakpoints that could not be set are erased, the rest have original bytes and are sorted by address
+		static void install (codePatcher &, std::vector <breakpoint> &, patchStats &);
+		static void remove (codePatcher &, std::vector <std::shared_ptr <breakpoint> > &, patchStats &); // sorted by address afterwards
+};
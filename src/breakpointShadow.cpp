@@ -0,0 +1,58 @@
+#include "breakpointShadow.h"
+#include <algorithm>
+
+void breakpointShadow::add (uint64_t address, uint8_t original)
+{
+	std::vector <shadowByte> & page = pages[address & ~(PAGE_SIZE - 1)];
+	uint16_t offset = address & (PAGE_SIZE - 1);
+	auto it = std::lower_bound (page.begin(), page.end(), offset, [] (const shadowByte & b, uint16_t o) { return b.offset < o; });
+	if (it != page.end() && it->offset == offset)
+	{
+		it->references++;
+		return;
+	}
+	page.insert (it, { offset, original, 1 });
+}
+void breakpointShadow::remove (uint64_t address)
+{
+	auto pageIt = pages.find (address & ~(PAGE_SIZE - 1));
+	if (pageIt == pages.end())
+	{
+		return;
+	}
+	std::vector <shadowByte> & page = pageIt->second;
+	uint16_t offset = address & (PAGE_SIZE - 1);
+	auto it = std::lower_bound (page.begin(), page.end(), offset, [] (const shadowByte & b, uint16_t o) { return b.offset < o; });
+	if (it == page.end() || it->offset != offset || --it->references > 0)
+	{
+		return;
+	}
+	page.erase (it);
+	if (page.empty())
+	{
+		pages.erase (pageIt);
+	}
+}
+void breakpointShadow::apply (uint64_t address, uint8_t * buffer, size_t size) const
+{
+	if (pages.empty() || size == 0)
+	{
+		return;
+	}
+	uint64_t end = address + size;
+	for (auto pageIt = pages.lower_bound (address & ~(PAGE_SIZE - 1)); pageIt != pages.end() && pageIt->first < end; ++pageIt)
+	{
+		for (const auto & b : pageIt->second)
+		{
+			uint64_t byteAddress = pageIt->first + b.offset;
+			if (byteAddress >= end)
+			{
+				break;
+			}
+			if (byteAddress >= address && buffer [byteAddress - address] == INT3) // restored breakpoint or code written by target is left as it is
+			{
+				buffer [byteAddress - address] = b.original;
+			}
+		}
+	}
+}
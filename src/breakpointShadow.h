@@ -0,0 +1,31 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include <map>
+
+// Original bytes hidden under software breakpoints, grouped by page and sorted by offset.
+// apply patches them back into buffer read from debugged process in one pass,
+// so every view of memory (disassembly, hexdump, unwinder, scans) sees code as it was before int3 was written.
+
+class breakpointShadow
+{
+	private:
+		static constexpr uint64_t PAGE_SIZE = 0x1000;
+		static constexpr uint8_t INT3 = 0xcc;
+
+		struct shadowByte
+		{
+			uint16_t offset; // in page
+			uint8_t original;
+			uint8_t references; // breakpoints sharing address, e.g. user and one hit breakpoint of next command
+		};
+
+		std::map <uint64_t, std::vector <shadowByte> > pages; // by page address
+	public:
+		void add (uint64_t, uint8_t); // first breakpoint at address owns original byte
+		void remove (uint64_t);
+		void apply (uint64_t, uint8_t *, size_t) const;
+		bool empty () const { return pages.empty(); }
+};
@@ -0,0 +1,181 @@
+#include "breakpointTable.h"
+#include <algorithm>
+#include <unordered_set>
+
+void breakpointShard::buildIndex ()
+{
+	uint32_t bits = 2;
+	while (((uint64_t) 1 << bits) < entries.size() * 2)
+	{
+		bits++;
+	}
+	shift = 64 - bits;
+	slots.assign ((size_t) 1 << bits, { 0, EMPTY });
+	uint64_t mask = slots.size() - 1;
+	for (uint32_t i = 0; i < entries.size(); i++)
+	{
+		uint64_t address = (uint64_t) entries[i]->getAddress();
+		uint64_t position = (breakpointSnapshot::hashAddress (address) << breakpointSnapshot::SHARD_BITS) >> shift;
+		while (slots[position].index != EMPTY)
+		{
+			position = (position + 1) & mask;
+		}
+		slots[position] = { address, i };
+	}
+}
+uint32_t breakpointShard::lookup (uint64_t address, uint64_t hash) const
+{
+	if (entries.empty())
+	{
+		return EMPTY;
+	}
+	uint64_t mask = slots.size() - 1;
+	for (uint64_t position = (hash << breakpointSnapshot::SHARD_BITS) >> shift; slots[position].index != EMPTY; position = (position + 1) & mask)
+	{
+		if (slots[position].address == address)
+		{
+			return slots[position].index;
+		}
+	}
+	return EMPTY;
+}
+
+const std::shared_ptr <breakpoint> * breakpointSnapshot::lookup (uint64_t address) const
+{
+	uint64_t hash = hashAddress (address);
+	const breakpointShard & shard = *shards[shardOf (hash)];
+	uint32_t index = shard.lookup (address, hash);
+	return index == breakpointShard::EMPTY ? nullptr : &shard.entries[index];
+}
+breakpoint * breakpointSnapshot::find (uint64_t address) const
+{
+	const std::shared_ptr <breakpoint> * entry = lookup (address);
+	return entry ? entry->get() : nullptr;
+}
+std::vector <std::shared_ptr <breakpoint> > breakpointSnapshot::getEntries () const
+{
+	std::vector <std::shared_ptr <breakpoint> > entries;
+	entries.reserve (count);
+	for (const auto & shard : shards)
+	{
+		entries.insert (entries.end(), shard->entries.begin(), shard->entries.end());
+	}
+	std::sort (entries.begin(), entries.end(), [] (const std::shared_ptr <breakpoint> & a, const std::shared_ptr <breakpoint> & b) { return a->getId() < b->getId(); });
+	return entries;
+}
+
+breakpointTable::breakpointTable ()
+{
+	auto empty = std::make_shared <breakpointSnapshot> ();
+	empty->shards.assign (breakpointSnapshot::SHARD_COUNT, std::make_shared <const breakpointShard> ());
+	current = std::move (empty);
+}
+std::shared_ptr <breakpoint> breakpointTable::find (uint64_t address) const
+{
+	auto table = snapshot ();
+	const std::shared_ptr <breakpoint> * entry = table->lookup (address);
+	return entry ? *entry : nullptr;
+}
+std::shared_ptr <breakpoint> breakpointTable::findById (uint32_t id)
+{
+	std::lock_guard <std::mutex> lock (writer);
+	auto it = idAddresses.find (id);
+	return it == idAddresses.end() ? nullptr : find (it->second);
+}
+uint32_t breakpointTable::add (const breakpoint & newBreakpoint)
+{
+	std::lock_guard <std::mutex> lock (writer);
+	uint32_t id = nextId;
+	return insert ( { newBreakpoint } ) ? id : NO_ID;
+}
+size_t breakpointTable::add (const std::vector <breakpoint> & newBreakpoints)
+{
+	std::lock_guard <std::mutex> lock (writer);
+	return insert (newBreakpoints);
+}
+size_t breakpointTable::insert (const std::vector <breakpoint> & newBreakpoints)
+{
+	auto table = snapshot ();
+	std::vector <std::shared_ptr <breakpointShard> > changed (breakpointSnapshot::SHARD_COUNT);
+	std::unordered_set <uint64_t> added; // duplicates inside of batch are skipped too
+	added.reserve (newBreakpoints.size());
+	for (const auto & newBreakpoint : newBreakpoints)
+	{
+		uint64_t address = (uint64_t) newBreakpoint.getAddress();
+		if (table->lookup (address) || !added.insert (address).second)
+		{
+			continue;
+		}
+		uint32_t shard = breakpointSnapshot::shardOf (breakpointSnapshot::hashAddress (address));
+		if (!changed[shard])
+		{
+			changed[shard] = std::make_shared <breakpointShard> ();
+			changed[shard]->entries = table->shards[shard]->entries;
+		}
+		changed[shard]->entries.push_back (std::make_shared <breakpoint> (newBreakpoint));
+		changed[shard]->entries.back()->setId (nextId); // ids only grow, entries stay sorted by id
+		idAddresses[nextId++] = address;
+	}
+	if (added.empty())
+	{
+		return 0;
+	}
+	auto next = std::make_shared <breakpointSnapshot> (*table);
+	for (uint32_t i = 0; i < breakpointSnapshot::SHARD_COUNT; i++)
+	{
+		if (changed[i])
+		{
+			changed[i]->buildIndex ();
+			next->shards[i] = std::move (changed[i]);
+		}
+	}
+	next->count += added.size();
+	std::atomic_store (&current, std::shared_ptr <const breakpointSnapshot> (std::move (next)));
+	return added.size();
+}
+std::shared_ptr <breakpoint> breakpointTable::removeAddress (uint64_t address)
+{
+	auto table = snapshot ();
+	uint64_t hash = breakpointSnapshot::hashAddress (address);
+	uint32_t shard = breakpointSnapshot::shardOf (hash);
+	const breakpointShard & old = *table->shards[shard];
+	uint32_t index = old.lookup (address, hash);
+	if (index == breakpointShard::EMPTY)
+	{
+		return nullptr;
+	}
+	std::shared_ptr <breakpoint> removed = old.entries[index];
+	auto changed = std::make_shared <breakpointShard> ();
+	changed->entries.reserve (old.entries.size() - 1);
+	changed->entries.insert (changed->entries.end(), old.entries.begin(), old.entries.begin() + index);
+	changed->entries.insert (changed->entries.end(), old.entries.begin() + index + 1, old.entries.end());
+	changed->buildIndex ();
+
+	auto next = std::make_shared <breakpointSnapshot> (*table);
+	next->shards[shard] = std::move (changed);
+	next->count--;
+	std::atomic_store (&current, std::shared_ptr <const breakpointSnapshot> (std::move (next)));
+	idAddresses.erase (removed->getId());
+	return removed;
+}
+std::shared_ptr <breakpoint> breakpointTable::remove (uint64_t address)
+{
+	std::lock_guard <std::mutex> lock (writer);
+	return removeAddress (address);
+}
+std::shared_ptr <breakpoint> breakpointTable::removeById (uint32_t id)
+{
+	std::lock_guard <std::mutex> lock (writer);
+	auto it = idAddresses.find (id);
+	return it == idAddresses.end() ? nullptr : removeAddress (it->second);
+}
+std::vector <std::shared_ptr <breakpoint> > breakpointTable::clear ()
+{
+	std::lock_guard <std::mutex> lock (writer);
+	auto table = snapshot ();
+	auto empty = std::make_shared <breakpointSnapshot> ();
+	empty->shards.assign (breakpointSnapshot::SHARD_COUNT, std::make_shared <const breakpointShard> ());
+	std::atomic_store (&current, std::shared_ptr <const breakpointSnapshot> (std::move (empty)));
+	idAddresses.clear ();
+	return table->getEntries ();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "breakpoint.h"
+
+// Breakpoints of debugged process keyed by address. Top bits of address hash select one of SHARD_COUNT shards, every shard is
+// open addressing hash (linear probing, power of two slots, at most half full). Every breakpoint gets stable id for bl/bd.
+// Readers take immutable snapshot, writers copy only shards they change, rebuild their index and publish snapshot sharing all
+// other shards atomically (RCU like), so breakpoint hit is one lookup that never races with command thread adding or deleting,
+// and adding or deleting one breakpoint copies one shard instead of whole table (one-hit breakpoints of every step).
+// Breakpoint objects are shared by snapshots, hit counts survive publishing.
+
+class breakpointShard
+{
+	friend class breakpointSnapshot;
+	friend class breakpointTable;
+	private:
+		static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+
+		struct slot
+		{
+			uint64_t address;
+			uint32_t index; // into entries, EMPTY for free slot
+		};
+
+		std::vector <std::shared_ptr <breakpoint> > entries; // sorted by id
+		std::vector <slot> slots;
+		uint32_t shift = 64; // (hash << SHARD_BITS) >> shift is home slot of address
+
+		void buildIndex ();
+		uint32_t lookup (uint64_t, uint64_t) const; // index into entries or EMPTY
+};
+
+class breakpointSnapshot
+{
+	friend class breakpointShard;
+	friend class breakpointTable;
+	private:
+		static constexpr uint32_t SHARD_BITS = 8;
+		static constexpr uint32_t SHARD_COUNT = 1 << SHARD_BITS;
+
+		std::vector <std::shared_ptr <const breakpointShard> > shards; // shards not changed by writer are shared with previous snapshot
+		size_t count = 0;
+
+		static uint64_t hashAddress (uint64_t address) { return address * 0x9E3779B97F4A7C15ull; } // Fibonacci hashing, neighbouring addresses land far apart
+		static uint32_t shardOf (uint64_t hash) { return hash >> (64 - SHARD_BITS); }
+		const std::shared_ptr <breakpoint> * lookup (uint64_t) const;
+	public:
+		breakpoint * find (uint64_t address) const; // valid while snapshot is held
+		std::vector <std::shared_ptr <breakpoint> > getEntries () const; // sorted by id, collected from all shards
+		size_t size () const { return count; }
+		bool empty () const { return count == 0; }
+};
+
+class breakpointTable
+{
+	private:
+		std::shared_ptr <const breakpointSnapshot> current;
+		std::mutex writer; // writers are serialized, readers never wait
+		uint32_t nextId = 0;
+		std::map <uint32_t, uint64_t> idAddresses; // id to address of every breakpoint, used under writer lock only
+
+		size_t insert (const std::vector <breakpoint> &); // writer lock is held
+		std::shared_ptr <breakpoint> removeAddress (uint64_t); // writer lock is held
+	public:
+		static constexpr uint32_t NO_ID = 0xFFFFFFFF;
+
+		breakpointTable ();
+
+		std::shared_ptr <const breakpointSnapshot> snapshot () const { return std::atomic_load (&current); }
+		std::shared_ptr <breakpoint> find (uint64_t) const;
+		std::shared_ptr <breakpoint> findById (uint32_t);
+
+		uint32_t add (const breakpoint &); // returns id, NO_ID when address already has breakpoint
+		size_t add (const std::vector <breakpoint> &); // published once, returns number added
+		std::shared_ptr <breakpoint> remove (uint64_t); // removed breakpoint or nullptr
+		std::shared_ptr <breakpoint> removeById (uint32_t);
+		std::vector <std::shared_ptr <breakpoint> > clear (); // all removed breakpoints
+};
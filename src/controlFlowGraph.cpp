@@ -0,0 +1,272 @@
+#include "controlFlowGraph.h"
+#include "parallel.h"
+#include <map>
+#include <set>
+
+namespace
+{
+	enum instructionFlow : uint8_t
+	{
+		FLOW_NEXT = 0, // including calls
+		FLOW_RETURN,
+		FLOW_JUMP,
+		FLOW_CONDITIONAL,
+		FLOW_INDIRECT,
+		FLOW_TRAP, // int3 padding after calls that do not return
+		FLOW_INVALID
+	};
+	struct decodedInstruction
+	{
+		uint8_t size;
+		uint8_t flow;
+		uint64_t target;
+	};
+}
+
+std::vector <controlFlowGraph::localBlock> controlFlowGraph::buildFunction (csh handle, cs_insn * insn, dataSpan<uint8_t> image, uint64_t base, cfgSeed seed)
+{
+	uint64_t rangeStart = seed.end ? seed.start : base;
+	uint64_t rangeEnd = seed.end ? seed.end : base + image.size();
+	auto inFunction = [&] (uint64_t address) { return address >= rangeStart && address < rangeEnd; };
+
+	std::map <uint64_t, decodedInstruction> instructions;
+	std::set <uint64_t> leaders = { seed.start };
+	std::vector <uint64_t> work = { seed.start };
+
+	while (!work.empty() && instructions.size() < MAX_FUNCTION_INSTRUCTIONS) // recursive descent, every leader decoded until end of its flow
+	{
+		uint64_t address = work.back();
+		work.pop_back();
+		while (inFunction (address))
+		{
+			if (instructions.find (address) != instructions.end()) // flow joins code decoded before, block has to be split there
+			{
+				leaders.insert (address);
+				break;
+			}
+			const uint8_t * code = image.data + (address - base);
+			size_t size = rangeEnd - address;
+			uint64_t decodeAddress = address;
+			if (!cs_disasm_iter (handle, &code, &size, &decodeAddress, insn))
+			{
+				instructions[address] = { 1, FLOW_INVALID, 0 };
+				break;
+			}
+			decodedInstruction decoded = { (uint8_t) insn->size, FLOW_NEXT, 0 };
+			instructionType type = disassembler::getInstructionType (*insn, insn->detail);
+			if (type.X86_GRP_RET || type.X86_GRP_IRET)
+			{
+				decoded.flow = FLOW_RETURN;
+			}
+			else if (type.X86_GRP_JUMP && insn->detail->x86.op_count == 1 && insn->detail->x86.operands[0].type == X86_OP_IMM)
+			{
+				decoded.flow = insn->id == X86_INS_JMP ? FLOW_JUMP : FLOW_CONDITIONAL;
+				decoded.target = insn->detail->x86.operands[0].imm;
+			}
+			else if (type.X86_GRP_JUMP)
+			{
+				decoded.flow = FLOW_INDIRECT;
+			}
+			else if (insn->id == X86_INS_INT3)
+			{
+				decoded.flow = FLOW_TRAP;
+			}
+			instructions[address] = decoded;
+
+			if ((decoded.flow == FLOW_JUMP || decoded.flow == FLOW_CONDITIONAL) && inFunction (decoded.target) && leaders.insert (decoded.target).second)
+			{
+				work.push_back (decoded.target);
+			}
+			if (decoded.flow == FLOW_CONDITIONAL)
+			{
+				leaders.insert (address + decoded.size);
+			}
+			else if (decoded.flow != FLOW_NEXT)
+			{
+				break;
+			}
+			address += decoded.size;
+		}
+	}
+
+	std::vector <localBlock> toRet;
+	for (uint64_t leader : leaders) // block runs from leader to terminator, next leader or end of decoded code
+	{
+		auto it = instructions.find (leader);
+		if (it == instructions.end())
+		{
+			continue;
+		}
+		localBlock block = { leader, leader, 0, 0, 0, { 0, 0 } };
+		while (true)
+		{
+			const decodedInstruction & decoded = it->second;
+			uint64_t next = it->first + decoded.size;
+			block.end = next;
+			block.instructionCount++;
+			if (decoded.flow == FLOW_RETURN)
+			{
+				block.flags |= BLOCK_RETURN;
+				break;
+			}
+			if (decoded.flow == FLOW_INDIRECT)
+			{
+				block.flags |= BLOCK_INDIRECT;
+				break;
+			}
+			if (decoded.flow == FLOW_INVALID)
+			{
+				block.flags |= BLOCK_INVALID;
+				break;
+			}
+			if (decoded.flow == FLOW_TRAP)
+			{
+				break;
+			}
+			if (decoded.flow == FLOW_JUMP || decoded.flow == FLOW_CONDITIONAL)
+			{
+				block.successors[block.successorCount++] = decoded.target;
+				if (!inFunction (decoded.target))
+				{
+					block.flags |= BLOCK_TAIL_CALL;
+				}
+				if (decoded.flow == FLOW_CONDITIONAL)
+				{
+					block.successors[block.successorCount++] = next;
+				}
+				break;
+			}
+			it = instructions.find (next);
+			if (leaders.count (next) || it == instructions.end()) // falls through into another block or out of function range
+			{
+				block.successors[block.successorCount++] = next;
+				if (!inFunction (next))
+				{
+					block.flags |= BLOCK_TAIL_CALL;
+				}
+				break;
+			}
+		}
+		toRet.push_back (block);
+	}
+	return toRet;
+}
+bool controlFlowGraph::build (dataSpan<uint8_t> image, uint64_t base, std::vector <cfgSeed> seeds)
+{
+	clear ();
+	std::sort (seeds.begin(), seeds.end(), [] (const cfgSeed & a, const cfgSeed & b) { return a.start < b.start || (a.start == b.start && a.end > b.end); });
+	seeds.erase (std::unique (seeds.begin(), seeds.end(), [] (const cfgSeed & a, const cfgSeed & b) { return a.start == b.start; }), seeds.end()); // seed with known range wins
+	seeds.erase (std::remove_if (seeds.begin(), seeds.end(), [&] (const cfgSeed & s) { return s.start < base || s.start >= base + image.size() || (s.end && s.end > base + image.size()); }), seeds.end());
+
+	unsigned workers = parallelWorkers (seeds.size(), MIN_FUNCTIONS_PER_WORKER);
+	std::vector <csh> handles (workers);
+	std::vector <cs_insn *> insns (workers, nullptr);
+	bool opened = true;
+	for (unsigned i = 0; i < workers; i++)
+	{
+		if (cs_open (CS_ARCH_X86, CS_MODE_64, &handles[i]) != CS_ERR_OK)
+		{
+			workers = i;
+			opened = false;
+			break;
+		}
+		cs_option (handles[i], CS_OPT_DETAIL, CS_OPT_ON);
+		insns[i] = cs_malloc (handles[i]);
+	}
+	std::vector <std::vector <localBlock> > results (seeds.size());
+	if (opened)
+	{
+		parallelSteal (seeds.size(), workers, [&] (unsigned worker, size_t index) // function sizes differ a lot, idle workers steal
+		{
+			results[index] = buildFunction (handles[worker], insns[worker], image, base, seeds[index]);
+		});
+	}
+	for (unsigned i = 0; i < workers; i++)
+	{
+		cs_free (insns[i], 1);
+		cs_close (&handles[i]);
+	}
+	if (!opened)
+	{
+		return false;
+	}
+
+	struct blockRef
+	{
+		uint64_t start;
+		uint32_t function;
+		uint32_t index;
+	};
+	std::vector <blockRef> order;
+	for (uint32_t f = 0; f < results.size(); f++)
+	{
+		for (uint32_t i = 0; i < results[f].size(); i++)
+		{
+			order.push_back ( { results[f][i].start, f, i } );
+		}
+	}
+	std::sort (order.begin(), order.end(), [] (const blockRef & a, const blockRef & b) { return a.start < b.start || (a.start == b.start && a.function < b.function); });
+
+	blocks.reserve (order.size());
+	functions.resize (seeds.size());
+	for (const auto & ref : order)
+	{
+		const localBlock & local = results[ref.function][ref.index];
+		blocks.push_back ( { local.start, local.end, ref.function, local.instructionCount, (uint32_t) successors.size(), local.successorCount, local.flags } );
+		successors.insert (successors.end(), local.successors, local.successors + local.successorCount);
+		functions[ref.function].blockCount++;
+	}
+	uint32_t firstBlock = 0;
+	for (uint32_t f = 0; f < functions.size(); f++)
+	{
+		functions[f].entry = seeds[f].start;
+		functions[f].end = seeds[f].end;
+		functions[f].firstBlock = firstBlock;
+		firstBlock += functions[f].blockCount;
+	}
+	functionBlocks.resize (blocks.size());
+	std::vector <uint32_t> filled (functions.size(), 0);
+	for (uint32_t b = 0; b < blocks.size(); b++) // blocks are visited by start, so blocks of every function stay sorted
+	{
+		cfgFunction & function = functions[blocks[b].function];
+		functionBlocks[function.firstBlock + filled[blocks[b].function]++] = b;
+	}
+	return true;
+}
+void controlFlowGraph::clear ()
+{
+	blocks.clear ();
+	successors.clear ();
+	functions.clear ();
+	functionBlocks.clear ();
+}
+const cfgBlock * controlFlowGraph::blockContaining (uint64_t address) const
+{
+	auto it = std::upper_bound (blocks.begin(), blocks.end(), address, [] (uint64_t a, const cfgBlock & b) { return a < b.start; });
+	for (size_t scanned = 0; it != blocks.begin() && scanned < MAX_OVERLAP_SCAN; scanned++)
+	{
+		--it;
+		if (address < it->end)
+		{
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+const cfgFunction * controlFlowGraph::functionAt (uint64_t entry) const
+{
+	auto it = std::lower_bound (functions.begin(), functions.end(), entry, [] (const cfgFunction & f, uint64_t e) { return f.entry < e; });
+	if (it != functions.end() && it->entry == entry)
+	{
+		return &*it;
+	}
+	return nullptr;
+}
+dataSpan<uint64_t> controlFlowGraph::getSuccessors (const cfgBlock * block) const
+{
+	return { successors.data() + block->firstSuccessor, block->successorCount };
+}
+dataSpan<uint32_t> controlFlowGraph::getFunctionBlocks (const cfgFunction * function) const
+{
+	return { functionBlocks.data() + function->firstBlock, function->blockCount };
+}
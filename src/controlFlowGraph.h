@@ -0,0 +1,85 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+#include <vector>
+
+#include <capstone/capstone.h>
+#include "utils.h"
+#include "disassembly.h"
+
+// Basic blocks and per function control flow graph built by recursive descent from function starts
+// (.pdata, function symbols, entry point). Every function is decoded on its own by worker threads,
+// then blocks of all functions are merged into one array sorted by start for O(log n) address to block lookup.
+// Calls do not end blocks, jumps outside of function range are kept as successors and marked as tail calls.
+
+enum cfgBlockFlags : uint16_t
+{
+	BLOCK_RETURN = 1,
+	BLOCK_INDIRECT = 2, // jump through register or memory, successors unknown
+	BLOCK_TAIL_CALL = 4, // successor outside of function
+	BLOCK_INVALID = 8 // decoding stopped on bytes that are not instruction
+};
+
+struct cfgSeed
+{
+	uint64_t start;
+	uint64_t end; // 0 when function range is unknown (symbol or entry point), then whole image is function range
+};
+
+struct cfgBlock
+{
+	uint64_t start;
+	uint64_t end; // first byte after last instruction
+	uint32_t function; // index into functions
+	uint32_t instructionCount;
+	uint32_t firstSuccessor; // index into successors
+	uint16_t successorCount;
+	uint16_t flags; // cfgBlockFlags
+};
+
+struct cfgFunction
+{
+	uint64_t entry;
+	uint64_t end;
+	uint32_t firstBlock; // index into functionBlocks
+	uint32_t blockCount;
+};
+
+class controlFlowGraph
+{
+	private:
+		static constexpr uint32_t MAX_FUNCTION_INSTRUCTIONS = 0x40000; // garbage must not be decoded forever
+		static constexpr size_t MIN_FUNCTIONS_PER_WORKER = 64;
+		static constexpr size_t MAX_OVERLAP_SCAN = 8; // blocks of different functions may overlap
+
+		struct localBlock
+		{
+			uint64_t start;
+			uint64_t end;
+			uint32_t instructionCount;
+			uint16_t flags;
+			uint8_t successorCount;
+			uint64_t successors [2];
+		};
+
+		std::vector <cfgBlock> blocks; // sorted by start
+		std::vector <uint64_t> successors;
+		std::vector <cfgFunction> functions; // sorted by entry
+		std::vector <uint32_t> functionBlocks; // indexes into blocks, grouped by function and sorted by start
+
+		static std::vector <localBlock> buildFunction (csh, cs_insn *, dataSpan<uint8_t>, uint64_t, cfgSeed);
+	public:
+		bool build (dataSpan<uint8_t>, uint64_t, std::vector <cfgSeed>); // image in memory layout at base
+		void clear ();
+
+		const cfgBlock * blockContaining (uint64_t) const;
+		const cfgFunction * functionAt (uint64_t) const; // exact entry
+		const cfgFunction * getFunction (const cfgBlock * block) const { return &functions[block->function]; }
+		dataSpan<uint64_t> getSuccessors (const cfgBlock *) const;
+		dataSpan<uint32_t> getFunctionBlocks (const cfgFunction *) const;
+		const cfgBlock & getBlock (uint32_t index) const { return blocks[index]; }
+		size_t size () const { return blocks.size(); }
+		size_t functionCount () const { return functions.size(); }
+		bool empty () const { return blocks.empty(); }
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+template <class T>
+struct dataSpan // read only view into memory owned by someone else (e.g. mapped file)
+{
+    const T * data = nullptr;
+    size_t count = 0;
+
+    const T * begin () const { return data; }
+    const T * end () const { return data + count; }
+    size_t size () const { return count; }
+    bool empty () const { return count == 0; }
+    const T & operator[] (size_t i) const { return data[i]; }
+};
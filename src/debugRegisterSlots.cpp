@@ -0,0 +1,129 @@
+#include "debugRegisterSlots.h"
+
+uint64_t debugRegisterSlots::encodeLength (uint8_t length) // LEN bits, 8 bytes is 10b and 4 bytes 11b
+{
+	switch (length)
+	{
+		case 2: return 1;
+		case 8: return 2;
+		case 4: return 3;
+		default: return 0;
+	}
+}
+bool debugRegisterSlots::isValid (uint64_t address, hardwareCondition condition, uint8_t length)
+{
+	if (condition == hardwareCondition::EXECUTE)
+	{
+		return length == 1;
+	}
+	if (length != 1 && length != 2 && length != 4 && length != 8)
+	{
+		return false;
+	}
+	return (address & (length - 1)) == 0; // unaligned range would watch different bytes
+}
+int debugRegisterSlots::hitSlot (uint64_t dr6)
+{
+	for (int i = 0; i < SLOT_COUNT; i++)
+	{
+		if (dr6 & DR6_HIT_BITS & ((uint64_t) 1 << i))
+		{
+			return i;
+		}
+	}
+	return NO_SLOT;
+}
+const char * debugRegisterSlots::getConditionName (hardwareCondition condition)
+{
+	switch (condition)
+	{
+		case hardwareCondition::EXECUTE: return "execute";
+		case hardwareCondition::WRITE: return "write";
+		case hardwareCondition::READ_WRITE: return "read/write";
+	}
+	return "";
+}
+bool debugRegisterSlots::parseCondition (std::string name, hardwareCondition & condition)
+{
+	if (name == "x" || name == "execute")
+	{
+		condition = hardwareCondition::EXECUTE;
+	}
+	else if (name == "w" || name == "write")
+	{
+		condition = hardwareCondition::WRITE;
+	}
+	else if (name == "rw" || name == "readwrite")
+	{
+		condition = hardwareCondition::READ_WRITE;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+int debugRegisterSlots::allocate (uint64_t address, hardwareCondition condition, uint8_t length)
+{
+	if (!isValid (address, condition, length) || find (address, condition) != NO_SLOT)
+	{
+		return NO_SLOT;
+	}
+	for (int i = 0; i < SLOT_COUNT; i++)
+	{
+		if (!slots[i].used)
+		{
+			slots[i] = { true, address, condition, length, 0 };
+			return i;
+		}
+	}
+	return NO_SLOT;
+}
+bool debugRegisterSlots::release (int slot)
+{
+	if (!isUsed (slot))
+	{
+		return false;
+	}
+	slots[slot] = hardwareSlot ();
+	return true;
+}
+int debugRegisterSlots::find (uint64_t address, hardwareCondition condition) const
+{
+	for (int i = 0; i < SLOT_COUNT; i++)
+	{
+		if (slots[i].used && slots[i].address == address && slots[i].condition == condition)
+		{
+			return i;
+		}
+	}
+	return NO_SLOT;
+}
+bool debugRegisterSlots::empty () const
+{
+	for (const auto & slot : slots)
+	{
+		if (slot.used)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t debugRegisterSlots::getDr7 () const
+{
+	uint64_t dr7 = 0;
+	for (int i = 0; i < SLOT_COUNT; i++)
+	{
+		if (!slots[i].used)
+		{
+			continue;
+		}
+		dr7 |= (uint64_t) 1 << (i * 2); // local enable, windows keeps it per thread
+		dr7 |= (uint64_t) slots[i].condition << (16 + i * 4);
+		dr7 |= encodeLength (slots[i].length) << (18 + i * 4);
+	}
+	return dr7;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string>
+
+// Hardware breakpoint slots and their debug register encoding, free of Win32 so it builds and is tested on any host.
+// DR0-DR3 hold addresses, DR7 enables slots (local enable bit of every slot) and tells what they break on (R/W bits)
+// and how many bytes they watch (LEN bits), DR6 tells which slot was hit.
+
+enum class hardwareCondition : uint8_t // R/W bits of DR7
+{
+	EXECUTE = 0,
+	WRITE = 1,
+	READ_WRITE = 3 // 2 is I/O, not available in user mode
+};
+
+struct hardwareSlot
+{
+	bool used = false;
+	uint64_t address = 0;
+	hardwareCondition condition = hardwareCondition::EXECUTE;
+	uint8_t length = 1;
+	uint64_t hitCount = 0;
+};
+
+class debugRegisterSlots
+{
+	public:
+		static constexpr int SLOT_COUNT = 4;
+		static constexpr int NO_SLOT = -1;
+	private:
+		static constexpr uint64_t DR7_SLOT_BITS = 0xFFFF00FF; // enable bits 0-7, R/W and LEN bits 16-31
+		static constexpr uint64_t DR6_HIT_BITS = 0xF; // B0-B3
+
+		hardwareSlot slots [SLOT_COUNT];
+
+		static uint64_t encodeLength (uint8_t);
+	public:
+		static bool isValid (uint64_t, hardwareCondition, uint8_t); // execute watches 1 byte, data 1, 2, 4 or 8 aligned bytes
+		static int hitSlot (uint64_t dr6); // lowest slot whose B bit is set, NO_SLOT when none
+		static const char * getConditionName (hardwareCondition);
+		static bool parseCondition (std::string, hardwareCondition &); // x, w, rw
+
+		int allocate (uint64_t, hardwareCondition, uint8_t); // NO_SLOT when all slots are used or breakpoint is invalid or already set
+		bool release (int);
+		int find (uint64_t, hardwareCondition) const;
+		bool isUsed (int slot) const { return slot >= 0 && slot < SLOT_COUNT && slots[slot].used; }
+		const hardwareSlot & getSlot (int slot) const { return slots[slot]; }
+		void incrementHitCount (int slot) { slots[slot].hitCount++; }
+		bool empty () const;
+
+		uint64_t getDr7 () const; // slot bits of used slots
+
+		// any context with Dr0-Dr3 and Dr7 fields (CONTEXT on Windows), other bits of DR7 are kept
+		template <typename C> void applyTo (C & context) const
+		{
+			context.Dr0 = slots[0].used ? slots[0].address : 0;
+			context.Dr1 = slots[1].used ? slots[1].address : 0;
+			context.Dr2 = slots[2].used ? slots[2].address : 0;
+			context.Dr3 = slots[3].used ? slots[3].address : 0;
+			context.Dr7 = (context.Dr7 & ~DR7_SLOT_BITS) | getDr7 ();
+		}
+};
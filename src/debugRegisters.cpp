@@ -0,0 +1,20 @@
+#include "debugRegisters.h"
+#include <string.h>
+
+void debugRegisters::apply (CONTEXT & context) const
+{
+	applyTo (context);
+}
+bool debugRegisters::applyToThread (contextAccessor & accessor, DWORD threadId) const
+{
+	CONTEXT context;
+	memset (&context, 0, sizeof (context));
+	context.ContextFlags = CONTEXT_DEBUG_REGISTERS;
+	if (!accessor.get (threadId, context))
+	{
+		return false;
+	}
+	apply (context);
+	context.ContextFlags = CONTEXT_DEBUG_REGISTERS;
+	return accessor.set (threadId, context);
+}
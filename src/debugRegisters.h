@@ -0,0 +1,17 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+
+#include "debugRegisterSlots.h"
+#include "threadContext.h"
+
+// Hardware breakpoint slots written into debug registers of threads of debugged process.
+// Slots are the same in every thread, they are written into context of each of them.
+
+class debugRegisters : public debugRegisterSlots
+{
+	public:
+		void apply (CONTEXT &) const; // DR0-DR3 and slot bits of DR7
+		bool applyToThread (contextAccessor &, DWORD) const; // reads debug registers of thread, applies slots and writes them back
+};
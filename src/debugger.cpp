@@ -15,112 +15,87 @@ t_GetFinalPathNameByHandleA GetFinalPathNameByHandleA()
     return f_GetFinalPathNameByHandleA;
 }
 
-breakpoint * debugger::searchForBreakpoint (std::vector <breakpoint> & b, void * address)
+bool debugger::decodeInstructionAt (uint64_t address, instructionLength & instruction)
 {
-    for (auto & i : b)
+    uint8_t code [MAX_X86_INSTRUCTION_LENGTH];
+    size_t size = sizeof (code);
+    if (!processReader->read (address, code, size)) // short instruction can be last one before unreadable page
     {
-        if (i.getAddress() == address)
+        size = std::min <size_t> (size, 0x1000 - (address & 0xFFF));
+        if (!processReader->read (address, code, size))
         {
-            return &i;
+            log ("Cannot read memory at %.16llx\n",logType::ERR, stdoutHandle, address);
+            return false;
         }
     }
-    return nullptr;
+    instruction = getInstructionLength (code, size);
+    return instruction.length != 0;
 }
-void * debugger::getNextInstructionAddress (void * ref)
+bool debugger::isInstructionStart (uint64_t address) // walks lengths from start of function, true when it cannot tell
 {
-    uint8_t * codeBuffer = new uint8_t [50];
-    if (!ReadProcessMemory (debuggedProcessHandle, (LPCVOID) ref, codeBuffer, 50 , NULL))
+    const functionRange * function = imageSymbols.functionContaining (address);
+    if (!function)
     {
-        log ("Cannot read memory at %.16llx\n",logType::ERR, stdoutHandle,  ref);
-        delete codeBuffer;
-        return nullptr;
+        return true;
     }
-    csh handle;
-    cs_insn *insn;
-    size_t count;
-
-    if (cs_open(CS_ARCH_X86, CS_MODE_64, &handle) != CS_ERR_OK)
+    uint64_t functionStart = imageSymbols.getBase () + function->start;
+    std::vector <uint8_t> code (address - functionStart + MAX_X86_INSTRUCTION_LENGTH);
+    if (!processReader->read (functionStart, code.data(), code.size()))
     {
-        delete codeBuffer;
-        return nullptr;
-    }
-    count = cs_disasm (handle, codeBuffer, 50 , (uint64_t) ref, 0, &insn);
-    if (count >= 2)
-    {  
-        void * toRet = (void *) insn[1].address;
-        cs_free (insn,count);
-        delete codeBuffer;
-        return toRet;
+        return true;
     }
-    else
+    uint64_t offset = 0;
+    while (offset < address - functionStart)
     {
-        delete codeBuffer;
-        return nullptr;
+        instructionLength instruction = getInstructionLength (code.data() + offset, code.size() - offset);
+        if (instruction.length == 0) // data inside of function
+        {
+            return true;
+        }
+        offset += instruction.length;
     }
-    
+    return offset == address - functionStart;
 }
 void debugger::disasmAt (void * address, int numberOfInstructions)
 {
-    static disassembler d {debuggedProcessBaseAddress, &COFFsymbols, &functionNames};
-    std::vector <breakpoint *> disassembledBreakpoints;
-    uint8_t * codeBuffer = new uint8_t [numberOfInstructions * d.MAX_INSTRUCTION_LENGTH];
-    uint64_t readBytes;
-    if (!ReadProcessMemory (debuggedProcessHandle, (LPCVOID) address, codeBuffer, numberOfInstructions * d.MAX_INSTRUCTION_LENGTH , &readBytes) && readBytes == 0)
+    static disassembler d {&imageSymbols, &codeCache};
+    static bool resolverSet = false;
+    if (!resolverSet)
     {
-        log ("Cannot read memory at %.16llx\n",logType::ERR, stdoutHandle, address);
-        return;
+        d.setAddressResolver ([this] (uint64_t target) { return getExportNameForAddress (target); });
+        resolverSet = true;
     }
-    if (readBytes != numberOfInstructions * d.MAX_INSTRUCTION_LENGTH)
+    std::shared_ptr <const breakpointSnapshot> current = breakpoints.snapshot ();
+    if (numberOfInstructions < 0) // instructions before address
     {
-        log ("Could read only %i bytes of memory at %.16llx\n",logType::ERR, stdoutHandle,readBytes , address);
+        d.disasmBackward (*processReader, (uint64_t) address, -numberOfInstructions, *current);
+        return;
     }
-    /*
-    memoryHelper h (debuggedProcessHandle, stdoutHandle);
-    h.printHexdump (address, readBytes);
-    */
-    d.disasm ((uint64_t) address, codeBuffer, readBytes, numberOfInstructions, breakpoints);    
-    delete codeBuffer;
+    d.disasm (*processReader, (uint64_t) address, numberOfInstructions, *current);
 }
-CONTEXT debugger::getContext (DWORD flags)
+const CONTEXT & debugger::getContext (DWORD flags) // reads only parts not read since the event
 {
-    CONTEXT lcContext;
-    lcContext.ContextFlags = flags;
-    HANDLE threadHandle = OpenThread (THREAD_GET_CONTEXT | THREAD_SUSPEND_RESUME, FALSE, currentDebugEvent.dwThreadId);
-    if (threadHandle == NULL)
-    {
-        log ("Cannot get thread handle when getting context \n",logType::ERR, stdoutHandle);
-        return lcContext;
-    }
-    if(SuspendThread(threadHandle) == -1)
-    {
-        log ("Cannot get handle to thread that caused exception  \n",logType::ERR, stdoutHandle);
-        return lcContext;
-    }
-
-    if (!GetThreadContext(threadHandle, &lcContext))
+    if (!currentContext.read (flags))
     {
-        log ("Cannot get thread context that caused exception \n",logType::ERR, stdoutHandle);
-        return lcContext;
+        log ("Cannot get context of thread %u\n",logType::ERR, stdoutHandle, currentContext.getThreadId ());
     }
-    if(ResumeThread(threadHandle) == -1)
-    {
-        log ("Cannot resume thread after getting context \n",logType::ERR, stdoutHandle);
-        return lcContext;
-    }
-    return lcContext;
+    return currentContext.get ();
+}
+CONTEXT & debugger::modifyContext (DWORD flags) // parts returned are written back before the event is continued
+{
+    getContext (flags);
+    return currentContext.modify (flags);
 }
-void debugger::setContext (CONTEXT & context)
+void debugger::setContext ()
 {
-    HANDLE threadHandle = OpenThread (THREAD_SET_CONTEXT, FALSE, currentDebugEvent.dwThreadId);
-    if (!SetThreadContext(threadHandle, &context))
+    if (!currentContext.flush ())
     {
-        log ("Cannot set thread context",logType::ERR, stdoutHandle);
-        return;
+        log ("Cannot set context of thread %u\n",logType::ERR, stdoutHandle, currentContext.getThreadId ());
     }
 }
 void debugger::showContext ()
 {
-    CONTEXT lcContext = this->currentContext;
+    CONTEXT lcContext = getContext (CONTEXT_CONTROL | CONTEXT_INTEGER);
 
     printf ("\n");
 
@@ -138,28 +113,16 @@ void debugger::showContext ()
 
     printf ("\n");
 
-    uint64_t displacement;
-    SymInitialize(debuggedProcessHandle, NULL, TRUE ); // ?????? 
-    char * buffer = new char [sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR)];
-    memset (buffer, 0, sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR));
-    PSYMBOL_INFO pSymbol = (PSYMBOL_INFO) buffer;
-    pSymbol->SizeOfStruct = sizeof(SYMBOL_INFO);
-    pSymbol->MaxNameLen = MAX_SYM_NAME;
-
-    SymFromAddr(debuggedProcessHandle, ( ULONG64 )currentContext.Rip, &displacement, pSymbol);
-    size_t symbolNameSize = strlen (pSymbol->Name);
-
-    std::string internalFuncName = getFunctionNameForAddress((uint64_t)currentContext.Rip);
+    std::string funcName = getSymbolForAddress((uint64_t)lcContext.Rip);
     log ("-----> %s\n",
         logType::INFO,
         stdoutHandle,
-        (symbolNameSize > 0 ? pSymbol->Name : internalFuncName.c_str())
+        funcName.c_str()
         );
 
-    delete [] buffer;
-
     printf ("\n");
 
+    disasmAt ((void *)lcContext.Rip, -SHOW_CONTEXT_PREVIOUS_INSTRUCTION_COUNT);
     disasmAt ((void *)lcContext.Rip, SHOW_CONTEXT_INSTRUCTION_COUNT);   
 
     printf ("\n"); 
@@ -171,29 +134,61 @@ void debugger::breakpointEntryPoint (CREATE_PROCESS_DEBUG_INFO * info)
     uint64_t entryVA = (uint64_t) info->lpBaseOfImage + (uint64_t) entryRVA;
     placeSoftwareBreakpoint ((void *) entryVA, false);
 }
-void debugger::checkInterruptEvent ()
+bool debugger::checkInterruptEvent ()
 {
-    for (const auto & i : interruptingEvents) 
+    bool interrupt = interruptingEvents.count (currentDebugEvent.dwDebugEventCode) != 0;
+    if (interrupt && currentDebugEvent.dwDebugEventCode == EXCEPTION_DEBUG_EVENT)
     {
-        if (i == EXCEPTION_DEBUG_EVENT)
-        {
-            for (const auto & j : interruptingExceptions)
-            {
-                if (currentDebugEvent.u.Exception.ExceptionRecord.ExceptionCode == j)
-                {
-                    SetEvent (commandEvent);
-                    WaitForSingleObject (continueDebugEvent,INFINITE);
-                    // wait for command to be executed
-                }
-            }
-        }
-        else if (currentDebugEvent.dwDebugEventCode == i)
-        {
-            SetEvent (commandEvent);
-            WaitForSingleObject (continueDebugEvent,INFINITE);
-            // wait for command to be executed
-        }
+        interrupt = exceptionPolicies.get (currentDebugEvent.u.Exception.ExceptionRecord.ExceptionCode) == exceptionPolicy::STOP;
+    }
+    if (interrupt)
+    {
+        SetEvent (commandEvent);
+        WaitForSingleObject (continueDebugEvent,INFINITE);
+        // wait for command to be executed
+    }
+    return interrupt;
+}
+bool debugger::isFastEvent (const DEBUG_EVENT & event) const // events that do not stop are continued without context
+{
+    if (event.dwDebugEventCode == CREATE_THREAD_DEBUG_EVENT && !hardwareBreakpoints.empty ()) // debug registers are written to new thread
+    {
+        return false;
     }
+    if (event.dwDebugEventCode != EXCEPTION_DEBUG_EVENT)
+    {
+        return interruptingEvents.count (event.dwDebugEventCode) == 0;
+    }
+    DWORD code = event.u.Exception.ExceptionRecord.ExceptionCode;
+    if (code == EXCEPTION_BREAKPOINT || code == EXCEPTION_SINGLE_STEP) // own breakpoints and stepping change context even when they do not stop
+    {
+        return false;
+    }
+    return interruptingEvents.count (EXCEPTION_DEBUG_EVENT) == 0 || exceptionPolicies.get (code) != exceptionPolicy::STOP;
+}
+void debugger::showEventStats ()
+{
+    auto now = std::chrono::steady_clock::now ();
+    double total = std::chrono::duration<double> (now - eventCountStart).count ();
+    double sinceLast = std::chrono::duration<double> (now - lastEventQuery).count ();
+    uint64_t events = debugEventCount;
+    log ("%llu debug events, %llu continued on fast path, %.0f events/s overall, %.0f events/s since last query\n", logType::INFO, stdoutHandle,
+        events, (uint64_t) fastEventCount, total > 0 ? events / total : 0.0, sinceLast > 0 ? (events - lastEventCount) / sinceLast : 0.0);
+    log ("Event to continue: fast path %.1f us average, %llu us max; full path %.1f us average, %llu us max\n", logType::INFO, stdoutHandle,
+        fastPathLatency.average (), fastPathLatency.maximum, fullPathLatency.average (), fullPathLatency.maximum);
+    log ("Stop to prompt: %.1f us average, %llu us max; %llu context reads, %llu context writes\n", logType::INFO, stdoutHandle,
+        stopToPromptLatency.average (), stopToPromptLatency.maximum, currentContext.getReads (), currentContext.getWrites ());
+    lastEventCount = events;
+    lastEventQuery = now;
+}
+void debugger::showExceptionPolicies ()
+{
+    for (const auto & entry : exceptionPolicies.getEntries ())
+    {
+        const char * name = exceptionPolicyTable::getExceptionName (entry.code);
+        log ("0x%.08x %-24s %s\n", logType::INFO, stdoutHandle, entry.code, name ? name : "", exceptionPolicyTable::getPolicyName (entry.policy));
+    }
+    log ("other exceptions %s\n", logType::INFO, stdoutHandle, exceptionPolicyTable::getPolicyName (exceptionPolicies.getDefault ()));
 }
 DWORD debugger::run (std::string fileName)
 {
@@ -212,8 +207,11 @@ DWORD debugger::run (std::string fileName)
 
     debuggedProcessHandle = pi.hProcess;
 
-    memHelper = new memoryHelper (debuggedProcessHandle, stdoutHandle);
+    memHelper = new memoryHelper (debuggedProcessHandle, stdoutHandle, &breakpointBytes);
+    processReader = new processMemoryReader (debuggedProcessHandle, &breakpointBytes);
+    stackUnwinder = new unwinder (*processReader, [this] (uint64_t address) { return currentMemoryMap->getImageBaseForAddress (address); });
 
+    eventCountStart = lastEventQuery = std::chrono::steady_clock::now ();
     while (debuggingActive)
     {
         ZeroMemory ( &currentDebugEvent, sizeof(currentDebugEvent));
@@ -223,224 +221,673 @@ DWORD debugger::run (std::string fileName)
             log ("WaitForDebugEven returned nonzero value\n",logType::ERR, stdoutHandle);
             return 2;
         }
+        debugEventCount++;
+        lastEventTime = std::chrono::steady_clock::now ();
 
-        this->currentContext = getContext (CONTEXT_ALL);
+        if (isFastEvent (currentDebugEvent)) // nothing reads or changes context, thread is not touched at all
+        {
+            fastEventCount++;
+            DWORD debugResponse = processDebugEvents (&currentDebugEvent, &debuggingActive);
+            fastPathLatency.add (std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - lastEventTime).count ());
+            codeCache.targetContinued ();
+            ContinueDebugEvent (currentDebugEvent.dwProcessId, currentDebugEvent.dwThreadId, debugResponse);
+            continue;
+        }
+
+        currentContext.reset (currentDebugEvent.dwThreadId); // read lazily by handlers and commands that need it
 
         DWORD debugResponse = processDebugEvents(&currentDebugEvent, &debuggingActive);
 
+        bool interrupted = false;
         if (!bypassInterruptOnce)
         {
-            checkInterruptEvent ();          
-            setContext (this->currentContext);
-            ContinueDebugEvent (currentDebugEvent.dwProcessId,currentDebugEvent.dwThreadId,debugResponse); 
+            interrupted = checkInterruptEvent ();
         }
-        else 
+        else
         {
             bypassInterruptOnce = false;
-            setContext (this->currentContext);
-            ContinueDebugEvent (currentDebugEvent.dwProcessId,currentDebugEvent.dwThreadId,debugResponse);
         }
+        setContext ();
+        if (!interrupted)
+        {
+            fullPathLatency.add (std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - lastEventTime).count ());
+        }
+        codeCache.targetContinued ();
+        ContinueDebugEvent (currentDebugEvent.dwProcessId,currentDebugEvent.dwThreadId,debugResponse);
     }
     return 0;
 }
 void debugger::showBreakpoints ()
 {
-    int j = 0;
-    for (auto & i : breakpoints)
+    std::shared_ptr <const breakpointSnapshot> current = breakpoints.snapshot ();
+    for (const auto & i : current->getEntries())
+    {
+        log ("Breakpoint [%u] address %.16llx oneHit %d hitCount %d\n",logType::INFO, stdoutHandle, i->getId(), i->getAddress(), i->getIsOneHit(), i->getHitCount());
+    }
+    for (int slot = 0; slot < debugRegisters::SLOT_COUNT; slot++)
+    {
+        if (hardwareBreakpoints.isUsed (slot))
+        {
+            const hardwareSlot & hw = hardwareBreakpoints.getSlot (slot);
+            log ("Hardware breakpoint [DR%d] address %.16llx %s %u bytes hitCount %llu\n",logType::INFO, stdoutHandle,
+                slot, hw.address, debugRegisters::getConditionName (hw.condition), hw.length, hw.hitCount);
+        }
+    }
+}
+void debugger::removeBreakpoint (breakpoint & bp)
+{
+    if (!bp.restore (debuggedProcessHandle)) // int3 must not stay in code after breakpoint is gone
     {
-        log ("Breakpoint [%d] address %.16llx oneHit %d hitCount %d\n",logType::INFO, stdoutHandle, j, i.getAddress(), i.getIsOneHit(), i.getHitCount());
-        j++;
+        log ("Cannot restore original byte at %.16llx\n",logType::ERR, stdoutHandle, bp.getAddress());
     }
+    breakpointBytes.remove ((uint64_t) bp.getAddress());
+    codeCache.invalidate ((uint64_t) bp.getAddress(), 1);
 }
 bool debugger::deleteBreakpointByAddress (void * address)
 {
-    for (auto it = std::begin (breakpoints); it != std::end (breakpoints); ++it) 
+    std::shared_ptr <breakpoint> bp = breakpoints.remove ((uint64_t) address);
+    if (!bp)
     {
-        if (it->getAddress() == address)
-        {
-            breakpoints.erase (it);
-            return true;
-        }
+        return false;
     }
-    return false;
+    removeBreakpoint (*bp);
+    return true;
 }
-bool debugger::deleteBreakpointByIndex (uint64_t number)
+bool debugger::deleteBreakpointById (uint32_t id)
 {
-    if (number < breakpoints.size())
+    std::shared_ptr <breakpoint> bp = breakpoints.removeById (id);
+    if (!bp)
     {
-        breakpoints.erase (breakpoints.begin() + number);
+        return false;
     }
+    removeBreakpoint (*bp);
+    return true;
 }
 void debugger::setRegisterWithValue (std::string registerString, uint64_t value)
 {
+    bool controlRegister = registerString == "rsp" || registerString == "RSP" || registerString == "rflags" || registerString == "RFLAGS";
+    CONTEXT & context = modifyContext (controlRegister ? CONTEXT_CONTROL : CONTEXT_INTEGER);
     if (registerString == "rax" | registerString == "RAX" )
     {
-        currentContext.Rax = value;
+        context.Rax = value;
     }
     else if (registerString == "rbx" | registerString == "RBX" )
     {
-        currentContext.Rbx = value;
+        context.Rbx = value;
     }
     else if (registerString == "rcx" | registerString == "RCX" )
     {
-        currentContext.Rcx = value;
+        context.Rcx = value;
     }
     else if (registerString == "rdx" | registerString == "RDX" )
     {
-        currentContext.Rdx = value;
+        context.Rdx = value;
     }
     else if (registerString == "rbp" | registerString == "RBP" )
     {
-        currentContext.Rbp = value;
+        context.Rbp = value;
     }
     else if (registerString == "rsp" | registerString == "RSP" )
     {
-        currentContext.Rsp = value;
+        context.Rsp = value;
     }
     else if (registerString == "rdi" | registerString == "RDI" )
     {
-        currentContext.Rdi = value;
+        context.Rdi = value;
     }
     else if (registerString == "rsi" | registerString == "RSI" )
     {
-        currentContext.Rsi = value;
+        context.Rsi = value;
     }
     else if (registerString == "r8" | registerString == "R8" )
     {
-        currentContext.R8 = value;
+        context.R8 = value;
     }
     else if (registerString == "r9" | registerString == "R9" )
     {
-        currentContext.R9 = value;
+        context.R9 = value;
     }
     else if (registerString == "r10" | registerString == "R10" )
     {
-        currentContext.R10 = value;
+        context.R10 = value;
     }
     else if (registerString == "r11" | registerString == "R11" )
     {
-        currentContext.R11 = value;
+        context.R11 = value;
     }
     else if (registerString == "r12" | registerString == "R12" )
     {
-        currentContext.R12 = value;
+        context.R12 = value;
     }
     else if (registerString == "r13" | registerString == "R13" )
     {
-        currentContext.R13 = value;
+        context.R13 = value;
     }  
     else if (registerString == "r14" | registerString == "R14" )
     {
-        currentContext.R14 = value;
+        context.R14 = value;
     }  
     else if (registerString == "r15" | registerString == "R15" )
     {
-        currentContext.R15 = value;
+        context.R15 = value;
     }  
     else if (registerString == "rflags" | registerString == "RFLAGS" )
     {
-        currentContext.EFlags = value;
+        context.EFlags = value;
     }              
 }
-HANDLE debugger::getCurrentThread ()
-{
-    return OpenThread (THREAD_GET_CONTEXT, FALSE, currentDebugEvent.dwThreadId);
-}
 std::string debugger::getFunctionNameForAddress (uint64_t address)
 {
-    for (const auto & func : functionNames)
+    const functionRange * func = imageSymbols.functionContaining (address);
+    if (func)
+    {
+        return imageSymbols.getFunctionName (func);
+    }
+    uint64_t moduleBase = currentMemoryMap->getImageBaseForAddress (address);
+    auto dbModule = moduleDbEntries.find (moduleBase);
+    if (dbModule != moduleDbEntries.end()) // prebuilt export database knows this module, nothing to parse
+    {
+        uint32_t rva = address - moduleBase;
+        const exportDbEntry * exported = exportDb.findNearest (dbModule->second, rva);
+        if (exported)
+        {
+            uint32_t displacement = rva - exported->rva;
+            return std::string (exportDb.getName (dbModule->second->nameOffset)) + "!" + exportDb.getName (exported->nameOffset) +
+                (displacement ? "+" + intToHex (displacement) : "");
+        }
+        return "?";
+    }
+    if (moduleBase != 0 && moduleBase != debuggedProcessBaseAddress)
     {
-        if (address >= func.start && address <= func.end)
+        functionIndex * functions = getModuleFunctions (moduleBase);
+        exportTable * exports = getModuleExports (moduleBase);
+        uint32_t rva = address - moduleBase;
+        std::string prefix = exports->getModuleName() + "!";
+
+        func = functions->containing (address);
+        if (func)
+        {
+            const exportEntry * exported = exports->findByRVA (func->start);
+            return prefix + (exported ? exports->getDisplayName (exported) : functions->getName (func));
+        }
+        const exportEntry * exported = exports->findNearest (rva); // leaf functions have no .pdata entry
+        if (exported)
         {
-            return func.name;
+            uint32_t displacement = rva - exported->rva;
+            return prefix + exports->getDisplayName (exported) + (displacement ? "+" + intToHex (displacement) : "");
         }
     }
     return "?";
 }
-void debugger::showBacktrace ()
+void debugger::initializeDbghelp ()
 {
-    // CaptureStackBackTrace
-    //std::vector<CALLSTACKENTRY> callstackVector;
-    const int MaxNameLen = 256;
-    CONTEXT context = getContext(CONTEXT_CONTROL | CONTEXT_INTEGER);
-
-    char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR)];
-    char name[MaxNameLen];
-    char module[MaxNameLen];
-    PSYMBOL_INFO pSymbol = (PSYMBOL_INFO)buffer;
-
-    DWORD64             displacement;
-
-    DWORD disp;
-
-    STACKFRAME64 frame;
-
-    ZeroMemory(&frame, sizeof(STACKFRAME64));
+    if (!dbghelpInitialized)
+    {
+        SymInitialize(debuggedProcessHandle, NULL, TRUE );
+        dbghelpInitialized = true;
+    }
+}
+std::string debugger::getSymbolForAddress (uint64_t address) // own symbols and export tables first, DbgHelp only for what they do not know
+{
+    std::string internalName = getFunctionNameForAddress (address);
+    if (internalName != "?")
+    {
+        return internalName;
+    }
+    initializeDbghelp ();
+    char buffer [sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR)];
+    memset (buffer, 0, sizeof (buffer));
+    PSYMBOL_INFO pSymbol = (PSYMBOL_INFO) buffer;
+    pSymbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+    pSymbol->MaxNameLen = MAX_SYM_NAME;
 
-    DWORD machineType = IMAGE_FILE_MACHINE_AMD64;
+    DWORD64 displacement;
+    if (SymFromAddr(debuggedProcessHandle, ( ULONG64 ) address, &displacement, pSymbol) && strlen (pSymbol->Name) > 0)
+    {
+        return pSymbol->Name;
+    }
+    return internalName;
+}
+std::string debugger::getExportNameForAddress (uint64_t address) // exact export start only, used for operands in disassembly
+{
+    uint64_t moduleBase = currentMemoryMap->getImageBaseForAddress (address);
+    if (moduleBase == 0 || moduleBase == debuggedProcessBaseAddress)
+    {
+        return "";
+    }
+    auto dbModule = moduleDbEntries.find (moduleBase);
+    if (dbModule != moduleDbEntries.end())
+    {
+        const exportDbEntry * exported = exportDb.findExact (dbModule->second, address - moduleBase);
+        if (exported)
+        {
+            return std::string (exportDb.getName (dbModule->second->nameOffset)) + "!" + exportDb.getName (exported->nameOffset);
+        }
+        return "";
+    }
+    exportTable * exports = getModuleExports (moduleBase);
+    const exportEntry * exported = exports->findByRVA (address - moduleBase);
+    if (exported)
+    {
+        return exports->getModuleName() + "!" + exports->getDisplayName (exported);
+    }
+    return "";
+}
+void debugger::loadExportDatabase ()
+{
+    char modulePath [MAX_PATH + 1];
+    DWORD size = GetModuleFileNameA (NULL, modulePath, MAX_PATH + 1);
+    if (size == 0 || size > MAX_PATH)
+    {
+        return;
+    }
+    std::string databasePath (modulePath, size);
+    databasePath = databasePath.substr (0, databasePath.find_last_of ("\\/") + 1) + EXPORT_DATABASE_NAME;
+    if (exportDb.load (databasePath))
+    {
+        log ("Export database loaded, %i modules\n", logType::INFO, stdoutHandle, exportDb.getModuleCount());
+    }
+}
+void debugger::loadSignatureLibrary ()
+{
+    char modulePath [MAX_PATH + 1];
+    DWORD size = GetModuleFileNameA (NULL, modulePath, MAX_PATH + 1);
+    if (size == 0 || size > MAX_PATH)
+    {
+        return;
+    }
+    std::string libraryPath (modulePath, size);
+    libraryPath = libraryPath.substr (0, libraryPath.find_last_of ("\\/") + 1) + SIGNATURE_LIBRARY_NAME;
+    if (signatures.load (libraryPath))
+    {
+        log ("Signature library loaded, %i signatures\n", logType::INFO, stdoutHandle, signatures.size());
+    }
+}
+bool debugger::matchSignatures (std::vector <functionRange> const & ranges) // names library functions of image without symbols, they go where COFF symbols would
+{
+    if (!signatures.isLoaded ())
+    {
+        return false;
+    }
+    std::vector <uint32_t> functionStarts;
+    for (const auto & range : ranges)
+    {
+        functionStarts.push_back (range.start);
+    }
+    functionStarts.push_back ((uint32_t) (debuggedProcessEntryPoint - debuggedProcessBaseAddress));
+    std::vector <uint8_t> image;
+    if (!readImage (image))
+    {
+        return false;
+    }
 
-    frame.AddrPC.Offset = context.Rip;
-    frame.AddrPC.Mode = AddrModeFlat;
+    auto start = std::chrono::steady_clock::now ();
+    std::vector <signatureMatch> matches = signatures.match ( { image.data(), image.size() }, functionStarts);
+    std::vector <symbolEntry> entries;
+    std::vector <char> pool;
+    for (const auto & match : matches)
+    {
+        const char * name = signatures.getName (match.nameOffset);
+        entries.push_back ( { match.rva, (uint32_t) pool.size(), 0, symbolType::FUNCTION_NAME } );
+        pool.insert (pool.end(), name, name + strlen (name) + 1);
+    }
+    COFFsymbols.build (std::move (entries), std::move (pool));
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+    log ("%zu of %zu functions named by signatures in %.3f ms\n", logType::INFO, stdoutHandle, COFFsymbols.size(), functionStarts.size(), elapsed / 1000.0);
+    return !COFFsymbols.empty ();
+}
+bool debugger::discoverFunctions (PEparser & parser) // image without .pdata, function boundaries are guessed from its code
+{
+    std::vector <uint8_t> image;
+    if (!readImage (image))
+    {
+        return false;
+    }
+    std::vector <uint32_t> knownStarts = { (uint32_t) (debuggedProcessEntryPoint - debuggedProcessBaseAddress) };
+    for (const auto & symbol : COFFsymbols.getEntries ())
+    {
+        if (symbol.type == symbolType::FUNCTION_NAME)
+        {
+            knownStarts.push_back (symbol.rva);
+        }
+    }
+    for (const auto & exported : parser.getExportTable ().getEntries ())
+    {
+        if (exported.rva != 0)
+        {
+            knownStarts.push_back (exported.rva);
+        }
+    }
 
-    frame.AddrFrame.Offset = context.Rsp;
-    frame.AddrFrame.Mode = AddrModeFlat;
+    auto start = std::chrono::steady_clock::now ();
+    discoveryStats stats;
+    functionDiscovery discovery ( { image.data(), image.size() }, debuggedProcessBaseAddress, parser.getSectionHeaders ());
+    discoveredFunctions = discovery.discover (std::move (knownStarts), stats);
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+    log ("No .pdata, %i functions discovered in %.3f ms (%i call targets, %i prologues, %i tail calls, %i rejected)\n", logType::INFO, stdoutHandle,
+        discoveredFunctions.size(), elapsed / 1000.0, stats.callTargets, stats.prologues, stats.tailCalls, stats.rejected);
+    return !discoveredFunctions.empty ();
+}
+void debugger::setImageFunctions (std::vector <functionRange> ranges) // unnamed ranges get names of symbols starting there
+{
+    for (auto & range : ranges)
+    {
+        const symbolEntry * functionSymbol = COFFsymbols.find (range.start);
+        range.nameOffset = functionSymbol ? functionSymbol->nameOffset : functionIndex::NO_NAME;
+    }
+    imageFunctions = functionIndex (debuggedProcessBaseAddress, ranges, COFFsymbols.getNamePool().data());
+}
+void debugger::matchExportDatabase (std::string dllName, uint64_t moduleBase)
+{
+    if (!exportDb.isLoaded())
+    {
+        return;
+    }
+    try
+    {
+        PEparser parser (debuggedProcessHandle, moduleBase); // headers only, identity of loaded module
+        if (!parser.isValid ())
+        {
+            return;
+        }
+        const exportDbModule * module = exportDb.findModule (dllName, parser.getTimeDateStamp (), parser.getSizeOfImage ());
+        if (module)
+        {
+            moduleDbEntries[moduleBase] = module;
+        }
+    }
+    catch (const std::exception &)
+    {
+        log ("Cannot read headers of %s\n", logType::ERR, stdoutHandle, dllName.c_str());
+    }
+}
+exportTable * debugger::getModuleExports (uint64_t moduleBase)
+{
+    auto it = moduleExports.find (moduleBase);
+    if (it != moduleExports.end())
+    {
+        return &it->second;
+    }
+    exportTable exports;
+    try
+    {
+        PEparser parser (debuggedProcessHandle, moduleBase);
+        if (parser.isValid ())
+        {
+            exports = parser.getExportTable ();
+        }
+    }
+    catch (const std::exception &)
+    {
+        log ("Cannot read export table of module at 0x%.16llx\n", logType::ERR, stdoutHandle, moduleBase);
+    }
+    return &(moduleExports[moduleBase] = std::move (exports));
+}
+functionIndex * debugger::getModuleFunctions (uint64_t moduleBase)
+{
+    auto it = moduleFunctions.find (moduleBase);
+    if (it != moduleFunctions.end())
+    {
+        return &it->second;
+    }
+    std::vector <functionRange> ranges;
+    try
+    {
+        PEparser parser (debuggedProcessHandle, moduleBase);
+        for (const auto & entry : parser.getPdataEntries ())
+        {
+            ranges.push_back ( { entry.BeginAddress, entry.EndAddress, functionIndex::NO_NAME } );
+        }
+    }
+    catch (const std::exception &)
+    {
+        log ("Cannot read .pdata of module at 0x%.16llx\n", logType::ERR, stdoutHandle, moduleBase);
+    }
+    return &(moduleFunctions[moduleBase] = functionIndex (moduleBase, ranges, nullptr));
+}
+void debugger::showBacktrace ()
+{
+    CONTEXT context = getContext(CONTEXT_CONTROL | CONTEXT_INTEGER);
+    currentMemoryMap->updateMemoryMap ();
 
-    frame.AddrStack.Offset = context.Rsp; // ???? was csp like generic stack pointer
-    frame.AddrStack.Mode = AddrModeFlat;
+    unwindContext start;
+    start.rip = context.Rip;
+    uint64_t registers [16] = { context.Rax, context.Rcx, context.Rdx, context.Rbx, context.Rsp, context.Rbp, context.Rsi, context.Rdi,
+                                context.R8, context.R9, context.R10, context.R11, context.R12, context.R13, context.R14, context.R15 };
+    memcpy (start.regs, registers, sizeof (registers));
 
-    const int MaxWalks = 50;
-    // Container for each callstack entry (50 pre-allocated entries)
-    //callstackVector.clear();
-    //callstackVector.reserve(MaxWalks);
+    std::vector <unwindFrame> frames = stackUnwinder->walk (start, MAX_BACKTRACE_FRAMES);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        std::string symbolName = getSymbolForAddress(frames[i].rip);
+        std::string sectionName = currentMemoryMap->getSectionNameForAddress (frames[i].rip);
+        std::string moduleName = currentMemoryMap->getImageNameForAddress(frames[i].rip);
 
-    HANDLE hThread = getCurrentThread ();
-    if (hThread == NULL)
+        printf ("#%d %.16llx <%s->%s> (%s)\n",
+                (int) i,
+                frames[i].rip,
+                moduleName.c_str(),
+                sectionName.c_str(),
+                symbolName.c_str());
+    }
+}
+void debugger::writeImageListing (std::string outputPath)
+{
+    if (!imageParser)
     {
-        log ("Cannot get handle to current thread when backtracing\n", logType::ERR, stdoutHandle);
+        log ("Image of debugged process is not parsed\n", logType::ERR, stdoutHandle);
         return;
     }
-    SymInitialize(debuggedProcessHandle, NULL, TRUE ); // ?????? 
-    currentMemoryMap->updateMemoryMap ();
-
-    for (int i = 0; i < MaxWalks; i++)
+    PEparser & parser = *imageParser;
+    std::vector <uint64_t> functionStarts;
+    for (const auto & function : parser.getPdataView ())
     {
-        if(!StackWalk64(
-                    machineType,
-                    debuggedProcessHandle,
-                    hThread,
-                    &frame,
-                    &context,
-                    NULL,
-                    SymFunctionTableAccess64,
-                    SymGetModuleBase64,
-                    NULL))
+        functionStarts.push_back (debuggedProcessBaseAddress + function.BeginAddress);
+    }
+    for (const auto & function : discoveredFunctions) // image without .pdata, sweep resyncs on guessed starts instead
+    {
+        functionStarts.push_back (debuggedProcessBaseAddress + function.start);
+    }
+    auto functionName = [this] (uint64_t address)
+    {
+        const functionRange * function = imageSymbols.functionStartingAt (address);
+        if (function)
         {
-            break;
+            return imageSymbols.getFunctionName (function);
         }
+        char name [32];
+        snprintf (name, sizeof (name), "sub_%x", (uint32_t) (address - debuggedProcessBaseAddress));
+        return std::string (name);
+    };
 
-        pSymbol->SizeOfStruct = sizeof(SYMBOL_INFO);
-        pSymbol->MaxNameLen = MAX_SYM_NAME;
-        SymFromAddr(debuggedProcessHandle, ( ULONG64 )frame.AddrPC.Offset, &displacement, pSymbol);
-        size_t symbolNameSize = strlen (pSymbol->Name);
-
-        std::string internalSymbolName = getFunctionNameForAddress(frame.AddrPC.Offset);
-
-        if(frame.AddrPC.Offset != 0)
+    FILE * output = fopen (outputPath.c_str(), "wb");
+    if (!output)
+    {
+        log ("Cannot create %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+        return;
+    }
+    sweepStats stats;
+    auto start = std::chrono::steady_clock::now ();
+    for (const auto & section : parser.getSectionHeaders ())
+    {
+        if (!(section.Characteristics & IMAGE_SCN_MEM_EXECUTE))
+        {
+            continue;
+        }
+        uint64_t sectionAddress = debuggedProcessBaseAddress + section.VirtualAddress;
+        std::vector <uint8_t> code (section.Misc.VirtualSize != 0 ? section.Misc.VirtualSize : section.SizeOfRawData);
+        if (!processReader->read (sectionAddress, code.data(), code.size())) // code as it is in memory now, breakpoints hidden
+        {
+            size_t readable = 0;
+            while (readable < code.size() && processReader->read (sectionAddress + readable, code.data() + readable, std::min <size_t> (0x1000, code.size() - readable)))
+            {
+                readable += 0x1000;
+            }
+            code.resize (std::min (readable, code.size()));
+        }
+        fprintf (output, "; section %.8s\n", section.Name);
+        linearSweep sweep ( { code.data(), code.size() }, sectionAddress, functionStarts, functionName,
+            [this] (uint64_t address) { return imageSymbols.getPointerSlotWidth (address); });
+        if (!sweep.writeListing (output, std::thread::hardware_concurrency (), stats))
+        {
+            log ("Cannot write listing of section %.8s\n", logType::ERR, stdoutHandle, section.Name);
+        }
+    }
+    fclose (output);
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+    log ("%llu instructions (%.1f MB) written to %s in %.3f ms\n", logType::INFO, stdoutHandle,
+        stats.instructions, stats.bytes / 1048576.0, outputPath.c_str(), elapsed / 1000.0);
+}
+bool debugger::readImage (std::vector <uint8_t> & image)
+{
+    if (!imageParser)
+    {
+        return false;
+    }
+    image.assign (imageParser->getSizeOfImage (), 0);
+    if (processReader->read (debuggedProcessBaseAddress, image.data(), image.size()))
+    {
+        return true;
+    }
+    bool anyPage = false;
+    for (size_t offset = 0; offset < image.size(); offset += 0x1000) // pages without access stay zeroed
+    {
+        anyPage = processReader->read (debuggedProcessBaseAddress + offset, image.data() + offset, std::min <size_t> (0x1000, image.size() - offset)) || anyPage;
+    }
+    return anyPage;
+}
+bool debugger::buildImageGraph ()
+{
+    std::vector <uint8_t> image;
+    if (!readImage (image))
+    {
+        log ("Cannot read image memory\n", logType::ERR, stdoutHandle);
+        return false;
+    }
+    PEparser & parser = *imageParser; // readImage succeeds only with parsed image
+    std::vector <cfgSeed> seeds;
+    for (const auto & function : parser.getPdataView ())
+    {
+        seeds.push_back ( { debuggedProcessBaseAddress + function.BeginAddress, debuggedProcessBaseAddress + function.EndAddress } );
+    }
+    for (const auto & symbol : COFFsymbols.getEntries ())
+    {
+        if (symbol.type == symbolType::FUNCTION_NAME)
         {
-            std::string sectionName = currentMemoryMap->getSectionNameForAddress (frame.AddrPC.Offset);
-            std::string moduleName = currentMemoryMap->getImageNameForAddress(frame.AddrPC.Offset);
+            seeds.push_back ( { debuggedProcessBaseAddress + symbol.rva, 0 } );
+        }
+    }
+    for (const auto & function : discoveredFunctions)
+    {
+        seeds.push_back ( { debuggedProcessBaseAddress + function.start, debuggedProcessBaseAddress + function.end } );
+    }
+    seeds.push_back ( { debuggedProcessEntryPoint, 0 } );
 
-            printf ("#%d %.16llx <%s->%s> (%s)\n",
-                    i,
-                    frame.AddrPC.Offset,
-                    moduleName.c_str(),
-                    sectionName.c_str(),
-                    (symbolNameSize == 0 ? internalSymbolName.c_str() : pSymbol->Name));
+    auto start = std::chrono::steady_clock::now ();
+    if (!imageGraph.build ( { image.data(), image.size() }, debuggedProcessBaseAddress, seeds))
+    {
+        log ("Cannot build control flow graph\n", logType::ERR, stdoutHandle);
+        return false;
+    }
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+    log ("Control flow graph of %i functions and %i blocks built in %.3f ms\n", logType::INFO, stdoutHandle,
+        imageGraph.functionCount(), imageGraph.size(), elapsed / 1000.0);
+    imageGraphBuilt = true;
+    return true;
+}
+void debugger::showFunctionGraph (uint64_t address)
+{
+    if (!imageGraphBuilt && !buildImageGraph ())
+    {
+        return;
+    }
+    const cfgBlock * block = imageGraph.blockContaining (address);
+    if (!block)
+    {
+        log ("No basic block at %.16llx\n", logType::ERR, stdoutHandle, address);
+        return;
+    }
+    const cfgFunction * function = imageGraph.getFunction (block);
+    std::string functionName = getSymbolForAddress (function->entry);
+    log ("%s <%.16llx>\n", logType::INFO, stdoutHandle, functionName.c_str(), function->entry);
+    for (uint32_t index : imageGraph.getFunctionBlocks (function))
+    {
+        const cfgBlock & current = imageGraph.getBlock (index);
+        printfColor ("%s%.16llx - %.16llx (%u)", &current == block ? 12 : 15, stdoutHandle, &current == block ? "-> " : "   ",
+            current.start, current.end, current.instructionCount);
+        for (uint64_t successor : imageGraph.getSuccessors (&current))
+        {
+            printf (" %.16llx", successor);
         }
-        else
+        printf ("%s%s%s\n", current.flags & BLOCK_RETURN ? " ret" : "", current.flags & BLOCK_INDIRECT ? " indirect" : "",
+            current.flags & BLOCK_TAIL_CALL ? " tail" : "");
+    }
+}
+void debugger::startXrefBuild ()
+{
+    waitXrefBuild ();
+    imageXrefsReady = false;
+    std::vector <uint8_t> image;
+    if (!readImage (image)) // copied here, debugging loop keeps changing breakpoint bytes while index is built
+    {
+        log ("Cannot read image memory, no cross references\n", logType::ERR, stdoutHandle);
+        return;
+    }
+    PEparser & parser = *imageParser;
+    std::vector <xrefCodeRange> ranges;
+    for (const auto & section : parser.getSectionHeaders ())
+    {
+        if (section.Characteristics & IMAGE_SCN_MEM_EXECUTE)
+        {
+            ranges.push_back ( { debuggedProcessBaseAddress + section.VirtualAddress, section.Misc.VirtualSize != 0 ? section.Misc.VirtualSize : section.SizeOfRawData } );
+        }
+    }
+    std::vector <uint64_t> functionStarts;
+    for (const auto & function : parser.getPdataView ())
+    {
+        functionStarts.push_back (debuggedProcessBaseAddress + function.BeginAddress);
+    }
+    for (const auto & function : discoveredFunctions)
+    {
+        functionStarts.push_back (debuggedProcessBaseAddress + function.start);
+    }
+    std::sort (functionStarts.begin(), functionStarts.end());
+    uint64_t base = debuggedProcessBaseAddress;
+    xrefThread = std::thread ([this, image = std::move (image), ranges = std::move (ranges), functionStarts = std::move (functionStarts), base] ()
+    {
+        auto start = std::chrono::steady_clock::now ();
+        if (!imageXrefs.build ( { image.data(), image.size() }, base, ranges, functionStarts, std::thread::hardware_concurrency (),
+            [this] (uint64_t address) { return imageSymbols.getPointerSlotWidth (address); }))
         {
-            break;
+            log ("Cannot build cross reference index\n", logType::ERR, stdoutHandle);
+            return;
         }
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+        imageXrefsReady = true;
+        log ("%i cross references to %i addresses indexed in %.3f ms\n", logType::INFO, stdoutHandle,
+            imageXrefs.size(), imageXrefs.targetCount(), elapsed / 1000.0);
+    });
+}
+void debugger::waitXrefBuild ()
+{
+    if (xrefThread.joinable ())
+    {
+        xrefThread.join ();
+    }
+}
+void debugger::showXrefs (uint64_t address)
+{
+    if (!imageXrefsReady)
+    {
+        log ("Cross reference index is not built yet\n", logType::WARNING, stdoutHandle);
+        return;
+    }
+    static const char * typeNames [] = { "call", "jump", "data" };
+    dataSpan<xrefSource> references = imageXrefs.referencesTo (address);
+    log ("%i references to %s <%.16llx>\n", logType::INFO, stdoutHandle, references.size(), getSymbolForAddress (address).c_str(), address);
+    for (const auto & reference : references)
+    {
+        printf ("    %s  %.16llx  %s\n", typeNames [reference.type], reference.address, getSymbolForAddress (reference.address).c_str());
     }
 }
 void debugger::handleCommands(command * currentCommand)
@@ -465,6 +912,10 @@ void debugger::handleCommands(command * currentCommand)
     else if (currentCommand->type == commandType::SOFT_BREAKPOINT && debuggingActive)
     {
         void * breakpointAddress = parseStringToAddress(currentCommand->arguments[0].arg);
+        if (!isInstructionStart ((uint64_t) breakpointAddress))
+        {
+            log ("%.16llx is inside of instruction, breakpoint will change its bytes\n", logType::WARNING, stdoutHandle, breakpointAddress);
+        }
         placeSoftwareBreakpoint (breakpointAddress, false);
     }
     else if (currentCommand->type == commandType::WRITE_MEMORY_INT && debuggerActive)
@@ -473,21 +924,13 @@ void debugger::handleCommands(command * currentCommand)
         uint32_t size = parseStringToNumber (currentCommand->arguments[1].arg, 10); // maximum 8 bytes
         uint64_t value = parseStringToNumber (currentCommand->arguments[2].arg, 16);
         memHelper->writeIntAt (value, address, size);
+        codeCache.invalidate ((uint64_t) address, size);
     }
     else if (currentCommand->type == commandType::SHOW_MEMORY_REGIONS && debuggingActive)
     {
         currentMemoryMap->updateMemoryMap ();
         currentMemoryMap->showMemoryMap ();
 
-        /*
-        std::vector <uint64_t> moduleBases = currentMemoryMap->getModulesAddr ();
-        for (const auto & i : moduleBases)
-        {
-            PEparser p (debuggedProcessHandle, i);
-            p.parseExportFunctionsVirtual ();
-        } 
-        */
-        
     }
     else if (currentCommand->type == commandType::SET_REGISTER && debuggingActive)
     {
@@ -510,10 +953,36 @@ void debugger::handleCommands(command * currentCommand)
         }
         else if (currentCommand->arguments[0].type == argumentType::NUMBER)
         {
-            int breakpointNumber = parseStringToNumber (currentCommand->arguments[0].arg, 10);
-            deleteBreakpointByIndex (breakpointNumber);
+            uint32_t breakpointId = (uint32_t) parseStringToNumber (currentCommand->arguments[0].arg, 10);
+            if (!deleteBreakpointById (breakpointId))
+            {
+                log ("No breakpoint with id %u\n",logType::ERR, stdoutHandle, breakpointId);
+            }
         }
     }
+    else if (currentCommand->type == commandType::BREAKPOINT_FUNCTIONS && debuggingActive)
+    {
+        breakFunctions ();
+    }
+    else if (currentCommand->type == commandType::HARD_BREAKPOINT && debuggingActive)
+    {
+        hardwareCondition condition;
+        debugRegisters::parseCondition (currentCommand->arguments[1].arg, condition); // regex allows only valid names
+        uint8_t length = (uint8_t) parseStringToNumber (currentCommand->arguments[2].arg, 10);
+        placeHardwareBreakpoint ((uint64_t) parseStringToAddress (currentCommand->arguments[0].arg), condition, length);
+    }
+    else if (currentCommand->type == commandType::HARD_BREAKPOINT_DELETE && debuggingActive)
+    {
+        int slot = (int) parseStringToNumber (currentCommand->arguments[0].arg, 10);
+        if (!deleteHardwareBreakpoint (slot))
+        {
+            log ("Debug register DR%d is not used\n",logType::ERR, stdoutHandle, slot);
+        }
+    }
+    else if (currentCommand->type == commandType::BREAKPOINT_CLEAR && debuggingActive)
+    {
+        clearBreakpoints ();
+    }
     else if (currentCommand->type == commandType::DISASM && debuggingActive)
     {
         void * address = parseStringToAddress(currentCommand->arguments[0].arg);
@@ -521,6 +990,47 @@ void debugger::handleCommands(command * currentCommand)
 
         disasmAt (address,numberOfInstructions);
     }
+    else if (currentCommand->type == commandType::LISTING && debuggingActive)
+    {
+        writeImageListing (currentCommand->arguments[0].arg);
+    }
+    else if (currentCommand->type == commandType::XREFS && debuggingActive)
+    {
+        showXrefs ((uint64_t) parseStringToAddress (currentCommand->arguments[0].arg));
+    }
+    else if (currentCommand->type == commandType::CONTROL_FLOW_GRAPH && debuggingActive)
+    {
+        showFunctionGraph ((uint64_t) parseStringToAddress (currentCommand->arguments[0].arg));
+    }
+    else if (currentCommand->type == commandType::EXCEPTION_POLICY)
+    {
+        if (currentCommand->arguments.empty ())
+        {
+            showExceptionPolicies ();
+        }
+        else
+        {
+            DWORD code;
+            exceptionPolicy policy;
+            exceptionPolicyTable::parsePolicy (currentCommand->arguments[1].arg, policy); // regex allows only valid names
+            if (currentCommand->arguments[0].arg == "default")
+            {
+                exceptionPolicies.setDefault (policy);
+            }
+            else if (exceptionPolicyTable::parseException (currentCommand->arguments[0].arg, code))
+            {
+                exceptionPolicies.set (code, policy);
+            }
+            else
+            {
+                log ("Unknown exception %s\n", logType::ERR, stdoutHandle, currentCommand->arguments[0].arg.c_str());
+            }
+        }
+    }
+    else if (currentCommand->type == commandType::EVENT_STATS)
+    {
+        showEventStats ();
+    }
     else if (currentCommand->type == commandType::SHOW_BREAKPOINTS)
     {
         showBreakpoints ();
@@ -539,28 +1049,34 @@ void debugger::handleCommands(command * currentCommand)
         debuggingActive = false;
         SetEvent (continueDebugEvent);
         debuggerThread.join();
+        waitXrefBuild ();
         commandModeActive = false;
     }
     else if (currentCommand->type == commandType::STEP_IN && debuggingActive)
     {
-        this->currentContext.EFlags |= 0x100;
+        modifyContext (CONTEXT_CONTROL).EFlags |= 0x100;
         SetEvent (continueDebugEvent);
         commandModeActive = false;
     }
     else if (currentCommand->type == commandType::NEXT_INSTRUCTION && debuggingActive)
     {
-        if (lastException.exceptionType == EXCEPTION_BREAKPOINT && !lastException.oneHitBreakpoint) // single_step after breakpoint restoring breakpoint but we do not want to interrupt that time
+        instructionLength instruction;
+        uint64_t rip = getContext (CONTEXT_CONTROL).Rip;
+        if (!decodeInstructionAt (rip, instruction))
         {
-            bypassInterruptOnce = true;
+            log ("Problem with next instruction command\n", logType::ERR, stdoutHandle);
         }
-        void * addr = getNextInstructionAddress ( (void *) currentContext.Rip);
-        if (addr)
+        else if (instruction.branch == BRANCH_JUMP || instruction.branch == BRANCH_CONDITIONAL || instruction.branch == BRANCH_INDIRECT_JUMP || instruction.branch == BRANCH_RETURN)
         {
-            placeSoftwareBreakpoint (addr, true);
+            modifyContext (CONTEXT_CONTROL).EFlags |= 0x100; // execution may not reach instruction after it, single step stops wherever it goes
         }
         else
         {
-            log ("Problem with next instruction command\n", logType::ERR, stdoutHandle);
+            if (lastException.exceptionType == EXCEPTION_BREAKPOINT && !lastException.oneHitBreakpoint) // single_step after breakpoint restoring breakpoint but we do not want to interrupt that time
+            {
+                bypassInterruptOnce = true;
+            }
+            placeSoftwareBreakpoint ((void *) (rip + instruction.length), true); // calls are stepped over
         }
         SetEvent (continueDebugEvent);
         commandModeActive = false;
@@ -580,6 +1096,7 @@ void debugger::interactiveCommands ()
         if (debuggingActive)
         {
             showContext ();
+            stopToPromptLatency.add (std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - lastEventTime).count ());
         }
         
         commandModeActive = true;
@@ -613,26 +1130,168 @@ void debugger::interactive ()
 }
 void debugger::placeSoftwareBreakpoint (void * address, bool oneHit)
 {
-    breakpoint newBreakpoint (address, breakpointType::SOFTWARE_TYPE, oneHit);
-    if (!newBreakpoint.set (debuggedProcessHandle))
+    if (breakpoints.find ((uint64_t) address)) // original byte would be read as int3
+    {
+        log ("Breakpoint at %.16llx already exists\n",logType::WARNING, stdoutHandle, address);
+        return;
+    }
+    patchStats stats;
+    if (!placeSoftwareBreakpoints ( { (uint64_t) address }, oneHit, stats))
+    {
+        log ("Cannot set breakpoint at %.16llx\n",logType::ERR, stdoutHandle, address);
+    }
+}
+size_t debugger::placeSoftwareBreakpoints (std::vector <uint64_t> const & addresses, bool oneHit, patchStats & stats)
+{
+    std::shared_ptr <const breakpointSnapshot> current = breakpoints.snapshot ();
+    std::vector <breakpoint> pending;
+    pending.reserve (addresses.size());
+    for (uint64_t address : addresses)
+    {
+        if (!current->find (address))
+        {
+            pending.push_back (breakpoint ((void *) address, breakpointType::SOFTWARE_TYPE, oneHit));
+        }
+    }
+    processCodePatcher patcher (debuggedProcessHandle);
+    breakpointBatch::install (patcher, pending, stats); // one read, write and flush per page
+    for (const auto & bp : pending)
+    {
+        breakpointBytes.add ((uint64_t) bp.getAddress(), bp.getOriginalByte());
+        codeCache.invalidate ((uint64_t) bp.getAddress(), 1);
+    }
+    breakpoints.add (pending);
+    return pending.size();
+}
+void debugger::breakFunctions ()
+{
+    if (!imageParser)
+    {
+        log ("Image of debugged process is not parsed\n", logType::ERR, stdoutHandle);
+        return;
+    }
+    PEparser & parser = *imageParser;
+    std::vector <uint64_t> starts;
+    for (const auto & function : parser.getPdataView ())
+    {
+        starts.push_back (debuggedProcessBaseAddress + function.BeginAddress);
+    }
+    for (const auto & function : discoveredFunctions)
     {
-        log ("Cannot set breakpoint at %.16llx\n",logType::ERR,address, address);
+        starts.push_back (debuggedProcessBaseAddress + function.start);
+    }
+    for (const auto & symbol : COFFsymbols.getEntries ())
+    {
+        if (symbol.type == symbolType::FUNCTION_NAME)
+        {
+            starts.push_back (debuggedProcessBaseAddress + symbol.rva);
+        }
+    }
+    std::sort (starts.begin(), starts.end());
+    starts.erase (std::unique (starts.begin(), starts.end()), starts.end());
+
+    patchStats stats;
+    auto start = std::chrono::steady_clock::now ();
+    size_t placed = placeSoftwareBreakpoints (starts, false, stats);
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+    log ("%i breakpoints set at %i function starts in %.3f ms (%i pages, %i writes)\n", logType::INFO, stdoutHandle,
+        placed, starts.size(), elapsed / 1000.0, stats.pages, stats.writes);
+    if (stats.failed)
+    {
+        log ("Cannot set %i breakpoints\n", logType::ERR, stdoutHandle, stats.failed);
+    }
+}
+void debugger::clearBreakpoints ()
+{
+    std::vector <std::shared_ptr <breakpoint> > removed = breakpoints.clear ();
+    processCodePatcher patcher (debuggedProcessHandle);
+    patchStats stats;
+    breakpointBatch::remove (patcher, removed, stats); // int3 must not stay in code after breakpoint is gone
+    for (const auto & bp : removed)
+    {
+        breakpointBytes.remove ((uint64_t) bp->getAddress());
+        codeCache.invalidate ((uint64_t) bp->getAddress(), 1);
+    }
+    log ("%i breakpoints deleted (%i pages written)\n", logType::INFO, stdoutHandle, removed.size(), stats.writes);
+    if (stats.failed)
+    {
+        log ("Cannot restore original bytes of %i breakpoints\n", logType::ERR, stdoutHandle, stats.failed);
+    }
+}
+
+void debugger::placeHardwareBreakpoint (uint64_t address, hardwareCondition condition, uint8_t length)
+{
+    if (!debugRegisters::isValid (address, condition, length))
+    {
+        log ("Execute breakpoint watches 1 byte, data breakpoint 1, 2, 4 or 8 bytes aligned to its size\n",logType::ERR, stdoutHandle);
+        return;
+    }
+    if (hardwareBreakpoints.find (address, condition) != debugRegisters::NO_SLOT)
+    {
+        log ("Hardware breakpoint at %.16llx already exists\n",logType::WARNING, stdoutHandle, address);
+        return;
+    }
+    int slot = hardwareBreakpoints.allocate (address, condition, length);
+    if (slot == debugRegisters::NO_SLOT)
+    {
+        log ("All %d debug registers are used\n",logType::ERR, stdoutHandle, debugRegisters::SLOT_COUNT);
+        return;
+    }
+    applyHardwareBreakpoints ();
+    log ("Hardware breakpoint DR%d set at %.16llx (%s, %u bytes)\n",logType::INFO, stdoutHandle, slot, address, debugRegisters::getConditionName (condition), length);
+}
+bool debugger::deleteHardwareBreakpoint (int slot)
+{
+    if (!hardwareBreakpoints.release (slot))
+    {
+        return false;
+    }
+    applyHardwareBreakpoints ();
+    return true;
+}
+void debugger::applyHardwareBreakpoints ()
+{
+    for (DWORD threadId : threads)
+    {
+        if (threadId == currentContext.getThreadId ()) // its context may be read and changed already, it is written at continue
+        {
+            hardwareBreakpoints.apply (modifyContext (CONTEXT_DEBUG_REGISTERS));
+        }
+        else if (!hardwareBreakpoints.applyToThread (contextAccess, threadId))
+        {
+            log ("Cannot set debug registers of thread %u\n",logType::ERR, stdoutHandle, threadId);
+        }
+    }
+}
+void debugger::handleHardwareBreakpoint (int slot, EXCEPTION_DEBUG_INFO * exception, std::string sectionName, std::string moduleName)
+{
+    const hardwareSlot & hw = hardwareBreakpoints.getSlot (slot);
+    hardwareBreakpoints.incrementHitCount (slot);
+    modifyContext (CONTEXT_DEBUG_REGISTERS).Dr6 = 0; // processor never clears hit bits
+    if (hw.condition == hardwareCondition::EXECUTE)
+    {
+        log ("Hardware breakpoint DR%d reached at 0x%.16llx <%s->%s>\n",logType::INFO, stdoutHandle,
+            slot, exception->ExceptionRecord.ExceptionAddress, moduleName.c_str(), sectionName.c_str());
+        modifyContext (CONTEXT_CONTROL).EFlags |= 0x10000; // resume flag, instruction runs once without breaking again and without single step
     }
     else
     {
-        breakpoints.push_back (newBreakpoint);
+        log ("Hardware breakpoint DR%d (%s %.16llx) hit by instruction before 0x%.16llx <%s->%s>\n",logType::INFO, stdoutHandle,
+            slot, debugRegisters::getConditionName (hw.condition), hw.address, exception->ExceptionRecord.ExceptionAddress, moduleName.c_str(), sectionName.c_str());
     }
 }
 
 debugger::debugger (std::string fileName)
 {
     interruptingEvents.insert(EXCEPTION_DEBUG_EVENT); // only exception interrupts execution
-    interruptingExceptions.insert (EXCEPTION_BREAKPOINT);
-    interruptingExceptions.insert (EXCEPTION_ACCESS_VIOLATION);
-    interruptingExceptions.insert (EXCEPTION_ILLEGAL_INSTRUCTION);
-    interruptingExceptions.insert (EXCEPTION_SINGLE_STEP);
+    exceptionPolicies.set (EXCEPTION_BREAKPOINT, exceptionPolicy::STOP);
+    exceptionPolicies.set (EXCEPTION_ACCESS_VIOLATION, exceptionPolicy::STOP);
+    exceptionPolicies.set (EXCEPTION_ILLEGAL_INSTRUCTION, exceptionPolicy::STOP);
+    exceptionPolicies.set (EXCEPTION_SINGLE_STEP, exceptionPolicy::STOP); // others are logged and passed to the process
 
     stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    loadExportDatabase ();
+    loadSignatureLibrary ();
     commandEvent = CreateEventA (NULL,false,false,"commandEvent");
     continueDebugEvent = CreateEventA (NULL,false,false,"continueDebugEvent");
     this->fileName = fileName;
@@ -641,16 +1300,34 @@ debugger::debugger (std::string fileName)
 void debugger::handleSingleStep (EXCEPTION_DEBUG_INFO * exception, std::string sectionName, std::string moduleName)
 {
     uint64_t breakpointAddress = (uint64_t) exception->ExceptionRecord.ExceptionAddress;
-    breakpoint * bp = searchForBreakpoint (breakpoints, (void *) lastException.rip);
+    std::shared_ptr <breakpoint> bp = breakpoints.find (lastException.rip);
+    int hardwareHit = hardwareBreakpoints.empty () ? debugRegisters::NO_SLOT : debugRegisters::hitSlot (getContext (CONTEXT_DEBUG_REGISTERS).Dr6);
 
-    if (bp && !bp->getIsOneHit() && lastException.exceptionType == EXCEPTION_BREAKPOINT)
+    if (hardwareBreakpoints.isUsed (hardwareHit))
+    {
+        if (bp && !bp->getIsOneHit() && lastException.exceptionType == EXCEPTION_BREAKPOINT && bp->setAgain (debuggedProcessHandle)) // step after int3 ended on hardware breakpoint
+        {
+            codeCache.invalidate ((uint64_t) bp->getAddress(), 1);
+        }
+        if (getContext (CONTEXT_CONTROL).EFlags & 0x100)
+        {
+            modifyContext (CONTEXT_CONTROL).EFlags &= ~0x100;
+        }
+        lastException.oneHitBreakpoint = true;
+        handleHardwareBreakpoint (hardwareHit, exception, sectionName, moduleName);
+    }
+    else if (bp && !bp->getIsOneHit() && lastException.exceptionType == EXCEPTION_BREAKPOINT)
     {
         lastException.oneHitBreakpoint = false;
         if (!bp->setAgain(debuggedProcessHandle))
         {
             log ("Cannot set breakpoint again (in single step exception)\n",logType::ERR, stdoutHandle);
         }
-        this->currentContext.EFlags &= ~0x100;
+        codeCache.invalidate ((uint64_t) bp->getAddress(), 1);
+        if (getContext (CONTEXT_CONTROL).EFlags & 0x100) // trap flag is normally cleared by the step itself
+        {
+            modifyContext (CONTEXT_CONTROL).EFlags &= ~0x100;
+        }
     }
     else
     {
@@ -663,7 +1340,7 @@ void debugger::handleSingleStep (EXCEPTION_DEBUG_INFO * exception, std::string s
 void debugger::handleBreakpoint (EXCEPTION_DEBUG_INFO * exception, std::string sectionName, std::string moduleName)
 {
     uint64_t breakpointAddress = (uint64_t) exception->ExceptionRecord.ExceptionAddress;
-    breakpoint * bp = searchForBreakpoint (breakpoints, (void *) breakpointAddress);
+    std::shared_ptr <breakpoint> bp = breakpoints.find (breakpointAddress);
 
     if (bp && bp->getType() == breakpointType::SOFTWARE_TYPE) // user breakpoint
     {
@@ -673,16 +1350,25 @@ void debugger::handleBreakpoint (EXCEPTION_DEBUG_INFO * exception, std::string s
         {
             log ("Cannot restore breakpoint at 0x%.16llx <%s->%s>\n",logType::INFO, stdoutHandle, breakpointAddress, moduleName.c_str(), sectionName.c_str());   
         }
-        bp->getIsOneHit() == 0 ? currentContext.EFlags |= 0x100 : currentContext.EFlags &= ~0x100;
+        codeCache.invalidate (breakpointAddress, 1);
+        if (!bp->getIsOneHit())
+        {
+            modifyContext (CONTEXT_CONTROL).EFlags |= 0x100; // single step sets breakpoint again
+        }
+        else if (getContext (CONTEXT_CONTROL).EFlags & 0x100)
+        {
+            modifyContext (CONTEXT_CONTROL).EFlags &= ~0x100;
+        }
         bp->getIsOneHit() == 0 ? lastException.oneHitBreakpoint = 0 : lastException.oneHitBreakpoint = 1;
         if (bp->getIsOneHit())
         {
-            breakpoints.erase(std::remove(breakpoints.begin(), breakpoints.end(), *bp), breakpoints.end());
+            breakpointBytes.remove (breakpointAddress);
+            breakpoints.remove (breakpointAddress);
         }
         lastException.exceptionType = (DWORD) exception->ExceptionRecord.ExceptionCode;
         lastException.rip = breakpointAddress;
 
-        this->currentContext.Rip--; // int3 already consumed, need to revert execution state
+        modifyContext (CONTEXT_CONTROL).Rip--; // int3 already consumed, need to revert execution state
     }
     else if (systemBreakpoint) // system breakpoint
     {
@@ -698,6 +1384,10 @@ void debugger::handleBreakpoint (EXCEPTION_DEBUG_INFO * exception, std::string s
 void debugger::parseFunctionNamesIAT ()
 {
     PEparser parser (debuggedProcessHandle, debuggedProcessBaseAddress);
+    if (!parser.isValid ())
+    {
+        return;
+    }
     std::map <std::string, std::vector<uint64_t> > functionsImported = parser.getFunctionAddressesFromIAT ();
     if (functionsImported.size() == 0)
     {
@@ -713,20 +1403,64 @@ DWORD debugger::processCreateProcess (DEBUG_EVENT * event)
     char * moduleName = PathFindFileNameA(modulePath + 4);
 
     debuggedProcessBaseAddress = (uint64_t) info->lpBaseOfImage;
+    debuggedProcessEntryPoint = (uint64_t) info->lpStartAddress;
+    threads.clear ();
+    threads.insert (event->dwThreadId);
+    imageGraph.clear ();
+    imageGraphBuilt = false;
     checkWOW64 ();
     currentMemoryMap = new memoryMap (debuggedProcessHandle, wow64);
     
-    if (!parseSymbols (moduleNameString))
+    imageParser = std::make_unique <PEparser> (moduleNameString); // mapped and parsed once, commands share it
+    if (!imageParser->isValid ()) // reason is logged by parser, process is debugged without symbols and functions
+    {
+        imageParser.reset ();
+        log ("%s loaded, base 0x%.16llx entrypoint 0x%.16llx\n",logType::INFO, stdoutHandle, moduleName, info->lpBaseOfImage, info->lpStartAddress);
+        breakpointEntryPoint (info);
+        delete [] modulePath;
+        return DBG_CONTINUE;
+    }
+    PEparser & parser = *imageParser;
+    bool symbolsLoaded = parseSymbols (parser, moduleNameString);
+    if (!symbolsLoaded)
     {
         log ("No symbols loaded, trying to load function imports by IAT when it is resolved\n", logType::INFO, stdoutHandle);
         coffSymbolsLoaded = false;
-        // parse IAT names
+    }
+    discoveredFunctions.clear ();
+    if (parser.getPdataView ().empty () && discoverFunctions (parser)) // 32-bit, packed or stripped image, unnamed functions are still sub_<rva>
+    {
+        if (!symbolsLoaded)
+        {
+            matchSignatures (discoveredFunctions);
+        }
+        setImageFunctions (discoveredFunctions);
+    }
+    else if (!symbolsLoaded)
+    {
+        std::vector <functionRange> ranges;
+        for (const auto & range : parser.getPdataView ())
+        {
+            ranges.push_back ( { range.BeginAddress, range.EndAddress, functionIndex::NO_NAME } );
+        }
+        matchSignatures (ranges);
+        if (signatures.isLoaded ())
+        {
+            setImageFunctions (std::move (ranges));
+        }
     }
     
-    PEparser parser (moduleNameString);
+    imageRelocations = parser.getRelocationTable ();
+    imageSymbols.rebase (debuggedProcessBaseAddress, parser.getSizeOfImage ());
+    if (parser.getImageBase () != debuggedProcessBaseAddress)
+    {
+        log ("Image relocated from preferred base 0x%.16llx, %zu pointer slots known to listing and xrefs\n", logType::INFO, stdoutHandle,
+            parser.getImageBase (), imageRelocations.size());
+    }
     std::string entrypointSectionName = parser.getSectionNameForAddress ((uint64_t)info->lpStartAddress - (uint64_t)info->lpBaseOfImage); 
     log ("%s loaded, base 0x%.16llx entrypoint 0x%.16llx <%.8s>\n",logType::INFO, stdoutHandle, moduleName, info->lpBaseOfImage, info->lpStartAddress, entrypointSectionName.c_str());
 
+    startXrefBuild ();
     breakpointEntryPoint (info);
 
     delete [] modulePath;
@@ -735,8 +1469,13 @@ DWORD debugger::processCreateProcess (DEBUG_EVENT * event)
 DWORD debugger::processExceptions (DEBUG_EVENT * event)
 {
     EXCEPTION_DEBUG_INFO * exception = &event->u.Exception;
+    exceptionPolicy policy = exceptionPolicies.get (exception->ExceptionRecord.ExceptionCode);
     if (exception->ExceptionRecord.ExceptionCode != EXCEPTION_BREAKPOINT && exception->ExceptionRecord.ExceptionCode != EXCEPTION_SINGLE_STEP)
     {
+        if (policy == exceptionPolicy::PASS)
+        {
+            return DBG_EXCEPTION_NOT_HANDLED;
+        }
         if (exception->dwFirstChance)
         {
             log ("First chance ", logType::ERR, stdoutHandle);
@@ -746,7 +1485,10 @@ DWORD debugger::processExceptions (DEBUG_EVENT * event)
             log ("Last chance ", logType::ERR, stdoutHandle);
         }   
     }
-    currentMemoryMap->updateMemoryMap ();
+    if (!isFastEvent (*event)) // logged exceptions use names of map as it was at last stop
+    {
+        currentMemoryMap->updateMemoryMap ();
+    }
     std::string sectionName = currentMemoryMap->getSectionNameForAddress ((uint64_t) exception->ExceptionRecord.ExceptionAddress);
     std::string moduleName = currentMemoryMap->getImageNameForAddress((uint64_t) exception->ExceptionRecord.ExceptionAddress);
     switch (exception->ExceptionRecord.ExceptionCode)
@@ -801,54 +1543,101 @@ DWORD debugger::processExceptions (DEBUG_EVENT * event)
         }
     }
 }
-bool debugger::parseSymbols (std::string filePath) // parse COFF symbols from PE reading it from disk
+bool debugger::parseSymbols (PEparser & parser, std::string filePath) // parse COFF symbols from PE reading it from disk, .pdb when there are none
 {
     // UnDecorateSymbolName
 
-    PEparser parser (filePath);
     uint32_t coffTableOffset = parser.getCoffSymbolTableOffset ();
     uint32_t coffSymbolNumber = parser.getCoffSymbolNumber ();
+    dataSpan<COFFentry> coffEntries;
     if (coffSymbolNumber > 0 && coffTableOffset != 0)
     {
-        log ("Found %i COFF symbols, parsing them\n",logType::INFO, stdoutHandle, coffSymbolNumber);
+        coffEntries = parser.getCoffEntries (); // empty when table pointer or count lies about file
+    }
+    bool hasCoffSymbols = !coffEntries.empty ();
+    codeViewInfo codeView;
+    if (!hasCoffSymbols && !parser.getCodeViewInfo (codeView))
+    {
+        return false;
+    }
 
-        coffSymbolParser symbolParser;
-        std::vector <COFFentry> entries = parser.getCoffEntries();
-        auto extendedNames = parser.getCoffExtendedNames();
-        uint64_t coffExtendedNamesOffset = parser.getCoffExtendedNamesOffset();
-        COFFsymbols = symbolParser.parseSymbols (parser.getCoffEntries (), extendedNames, coffExtendedNamesOffset, parser);
+    auto parseStart = std::chrono::steady_clock::now ();
+    std::vector <functionRange> ranges;
+    symbolCache cache (parser);
 
-        std::vector <RUNTIME_FUNCTION> functionRanges = parser.getPdataEntries ();
-        if (functionRanges.size() == 0)
+    if (cache.load (COFFsymbols, ranges))
+    {
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - parseStart).count ();
+        log ("Symbol cache hit, %i symbols and %i functions loaded in %.3f ms (warm start)\n",logType::INFO, stdoutHandle,
+            COFFsymbols.size(), ranges.size(), elapsed / 1000.0);
+    }
+    else
+    {
+        if (hasCoffSymbols)
         {
-            return true;
+            log ("Symbol cache miss, found %i COFF symbols, parsing them\n",logType::INFO, stdoutHandle, coffSymbolNumber);
+
+            coffSymbolParser symbolParser;
+            COFFsymbols = symbolParser.parseSymbols (coffEntries, parser.getCoffStringTable (), parser.getSectionHeaders ());
+        }
+        else if (!parsePdbSymbols (parser, filePath, codeView))
+        {
+            return false;
         }
 
-        for (const auto & range : functionRanges)
+        for (const auto & range : parser.getPdataView ())
         {
-            if (COFFsymbols.find(range.BeginAddress) != COFFsymbols.end())
+            const symbolEntry * functionSymbol = COFFsymbols.find (range.BeginAddress);
+            if (functionSymbol)
             {
-                function newFunction;
-                newFunction.name = COFFsymbols[range.BeginAddress].name;
-                newFunction.start = range.BeginAddress + debuggedProcessBaseAddress;
-                newFunction.end = range.EndAddress + debuggedProcessBaseAddress;
-
-                functionNames.push_back (newFunction);
-                //printf ("%s ", COFFsymbols[range.BeginAddress].name.c_str());
+                ranges.push_back ( { range.BeginAddress, range.EndAddress, functionSymbol->nameOffset } );
             }
-            
-            //printf ("%.16llx - %.16llx \n", debuggedProcessBaseAddress+range.BeginAddress, debuggedProcessBaseAddress+range.EndAddress);
         }
-        /*
-        
-        for ( auto const& [key, val] : COFFsymbols )
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - parseStart).count ();
+        log ("%i symbols and %i functions parsed in %.3f ms (cold start)\n",logType::INFO, stdoutHandle,
+            COFFsymbols.size(), ranges.size(), elapsed / 1000.0);
+
+        if (cache.store (COFFsymbols, ranges))
         {
-            fprintf (fw, "%i %.16llx --> %s\n", val.type, key, val.name.c_str());
-            //printf ("%.16llx --> %s\n",key, val.c_str());
+            log ("Symbols cached in %s\n",logType::INFO, stdoutHandle, cache.getPath().c_str());
         }
-        */
+    }
 
-        return true;
+    imageFunctions = functionIndex (debuggedProcessBaseAddress, ranges, COFFsymbols.getNamePool().data());
+    /*
+    
+    for (const auto & entry : COFFsymbols.getEntries ())
+    {
+        fprintf (fw, "%i %.16llx --> %s\n", entry.type, entry.rva, COFFsymbols.getName (&entry));
+    }
+    */
+
+    return true;
+}
+bool debugger::parsePdbSymbols (PEparser & parser, std::string filePath, codeViewInfo & codeView)
+{
+    // path stored by linker first, then .pdb of the same name next to the executable
+    std::string directory = filePath.substr (0, filePath.find_last_of ("\\/") + 1);
+    std::string candidates [] = {
+        codeView.pdbPath,
+        directory + codeView.pdbPath.substr (codeView.pdbPath.find_last_of ("\\/") + 1),
+        filePath.substr (0, filePath.find_last_of ('.')) + ".pdb"
+    };
+    for (const auto & candidate : candidates)
+    {
+        pdbParser pdb;
+        if (candidate.empty() || GetFileAttributesA (candidate.c_str()) == INVALID_FILE_ATTRIBUTES || !pdb.open (candidate))
+        {
+            continue;
+        }
+        if (!pdb.matches (codeView.guid, codeView.age))
+        {
+            log ("%s does not match executable (GUID or age differs)\n", logType::WARNING, stdoutHandle, candidate.c_str());
+            continue;
+        }
+        COFFsymbols = pdb.getPublicSymbols (parser.getSectionHeaders ());
+        log ("Symbol cache miss, %i public symbols read from %s\n", logType::INFO, stdoutHandle, COFFsymbols.size(), candidate.c_str());
+        return !COFFsymbols.empty();
     }
     return false;
 }
@@ -870,21 +1659,34 @@ DWORD debugger::processDebugEvents (DEBUG_EVENT * event, bool * debuggingActive)
             SetEvent (commandEvent);
             delete currentMemoryMap;
             delete memHelper;
+            delete stackUnwinder;
+            delete processReader;
+            processReader = nullptr;
+            imageParser.reset ();
             return DBG_CONTINUE;
         }
         case EXIT_THREAD_DEBUG_EVENT:
         {
             EXIT_THREAD_DEBUG_INFO * infoThread = &event->u.ExitThread;
             log ("Thread %u exited with code 0x%.08x\n", logType::THREAD, stdoutHandle, event->dwThreadId, infoThread->dwExitCode);
+            threads.erase (event->dwThreadId);
             return DBG_CONTINUE;
         }
         case CREATE_THREAD_DEBUG_EVENT:
         {
             CREATE_THREAD_DEBUG_INFO * infoThread = &event->u.CreateThread;
-            currentMemoryMap->updateMemoryMap ();
+            if (!isFastEvent (*event)) // thread creation that does not stop uses names of map as it was at last stop
+            {
+                currentMemoryMap->updateMemoryMap ();
+            }
             std::string sectionName = currentMemoryMap->getSectionNameForAddress ((uint64_t) infoThread->lpStartAddress);
             std::string moduleName = currentMemoryMap->getImageNameForAddress((uint64_t) infoThread->lpStartAddress);
             log ("Thread 0x%x created with entry address 0x%.16llx <%s->%s>\n", logType::THREAD, stdoutHandle, event->dwThreadId, infoThread->lpStartAddress, moduleName.c_str(), sectionName.c_str());
+            threads.insert (event->dwThreadId);
+            if (!hardwareBreakpoints.empty ()) // not a fast event then, context of new thread is current
+            {
+                hardwareBreakpoints.apply (modifyContext (CONTEXT_DEBUG_REGISTERS));
+            }
             return DBG_CONTINUE;
         }
         case LOAD_DLL_DEBUG_EVENT:
@@ -894,6 +1696,8 @@ DWORD debugger::processDebugEvents (DEBUG_EVENT * event, bool * debuggingActive)
             GetFinalPathNameByHandleA()(loadInfo->hFile,dllPath,MAX_PATH+1,0);
             char * dllName = PathFindFileNameA(dllPath + 4);
             log ("%s loaded (0x%.16llx)\n",logType::DLL, stdoutHandle, dllName, loadInfo->lpBaseOfDll);
+            matchExportDatabase (dllName, (uint64_t) loadInfo->lpBaseOfDll);
+            codeCache.clear (); // call targets in cached operands may have names now
             free (dllPath);
             return DBG_CONTINUE;
         }
@@ -901,6 +1705,11 @@ DWORD debugger::processDebugEvents (DEBUG_EVENT * event, bool * debuggingActive)
         {
             UNLOAD_DLL_DEBUG_INFO * unloadInfo = &event->u.UnloadDll;
             log ("0x%.16llx DLL unloaded\n",logType::DLL, stdoutHandle, unloadInfo->lpBaseOfDll);
+            moduleFunctions.erase ((uint64_t) unloadInfo->lpBaseOfDll); // another module can be loaded at this base later
+            moduleExports.erase ((uint64_t) unloadInfo->lpBaseOfDll);
+            moduleDbEntries.erase ((uint64_t) unloadInfo->lpBaseOfDll);
+            stackUnwinder->removeModule ((uint64_t) unloadInfo->lpBaseOfDll);
+            codeCache.clear ();
             return DBG_CONTINUE;
         }
         case EXCEPTION_DEBUG_EVENT:
@@ -951,5 +1760,6 @@ void debugger::exitDebugger ()
         debuggingActive = false;
         SetEvent (continueDebugEvent);
         debuggerThread.join();
+        waitXrefBuild ();
     }
 }
\ No newline at end of file
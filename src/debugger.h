@@ -7,24 +7,48 @@
 #include <thread>
 #include <iostream>
 #include <mutex>
+#include <atomic>
 #include <queue>
 #include <set>
 #include <vector>
 #include <map>
 #include <memory>
+#include <chrono>
 #include "breakpoint.h"
+#include "breakpointTable.h"
+#include "breakpointBatch.h"
+#include "debugRegisters.h"
 #include "memory.h"
 #include "utils.h"
 #include "peParser.h"
 #include "symbolParse.h"
+#include "symbolCache.h"
 #include "structs.h"
 #include "disassembly.h"
+#include "functionIndex.h"
+#include "exportDatabase.h"
+#include "unwinder.h"
+#include "pdbParser.h"
+#include "symbolView.h"
+#include "instructionCache.h"
+#include "linearSweep.h"
+#include "controlFlowGraph.h"
+#include "xrefIndex.h"
+#include "instructionLength.h"
+#include "signatureLibrary.h"
+#include "functionDiscovery.h"
+#include "exceptionPolicy.h"
+#include "threadContext.h"
 
 class debugger
 {
     private:
 
         static constexpr int SHOW_CONTEXT_INSTRUCTION_COUNT = 10;
+        static constexpr int SHOW_CONTEXT_PREVIOUS_INSTRUCTION_COUNT = 3;
+        static constexpr int MAX_BACKTRACE_FRAMES = 128;
+        static constexpr const char * EXPORT_DATABASE_NAME = "maldbg.exportdb"; // next to maldbg executable, built by maldbgtool exportdb
+        static constexpr const char * SIGNATURE_LIBRARY_NAME = "maldbg.sig"; // next to maldbg executable, built by maldbgtool sigmake
 
         void checkWOW64 ();
         DWORD run (std::string);
@@ -35,33 +59,68 @@ class debugger
         void handleSingleStep (EXCEPTION_DEBUG_INFO * exception, std::string, std::string);
         void breakpointEntryPoint (CREATE_PROCESS_DEBUG_INFO * info);
         void placeSoftwareBreakpoint (void *, bool);
+        size_t placeSoftwareBreakpoints (std::vector <uint64_t> const &, bool, patchStats &); // addresses with breakpoint already are skipped
+        void breakFunctions ();
+        void placeHardwareBreakpoint (uint64_t, hardwareCondition, uint8_t);
+        bool deleteHardwareBreakpoint (int);
+        void applyHardwareBreakpoints (); // slots into debug registers of every thread
+        void handleHardwareBreakpoint (int, EXCEPTION_DEBUG_INFO *, std::string, std::string);
+        void clearBreakpoints ();
         void interactiveCommands ();
         void handleCommands (command *);
-        CONTEXT getContext (DWORD);
-        HANDLE getCurrentThread ();
-        void setContext (CONTEXT &);
+        const CONTEXT & getContext (DWORD);
+        CONTEXT & modifyContext (DWORD);
+        void setContext ();
         void showContext ();
         void disasmAt (void *, int);
-        void checkInterruptEvent ();
-        breakpoint * searchForBreakpoint (std::vector<breakpoint> &, void * address);
-        void * getNextInstructionAddress (void *);
+        bool checkInterruptEvent (); // true when debugging loop waited for commands
+        bool isFastEvent (const DEBUG_EVENT &) const;
+        void showEventStats ();
+        void showExceptionPolicies ();
+        bool decodeInstructionAt (uint64_t, instructionLength &);
+        bool isInstructionStart (uint64_t);
         void showBreakpoints ();
         void showMemory ();
         bool deleteBreakpointByAddress (void *);
-        bool deleteBreakpointByIndex (uint64_t);
+        bool deleteBreakpointById (uint32_t);
+        void removeBreakpoint (breakpoint &); // restores original byte of breakpoint already taken out of table
         void setRegisterWithValue (std::string, uint64_t);
 
-        bool parseSymbols (std::string);
+        bool parseSymbols (PEparser &, std::string);
+        bool parsePdbSymbols (PEparser &, std::string, codeViewInfo &);
         void parseFunctionNamesIAT ();
         std::string getFunctionNameForAddress (uint64_t address);
+        functionIndex * getModuleFunctions (uint64_t moduleBase);
+        exportTable * getModuleExports (uint64_t moduleBase);
+        std::string getExportNameForAddress (uint64_t address);
+        std::string getSymbolForAddress (uint64_t address);
+        void initializeDbghelp ();
+        void loadExportDatabase ();
+        void matchExportDatabase (std::string, uint64_t);
+        void loadSignatureLibrary ();
+        bool matchSignatures (std::vector <functionRange> const &);
+        bool discoverFunctions (PEparser &);
+        void setImageFunctions (std::vector <functionRange>);
         void showBacktrace ();
+        void writeImageListing (std::string);
+        bool readImage (std::vector <uint8_t> &); // main image as it is mapped now
+        bool buildImageGraph ();
+        void showFunctionGraph (uint64_t);
+        void startXrefBuild (); // index is built on background thread, command thread reads it when ready
+        void waitXrefBuild ();
+        void showXrefs (uint64_t);
         
 
-        CONTEXT currentContext; // shared resource, never used in paralel
+        threadContextAccessor contextAccess;
+        threadContext currentContext {&contextAccess}; // thread of current event, shared resource, never used in paralel
         memoryMap * currentMemoryMap;
         memoryHelper * memHelper;
+        processMemoryReader * processReader = nullptr;
+        std::unique_ptr <PEparser> imageParser; // main image file, parsed at process creation and shared by commands
+        unwinder * stackUnwinder; // keeps decoded unwind info of modules between backtraces
         
         uint64_t debuggedProcessBaseAddress;
+        uint64_t debuggedProcessEntryPoint;
         int32_t wow64;
 
     	std::string fileName;
@@ -78,21 +137,48 @@ class debugger
         bool bypassInterruptOnce = false;
         bool coffSymbolsLoaded = true;
         bool systemBreakpoint = true;
+        bool dbghelpInitialized = false;
 
     	std::mutex m_debuggingActive;
     	std::mutex m_debuggerActive;
 
-        std::vector <breakpoint> breakpoints;
+        breakpointTable breakpoints; // hit lookup reads snapshot, commands publish new ones
+        debugRegisters hardwareBreakpoints; // DR0-DR3, the same in every thread
+        std::set <DWORD> threads; // of debugged process, new ones get hardware breakpoints at their create event
+        breakpointShadow breakpointBytes; // original bytes of software breakpoints, patched into every read of process memory
         std::vector <memoryRegion> memoryRegions;
-        std::vector <function> functionNames;
+        functionIndex imageFunctions; // main image, built from COFF symbols and .pdata
+        std::vector <functionRange> discoveredFunctions; // main image without .pdata, found by functionDiscovery
+        std::map <uint64_t, functionIndex> moduleFunctions; // other modules, built lazily from their .pdata
+        std::map <uint64_t, exportTable> moduleExports; // other modules, built lazily from their export directory
+        std::map <uint64_t, const exportDbModule *> moduleDbEntries; // modules found in export database
+        exportDatabase exportDb;
+        signatureLibrary signatures;
         std::set <DWORD> interruptingEvents;
-        std::set <DWORD> interruptingExceptions;
-        std::map <uint64_t, symbol> COFFsymbols;
+        exceptionPolicyTable exceptionPolicies; // replaces set of interrupting exception codes
+        std::atomic <uint64_t> debugEventCount {0};
+        std::atomic <uint64_t> fastEventCount {0}; // continued without touching thread context
+        std::chrono::steady_clock::time_point eventCountStart;
+        std::chrono::steady_clock::time_point lastEventQuery;
+        uint64_t lastEventCount = 0;
+        std::chrono::steady_clock::time_point lastEventTime; // when WaitForDebugEvent returned
+        latencyStats fastPathLatency; // event to continue
+        latencyStats fullPathLatency; // event to continue, events that did not stop
+        latencyStats stopToPromptLatency;
+        symbolTable COFFsymbols; // RVA keyed, from COFF symbol table or .pdb publics
+        relocationTable imageRelocations; // main image
+        symbolView imageSymbols {&COFFsymbols, &imageFunctions, &imageRelocations}; // rebased when process is created
+        controlFlowGraph imageGraph; // main image, built at first cfg command
+        bool imageGraphBuilt = false;
+        xrefIndex imageXrefs; // main image as it was mapped after load
+        std::atomic <bool> imageXrefsReady {false};
+        instructionCache codeCache {[this] (uint64_t page, uint8_t * bytes) { return processReader && processReader->read (page, bytes, instructionCache::PAGE_SIZE); }}; // decoded instructions shown by disasm and context
 
     	DEBUG_EVENT currentDebugEvent;
 
     	std::thread debuggerThread;
     	std::thread commandThread;
+    	std::thread xrefThread;
 
     	HANDLE commandEvent;
     	HANDLE continueDebugEvent;
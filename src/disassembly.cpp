@@ -1,11 +1,10 @@
 #include "disassembly.h"
 
-disassembler::disassembler(uint64_t baseAddress, std::map <uint64_t, symbol> const * symbols, std::vector <function> const * functionNames)
+disassembler::disassembler(symbolView const * image, instructionCache * cache)
 {
 	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-	this->baseAddress = baseAddress;
-	this->symbols = symbols;
-    this->functionNames = functionNames;
+	this->image = image;
+	this->cache = cache;
 
 	defaultColor = getCurrentPromptColor (stdoutHandle);
 
@@ -19,57 +18,22 @@ disassembler::disassembler(uint64_t baseAddress, std::map <uint64_t, symbol> con
     	log ("Cannot set detail disassembly option in capstone disassembler\n",logType::ERR, stdoutHandle);
         return;
     }
-}
-disassembler::~disassembler()
-{
-	cs_close (&handle);
-}
-breakpoint * disassembler::searchForBreakpoint (std::vector <breakpoint> & b, void * address)
-{
-    for (auto & i : b)
+    if (cs_open(CS_ARCH_X86, CS_MODE_64, &fastHandle) != CS_ERR_OK)
     {
-        if (i.getAddress() == address)
-        {
-            return &i;
-        }
+    	log ("Cannot initialize capstone disassemble\n",logType::ERR, stdoutHandle);
+        return;
     }
-    return nullptr;
 }
-void disassembler::changeBreakpointsToOriginal (
-	std::vector <breakpoint *> & disassembledBreakpoints,
-	std::vector <breakpoint> & breakpoints,
-	cs_insn ** insn,
-	uint8_t * codeBuffer,
-	uint64_t address,
-	uint32_t codeSize,
-	uint32_t numberOfInstructions,
-	size_t & count
-	 )
+disassembler::~disassembler()
 {
-	for (int j = 0; j < (numberOfInstructions >= count ? count : numberOfInstructions); j++) // iterate over all instructions disassembled to find breakpoint locations
-    {
-        breakpoint * bp = searchForBreakpoint (breakpoints, (void *) (*insn)[j].address);
-        if (bp)
-        {
-            disassembledBreakpoints.push_back (bp); // even if breakpoint is not restored yet or it is hardware it is displayed
-        }
-        if (!strncmp ((*insn)[j].mnemonic, "int3", 4) && bp ) // if breakpoint is set and there is 0xcc byte 
-        {
-            if (bp->getType() == breakpointType::SOFTWARE_TYPE) // user software breakpoint
-            {
-                size_t int3Offset = (*insn)[j].address - (uint64_t) address;
-                codeBuffer [int3Offset] = bp->getOriginalByte();
-                cs_free (*insn, count);
-                count = cs_disasm (handle, codeBuffer, codeSize , (uint64_t) address, 0, insn); // disassembly again
-            }
-        }
-    }
+	cs_close (&handle);
+	cs_close (&fastHandle);
 }
 instructionType disassembler::getInstructionType (cs_insn insn, cs_detail * detail)
 {
 	instructionType type;
 
-	for (int i = 0 ; i < 8; i++)
+	for (int i = 0 ; i < detail->groups_count; i++) // unused entries are zero, which is X86_GRP_INVALID
 	{
 		if (detail->groups[i] == x86_insn_group::X86_GRP_INVALID)
 		{
@@ -108,20 +72,6 @@ instructionType disassembler::getInstructionType (cs_insn insn, cs_detail * deta
 }
 void disassembler::parseInstruction (cs_insn insn, disassemblyLineInfo & lineInfo)
 {
-    std::string start = getFunctionNameStartForAddress (insn.address);
-    std::string end = getFunctionNameEndForAddress (insn.address);
-
-	if (start.size() > 0)
-    {
-        centerTextColorDecorate (start.c_str(), 60, 15, stdoutHandle);
-        printf ("\n\n");
-    }
-    else if (end.size() > 0)
-    {
-        std::string toWrite = "end " + end;
-        centerTextColorDecorate (toWrite.c_str(), 60, 15, stdoutHandle);
-        printf ("\n\n");   
-    }
 	cs_detail *detail = insn.detail;
 	instructionType type = getInstructionType (insn, detail);
 
@@ -136,20 +86,29 @@ void disassembler::parseInstruction (cs_insn insn, disassemblyLineInfo & lineInf
 
         if (op->type == X86_OP_IMM)
         {
-            if (symbols->find(op->imm - baseAddress) != symbols->end())
+            const symbolEntry * sym = image->find (op->imm);
+            if (sym)
             {
-                std::string a = symbols->at(op->imm - baseAddress).name + " <" + intToHex (op->imm) + ">";
+                std::string a = std::string (image->getName (sym)) + " <" + intToHex (op->imm) + ">";
                 lineInfo.op.str = a;
                 lineInfo.op.color = 15;
                 return;
             }  
+            std::string resolved = (addressResolver ? addressResolver (op->imm) : "");
+            if (resolved.size() > 0)
+            {
+                lineInfo.op.str = resolved + " <" + intToHex (op->imm) + ">";
+                lineInfo.op.color = 15;
+                return;
+            }
         }
         if (op->type == X86_OP_MEM)
         {
         	uint64_t relativeAddress = X86_REL_ADDR (insn);
-        	if (symbols->find(relativeAddress - baseAddress) != symbols->end())
+            const symbolEntry * sym = image->find (relativeAddress);
+        	if (sym)
             {
-                std::string a = symbols->at(relativeAddress - baseAddress).name + " <" + intToHex (op->imm) + ">";
+                std::string a = std::string (image->getName (sym)) + " <" + intToHex (op->imm) + ">";
                 lineInfo.op.str = a;
                 lineInfo.op.color = 15;
                 return;
@@ -161,9 +120,10 @@ void disassembler::parseInstruction (cs_insn insn, disassemblyLineInfo & lineInf
     	if (!strncmp(cs_reg_name(handle, detail->x86.operands[0].mem.base), "rip", 3))
     	{
     		uint64_t relativeAddress = X86_REL_ADDR (insn);
-    		if (symbols->find(relativeAddress - baseAddress) != symbols->end())
+            const symbolEntry * sym = image->find (relativeAddress);
+    		if (sym)
             {
-                std::string op1 = symbols->at(relativeAddress - baseAddress).name;
+                std::string op1 = image->getName (sym);
                 std::string op2 = "";
                 if (detail->x86.operands[1].type == X86_OP_REG)
             	{
@@ -184,9 +144,10 @@ void disassembler::parseInstruction (cs_insn insn, disassemblyLineInfo & lineInf
 		if (!strncmp(cs_reg_name(handle, detail->x86.operands[1].mem.base), "rip", 3))
     	{
 			uint64_t relativeAddress = X86_REL_ADDR (insn);
-    		if (symbols->find(relativeAddress - baseAddress) != symbols->end())
+            const symbolEntry * sym = image->find (relativeAddress);
+    		if (sym)
             {
-                std::string op2 = symbols->at(relativeAddress - baseAddress).name;
+                std::string op2 = image->getName (sym);
                 std::string op1 = "";
             	op1 = cs_reg_name(handle, detail->x86.operands[0].reg);
        			lineInfo.op.str = op1 + ", " + op2 + " <" + intToHex(relativeAddress) + ">";
@@ -198,82 +159,217 @@ void disassembler::parseInstruction (cs_insn insn, disassemblyLineInfo & lineInf
     lineInfo.op.str = std::string (insn.op_str); // id any symbol applies then leave it as it is
     lineInfo.op.color = defaultColor;
 }
-void disassembler::printLine (std::vector <breakpoint *> & disassembledBreakpoints, disassemblyLineInfo & line)
+void disassembler::printFunctionBanner (uint64_t address)
+{
+    std::string start = getFunctionNameStartForAddress (address);
+    std::string end = getFunctionNameEndForAddress (address);
+
+	if (start.size() > 0)
+    {
+        centerTextColorDecorate (start.c_str(), 60, 15, stdoutHandle);
+        printf ("\n\n");
+    }
+    else if (end.size() > 0)
+    {
+        std::string toWrite = "end " + end;
+        centerTextColorDecorate (toWrite.c_str(), 60, 15, stdoutHandle);
+        printf ("\n\n");   
+    }
+}
+void disassembler::printLine (const breakpoint * bp, disassemblyLineInfo & line)
+{
+    if (bp && bp->getType() == breakpointType::SOFTWARE_TYPE && !bp->getIsOneHit()) // breakpoint line spotted
+    {
+        printfColor ("0x%llx:\t%s\t\t%s\n", 12, stdoutHandle, line.address.val, line.mnemonic.str.c_str(), line.op.str.c_str());
+    }
+    else if (bp && bp->getType() == breakpointType::HARDWARE_TYPE)
+    {
+        printfColor ("0x%llx:\t%s\t\t%s\n", 9, stdoutHandle, line.address.val, line.mnemonic.str.c_str(), line.op.str.c_str());
+    }
+    else // if line is not breakpoint print it normally
+    {
+        printfColor ("0x%llx:", line.address.color, stdoutHandle, line.address.val);
+        printfColor ("\t%s", line.mnemonic.color, stdoutHandle, line.mnemonic.str.c_str());
+        printfColor ("\t\t%s\n", line.op.color, stdoutHandle, line.op.str.c_str());
+    }
+}
+bool disassembler::decode (memoryReader & reader, uint64_t address, uint32_t numberOfInstructions)
 {
-	bool breakpointShown = false;
-    for (const auto & a : disassembledBreakpoints) // search for line with breakpoint
+    instructionStream stream (handle, reader, address, numberOfInstructions * MAX_INSTRUCTION_LENGTH);
+    uint32_t count = 0;
+    for (; count < numberOfInstructions; count++)
     {
-        if ((void *) line.address.val == a->getAddress() && a->getType() == breakpointType::SOFTWARE_TYPE && !a->getIsOneHit())
+        const cs_insn * insn = stream.next ();
+        if (!insn)
         {
-            printfColor ("0x%llx:\t%s\t\t%s\n", 12, stdoutHandle, line.address.val, line.mnemonic.str.c_str(), line.op.str.c_str()); // breakpoint line spotted
-            breakpointShown = true;
+            break;
         }
-        else if ((void *) line.address.val == a->getAddress() && a->getType() == breakpointType::HARDWARE_TYPE)
+        cachedInstruction instruction;
+        parseInstruction (*insn, instruction.line);
+        instruction.size = insn->size;
+        cache->insert (insn->address, std::move (instruction));
+    }
+    if (count == 0)
+    {
+        log ("Cannot disassembly memory at %.16llx\n",logType::ERR, stdoutHandle, address);
+        return false;
+    }
+    return true;
+}
+void disassembler::disasmStream (memoryReader & reader, uint64_t address, uint32_t numberOfInstructions, const breakpointSnapshot & breakpoints)
+{
+    instructionStream stream (fastHandle, reader, address, UINT64_MAX);
+    for (uint32_t j = 0; j < numberOfInstructions; j++)
+    {
+        const cs_insn * insn = stream.next ();
+        if (!insn)
         {
-            printfColor ("0x%llx:\t%s\t\t%s\n", 9, stdoutHandle, line.address.val, line.mnemonic.str.c_str(), line.op.str.c_str());
-            breakpointShown = true;
+            uint64_t badAddress = stream.getAddress ();
+            if (!stream.skipByte ())
+            {
+                log ("Cannot read memory at %.16llx\n",logType::ERR, stdoutHandle, badAddress);
+                return;
+            }
+            printf ("0x%llx:\t(bad)\n", badAddress);
+            continue;
+        }
+        printFunctionBanner (insn->address);
+        const breakpoint * bp = breakpoints.find (insn->address);
+        if (bp && (bp->getType() == breakpointType::HARDWARE_TYPE || !bp->getIsOneHit()))
+        {
+            printfColor ("0x%llx:\t%s\t\t%s\n", bp->getType() == breakpointType::HARDWARE_TYPE ? 9 : 12, stdoutHandle, insn->address, insn->mnemonic, insn->op_str);
+        }
+        else
+        {
+            printf ("0x%llx:\t%s\t\t%s\n", insn->address, insn->mnemonic, insn->op_str);
         }
     }
-    if (!breakpointShown) // if line is not breakpoint print it normally
+}
+void disassembler::disasm (memoryReader & reader, uint64_t address, uint32_t numberOfInstructions, const breakpointSnapshot & breakpoints)
+{
+    if (numberOfInstructions > MAX_CACHED_VIEW)
     {
-        printfColor ("0x%llx:", line.address.color, stdoutHandle, line.address.val);
-        printfColor ("\t%s", line.mnemonic.color, stdoutHandle, line.mnemonic.str.c_str());
-        printfColor ("\t\t%s\n", line.op.color, stdoutHandle, line.op.str.c_str());
-        //printf ("0x%.16llx:\t%s\t\t%s\n", line.address.val, line.mnemonic.str.c_str(), line.op.str.c_str());
+        disasmStream (reader, address, numberOfInstructions, breakpoints);
+        return;
+    }
+    for (uint32_t j = 0; j < numberOfInstructions; j++) // main print loop
+    {
+        const cachedInstruction * instruction = cache->find (address);
+        if (!instruction && decode (reader, address, numberOfInstructions - j))
+        {
+            instruction = cache->find (address);
+        }
+        if (!instruction)
+        {
+            return;
+        }
+        disassemblyLineInfo line = instruction->line;
+        printFunctionBanner (address);
+        printLine (breakpoints.find (address), line);
+        address += instruction->size;
     }
 }
-
-void disassembler::disasm (uint64_t address, uint8_t * codeBuffer, uint32_t codeSize, uint32_t numberOfInstructions, std::vector <breakpoint> & breakpoints)
+uint64_t disassembler::findStartBefore (memoryReader & reader, uint64_t address, uint32_t & numberOfInstructions)
 {
-	cs_insn * insn;
-    size_t count;
-    std::vector <breakpoint *> disassembledBreakpoints;
+    uint32_t found = 0;
+    uint64_t start = address;
+    uint64_t previous;
+    while (found < numberOfInstructions && cache->findEndingAt (start, previous)) // shown or decoded before
+    {
+        start = previous;
+        found++;
+    }
+    if (found == numberOfInstructions)
+    {
+        return start;
+    }
 
-    count = cs_disasm (handle, codeBuffer, codeSize, (uint64_t)address, 0, &insn);
-    if (count > 0)
+    // Rest is resynced: every offset of window before start is decoded once, decode chains from all offsets vote
+    // for boundaries they pass through (x86 decoding converges quickly), chain ending at start with most votes wins.
+    uint64_t windowSize = (numberOfInstructions - found) * MAX_INSTRUCTION_LENGTH + RESYNC_MARGIN;
+    uint64_t low = start > windowSize ? start - windowSize : 0;
+    std::vector <uint8_t> bytes (start - low);
+    if (!reader.read (low, bytes.data(), bytes.size())) // window reaches to unreadable page, only page of start is used
+    {
+        low = std::max (low, (start - 1) & ~(uint64_t) 0xFFF);
+        bytes.resize (start - low);
+        if (!reader.read (low, bytes.data(), bytes.size()))
+        {
+            numberOfInstructions = found;
+            return start;
+        }
+    }
+    size_t size = bytes.size();
+    std::vector <uint8_t> length (size, 0);
+    std::vector <uint32_t> votes (size + 1, 0);
+    const functionRange * function = image->functionContaining (start - 1);
+    uint64_t functionStart = function ? image->getBase() + function->start : UINT64_MAX;
+    cs_insn * insn = cs_malloc (fastHandle);
+    for (size_t i = 0; i < size; i++)
     {
-    	changeBreakpointsToOriginal (
-    		disassembledBreakpoints,
-    		breakpoints,
-    		&insn,
-    		codeBuffer,
-    		address,
-    		codeSize,
-    		numberOfInstructions,
-    		count);
+        const uint8_t * code = bytes.data() + i;
+        size_t left = size - i;
+        uint64_t decodeAddress = low + i;
+        if (cs_disasm_iter (fastHandle, &code, &left, &decodeAddress, insn))
+        {
+            length[i] = insn->size;
+        }
+        const cachedInstruction * known = length[i] ? cache->find (low + i) : nullptr;
+        votes[i] += (known && known->size == length[i]) || low + i == functionStart ? ANCHOR_VOTES : 1;
+        if (length[i] && i + length[i] <= size)
+        {
+            votes[i + length[i]] += votes[i];
+        }
+    }
+    cs_free (insn, 1);
 
-        for (int j = 0 ; j < (numberOfInstructions >= count ? count : numberOfInstructions); j++) // main print loop
+    size_t position = size;
+    for (; found < numberOfInstructions; found++) // from start back, predecessor with most votes
+    {
+        size_t best = SIZE_MAX;
+        for (size_t len = 1; len <= MAX_INSTRUCTION_LENGTH && len <= position; len++)
         {
-            disassemblyLineInfo line;
-            parseInstruction (insn[j], line);
-            printLine (disassembledBreakpoints, line);
+            size_t candidate = position - len;
+            if (length[candidate] == len && (best == SIZE_MAX || votes[candidate] > votes[best]))
+            {
+                best = candidate;
+            }
         }
-        cs_free (insn, count);
+        if (best == SIZE_MAX)
+        {
+            break;
+        }
+        position = best;
     }
-    else
+    numberOfInstructions = found;
+    return low + position;
+}
+void disassembler::disasmBackward (memoryReader & reader, uint64_t address, uint32_t numberOfInstructions, const breakpointSnapshot & breakpoints)
+{
+    numberOfInstructions = std::min (numberOfInstructions, MAX_CACHED_VIEW);
+    uint64_t start = findStartBefore (reader, address, numberOfInstructions);
+    if (numberOfInstructions == 0)
     {
-        log ("Cannot disassembly memory at %.16llx\n",logType::ERR, stdoutHandle, address);
+        log ("Cannot find instructions before %.16llx\n",logType::ERR, stdoutHandle, address);
+        return;
     }
+    disasm (reader, start, numberOfInstructions, breakpoints); // decoded lines go to cache, next backward view of same code only walks it
 }
 std::string disassembler::getFunctionNameStartForAddress (uint64_t address)
 {
-    for (const auto & func : *functionNames)
+    const functionRange * func = image->functionStartingAt (address);
+    if (func)
     {
-        if (address == func.start)
-        {
-            return func.name;
-        }
+        return image->getFunctionName (func);
     }
     return "";
 }
 std::string disassembler::getFunctionNameEndForAddress (uint64_t address)
 {
-    for (const auto & func : *functionNames)
+    const functionRange * func = image->functionEndingAt (address);
+    if (func)
     {
-        if (address == func.end)
-        {
-            return func.name;
-        }
+        return image->getFunctionName (func);
     }
     return "";
 }
\ No newline at end of file
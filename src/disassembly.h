@@ -3,12 +3,16 @@
 #include <windows.h>
 #include <vector>
 #include <map>
+#include <functional>
 
 #include <capstone/capstone.h>
-#include "breakpoint.h"
+#include "breakpointTable.h"
 #include "utils.h"
-#include "symbolParse.h"
+#include "symbolView.h"
 #include "structs.h"
+#include "instructionCache.h"
+#include "unwinder.h"
+#include "instructionStream.h"
 
 struct instructionType
 {
@@ -36,58 +40,37 @@ struct instructionType
 	bool X86_GRP_BRANCH_RELATIVE = 0; 
 };
 
-struct disassemblyLineInfo
-{
-	struct
-	{
-		uint64_t val = 0xbeefc0de;
-		DWORD color = 0;
-	} address;
-	struct
-	{
-		std::string str = "?";
-		DWORD color = 0;
-	} mnemonic;
-	struct
-	{
-		std::string str = "";
-		std::string op1 = "";
-		std::string op2 = "";
-		DWORD color = 0;
-	} op;
-};
-
 class disassembler
 {
 	private:
+		static constexpr uint32_t MAX_CACHED_VIEW = 256; // longer listings are streamed without detail, symbols and cache
+		static constexpr uint64_t RESYNC_MARGIN = 32; // extra bytes decoded before backward window so decodes from wrong offsets converge
+		static constexpr uint32_t ANCHOR_VOTES = 0x10000; // known boundary (cached instruction, function start) outweighs any number of guesses
+
 		csh handle;
+		csh fastHandle; // detail off
 		HANDLE stdoutHandle;
-		uint64_t baseAddress;
 		DWORD defaultColor;
-		std::map <uint64_t, symbol> const * symbols;
-		std::vector <function> const * functionNames;
+		symbolView const * image; // main image symbols at its current base
+		instructionCache * cache;
+		std::function <std::string (uint64_t)> addressResolver; // names addresses outside of main image symbols
 
-		breakpoint * searchForBreakpoint (std::vector <breakpoint> & b, void * address);
 		std::string getFunctionNameStartForAddress (uint64_t address);
 		std::string getFunctionNameEndForAddress (uint64_t address);
 
-		void changeBreakpointsToOriginal (
-			std::vector <breakpoint *> &,
-			std::vector <breakpoint> &,
-			cs_insn **,
-			uint8_t *,
-			uint64_t,
-			uint32_t,
-			uint32_t,
-			size_t &
-	 	);
-	 	void printLine (std::vector <breakpoint *> &, disassemblyLineInfo &);
+		bool decode (memoryReader &, uint64_t, uint32_t);
+		uint64_t findStartBefore (memoryReader &, uint64_t, uint32_t &);
+		void disasmStream (memoryReader &, uint64_t, uint32_t, const breakpointSnapshot &);
+		void printFunctionBanner (uint64_t);
+	 	void printLine (const breakpoint *, disassemblyLineInfo &);
 	 	void parseInstruction (cs_insn, disassemblyLineInfo &);
-	 	instructionType getInstructionType (cs_insn, cs_detail *);
 	 	void parseOperands ();
 	public:
 		const uint32_t MAX_INSTRUCTION_LENGTH = 15;
-		disassembler (uint64_t, std::map <uint64_t, symbol> const *, std::vector <function> const *);
+		static instructionType getInstructionType (cs_insn, cs_detail *); // detail has to be on
+		disassembler (symbolView const *, instructionCache *);
 		~disassembler ();
-		void disasm (uint64_t, uint8_t *, uint32_t, uint32_t, std::vector <breakpoint> &);
+		void setAddressResolver (std::function <std::string (uint64_t)> resolver) { addressResolver = resolver; }
+		void disasm (memoryReader &, uint64_t, uint32_t, const breakpointSnapshot &); // reader has to hide breakpoints, decodes only instructions missing in cache
+		void disasmBackward (memoryReader &, uint64_t, uint32_t, const breakpointSnapshot &); // instructions ending at address
 };
\ No newline at end of file
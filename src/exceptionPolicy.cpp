@@ -0,0 +1,101 @@
+#include "exceptionPolicy.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace
+{
+	struct exceptionName
+	{
+		DWORD code;
+		const char * name;
+		const char * shortName;
+	};
+	constexpr exceptionName EXCEPTION_NAMES [] =
+	{
+		{ EXCEPTION_ACCESS_VIOLATION, "access_violation", "av" },
+		{ EXCEPTION_BREAKPOINT, "breakpoint", "bp" },
+		{ EXCEPTION_SINGLE_STEP, "single_step", "ss" },
+		{ EXCEPTION_ILLEGAL_INSTRUCTION, "illegal_instruction", "ud" },
+		{ EXCEPTION_PRIV_INSTRUCTION, "priv_instruction", "priv" },
+		{ EXCEPTION_INT_DIVIDE_BY_ZERO, "int_divide_by_zero", "div" },
+		{ EXCEPTION_INT_OVERFLOW, "int_overflow", "ov" },
+		{ EXCEPTION_STACK_OVERFLOW, "stack_overflow", "so" },
+		{ EXCEPTION_GUARD_PAGE, "guard_page", "guard" },
+		{ EXCEPTION_IN_PAGE_ERROR, "in_page_error", "inpage" },
+		{ EXCEPTION_INVALID_HANDLE, "invalid_handle", "handle" },
+		{ EXCEPTION_DATATYPE_MISALIGNMENT, "datatype_misalignment", "align" },
+		{ EXCEPTION_ARRAY_BOUNDS_EXCEEDED, "array_bounds_exceeded", "bounds" },
+		{ EXCEPTION_NONCONTINUABLE_EXCEPTION, "noncontinuable", "nc" },
+		{ 0x40010005, "control_c", "ctrlc" }, // DBG_CONTROL_C
+		{ 0x406D1388, "set_thread_name", "name" }, // MSVC thread naming
+		{ 0xE06D7363, "cpp", "cpp" } // MSVC C++ throw
+	};
+}
+
+void exceptionPolicyTable::set (DWORD code, exceptionPolicy policy)
+{
+	auto it = std::lower_bound (entries.begin(), entries.end(), code, [] (const exceptionPolicyEntry & e, DWORD c) { return e.code < c; });
+	if (it != entries.end() && it->code == code)
+	{
+		it->policy = policy;
+		return;
+	}
+	entries.insert (it, { code, policy });
+}
+exceptionPolicy exceptionPolicyTable::get (DWORD code) const
+{
+	auto it = std::lower_bound (entries.begin(), entries.end(), code, [] (const exceptionPolicyEntry & e, DWORD c) { return e.code < c; });
+	return it != entries.end() && it->code == code ? it->policy : defaultPolicy;
+}
+const char * exceptionPolicyTable::getPolicyName (exceptionPolicy policy)
+{
+	switch (policy)
+	{
+		case exceptionPolicy::STOP: return "stop";
+		case exceptionPolicy::LOG: return "log";
+		case exceptionPolicy::PASS: return "pass";
+	}
+	return "?";
+}
+bool exceptionPolicyTable::parsePolicy (std::string name, exceptionPolicy & policy)
+{
+	for (exceptionPolicy candidate : { exceptionPolicy::STOP, exceptionPolicy::LOG, exceptionPolicy::PASS })
+	{
+		if (name == getPolicyName (candidate))
+		{
+			policy = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+const char * exceptionPolicyTable::getExceptionName (DWORD code)
+{
+	for (const auto & known : EXCEPTION_NAMES)
+	{
+		if (known.code == code)
+		{
+			return known.name;
+		}
+	}
+	return nullptr;
+}
+bool exceptionPolicyTable::parseException (std::string name, DWORD & code)
+{
+	for (const auto & known : EXCEPTION_NAMES)
+	{
+		if (name == known.name || name == known.shortName)
+		{
+			code = known.code;
+			return true;
+		}
+	}
+	char * end = nullptr;
+	unsigned long value = strtoul (name.c_str(), &end, 16);
+	if (name.empty() || *end != '\0' || value > 0xFFFFFFFF)
+	{
+		return false;
+	}
+	code = (DWORD) value;
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+// What debugging loop does with exception of given code: stop (interrupt and wait for commands), log (print it and pass it
+// to the process) or pass it silently. Exceptions that do not stop are continued without reading or writing thread context.
+// Table is small array sorted by code, codes not in it get default policy.
+
+enum class exceptionPolicy : uint8_t
+{
+	STOP = 0,
+	LOG = 1,
+	PASS = 2
+};
+
+struct exceptionPolicyEntry
+{
+	DWORD code;
+	exceptionPolicy policy;
+};
+
+class exceptionPolicyTable
+{
+	private:
+		std::vector <exceptionPolicyEntry> entries; // sorted by code
+		exceptionPolicy defaultPolicy = exceptionPolicy::LOG;
+	public:
+		void set (DWORD, exceptionPolicy);
+		void setDefault (exceptionPolicy policy) { defaultPolicy = policy; }
+		exceptionPolicy get (DWORD) const;
+		exceptionPolicy getDefault () const { return defaultPolicy; }
+		const std::vector <exceptionPolicyEntry> & getEntries () const { return entries; }
+
+		static const char * getPolicyName (exceptionPolicy);
+		static bool parsePolicy (std::string, exceptionPolicy &);
+		static const char * getExceptionName (DWORD); // nullptr for codes without name
+		static bool parseException (std::string, DWORD &); // name (access_violation, av ...) or hex code
+};
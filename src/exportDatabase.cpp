@@ -0,0 +1,209 @@
+#include "exportDatabase.h"
+#include "peParser.h"
+#include <algorithm>
+
+constexpr char exportDatabase::MAGIC [8];
+
+exportDatabase::exportDatabase ()
+{
+	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+}
+uint64_t exportDatabase::moduleKey (std::string name, uint32_t timeDateStamp, uint32_t sizeOfImage)
+{
+	std::transform (name.begin(), name.end(), name.begin(), ::tolower);
+	uint64_t identity [2] = { hashBytes ((const uint8_t *) name.data(), name.size()), ((uint64_t) timeDateStamp << 32) | sizeOfImage };
+	return hashBytes ((const uint8_t *) identity, sizeof (identity));
+}
+bool exportDatabase::load (std::string path)
+{
+	if (!file.open (path))
+	{
+		return false;
+	}
+	const exportDbHeader * header = (const exportDbHeader *) file.at (0, sizeof (exportDbHeader));
+	if (header == nullptr || memcmp (header->magic, MAGIC, sizeof (MAGIC)) || header->version != VERSION ||
+		header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)))
+	{
+		log ("Export database %s has invalid header\n", logType::ERR, stdoutHandle, path.c_str());
+		file.close ();
+		return false;
+	}
+	uint64_t offset = sizeof (exportDbHeader);
+	modules = file.spanAt<exportDbModule> (offset, header->moduleCount);
+	offset += (uint64_t) header->moduleCount * sizeof (exportDbModule);
+	moduleSlots = file.spanAt<uint32_t> (offset, header->slotCount);
+	offset += (uint64_t) header->slotCount * sizeof (uint32_t);
+	exports = file.spanAt<exportDbEntry> (offset, header->exportCount);
+	offset += (uint64_t) header->exportCount * sizeof (exportDbEntry);
+	pool = file.spanAt<char> (offset, header->poolSize);
+
+	bool valid = modules.size() == header->moduleCount && moduleSlots.size() == header->slotCount &&
+		exports.size() == header->exportCount && pool.size() == header->poolSize && !pool.empty() && pool[pool.size() - 1] == '\0';
+	for (size_t i = 0; valid && i < modules.size(); i++)
+	{
+		valid = modules[i].nameOffset < pool.size() && modules[i].firstExport <= exports.size() &&
+			modules[i].exportCount <= exports.size() - modules[i].firstExport;
+	}
+	for (size_t i = 0; valid && i < exports.size(); i++)
+	{
+		valid = exports[i].nameOffset < pool.size();
+	}
+	for (size_t i = 0; valid && i < moduleSlots.size(); i++)
+	{
+		valid = moduleSlots[i] <= modules.size();
+	}
+	if (!valid)
+	{
+		log ("Export database %s is corrupted\n", logType::ERR, stdoutHandle, path.c_str());
+		modules = {};
+		file.close ();
+		return false;
+	}
+	return true;
+}
+const exportDbModule * exportDatabase::findModule (std::string name, uint32_t timeDateStamp, uint32_t sizeOfImage)
+{
+	if (!isLoaded ())
+	{
+		return nullptr;
+	}
+	uint64_t key = moduleKey (name, timeDateStamp, sizeOfImage);
+	size_t mask = moduleSlots.size() - 1;
+	for (size_t slot = key & mask, probes = 0; moduleSlots[slot] != 0 && probes < moduleSlots.size(); slot = (slot + 1) & mask, probes++)
+	{
+		const exportDbModule * module = &modules[moduleSlots[slot] - 1];
+		if (module->key == key && module->timeDateStamp == timeDateStamp && module->sizeOfImage == sizeOfImage)
+		{
+			return module;
+		}
+	}
+	return nullptr;
+}
+const exportDbEntry * exportDatabase::findNearest (const exportDbModule * module, uint32_t rva)
+{
+	const exportDbEntry * first = exports.data + module->firstExport;
+	const exportDbEntry * last = first + module->exportCount;
+	const exportDbEntry * it = std::upper_bound (first, last, rva, [] (uint32_t v, const exportDbEntry & e) { return v < e.rva; });
+	if (it == first)
+	{
+		return nullptr;
+	}
+	return it - 1;
+}
+const exportDbEntry * exportDatabase::findExact (const exportDbModule * module, uint32_t rva)
+{
+	const exportDbEntry * entry = findNearest (module, rva);
+	if (entry && entry->rva == rva)
+	{
+		return entry;
+	}
+	return nullptr;
+}
+bool exportDatabase::build (std::vector <std::string> const & dllPaths, std::string outputPath, HANDLE stdoutHandle)
+{
+	std::vector <exportDbModule> modules;
+	std::vector <exportDbEntry> exports;
+	std::vector <char> pool;
+	auto addString = [&pool] (std::string str) -> uint32_t
+	{
+		uint32_t offset = pool.size();
+		pool.insert (pool.end(), str.begin(), str.end());
+		pool.push_back ('\0');
+		return offset;
+	};
+
+	for (const auto & path : dllPaths)
+	{
+		try
+		{
+			PEparser parser (path);
+			if (!parser.isValid ())
+			{
+				log ("Skipping %s, it is not a supported PE file\n", logType::WARNING, stdoutHandle, path.c_str());
+				continue;
+			}
+			exportTable table = parser.getExportTable ();
+			if (table.empty())
+			{
+				continue;
+			}
+			std::string fileName = path.substr (path.find_last_of ("\\/") + 1);
+
+			exportDbModule module;
+			module.timeDateStamp = parser.getTimeDateStamp ();
+			module.sizeOfImage = parser.getSizeOfImage ();
+			module.key = moduleKey (fileName, module.timeDateStamp, module.sizeOfImage);
+			module.nameOffset = addString (fileName);
+			module.firstExport = exports.size();
+			module.reserved = 0;
+
+			std::vector <exportDbEntry> moduleExports;
+			for (const auto & entry : table.getEntries ())
+			{
+				if (entry.forwarderOffset == exportTable::NO_NAME && table.findByRVA (entry.rva) == &entry) // one name per address
+				{
+					moduleExports.push_back ( { entry.rva, addString (table.getDisplayName (&entry)) } );
+				}
+			}
+			std::stable_sort (moduleExports.begin(), moduleExports.end(), [] (const exportDbEntry & a, const exportDbEntry & b) { return a.rva < b.rva; });
+			module.exportCount = moduleExports.size();
+			exports.insert (exports.end(), moduleExports.begin(), moduleExports.end());
+			modules.push_back (module);
+
+			log ("%s: %u exports\n", logType::INFO, stdoutHandle, fileName.c_str(), module.exportCount);
+		}
+		catch (const std::exception &)
+		{
+			log ("Skipping %s, it is not a supported PE file\n", logType::WARNING, stdoutHandle, path.c_str());
+		}
+	}
+	if (pool.empty())
+	{
+		pool.push_back ('\0');
+	}
+
+	uint32_t slotCount = 16;
+	while (slotCount < modules.size() * 2)
+	{
+		slotCount <<= 1;
+	}
+	std::vector <uint32_t> moduleSlots (slotCount, 0);
+	for (uint32_t i = 0; i < modules.size(); i++)
+	{
+		size_t slot = modules[i].key & (slotCount - 1);
+		while (moduleSlots[slot] != 0)
+		{
+			slot = (slot + 1) & (slotCount - 1);
+		}
+		moduleSlots[slot] = i + 1;
+	}
+
+	exportDbHeader header;
+	memcpy (header.magic, MAGIC, sizeof (MAGIC));
+	header.version = VERSION;
+	header.moduleCount = modules.size();
+	header.slotCount = slotCount;
+	header.exportCount = exports.size();
+	header.poolSize = pool.size();
+
+	FILE * f = fopen (outputPath.c_str(), "wb");
+	if (!f)
+	{
+		log ("Cannot create export database %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+		return false;
+	}
+	bool written = fwrite (&header, sizeof (header), 1, f) == 1 &&
+		fwrite (modules.data(), sizeof (exportDbModule), modules.size(), f) == modules.size() &&
+		fwrite (moduleSlots.data(), sizeof (uint32_t), moduleSlots.size(), f) == moduleSlots.size() &&
+		fwrite (exports.data(), sizeof (exportDbEntry), exports.size(), f) == exports.size() &&
+		fwrite (pool.data(), 1, pool.size(), f) == pool.size();
+	fclose (f);
+	if (!written)
+	{
+		log ("Cannot write export database %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+		return false;
+	}
+	log ("Export database with %u modules and %u exports written to %s\n", logType::INFO, stdoutHandle,
+		header.moduleCount, header.exportCount, outputPath.c_str());
+	return true;
+}
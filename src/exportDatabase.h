@@ -0,0 +1,69 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "mappedFile.h"
+
+// Export database layout (little endian):
+// exportDbHeader | exportDbModule [moduleCount] | uint32_t moduleSlots [slotCount] | exportDbEntry [exportCount] | char pool [poolSize]
+// moduleSlots is open addressing table indexed by module key, it holds module index + 1 (0 is empty slot)
+// exports of every module are sorted by RVA, forwarded exports are not stored (they have no address)
+
+#pragma pack(push)
+#pragma pack(1)
+struct exportDbHeader
+{
+	char magic [8];
+	uint32_t version;
+	uint32_t moduleCount;
+	uint32_t slotCount;
+	uint32_t exportCount;
+	uint64_t poolSize;
+};
+struct exportDbModule
+{
+	uint64_t key;
+	uint32_t timeDateStamp;
+	uint32_t sizeOfImage;
+	uint32_t nameOffset;
+	uint32_t firstExport;
+	uint32_t exportCount;
+	uint32_t reserved;
+};
+struct exportDbEntry
+{
+	uint32_t rva;
+	uint32_t nameOffset;
+};
+#pragma pack(pop)
+
+class exportDatabase
+{
+	private:
+		static constexpr char MAGIC [8] = {'M','D','B','G','E','X','D','B'};
+		static constexpr uint32_t VERSION = 1;
+
+		mappedFile file;
+		HANDLE stdoutHandle;
+		dataSpan<exportDbModule> modules;
+		dataSpan<uint32_t> moduleSlots;
+		dataSpan<exportDbEntry> exports;
+		dataSpan<char> pool;
+
+		static uint64_t moduleKey (std::string, uint32_t, uint32_t);
+	public:
+		exportDatabase ();
+		bool load (std::string);
+		bool isLoaded () { return !modules.empty(); }
+		size_t getModuleCount () { return modules.size(); }
+
+		const exportDbModule * findModule (std::string, uint32_t, uint32_t); // file name is case insensitive
+		const exportDbEntry * findExact (const exportDbModule *, uint32_t);
+		const exportDbEntry * findNearest (const exportDbModule *, uint32_t); // nearest preceding or equal
+		const char * getName (uint32_t offset) { return pool.data + offset; }
+
+		static bool build (std::vector <std::string> const &, std::string, HANDLE);
+};
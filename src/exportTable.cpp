@@ -0,0 +1,113 @@
+#include "exportTable.h"
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+
+exportTable::exportTable (std::string moduleName, std::vector <exportEntry> && entries, std::vector <char> && namePool)
+{
+	this->moduleName = moduleName;
+	this->entries = std::move (entries);
+	this->namePool = std::move (namePool);
+	buildIndexes ();
+}
+uint32_t exportTable::hashName (const char * name) // FNV-1a
+{
+	uint32_t h = 2166136261u;
+	for (; *name; name++)
+	{
+		h ^= (uint8_t) *name;
+		h *= 16777619u;
+	}
+	return h;
+}
+void exportTable::buildIndexes ()
+{
+	byRVA.clear ();
+	for (uint32_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].forwarderOffset == NO_NAME && entries[i].rva != 0)
+		{
+			byRVA.push_back (i);
+		}
+	}
+	std::stable_sort (byRVA.begin(), byRVA.end(), [this] (uint32_t a, uint32_t b) { return entries[a].rva < entries[b].rva; });
+
+	size_t named = 0;
+	for (const auto & e : entries)
+	{
+		named += (e.nameOffset != NO_NAME);
+	}
+	size_t slots = 16;
+	while (slots < named * 2)
+	{
+		slots <<= 1;
+	}
+	nameHash.assign (slots, 0);
+	for (uint32_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].nameOffset == NO_NAME)
+		{
+			continue;
+		}
+		size_t slot = hashName (namePool.data() + entries[i].nameOffset) & (slots - 1);
+		while (nameHash[slot] != 0)
+		{
+			slot = (slot + 1) & (slots - 1);
+		}
+		nameHash[slot] = i + 1;
+	}
+}
+const exportEntry * exportTable::findByName (const char * name) const
+{
+	if (nameHash.empty())
+	{
+		return nullptr;
+	}
+	size_t mask = nameHash.size() - 1;
+	for (size_t slot = hashName (name) & mask; nameHash[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const exportEntry * e = &entries[nameHash[slot] - 1];
+		if (!strcmp (namePool.data() + e->nameOffset, name))
+		{
+			return e;
+		}
+	}
+	return nullptr;
+}
+const exportEntry * exportTable::findByRVA (uint32_t rva) const
+{
+	auto it = std::lower_bound (byRVA.begin(), byRVA.end(), rva, [this] (uint32_t i, uint32_t v) { return entries[i].rva < v; });
+	if (it == byRVA.end() || entries[*it].rva != rva)
+	{
+		return nullptr;
+	}
+	// prefer named export when many exports share one address
+	for (auto named = it; named != byRVA.end() && entries[*named].rva == rva; ++named)
+	{
+		if (entries[*named].nameOffset != NO_NAME)
+		{
+			return &entries[*named];
+		}
+	}
+	return &entries[*it];
+}
+const exportEntry * exportTable::findNearest (uint32_t rva) const
+{
+	auto it = std::upper_bound (byRVA.begin(), byRVA.end(), rva, [this] (uint32_t v, uint32_t i) { return v < entries[i].rva; });
+	if (it == byRVA.begin())
+	{
+		return nullptr;
+	}
+	return findByRVA (entries[*(it - 1)].rva);
+}
+std::string exportTable::getDisplayName (const exportEntry * entry) const
+{
+	const char * name = getName (entry);
+	if (name)
+	{
+		return name;
+	}
+	char ordinalName [16];
+	snprintf (ordinalName, sizeof (ordinalName), "#%u", entry->ordinal);
+	return ordinalName;
+}
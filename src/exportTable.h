@@ -0,0 +1,43 @@
+#pragma once
+
+#include <windows.h>
+#include <vector>
+#include <string>
+#include <inttypes.h>
+
+struct exportEntry
+{
+	uint32_t rva; // 0 for forwarded exports
+	uint32_t nameOffset; // NO_NAME for exports by ordinal only
+	uint32_t forwarderOffset; // NO_NAME when not forwarded, otherwise "dll.function" string
+	uint16_t ordinal;
+};
+
+class exportTable
+{
+	private:
+		std::string moduleName;
+		std::vector <exportEntry> entries; // ordinal order
+		std::vector <char> namePool; // names and forwarder strings
+		std::vector <uint32_t> byRVA; // indexes of not forwarded entries sorted by RVA
+		std::vector <uint32_t> nameHash; // open addressing, entry index + 1, 0 is empty slot
+
+		static uint32_t hashName (const char *);
+		void buildIndexes ();
+	public:
+		static constexpr uint32_t NO_NAME = 0xFFFFFFFF;
+
+		exportTable () = default;
+		exportTable (std::string, std::vector <exportEntry> &&, std::vector <char> &&);
+
+		const exportEntry * findByName (const char *) const;
+		const exportEntry * findByRVA (uint32_t) const; // exact
+		const exportEntry * findNearest (uint32_t) const; // nearest preceding or equal, forwarded exports skipped
+		const char * getName (const exportEntry * entry) const { return entry->nameOffset == NO_NAME ? nullptr : namePool.data() + entry->nameOffset; }
+		const char * getForwarder (const exportEntry * entry) const { return entry->forwarderOffset == NO_NAME ? nullptr : namePool.data() + entry->forwarderOffset; }
+		std::string getDisplayName (const exportEntry *) const; // name or #ordinal
+		const std::string & getModuleName () const { return moduleName; }
+		const std::vector <exportEntry> & getEntries () const { return entries; }
+		size_t size () const { return entries.size(); }
+		bool empty () const { return entries.empty(); }
+};
@@ -0,0 +1,297 @@
+#include "functionDiscovery.h"
+#include "functionIndex.h"
+#include "instructionLength.h"
+#include "parallel.h"
+
+namespace
+{
+	struct prologuePattern
+	{
+		uint8_t length;
+		uint8_t bytes [5];
+		uint8_t mask [5];
+	};
+	constexpr prologuePattern PROLOGUES [] =
+	{
+		{ 4, { 0x48, 0x89, 0x44, 0x24 }, { 0xFB, 0xFF, 0xC7, 0xFF } }, // mov [rsp + x], reg (home space spill of rcx, rdx, r8, r9, rbx ...)
+		{ 2, { 0x40, 0x50 }, { 0xFE, 0xF8 } }, // push reg with REX prefix (40 53, 41 57 ...)
+		{ 4, { 0x50, 0x48, 0x83, 0xEC }, { 0xF8, 0xFF, 0xFF, 0xFF } }, // push reg, sub rsp, imm8
+		{ 3, { 0x48, 0x83, 0xEC }, { 0xFF, 0xFF, 0xFF } }, // sub rsp, imm8
+		{ 3, { 0x48, 0x81, 0xEC }, { 0xFF, 0xFF, 0xFF } }, // sub rsp, imm32
+		{ 4, { 0x55, 0x48, 0x89, 0xE5 }, { 0xFF, 0xFF, 0xFF, 0xFF } }, // push rbp, mov rbp, rsp
+		{ 4, { 0x55, 0x48, 0x8B, 0xEC }, { 0xFF, 0xFF, 0xFF, 0xFF } }, // push rbp, mov rbp, rsp
+		{ 3, { 0x4C, 0x8B, 0xDC }, { 0xFF, 0xFF, 0xFF } }, // mov r11, rsp
+		{ 3, { 0x48, 0x8B, 0xC4 }, { 0xFF, 0xFF, 0xFF } }, // mov rax, rsp
+		{ 3, { 0x55, 0x8B, 0xEC }, { 0xFF, 0xFF, 0xFF } }, // push ebp, mov ebp, esp (32-bit)
+		{ 5, { 0x8B, 0xFF, 0x55, 0x8B, 0xEC }, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } } // mov edi, edi hotpatch prologue (32-bit)
+	};
+}
+
+functionDiscovery::functionDiscovery (dataSpan<uint8_t> image, uint64_t base, dataSpan<IMAGE_SECTION_HEADER> allSections)
+{
+	this->image = image;
+	this->base = base;
+	for (const auto & section : allSections)
+	{
+		if ((section.Characteristics & IMAGE_SCN_MEM_EXECUTE) && section.VirtualAddress < image.size())
+		{
+			sections.push_back (section);
+		}
+	}
+	std::sort (sections.begin(), sections.end(), [] (const IMAGE_SECTION_HEADER & a, const IMAGE_SECTION_HEADER & b) { return a.VirtualAddress < b.VirtualAddress; });
+}
+const IMAGE_SECTION_HEADER * functionDiscovery::sectionContaining (uint32_t rva) const
+{
+	for (const auto & section : sections)
+	{
+		if (rva >= section.VirtualAddress && rva < sectionEnd (&section))
+		{
+			return &section;
+		}
+	}
+	return nullptr;
+}
+uint32_t functionDiscovery::sectionEnd (const IMAGE_SECTION_HEADER * section) const
+{
+	uint64_t size = section->Misc.VirtualSize != 0 ? section->Misc.VirtualSize : section->SizeOfRawData;
+	return (uint32_t) std::min <uint64_t> (section->VirtualAddress + size, image.size());
+}
+bool functionDiscovery::followsPadding (uint32_t rva) const
+{
+	const IMAGE_SECTION_HEADER * section = sectionContaining (rva);
+	if (!section)
+	{
+		return false;
+	}
+	if (rva == section->VirtualAddress)
+	{
+		return true;
+	}
+	uint8_t previous = image.data[rva - 1];
+	return previous == 0xCC || previous == 0x90 || previous == 0xC3;
+}
+bool functionDiscovery::isPrologue (const uint8_t * code, size_t size)
+{
+	for (const auto & pattern : PROLOGUES)
+	{
+		if (pattern.length > size)
+		{
+			continue;
+		}
+		bool matches = true;
+		for (uint8_t i = 0; i < pattern.length && matches; i++)
+		{
+			matches = (code[i] & pattern.mask[i]) == pattern.bytes[i];
+		}
+		if (matches)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+void functionDiscovery::scanUnit (const IMAGE_SECTION_HEADER & section, sweepUnit unit, unitResult & result) const
+{
+	uint32_t begin = section.VirtualAddress;
+	uint32_t end = sectionEnd (&section);
+	uint64_t offset = unit.begin;
+	while (offset < unit.end) // last instruction may cross unit end
+	{
+		uint32_t rva = begin + (uint32_t) offset;
+		instructionLength decoded = getInstructionLength (image.data + rva, std::min <size_t> (MAX_X86_INSTRUCTION_LENGTH, end - rva));
+		if (!decoded.length)
+		{
+			offset++;
+			continue;
+		}
+		if (decoded.branch == BRANCH_CALL)
+		{
+			uint64_t target = decoded.getTarget (rva);
+			if (target < image.size() && sectionContaining ((uint32_t) target))
+			{
+				result.callTargets.push_back ((uint32_t) target);
+			}
+		}
+		offset += decoded.length;
+	}
+
+	// prologues do not depend on decoding being in sync, every aligned address after padding is checked
+	for (offset = (unit.begin + PROLOGUE_ALIGNMENT - 1) & ~(uint64_t) (PROLOGUE_ALIGNMENT - 1); offset < unit.end; offset += PROLOGUE_ALIGNMENT)
+	{
+		uint32_t rva = begin + (uint32_t) offset;
+		if (followsPadding (rva) && isPrologue (image.data + rva, end - rva))
+		{
+			result.prologues.push_back (rva);
+		}
+	}
+}
+std::vector <functionRange> functionDiscovery::confirm (std::vector <candidate> & candidates, controlFlowGraph & graph, std::vector <uint32_t> & rejected) const
+{
+	// every candidate is decoded up to next candidate or end of its section, jumps further are tail calls
+	std::vector <cfgSeed> seeds;
+	std::vector <uint32_t> limits;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		uint32_t limit = sectionEnd (sectionContaining (candidates[i].rva));
+		if (i + 1 < candidates.size())
+		{
+			limit = std::min (limit, candidates[i + 1].rva);
+		}
+		seeds.push_back ( { base + candidates[i].rva, base + limit } );
+		limits.push_back (limit);
+	}
+	std::vector <functionRange> ranges;
+	if (!graph.build (image, base, seeds))
+	{
+		return ranges;
+	}
+
+	std::vector <candidate> confirmed;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		const cfgFunction * function = graph.functionAt (base + candidates[i].rva);
+		if (!function || function->blockCount == 0)
+		{
+			rejected.push_back (candidates[i].rva);
+			continue;
+		}
+		uint64_t end = 0;
+		bool invalid = false;
+		for (uint32_t index : graph.getFunctionBlocks (function))
+		{
+			const cfgBlock & block = graph.getBlock (index);
+			end = std::max (end, block.end);
+			invalid = invalid || (block.flags & BLOCK_INVALID);
+		}
+		if (invalid && !(candidates[i].sources & SOURCE_KNOWN)) // real code does not run into bytes that are not instructions
+		{
+			rejected.push_back (candidates[i].rva);
+			continue;
+		}
+		confirmed.push_back (candidates[i]);
+		ranges.push_back ( { candidates[i].rva, (uint32_t) std::min <uint64_t> (end - base, limits[i]), functionIndex::NO_NAME } );
+	}
+	candidates.swap (confirmed);
+	return ranges;
+}
+std::vector <functionRange> functionDiscovery::discover (std::vector <uint32_t> knownStarts, discoveryStats & stats) const
+{
+	std::vector <uint64_t> unitStarts;
+	for (uint32_t start : knownStarts)
+	{
+		unitStarts.push_back (base + start);
+	}
+	std::sort (unitStarts.begin(), unitStarts.end());
+
+	struct unitTask
+	{
+		const IMAGE_SECTION_HEADER * section;
+		sweepUnit unit;
+	};
+	std::vector <unitTask> tasks;
+	for (const auto & section : sections)
+	{
+		for (const auto & unit : splitSweepUnits (sectionEnd (&section) - section.VirtualAddress, base + section.VirtualAddress, unitStarts, UNIT_SIZE))
+		{
+			tasks.push_back ( { &section, unit } );
+		}
+	}
+	std::vector <unitResult> results (tasks.size());
+	parallelSteal (tasks.size(), parallelWorkers (tasks.size(), 1), [&] (unsigned, size_t index)
+	{
+		scanUnit (*tasks[index].section, tasks[index].unit, results[index]);
+	});
+
+	std::vector <candidate> candidates;
+	std::vector <uint32_t> callTargets;
+	for (const auto & result : results)
+	{
+		callTargets.insert (callTargets.end(), result.callTargets.begin(), result.callTargets.end());
+		for (uint32_t rva : result.prologues)
+		{
+			candidates.push_back ( { rva, SOURCE_PROLOGUE } );
+		}
+	}
+	std::sort (callTargets.begin(), callTargets.end());
+	for (size_t i = 0, next = 0; i < callTargets.size(); i = next)
+	{
+		for (next = i; next < callTargets.size() && callTargets[next] == callTargets[i]; next++);
+		if (next - i >= MIN_CALLERS || followsPadding (callTargets[i]))
+		{
+			candidates.push_back ( { callTargets[i], SOURCE_CALL } );
+		}
+	}
+	for (uint32_t start : knownStarts)
+	{
+		if (sectionContaining (start)) // exported data and symbols of other sections are not functions
+		{
+			candidates.push_back ( { start, SOURCE_KNOWN } );
+		}
+	}
+	auto mergeCandidates = [] (std::vector <candidate> & list)
+	{
+		std::sort (list.begin(), list.end(), [] (const candidate & a, const candidate & b) { return a.rva < b.rva; });
+		std::vector <candidate> merged;
+		for (const auto & c : list)
+		{
+			if (!merged.empty() && merged.back().rva == c.rva)
+			{
+				merged.back().sources |= c.sources;
+			}
+			else
+			{
+				merged.push_back (c);
+			}
+		}
+		list.swap (merged);
+	};
+	mergeCandidates (candidates);
+
+	// first round with call targets and known starts only, prologue lookalikes inside their code are dropped
+	// and targets of their tail calls become candidates too
+	std::vector <candidate> strong;
+	std::vector <candidate> weak;
+	for (const auto & c : candidates)
+	{
+		(c.sources & (SOURCE_KNOWN | SOURCE_CALL) ? strong : weak).push_back (c);
+		stats.callTargets += (c.sources & SOURCE_CALL) ? 1 : 0;
+	}
+	controlFlowGraph graph;
+	std::vector <uint32_t> rejected;
+	confirm (strong, graph, rejected);
+
+	candidates = strong;
+	for (const auto & c : weak)
+	{
+		if (!graph.blockContaining (base + c.rva))
+		{
+			candidates.push_back (c);
+			stats.prologues++;
+		}
+	}
+	for (size_t b = 0; b < graph.size(); b++)
+	{
+		const cfgBlock & block = graph.getBlock ((uint32_t) b);
+		if (!(block.flags & BLOCK_TAIL_CALL))
+		{
+			continue;
+		}
+		const cfgFunction * function = graph.getFunction (&block);
+		for (uint64_t successor : graph.getSuccessors (&block))
+		{
+			if ((successor < function->entry || successor >= function->end) && successor >= base && successor - base < image.size() &&
+				sectionContaining ((uint32_t) (successor - base)) && !graph.functionAt (successor))
+			{
+				candidates.push_back ( { (uint32_t) (successor - base), SOURCE_TAIL_CALL } );
+			}
+		}
+	}
+	mergeCandidates (candidates);
+	stats.tailCalls = std::count_if (candidates.begin(), candidates.end(), [] (const candidate & c) { return c.sources == SOURCE_TAIL_CALL; });
+	std::vector <functionRange> ranges = confirm (candidates, graph, rejected);
+
+	// candidate rejected in first round can come back as tail call target, it is one rejected candidate still
+	std::sort (rejected.begin(), rejected.end());
+	stats.rejected = std::unique (rejected.begin(), rejected.end()) - rejected.begin();
+	return ranges;
+}
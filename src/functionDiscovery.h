@@ -0,0 +1,66 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+#include <vector>
+
+#include "utils.h"
+#include "structs.h"
+#include "controlFlowGraph.h"
+#include "linearSweep.h"
+
+// Function boundaries of images without .pdata (32-bit, packed or stripped) found by heuristics.
+// Executable sections are swept on worker threads with length decoder collecting call targets and prologues after padding,
+// candidates are confirmed by recursive descent (controlFlowGraph) and every function ends where its reachable code ends.
+
+struct discoveryStats
+{
+	size_t callTargets = 0;
+	size_t prologues = 0;
+	size_t tailCalls = 0;
+	size_t rejected = 0;
+};
+
+class functionDiscovery
+{
+	private:
+		static constexpr uint64_t UNIT_SIZE = 0x10000;
+		static constexpr uint32_t PROLOGUE_ALIGNMENT = 16;
+		static constexpr uint32_t MIN_CALLERS = 2; // one call rel32 is easily decoded from data, unless target follows padding
+
+		enum candidateSource : uint8_t
+		{
+			SOURCE_KNOWN = 1, // entry point, export, symbol
+			SOURCE_CALL = 2,
+			SOURCE_PROLOGUE = 4,
+			SOURCE_TAIL_CALL = 8
+		};
+
+		struct candidate
+		{
+			uint32_t rva;
+			uint8_t sources; // candidateSource
+		};
+
+		struct unitResult
+		{
+			std::vector <uint32_t> callTargets;
+			std::vector <uint32_t> prologues;
+		};
+
+		dataSpan<uint8_t> image;
+		uint64_t base;
+		std::vector <IMAGE_SECTION_HEADER> sections; // executable ones, sorted by address
+
+		const IMAGE_SECTION_HEADER * sectionContaining (uint32_t) const;
+		uint32_t sectionEnd (const IMAGE_SECTION_HEADER *) const;
+		bool followsPadding (uint32_t) const; // first byte of section or after int3, nop or ret
+		static bool isPrologue (const uint8_t *, size_t);
+		void scanUnit (const IMAGE_SECTION_HEADER &, sweepUnit, unitResult &) const;
+		std::vector <functionRange> confirm (std::vector <candidate> &, controlFlowGraph &, std::vector <uint32_t> & rejected) const;
+	public:
+		functionDiscovery (dataSpan<uint8_t>, uint64_t, dataSpan<IMAGE_SECTION_HEADER>); // image in memory layout at base
+
+		// known starts are RVAs trusted without confirmation, result is sorted by start and unnamed (NO_NAME)
+		std::vector <functionRange> discover (std::vector <uint32_t>, discoveryStats &) const;
+};
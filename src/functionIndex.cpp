@@ -0,0 +1,114 @@
+#include "functionIndex.h"
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+
+functionIndex::functionIndex (uint64_t imageBase, std::vector <functionRange> const & sourceRanges, const char * sourceNamePool)
+{
+	this->imageBase = imageBase;
+	ranges.reserve (sourceRanges.size());
+	for (auto range : sourceRanges)
+	{
+		if (range.end <= range.start) // .pdata read from memory can be padded with zeroed entries
+		{
+			continue;
+		}
+		if (range.nameOffset != NO_NAME && sourceNamePool != nullptr)
+		{
+			const char * name = sourceNamePool + range.nameOffset;
+			range.nameOffset = namePool.size();
+			namePool.insert (namePool.end(), name, name + strlen (name) + 1);
+		}
+		else
+		{
+			range.nameOffset = NO_NAME;
+		}
+		ranges.push_back (range);
+	}
+	std::sort (ranges.begin(), ranges.end(), [] (const functionRange & a, const functionRange & b) { return a.start < b.start; });
+
+	endOrder.resize (ranges.size());
+	for (uint32_t i = 0; i < ranges.size(); i++)
+	{
+		endOrder[i] = i;
+	}
+	std::sort (endOrder.begin(), endOrder.end(), [this] (uint32_t a, uint32_t b) { return ranges[a].end < ranges[b].end; });
+}
+bool functionIndex::toRVA (uint64_t address, uint32_t & rva) const
+{
+	if (address < imageBase || address - imageBase > 0xFFFFFFFF)
+	{
+		return false;
+	}
+	rva = address - imageBase;
+	return true;
+}
+const functionRange * functionIndex::containing (uint64_t address) const
+{
+	uint32_t rva;
+	if (!toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return containingRVA (rva);
+}
+const functionRange * functionIndex::containingRVA (uint32_t rva) const
+{
+	auto it = std::upper_bound (ranges.begin(), ranges.end(), rva, [] (uint32_t v, const functionRange & r) { return v < r.start; });
+	if (it == ranges.begin())
+	{
+		return nullptr;
+	}
+	--it;
+	if (rva < it->end)
+	{
+		return &(*it);
+	}
+	return nullptr;
+}
+const functionRange * functionIndex::startingAt (uint64_t address) const
+{
+	uint32_t rva;
+	if (!toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return startingAtRVA (rva);
+}
+const functionRange * functionIndex::startingAtRVA (uint32_t rva) const
+{
+	auto it = std::lower_bound (ranges.begin(), ranges.end(), rva, [] (const functionRange & r, uint32_t v) { return r.start < v; });
+	if (it != ranges.end() && it->start == rva)
+	{
+		return &(*it);
+	}
+	return nullptr;
+}
+const functionRange * functionIndex::endingAt (uint64_t address) const
+{
+	uint32_t rva;
+	if (!toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return endingAtRVA (rva);
+}
+const functionRange * functionIndex::endingAtRVA (uint32_t rva) const
+{
+	auto it = std::lower_bound (endOrder.begin(), endOrder.end(), rva, [this] (uint32_t i, uint32_t v) { return ranges[i].end < v; });
+	if (it != endOrder.end() && ranges[*it].end == rva)
+	{
+		return &ranges[*it];
+	}
+	return nullptr;
+}
+std::string functionIndex::getName (const functionRange * range) const
+{
+	if (range->nameOffset == NO_NAME)
+	{
+		char name [32];
+		snprintf (name, sizeof (name), "sub_%x", range->start);
+		return name;
+	}
+	return namePool.data() + range->nameOffset;
+}
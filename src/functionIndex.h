@@ -0,0 +1,40 @@
+#pragma once
+
+#include <windows.h>
+#include <vector>
+#include <string>
+#include <inttypes.h>
+
+#include "structs.h"
+
+// Sorted, RVA based index of function ranges (usually from .pdata).
+// Queries take virtual addresses, so the same index serves every base the image is loaded at.
+
+class functionIndex
+{
+	private:
+		uint64_t imageBase = 0;
+		std::vector <functionRange> ranges; // sorted by start
+		std::vector <uint32_t> endOrder; // indexes into ranges sorted by end
+		std::vector <char> namePool; // only names used by ranges
+
+		bool toRVA (uint64_t, uint32_t &) const;
+	public:
+		static constexpr uint32_t NO_NAME = 0xFFFFFFFF;
+
+		functionIndex () = default;
+		functionIndex (uint64_t, std::vector <functionRange> const &, const char * sourceNamePool); // nameOffset of ranges points into sourceNamePool or is NO_NAME
+
+		void rebase (uint64_t newBase) { imageBase = newBase; }
+		uint64_t getBase () const { return imageBase; }
+		size_t size () const { return ranges.size(); }
+		bool empty () const { return ranges.empty(); }
+
+		const functionRange * containing (uint64_t) const; // start <= address < end
+		const functionRange * startingAt (uint64_t) const;
+		const functionRange * endingAt (uint64_t) const;
+		const functionRange * containingRVA (uint32_t) const;
+		const functionRange * startingAtRVA (uint32_t) const;
+		const functionRange * endingAtRVA (uint32_t) const;
+		std::string getName (const functionRange *) const; // sub_<rva> for unnamed ranges
+};
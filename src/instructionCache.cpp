@@ -0,0 +1,99 @@
+#include "instructionCache.h"
+
+instructionCache::instructionCache (std::function <bool (uint64_t, uint8_t *)> readPage)
+{
+	this->readPage = readPage;
+}
+uint32_t instructionCache::getGeneration (uint64_t address)
+{
+	uint64_t pageAddress = address & ~(PAGE_SIZE - 1);
+	pageState & page = pages[pageAddress];
+	if (page.checkedRun != run) // target ran or debugger wrote page since last comparison
+	{
+		std::vector <uint8_t> current (PAGE_SIZE);
+		if (!readPage || !readPage (pageAddress, current.data()))
+		{
+			current.clear ();
+		}
+		if (current.empty () || current != page.bytes) // unreadable page is never trusted
+		{
+			page.generation++;
+			page.bytes.swap (current);
+		}
+		page.checkedRun = run;
+	}
+	return page.generation;
+}
+const cachedInstruction * instructionCache::find (uint64_t address)
+{
+	auto it = entries.find (address);
+	if (it == entries.end())
+	{
+		return nullptr;
+	}
+	if (it->second.firstPageGeneration != getGeneration (address) || it->second.lastPageGeneration != getGeneration (address + it->second.size - 1))
+	{
+		entries.erase (it);
+		return nullptr;
+	}
+	return &it->second;
+}
+const cachedInstruction * instructionCache::findEndingAt (uint64_t end, uint64_t & address)
+{
+	const cachedInstruction * toRet = nullptr;
+	for (uint64_t size = 1; size <= MAX_INSTRUCTION_LENGTH && size <= end; size++)
+	{
+		const cachedInstruction * instruction = find (end - size);
+		if (!instruction || instruction->size != size)
+		{
+			continue;
+		}
+		if (toRet) // decodes from different starts overlap here, boundary is not known
+		{
+			return nullptr;
+		}
+		toRet = instruction;
+		address = end - size;
+	}
+	return toRet;
+}
+void instructionCache::insert (uint64_t address, cachedInstruction instruction)
+{
+	if (instruction.size == 0)
+	{
+		return;
+	}
+	if (entries.size() >= MAX_ENTRIES)
+	{
+		entries.clear ();
+		pages.clear (); // copies of pages are needed only by entries
+	}
+	instruction.firstPageGeneration = getGeneration (address);
+	instruction.lastPageGeneration = getGeneration (address + instruction.size - 1);
+	entries[address] = std::move (instruction);
+}
+void instructionCache::invalidate (uint64_t address, uint64_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	for (uint64_t page = address & ~(PAGE_SIZE - 1); page <= ((address + size - 1) & ~(PAGE_SIZE - 1)); page += PAGE_SIZE)
+	{
+		auto it = pages.find (page);
+		if (it != pages.end()) // pages without state hold no entries
+		{
+			it->second.generation++;
+			it->second.checkedRun = 0; // copy of page is stale, next lookup takes new one
+		}
+		if (page + PAGE_SIZE < page)
+		{
+			break;
+		}
+	}
+}
+void instructionCache::clear ()
+{
+	entries.clear ();
+	pages.clear ();
+}
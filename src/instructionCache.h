@@ -0,0 +1,75 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <vector>
+
+// Decoded and symbolized instructions of debugged process keyed by address.
+// Every page has generation counter and entry is valid only while pages it was decoded from keep their generation.
+// Debugger bumps generation of pages it writes (memory writes, breakpoints). After target was continued every page
+// is read again at its first lookup and bumped when its bytes differ from the copy taken when it was checked last,
+// so code written by target is noticed even when page is not writable any more or was written through another mapping.
+// Valid entries are also known instruction boundaries, backward disassembly walks them from end to start.
+
+struct disassemblyLineInfo
+{
+	struct
+	{
+		uint64_t val = 0xbeefc0de;
+		DWORD color = 0;
+	} address;
+	struct
+	{
+		std::string str = "?";
+		DWORD color = 0;
+	} mnemonic;
+	struct
+	{
+		std::string str = "";
+		std::string op1 = "";
+		std::string op2 = "";
+		DWORD color = 0;
+	} op;
+};
+
+struct cachedInstruction
+{
+	disassemblyLineInfo line; // operand text already symbolized
+	uint8_t size = 0;
+	uint32_t firstPageGeneration = 0;
+	uint32_t lastPageGeneration = 0; // differs from first page only when instruction crosses page boundary
+};
+
+class instructionCache
+{
+	private:
+		static constexpr size_t MAX_ENTRIES = 0x10000; // whole cache is dropped when reached
+		static constexpr uint64_t MAX_INSTRUCTION_LENGTH = 15;
+
+		struct pageState
+		{
+			uint32_t generation = 0;
+			uint64_t checkedRun = 0; // target run in which bytes of page were compared, 0 forces new comparison
+			std::vector <uint8_t> bytes; // page as entries were decoded from it, empty when it could not be read
+		};
+
+		std::unordered_map <uint64_t, pageState> pages; // by page address
+		std::unordered_map <uint64_t, cachedInstruction> entries; // by instruction address
+		std::function <bool (uint64_t, uint8_t *)> readPage; // PAGE_SIZE bytes of target memory at page address
+		uint64_t run = 1;
+
+		uint32_t getGeneration (uint64_t);
+	public:
+		static constexpr uint64_t PAGE_SIZE = 0x1000;
+
+		instructionCache (std::function <bool (uint64_t, uint8_t *)>);
+		const cachedInstruction * find (uint64_t);
+		const cachedInstruction * findEndingAt (uint64_t, uint64_t &); // only when exactly one known instruction ends there, gives its address
+		void insert (uint64_t, cachedInstruction);
+		void invalidate (uint64_t, uint64_t); // memory range written by debugger
+		void targetContinued () { run++; }
+		void clear (); // symbols changed, operand text of all entries is stale
+};
@@ -0,0 +1,335 @@
+#include "instructionLength.h"
+
+namespace
+{
+	enum opcodeFlags : uint16_t
+	{
+		OP_MODRM = 1,
+		OP_IMM8 = 2,
+		OP_IMM16 = 4,
+		OP_IMMZ = 8, // 16 or 32 bits by operand size
+		OP_IMMV = 0x10, // 16, 32 or 64 bits (mov r, imm)
+		OP_MOFFS = 0x20, // 64 bits address, 32 bits with 0x67
+		OP_REL32 = 0x40, // 32 bits in 64 bit mode even with 0x66
+		OP_PREFIX = 0x80, // legacy prefix, REX is handled on its own
+		OP_VEX = 0x100, // VEX, EVEX or XOP prefix
+		OP_INVALID = 0x200
+	};
+
+	struct opcodeTables
+	{
+		uint16_t flags [2][256]; // one byte map, 0x0F map
+		uint8_t branch [2][256];
+	};
+
+	constexpr opcodeTables buildOpcodeTables ()
+	{
+		opcodeTables t {};
+		uint16_t * one = t.flags[0];
+		uint16_t * two = t.flags[1];
+
+		for (int op = 0; op < 0x40; op++) // add, or, adc, sbb, and, sub, xor, cmp rows
+		{
+			int low = op & 7;
+			one[op] = low < 4 ? OP_MODRM : (low == 4 ? OP_IMM8 : (low == 5 ? OP_IMMZ : OP_INVALID)); // push/pop segment, daa... are invalid
+		}
+		one[0x26] = one[0x2E] = one[0x36] = one[0x3E] = OP_PREFIX;
+		one[0x0F] = 0; // escape, decoded separately
+		for (int op = 0x40; op < 0x60; op++) // REX, push, pop
+		{
+			one[op] = 0;
+		}
+		one[0x60] = one[0x61] = OP_INVALID;
+		one[0x62] = OP_VEX; // EVEX
+		one[0x63] = OP_MODRM;
+		one[0x64] = one[0x65] = one[0x66] = one[0x67] = OP_PREFIX;
+		one[0x68] = OP_IMMZ;
+		one[0x69] = OP_MODRM | OP_IMMZ;
+		one[0x6A] = OP_IMM8;
+		one[0x6B] = OP_MODRM | OP_IMM8;
+		for (int op = 0x70; op < 0x80; op++)
+		{
+			one[op] = OP_IMM8;
+		}
+		one[0x80] = one[0x83] = OP_MODRM | OP_IMM8;
+		one[0x81] = OP_MODRM | OP_IMMZ;
+		one[0x82] = OP_INVALID;
+		for (int op = 0x84; op < 0x90; op++)
+		{
+			one[op] = OP_MODRM;
+		}
+		one[0x9A] = OP_INVALID;
+		one[0xA0] = one[0xA1] = one[0xA2] = one[0xA3] = OP_MOFFS;
+		one[0xA8] = OP_IMM8;
+		one[0xA9] = OP_IMMZ;
+		for (int op = 0xB0; op < 0xB8; op++)
+		{
+			one[op] = OP_IMM8;
+			one[op + 8] = OP_IMMV;
+		}
+		one[0xC0] = one[0xC1] = one[0xC6] = OP_MODRM | OP_IMM8;
+		one[0xC7] = OP_MODRM | OP_IMMZ;
+		one[0xC2] = one[0xCA] = OP_IMM16;
+		one[0xC4] = one[0xC5] = OP_VEX;
+		one[0xC8] = OP_IMM16 | OP_IMM8;
+		one[0xCD] = OP_IMM8;
+		one[0xCE] = OP_INVALID;
+		one[0xD0] = one[0xD1] = one[0xD2] = one[0xD3] = OP_MODRM;
+		one[0xD4] = one[0xD5] = one[0xD6] = OP_INVALID;
+		for (int op = 0xD8; op < 0xE0; op++) // x87
+		{
+			one[op] = OP_MODRM;
+		}
+		for (int op = 0xE0; op < 0xE8; op++) // loop, jrcxz, in, out
+		{
+			one[op] = OP_IMM8;
+		}
+		one[0xE8] = one[0xE9] = OP_REL32;
+		one[0xEA] = OP_INVALID;
+		one[0xEB] = OP_IMM8;
+		one[0xF0] = one[0xF2] = one[0xF3] = OP_PREFIX;
+		one[0xF6] = one[0xF7] = one[0xFE] = one[0xFF] = OP_MODRM; // group 3 immediate depends on ModRM.reg
+
+		for (int op = 0; op < 0x100; op++) // 0x0F map, most opcodes take ModRM
+		{
+			two[op] = OP_MODRM;
+		}
+		two[0x04] = two[0x0A] = two[0x0C] = OP_INVALID;
+		two[0x05] = two[0x06] = two[0x07] = two[0x08] = two[0x09] = two[0x0B] = two[0x0E] = 0;
+		two[0x0F] = OP_MODRM | OP_IMM8; // 3DNow! suffix byte
+		for (int op = 0x24; op < 0x28; op++)
+		{
+			two[op] = OP_INVALID;
+		}
+		for (int op = 0x30; op < 0x38; op++) // wrmsr, rdtsc, rdmsr, rdpmc, sysenter, sysexit, getsec
+		{
+			two[op] = 0;
+		}
+		two[0x36] = OP_INVALID;
+		two[0x38] = two[0x3A] = 0; // three byte maps, decoded separately
+		two[0x39] = two[0x3B] = two[0x3C] = two[0x3D] = two[0x3E] = two[0x3F] = OP_INVALID;
+		two[0x70] = two[0x71] = two[0x72] = two[0x73] = OP_MODRM | OP_IMM8;
+		two[0x77] = 0; // emms
+		two[0x7A] = two[0x7B] = OP_INVALID;
+		for (int op = 0x80; op < 0x90; op++)
+		{
+			two[op] = OP_REL32;
+		}
+		two[0xA0] = two[0xA1] = two[0xA2] = two[0xA8] = two[0xA9] = two[0xAA] = 0; // push/pop fs/gs, cpuid, rsm
+		two[0xA6] = two[0xA7] = OP_INVALID;
+		two[0xA4] = two[0xAC] = two[0xBA] = OP_MODRM | OP_IMM8;
+		two[0xC2] = two[0xC4] = two[0xC5] = two[0xC6] = OP_MODRM | OP_IMM8;
+		for (int op = 0xC8; op < 0xD0; op++) // bswap
+		{
+			two[op] = 0;
+		}
+
+		uint8_t * oneBranch = t.branch[0];
+		uint8_t * twoBranch = t.branch[1];
+		for (int op = 0x70; op < 0x80; op++)
+		{
+			oneBranch[op] = BRANCH_CONDITIONAL;
+			twoBranch[op + 0x10] = BRANCH_CONDITIONAL;
+		}
+		oneBranch[0xE0] = oneBranch[0xE1] = oneBranch[0xE2] = oneBranch[0xE3] = BRANCH_CONDITIONAL;
+		oneBranch[0xE8] = BRANCH_CALL;
+		oneBranch[0xE9] = oneBranch[0xEB] = BRANCH_JUMP;
+		oneBranch[0xC2] = oneBranch[0xC3] = oneBranch[0xCA] = oneBranch[0xCB] = oneBranch[0xCF] = BRANCH_RETURN;
+		oneBranch[0xCC] = oneBranch[0xCD] = oneBranch[0xF1] = BRANCH_INTERRUPT;
+		twoBranch[0x05] = twoBranch[0x34] = BRANCH_INTERRUPT;
+		twoBranch[0x07] = twoBranch[0x35] = BRANCH_RETURN;
+		return t;
+	}
+
+	constexpr opcodeTables tables = buildOpcodeTables ();
+
+	static_assert (tables.flags[0][0xE8] == OP_REL32 && tables.branch[0][0xE8] == BRANCH_CALL, "call rel32");
+	static_assert (tables.flags[0][0x05] == OP_IMMZ && tables.flags[0][0x06] == OP_INVALID, "arithmetic rows");
+	static_assert (tables.flags[1][0x85] == OP_REL32 && tables.branch[1][0x85] == BRANCH_CONDITIONAL, "jcc rel32");
+	static_assert (tables.flags[1][0xBA] == (OP_MODRM | OP_IMM8) && tables.flags[1][0xC9] == 0, "0F map");
+
+	constexpr bool isRelative8 (uint8_t opcode)
+	{
+		return (opcode >= 0x70 && opcode < 0x80) || (opcode >= 0xE0 && opcode < 0xE4) || opcode == 0xEB;
+	}
+}
+
+instructionLength getInstructionLength (const uint8_t * code, size_t size)
+{
+	instructionLength toRet;
+	if (size > MAX_X86_INSTRUCTION_LENGTH)
+	{
+		size = MAX_X86_INSTRUCTION_LENGTH;
+	}
+	size_t i = 0;
+	bool operandSize16 = false;
+	bool addressSize32 = false;
+	bool rexW = false;
+	for (; i < size; i++) // REX counts only right before opcode, legacy prefix or another REX after it makes it ignored
+	{
+		if (tables.flags[0][code[i]] & OP_PREFIX)
+		{
+			operandSize16 = operandSize16 || code[i] == 0x66;
+			addressSize32 = addressSize32 || code[i] == 0x67;
+			rexW = false;
+		}
+		else if ((code[i] & 0xF0) == 0x40)
+		{
+			rexW = code[i] & 8;
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (i >= size)
+	{
+		return toRet;
+	}
+
+	uint8_t opcode = code[i++];
+	uint16_t flags = 0;
+	uint8_t map = 0;
+	if (opcode == 0x0F)
+	{
+		if (i >= size)
+		{
+			return toRet;
+		}
+		opcode = code[i++];
+		if (opcode == 0x38 || opcode == 0x3A)
+		{
+			if (i >= size)
+			{
+				return toRet;
+			}
+			flags = opcode == 0x38 ? OP_MODRM : OP_MODRM | OP_IMM8;
+			opcode = code[i++];
+			map = 2;
+		}
+		else
+		{
+			flags = tables.flags[1][opcode];
+			toRet.branch = tables.branch[1][opcode];
+			map = 1;
+		}
+	}
+	else if ((tables.flags[0][opcode] & OP_VEX) || (opcode == 0x8F && i < size && (code[i] & 0x1F) >= 8)) // 0x8F with map select >= 8 is XOP, otherwise pop r/m
+	{
+		size_t payload = opcode == 0xC5 ? 1 : (opcode == 0x62 ? 3 : 2);
+		if (i + payload >= size)
+		{
+			return toRet;
+		}
+		uint8_t vexMap = opcode == 0xC5 ? 1 : (opcode == 0x62 ? code[i] & 7 : code[i] & 0x1F);
+		bool xop = opcode == 0x8F;
+		i += payload;
+		uint8_t vexOpcode = code[i++];
+		flags = OP_MODRM;
+		if (xop)
+		{
+			if (vexMap == 8)
+			{
+				flags |= OP_IMM8;
+			}
+			else if (vexMap == 0xA)
+			{
+				flags |= OP_IMMZ;
+			}
+			else if (vexMap != 9)
+			{
+				return toRet;
+			}
+		}
+		else if (vexMap == 1)
+		{
+			flags = vexOpcode == 0x77 && opcode != 0x62 ? 0 : OP_MODRM | (tables.flags[1][vexOpcode] & OP_IMM8); // vzeroupper, vzeroall
+		}
+		else if (vexMap == 3)
+		{
+			flags |= OP_IMM8;
+		}
+		else if (vexMap != 2 && !(opcode == 0x62 && (vexMap == 5 || vexMap == 6)))
+		{
+			return toRet;
+		}
+		operandSize16 = false; // implied prefixes of VEX do not change immediate sizes
+		map = 2;
+	}
+	else
+	{
+		flags = tables.flags[0][opcode];
+		toRet.branch = tables.branch[0][opcode];
+	}
+	if (flags & OP_INVALID)
+	{
+		return toRet;
+	}
+
+	if (flags & OP_MODRM)
+	{
+		if (i >= size)
+		{
+			return toRet;
+		}
+		uint8_t modrm = code[i++];
+		uint8_t mod = modrm >> 6;
+		uint8_t reg = (modrm >> 3) & 7;
+		uint8_t rm = modrm & 7;
+		if (mod != 3)
+		{
+			if (rm == 4)
+			{
+				if (i >= size)
+				{
+					return toRet;
+				}
+				uint8_t sib = code[i++];
+				if (mod == 0 && (sib & 7) == 5)
+				{
+					i += 4;
+				}
+			}
+			if (mod == 0 && rm == 5) // RIP relative
+			{
+				toRet.relativeOffset = (uint8_t) i;
+				i += 4;
+			}
+			i += mod == 1 ? 1 : (mod == 2 ? 4 : 0);
+		}
+		if (map == 0 && (opcode == 0xF6 || opcode == 0xF7) && reg < 2) // test r/m, imm
+		{
+			flags |= opcode == 0xF6 ? OP_IMM8 : OP_IMMZ;
+		}
+		if (map == 0 && opcode == 0xFF)
+		{
+			if (reg == 7)
+			{
+				return toRet;
+			}
+			toRet.branch = reg == 2 || reg == 3 ? BRANCH_INDIRECT_CALL : (reg == 4 || reg == 5 ? BRANCH_INDIRECT_JUMP : BRANCH_NONE);
+		}
+	}
+
+	i += flags & OP_IMM8 ? 1 : 0;
+	i += flags & OP_IMM16 ? 2 : 0;
+	i += flags & OP_IMMZ ? (operandSize16 && !rexW ? 2 : 4) : 0;
+	i += flags & OP_IMMV ? (rexW ? 8 : (operandSize16 ? 2 : 4)) : 0;
+	i += flags & OP_MOFFS ? (addressSize32 ? 4 : 8) : 0;
+	i += flags & OP_REL32 ? 4 : 0;
+	if (i > size)
+	{
+		return instructionLength ();
+	}
+	toRet.length = (uint8_t) i;
+	if (map == 0 && isRelative8 (opcode))
+	{
+		toRet.displacement = (int8_t) code[i - 1];
+	}
+	else if (flags & OP_REL32)
+	{
+		toRet.relativeOffset = (uint8_t) (i - 4);
+		toRet.displacement = (int32_t) ((uint32_t) code[i - 4] | (uint32_t) code[i - 3] << 8 | (uint32_t) code[i - 2] << 16 | (uint32_t) code[i - 1] << 24);
+	}
+	return toRet;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+// Length and control flow class of x86-64 instruction from its bytes only, without capstone.
+// Opcode property tables are generated at compile time, decoding is prefix scan, one table lookup and ModRM/SIB arithmetic.
+// Used where only instruction boundaries or branch kind are needed (stepping over, breakpoint placement checks).
+
+enum branchType : uint8_t
+{
+	BRANCH_NONE = 0,
+	BRANCH_CALL = 1, // call rel32
+	BRANCH_INDIRECT_CALL = 2, // call r/m, call far
+	BRANCH_JUMP = 3, // jmp rel8/rel32
+	BRANCH_CONDITIONAL = 4, // jcc, loop, jrcxz
+	BRANCH_INDIRECT_JUMP = 5, // jmp r/m, jmp far
+	BRANCH_RETURN = 6, // ret, retf, iret, sysret
+	BRANCH_INTERRUPT = 7 // int3, int n, int1, syscall, sysenter, execution continues after it
+};
+
+struct instructionLength
+{
+	uint8_t length = 0; // 0 when bytes are not valid instruction or buffer ends inside of it
+	uint8_t branch = BRANCH_NONE; // branchType
+	int32_t displacement = 0; // of relative branch, from end of instruction
+	uint8_t relativeOffset = 0; // where rel32 or RIP relative disp32 starts in instruction, 0 when there is none
+
+	uint64_t getTarget (uint64_t address) const { return address + length + (int64_t) displacement; }
+};
+
+static constexpr size_t MAX_X86_INSTRUCTION_LENGTH = 15;
+
+instructionLength getInstructionLength (const uint8_t *, size_t);
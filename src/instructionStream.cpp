@@ -0,0 +1,86 @@
+#include "instructionStream.h"
+
+instructionStream::instructionStream (csh handle, memoryReader & reader, uint64_t address, uint64_t maxSize) : reader (reader)
+{
+	this->handle = handle;
+	bufferAddress = address;
+	endAddress = (address + maxSize < address) ? UINT64_MAX : address + maxSize;
+	buffer.resize (CHUNK_SIZE);
+	insn = cs_malloc (handle);
+}
+instructionStream::~instructionStream ()
+{
+	cs_free (insn, 1);
+}
+bool instructionStream::refill ()
+{
+	if (endOfMemory)
+	{
+		return false;
+	}
+	memmove (buffer.data(), buffer.data() + position, bufferSize - position); // unfinished instruction moves to front
+	bufferAddress += position;
+	bufferSize -= position;
+	position = 0;
+
+	uint64_t readAddress = bufferAddress + bufferSize;
+	size_t toRead = std::min <uint64_t> (CHUNK_SIZE - bufferSize, endAddress - readAddress);
+	if (toRead == 0 || !reader.read (readAddress, buffer.data() + bufferSize, toRead))
+	{
+		// range may cross into uncommitted page, one page is readable as whole or not at all
+		while (toRead > 0)
+		{
+			size_t pagePart = std::min <uint64_t> (toRead, PAGE_SIZE - (readAddress & (PAGE_SIZE - 1)));
+			if (!reader.read (readAddress, buffer.data() + bufferSize, pagePart))
+			{
+				break;
+			}
+			bufferSize += pagePart;
+			readAddress += pagePart;
+			toRead -= pagePart;
+		}
+		endOfMemory = true;
+		return true;
+	}
+	bufferSize += toRead;
+	endOfMemory = (readAddress + toRead == endAddress);
+	return true;
+}
+const cs_insn * instructionStream::next ()
+{
+	if (bufferSize - position < MAX_INSTRUCTION_LENGTH)
+	{
+		refill ();
+	}
+	const uint8_t * code = buffer.data() + position;
+	size_t size = bufferSize - position;
+	uint64_t address = getAddress ();
+	if (size == 0 || !cs_disasm_iter (handle, &code, &size, &address, insn))
+	{
+		return nullptr;
+	}
+	position = code - buffer.data();
+	return insn;
+}
+bool instructionStream::skip (size_t count)
+{
+	if (bufferSize - position < count)
+	{
+		refill ();
+	}
+	if (bufferSize - position < count)
+	{
+		return false;
+	}
+	position += count;
+	return true;
+}
+bool instructionStream::skipByte ()
+{
+	if (position >= bufferSize)
+	{
+		return false;
+	}
+	position++;
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include <capstone/capstone.h>
+#include "unwinder.h"
+
+class instructionStream // decodes with cs_disasm_iter into one reused cs_insn, memory is read in chunks, nothing is allocated per instruction
+{
+	private:
+		static constexpr size_t CHUNK_SIZE = 0x4000;
+		static constexpr size_t PAGE_SIZE = 0x1000;
+		static constexpr size_t MAX_INSTRUCTION_LENGTH = 15;
+
+		csh handle;
+		memoryReader & reader;
+		cs_insn * insn;
+		std::vector <uint8_t> buffer;
+		uint64_t bufferAddress; // address of buffer [0]
+		size_t bufferSize = 0; // valid bytes in buffer
+		size_t position = 0;
+		uint64_t endAddress; // stream never reads past it
+		bool endOfMemory = false;
+
+		bool refill ();
+	public:
+		instructionStream (csh, memoryReader &, uint64_t, uint64_t maxSize);
+		~instructionStream ();
+		const cs_insn * next (); // nullptr when bytes do not decode or memory ended
+		bool skipByte (); // steps over undecodable byte, false at end of memory
+		bool skip (size_t); // steps over data known not to be code, false when memory ends before it
+		uint64_t getAddress () const { return bufferAddress + position; }
+};
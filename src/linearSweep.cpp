@@ -0,0 +1,141 @@
+#include "linearSweep.h"
+#include "parallel.h"
+
+std::vector <sweepUnit> splitSweepUnits (uint64_t size, uint64_t address, const std::vector <uint64_t> & functionStarts, uint64_t unitSize)
+{
+	std::vector <sweepUnit> units;
+	uint64_t begin = 0;
+	while (begin < size)
+	{
+		uint64_t end = begin + unitSize;
+		if (end >= size)
+		{
+			end = size;
+		}
+		else
+		{
+			auto start = std::lower_bound (functionStarts.begin(), functionStarts.end(), address + end);
+			if (start != functionStarts.end() && *start < address + size) // resync on next function start
+			{
+				end = *start - address;
+			}
+		}
+		units.push_back ( { begin, end } );
+		begin = end;
+	}
+	return units;
+}
+bool spanMemoryReader::read (uint64_t readAddress, void * buffer, size_t size)
+{
+	if (readAddress < address || readAddress - address > bytes.size() || size > bytes.size() - (readAddress - address))
+	{
+		return false;
+	}
+	memcpy (buffer, bytes.data + (readAddress - address), size);
+	return true;
+}
+
+linearSweep::linearSweep (dataSpan<uint8_t> code, uint64_t address, std::vector <uint64_t> functionStarts, std::function <std::string (uint64_t)> functionName,
+	std::function <uint32_t (uint64_t)> pointerSlotWidth)
+{
+	this->code = code;
+	this->address = address;
+	this->functionName = functionName;
+	this->pointerSlotWidth = pointerSlotWidth;
+	std::sort (functionStarts.begin(), functionStarts.end());
+	functionStarts.erase (std::unique (functionStarts.begin(), functionStarts.end()), functionStarts.end());
+	this->functionStarts = std::move (functionStarts);
+}
+linearSweep::unitListing linearSweep::disassembleUnit (csh handle, sweepUnit u) const
+{
+	unitListing listing;
+	listing.text.reserve ((u.end - u.begin) * 10);
+	listing.stats.bytes = u.end - u.begin;
+
+	spanMemoryReader reader (code, address);
+	uint64_t streamSize = std::min (u.end + MAX_INSTRUCTION_LENGTH, (uint64_t) code.size()) - u.begin; // last instruction may cross unit end
+	instructionStream stream (handle, reader, address + u.begin, streamSize);
+	auto nextStart = std::lower_bound (functionStarts.begin(), functionStarts.end(), address + u.begin);
+	char line [256];
+
+	while (stream.getAddress() < address + u.end)
+	{
+		uint64_t current = stream.getAddress();
+		while (nextStart != functionStarts.end() && *nextStart < current)
+		{
+			nextStart++;
+		}
+		if (nextStart != functionStarts.end() && *nextStart == current && functionName)
+		{
+			std::string name = functionName (current);
+			if (name.size() > 0)
+			{
+				listing.text += "\n" + name + ":\n";
+			}
+		}
+		uint32_t slotWidth = pointerSlotWidth ? pointerSlotWidth (current) : 0;
+		if (slotWidth) // pointer stored in code, decoding it would also break sync of instructions after it
+		{
+			uint64_t value = 0;
+			memcpy (&value, code.data + (current - address), std::min <uint64_t> (slotWidth, code.size() - (current - address)));
+			if (!stream.skip (slotWidth))
+			{
+				break;
+			}
+			snprintf (line, sizeof (line), "%.16llx:\t%s\t0x%llx\n", current, slotWidth == 8 ? "dq" : "dd", value);
+			listing.text += line;
+			listing.stats.pointerSlots++;
+			continue;
+		}
+		const cs_insn * insn = stream.next ();
+		if (!insn)
+		{
+			if (!stream.skipByte ())
+			{
+				break;
+			}
+			snprintf (line, sizeof (line), "%.16llx:\tdb\t0x%.2x\n", current, code[current - address]);
+			listing.text += line;
+			listing.stats.invalidBytes++;
+			continue;
+		}
+		snprintf (line, sizeof (line), "%.16llx:\t%s\t\t%s\n", insn->address, insn->mnemonic, insn->op_str);
+		listing.text += line;
+		listing.stats.instructions++;
+	}
+	return listing;
+}
+bool linearSweep::writeListing (FILE * output, unsigned workers, sweepStats & stats) const
+{
+	std::vector <sweepUnit> units = splitSweepUnits (code.size(), address, functionStarts, UNIT_SIZE);
+	workers = std::max (1u, std::min <unsigned> (workers, units.size()));
+
+	std::vector <csh> handles (workers);
+	unsigned opened = 0;
+	for (; opened < workers; opened++)
+	{
+		if (cs_open (CS_ARCH_X86, CS_MODE_64, &handles[opened]) != CS_ERR_OK) // detail stays off
+		{
+			break;
+		}
+	}
+	bool written = opened == workers;
+	if (written)
+	{
+		parallelOrdered <unitListing> (units.size(), workers, workers * PENDING_UNITS_PER_WORKER,
+			[&] (unsigned worker, size_t index) { return disassembleUnit (handles[worker], units[index]); },
+			[&] (size_t index, unitListing & listing)
+			{
+				written = written && fwrite (listing.text.data(), 1, listing.text.size(), output) == listing.text.size();
+				stats.bytes += listing.stats.bytes;
+				stats.instructions += listing.stats.instructions;
+				stats.invalidBytes += listing.stats.invalidBytes;
+				stats.pointerSlots += listing.stats.pointerSlots;
+			});
+	}
+	for (unsigned i = 0; i < opened; i++)
+	{
+		cs_close (&handles[i]);
+	}
+	return written;
+}
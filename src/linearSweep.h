@@ -0,0 +1,69 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <capstone/capstone.h>
+#include "utils.h"
+#include "unwinder.h"
+#include "instructionStream.h"
+
+// Linear sweep of one executable section on worker threads writing text listing.
+// Section is split into units that start at function starts (.pdata) near every UNIT_SIZE bytes, so each worker
+// begins on real instruction boundary, units are disassembled with capstone handle of worker and written in order.
+// Without function starts units are split at fixed offsets and first instructions of unit may be decoded out of sync.
+
+struct sweepStats
+{
+	uint64_t bytes = 0;
+	uint64_t instructions = 0;
+	uint64_t invalidBytes = 0;
+	uint64_t pointerSlots = 0; // base relocation slots in code, written as data
+};
+
+struct sweepUnit
+{
+	uint64_t begin; // offsets in section
+	uint64_t end;
+};
+
+// splits section of given size at address into units of about unitSize, every unit but first starts at function start when there is one
+std::vector <sweepUnit> splitSweepUnits (uint64_t, uint64_t, const std::vector <uint64_t> &, uint64_t);
+
+class spanMemoryReader : public memoryReader // bytes already in memory (file mapping, copied section) seen at given address
+{
+	private:
+		dataSpan<uint8_t> bytes;
+		uint64_t address;
+	public:
+		spanMemoryReader (dataSpan<uint8_t> bytes, uint64_t address) : bytes (bytes), address (address) {}
+		bool read (uint64_t, void *, size_t) override;
+};
+
+class linearSweep
+{
+	private:
+		static constexpr uint64_t UNIT_SIZE = 0x40000;
+		static constexpr uint64_t MAX_INSTRUCTION_LENGTH = 15;
+		static constexpr size_t PENDING_UNITS_PER_WORKER = 4; // bounds memory held by finished but not written units
+
+		struct unitListing
+		{
+			std::string text;
+			sweepStats stats;
+		};
+
+		dataSpan<uint8_t> code;
+		uint64_t address;
+		std::vector <uint64_t> functionStarts; // sorted virtual addresses
+		std::function <std::string (uint64_t)> functionName; // label printed at function start, may be empty
+		std::function <uint32_t (uint64_t)> pointerSlotWidth; // size of relocated absolute address stored at address or 0, may be empty
+
+		unitListing disassembleUnit (csh, sweepUnit) const;
+	public:
+		linearSweep (dataSpan<uint8_t>, uint64_t, std::vector <uint64_t>, std::function <std::string (uint64_t)>, std::function <uint32_t (uint64_t)> = nullptr);
+		bool writeListing (FILE *, unsigned, sweepStats &) const;
+};
@@ -14,7 +14,7 @@ int main (int argc, char ** argv)
     	debugger d (debugged);
     	d.interactive ();
     }
-    catch (std::exception)
+    catch (const std::exception &)
     {
     	return 1;
     } 
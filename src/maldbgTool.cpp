@@ -0,0 +1,756 @@
+// offline helpers for maldbg, they work on PE files on disk or on in-memory fake targets only
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include "utils.h"
+#include "exportDatabase.h"
+#include "mappedFile.h"
+#include "peView.h"
+#include "peParser.h"
+#include "linearSweep.h"
+#include "instructionLength.h"
+#include "signatureLibrary.h"
+#include "breakpoint.h"
+#include "breakpointBatch.h"
+#include "symbolParse.h"
+#include "symbolCache.h"
+#include "functionIndex.h"
+
+static constexpr uint32_t CORPUS_MUTATED_BYTES = 0x400; // mutations hit headers, not section data
+static constexpr uint32_t MAX_REPORTED_MISMATCHES = 32;
+static constexpr uint64_t FAKE_TARGET_BASE = 0x140001000;
+
+static std::vector <std::string> listFiles (std::string directory, std::string pattern)
+{
+	std::vector <std::string> toRet;
+	if (directory.size() > 0 && directory.back() != '\\' && directory.back() != '/')
+	{
+		directory += "\\";
+	}
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA ((directory + pattern).c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return toRet;
+	}
+	do
+	{
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			toRet.push_back (directory + findData.cFileName);
+		}
+	}
+	while (FindNextFileA (find, &findData));
+	FindClose (find);
+	return toRet;
+}
+static uint32_t touchPE (peView & view) // what debugger reads after headers, every directory and every section start
+{
+	uint32_t touched = 0;
+	for (uint32_t i = 0; i < IMAGE_NUMBEROF_DIRECTORY_ENTRIES; i++)
+	{
+		IMAGE_DATA_DIRECTORY directory = view.getDirectory (i);
+		dataSpan<uint8_t> data;
+		if (directory.VirtualAddress != 0 && view.getRVA (directory.VirtualAddress, directory.Size, data) == peError::OK)
+		{
+			touched += data.size() > 0 ? data[0] : 0;
+		}
+	}
+	for (const auto & section : view.getSections ())
+	{
+		dataSpan<uint8_t> data;
+		if (view.getRVA (section.VirtualAddress, 1, data) == peError::OK)
+		{
+			touched += data[0];
+		}
+	}
+	return touched;
+}
+static std::vector <std::string> listPEFiles (std::string path) // PE files of directory or path itself
+{
+	std::vector <std::string> files;
+	DWORD attributes = GetFileAttributesA (path.c_str());
+	if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		for (const char * pattern : { "*.exe", "*.dll", "*.sys" })
+		{
+			std::vector <std::string> found = listFiles (path, pattern);
+			files.insert (files.end(), found.begin(), found.end());
+		}
+	}
+	else
+	{
+		files.push_back (path);
+	}
+	return files;
+}
+static int benchmarkPE (std::string path, uint32_t iterations, HANDLE stdoutHandle)
+{
+	std::vector <std::string> files = listPEFiles (path);
+	if (files.empty())
+	{
+		log ("No PE files found in %s\n", logType::ERR, stdoutHandle, path.c_str());
+		return 1;
+	}
+
+	uint64_t errors [(int) peError::COUNT] = {};
+	uint64_t parsed = 0;
+	uint64_t bytes = 0;
+	volatile uint32_t sink = 0;
+	auto start = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		for (const auto & file : files)
+		{
+			mappedFile mapping;
+			if (!mapping.open (file))
+			{
+				continue;
+			}
+			peView view;
+			peError error = view.parse ( { mapping.data(), (size_t) mapping.getSize() }, false);
+			errors[(int) error]++;
+			if (error == peError::OK)
+			{
+				sink += touchPE (view);
+			}
+			parsed++;
+			bytes += mapping.getSize();
+		}
+	}
+	double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	log ("%llu files (%.1f MB) in %.3f s, %.0f files/s\n", logType::INFO, stdoutHandle, parsed, bytes / 1048576.0, seconds, parsed / seconds);
+	for (int i = 0; i < (int) peError::COUNT; i++)
+	{
+		if (errors[i])
+		{
+			printf ("    %-36s %llu\n", peErrorToString ((peError) i), errors[i]);
+		}
+	}
+	return 0;
+}
+static int malformedCorpus (std::string seedPath, uint32_t count, HANDLE stdoutHandle)
+{
+	// deterministic corpus: every sample is seed file with header bytes and size fields corrupted
+	mappedFile seed;
+	if (!seed.open (seedPath))
+	{
+		log ("Cannot open %s\n", logType::ERR, stdoutHandle, seedPath.c_str());
+		return 1;
+	}
+	if (seed.getSize() < sizeof (IMAGE_DOS_HEADER)) // nothing to mutate, truncation would divide by zero
+	{
+		log ("Seed file %s is smaller than DOS header\n", logType::ERR, stdoutHandle, seedPath.c_str());
+		return 1;
+	}
+	std::vector <uint8_t> sample;
+	uint64_t errors [(int) peError::COUNT] = {};
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	auto random = [&state] () { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return state; };
+	volatile uint32_t sink = 0;
+	double seconds = 0;
+	uint32_t mutatedSize = std::min <uint64_t> (CORPUS_MUTATED_BYTES, seed.getSize());
+	for (uint32_t i = 0; i < count; i++)
+	{
+		sample.assign (seed.data(), seed.data() + seed.getSize());
+		uint32_t mutations = 1 + random () % 8;
+		for (uint32_t m = 0; m < mutations && mutatedSize >= sizeof (uint32_t); m++)
+		{
+			uint32_t offset = random () % (mutatedSize - sizeof (uint32_t) + 1);
+			switch (random () % 4)
+			{
+				case 0: sample[offset] ^= 1 << (random () % 8); break; // bit flip
+				case 1: sample[offset] = random (); break; // byte
+				case 2: memset (&sample[offset], 0xFF, sizeof (uint32_t)); break; // huge size or offset
+				case 3: memset (&sample[offset], 0, sizeof (uint32_t)); break;
+			}
+		}
+		if (random () % 8 == 0 && !sample.empty ())
+		{
+			sample.resize (random () % sample.size()); // truncated file
+		}
+
+		auto start = std::chrono::steady_clock::now ();
+		peView view;
+		peError error = view.parse ( { sample.data(), sample.size() }, false);
+		if (error == peError::OK)
+		{
+			sink += touchPE (view);
+		}
+		seconds += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+		errors[(int) error]++;
+	}
+	log ("%u malformed samples parsed in %.3f s, %.0f files/s\n", logType::INFO, stdoutHandle, count, seconds, count / seconds);
+	for (int i = 0; i < (int) peError::COUNT; i++)
+	{
+		if (errors[i])
+		{
+			printf ("    %-36s %llu\n", peErrorToString ((peError) i), errors[i]);
+		}
+	}
+	return 0;
+}
+static int writeListing (std::string path, std::string outputPath, unsigned workers, HANDLE stdoutHandle)
+{
+	try
+	{
+		PEparser parser (path);
+		if (!parser.isValid ()) // reason is logged by parser
+		{
+			return 1;
+		}
+		uint64_t imageBase = parser.getImageBase ();
+		dataSpan<uint8_t> file = parser.getFileView ();
+
+		std::vector <uint64_t> functionStarts;
+		for (const auto & function : parser.getPdataView ())
+		{
+			functionStarts.push_back (imageBase + function.BeginAddress);
+		}
+		exportTable exports = parser.getExportTable ();
+		relocationTable relocations = parser.getRelocationTable ();
+		auto pointerSlotWidth = [&] (uint64_t address) { return address >= imageBase ? relocations.getPointerSlotWidth (address - imageBase) : 0; };
+		auto functionName = [&] (uint64_t address)
+		{
+			const exportEntry * entry = exports.findByRVA (address - imageBase);
+			if (entry)
+			{
+				return exports.getDisplayName (entry);
+			}
+			char name [32];
+			snprintf (name, sizeof (name), "sub_%x", (uint32_t) (address - imageBase));
+			return std::string (name);
+		};
+
+		FILE * output = fopen (outputPath.c_str(), "wb");
+		if (!output)
+		{
+			log ("Cannot create %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+			return 1;
+		}
+		sweepStats stats;
+		bool written = true;
+		auto start = std::chrono::steady_clock::now ();
+		for (const auto & section : parser.getSectionHeaders ())
+		{
+			if (!(section.Characteristics & IMAGE_SCN_MEM_EXECUTE) || section.PointerToRawData >= file.size())
+			{
+				continue;
+			}
+			uint64_t size = section.SizeOfRawData;
+			if (section.Misc.VirtualSize != 0 && section.Misc.VirtualSize < size) // raw data is padded with zeroes to file alignment
+			{
+				size = section.Misc.VirtualSize;
+			}
+			size = std::min <uint64_t> (size, file.size() - section.PointerToRawData);
+			fprintf (output, "; section %.8s\n", section.Name);
+			linearSweep sweep ( { file.data + section.PointerToRawData, (size_t) size }, imageBase + section.VirtualAddress, functionStarts, functionName, pointerSlotWidth);
+			written = sweep.writeListing (output, workers, stats) && written;
+		}
+		double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+		fclose (output);
+		if (!written)
+		{
+			log ("Cannot write listing to %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+			return 1;
+		}
+		log ("%llu instructions (%.1f MB, %llu bytes not decoded, %llu pointer slots) in %.3f s, %.1f MB/s\n", logType::INFO, stdoutHandle,
+			stats.instructions, stats.bytes / 1048576.0, stats.invalidBytes, stats.pointerSlots, seconds, stats.bytes / 1048576.0 / seconds);
+	}
+	catch (std::exception &)
+	{
+		log ("Cannot parse %s\n", logType::ERR, stdoutHandle, path.c_str());
+		return 1;
+	}
+	return 0;
+}
+static uint8_t capstoneBranch (const cs_insn * insn) // branchType of instruction decoded with detail
+{
+	const cs_x86 & x86 = insn->detail->x86;
+	bool immediate = x86.op_count == 1 && x86.operands[0].type == X86_OP_IMM;
+	for (uint8_t i = 0; i < insn->detail->groups_count; i++)
+	{
+		switch (insn->detail->groups[i])
+		{
+			case X86_GRP_CALL:
+				return immediate ? BRANCH_CALL : BRANCH_INDIRECT_CALL;
+			case X86_GRP_RET:
+			case X86_GRP_IRET:
+				return BRANCH_RETURN;
+			case X86_GRP_JUMP:
+				if (!immediate)
+				{
+					return BRANCH_INDIRECT_JUMP;
+				}
+				return insn->id == X86_INS_JMP ? BRANCH_JUMP : BRANCH_CONDITIONAL;
+			case X86_GRP_INT:
+				return BRANCH_INTERRUPT;
+		}
+	}
+	return BRANCH_NONE;
+}
+static int checkLengthDecoder (std::string path, uint32_t iterations, HANDLE stdoutHandle) // table decoder against capstone on executable sections of file
+{
+	struct position
+	{
+		const uint8_t * code;
+		size_t size;
+	};
+	std::vector <position> positions;
+	uint64_t lengthMismatches = 0;
+	uint64_t branchMismatches = 0;
+	PEparser parser (path); // positions point into its mapping, it has to outlive both passes
+	if (!parser.isValid ())
+	{
+		return 1;
+	}
+	csh handle;
+	if (cs_open (CS_ARCH_X86, CS_MODE_64, &handle) != CS_ERR_OK)
+	{
+		log ("Cannot initialize capstone\n", logType::ERR, stdoutHandle);
+		return 1;
+	}
+	cs_option (handle, CS_OPT_DETAIL, CS_OPT_ON);
+	cs_insn * insn = cs_malloc (handle);
+
+	// prefix orders compilers rarely emit, checked even when file has none of them (REX is ignored unless opcode follows it)
+	static const std::vector <uint8_t> prefixOrders [] = {
+		{ 0x48, 0x66, 0xB8, 0x34, 0x12 },
+		{ 0x48, 0x66, 0xC7, 0x00, 0x34, 0x12 },
+		{ 0x48, 0xF3, 0xB8, 1, 2, 3, 4 },
+		{ 0x66, 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 },
+		{ 0x48, 0x40, 0xB8, 1, 2, 3, 4 },
+		{ 0x40, 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 } };
+	for (const auto & sequence : prefixOrders)
+	{
+		const uint8_t * code = sequence.data();
+		size_t size = sequence.size();
+		uint64_t address = 0;
+		instructionLength ours = getInstructionLength (sequence.data(), sequence.size());
+		if (cs_disasm_iter (handle, &code, &size, &address, insn) && ours.length != insn->size)
+		{
+			lengthMismatches++;
+			printf ("    prefix order %-8s %-40s capstone %u, table %u\n", insn->mnemonic, insn->op_str, insn->size, ours.length);
+		}
+	}
+	try
+	{
+		dataSpan<uint8_t> file = parser.getFileView ();
+		for (const auto & section : parser.getSectionHeaders ())
+		{
+			if (!(section.Characteristics & IMAGE_SCN_MEM_EXECUTE) || section.PointerToRawData >= file.size())
+			{
+				continue;
+			}
+			const uint8_t * code = file.data + section.PointerToRawData;
+			size_t size = std::min <size_t> (section.Misc.VirtualSize != 0 ? section.Misc.VirtualSize : section.SizeOfRawData, file.size() - section.PointerToRawData);
+			uint64_t address = parser.getImageBase () + section.VirtualAddress;
+			while (size > 0)
+			{
+				const uint8_t * current = code;
+				size_t left = size;
+				if (!cs_disasm_iter (handle, &code, &size, &address, insn))
+				{
+					code++;
+					size--;
+					address++;
+					continue;
+				}
+				positions.push_back ( { current, left } );
+				instructionLength ours = getInstructionLength (current, left);
+				bool lengthDiffers = ours.length != insn->size;
+				bool branchDiffers = !lengthDiffers && ours.branch != capstoneBranch (insn);
+				lengthMismatches += lengthDiffers;
+				branchMismatches += branchDiffers;
+				if ((lengthDiffers || branchDiffers) && lengthMismatches + branchMismatches <= MAX_REPORTED_MISMATCHES)
+				{
+					printf ("    %.16llx %-8s %-40s capstone %u/%u, table %u/%u\n", insn->address, insn->mnemonic, insn->op_str,
+						insn->size, capstoneBranch (insn), ours.length, ours.branch);
+				}
+			}
+		}
+	}
+	catch (std::exception &)
+	{
+		log ("Cannot parse %s\n", logType::ERR, stdoutHandle, path.c_str());
+		cs_free (insn, 1);
+		cs_close (&handle);
+		return 1;
+	}
+	log ("%llu instructions, %llu length and %llu branch type mismatches\n", logType::INFO, stdoutHandle,
+		positions.size(), lengthMismatches, branchMismatches);
+
+	cs_option (handle, CS_OPT_DETAIL, CS_OPT_OFF); // the way stepping would use capstone
+	uint64_t capstoneBytes = 0;
+	auto start = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		for (const auto & p : positions)
+		{
+			const uint8_t * code = p.code;
+			size_t size = p.size;
+			uint64_t address = 0;
+			capstoneBytes += cs_disasm_iter (handle, &code, &size, &address, insn) ? insn->size : 0;
+		}
+	}
+	double capstoneSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	uint64_t tableBytes = 0;
+	start = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		for (const auto & p : positions)
+		{
+			tableBytes += getInstructionLength (p.code, p.size).length;
+		}
+	}
+	double tableSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	cs_free (insn, 1);
+	cs_close (&handle);
+
+	double decoded = (double) positions.size() * iterations;
+	if (decoded > 0)
+	{
+		log ("capstone %.1f ns, table %.1f ns per instruction (%.1fx), %llu/%llu bytes\n", logType::INFO, stdoutHandle,
+			capstoneSeconds * 1e9 / decoded, tableSeconds * 1e9 / decoded, capstoneSeconds / std::max (tableSeconds, 1e-9), capstoneBytes, tableBytes);
+	}
+	return lengthMismatches == 0 ? 0 : 1;
+}
+class fakeCodeTarget : public codePatcher // code of process kept in memory, counts calls that would be syscalls
+{
+	private:
+		std::vector <uint8_t> code;
+		uint64_t base;
+	public:
+		size_t reads = 0;
+		size_t writes = 0;
+		size_t flushes = 0;
+
+		fakeCodeTarget (uint64_t base, std::vector <uint8_t> const & code) : code (code), base (base) {}
+		const std::vector <uint8_t> & getCode () const { return code; }
+		bool read (uint64_t address, void * buffer, size_t size) override
+		{
+			reads++;
+			if (address < base || address - base > code.size() || size > code.size() - (address - base))
+			{
+				return false;
+			}
+			memcpy (buffer, code.data() + (address - base), size);
+			return true;
+		}
+		bool write (uint64_t address, const void * buffer, size_t size) override
+		{
+			writes++;
+			if (address < base || address - base > code.size() || size > code.size() - (address - base))
+			{
+				return false;
+			}
+			memcpy (code.data() + (address - base), buffer, size);
+			return true;
+		}
+		void flush (uint64_t, size_t) override
+		{
+			flushes++;
+		}
+};
+static int benchmarkBreakpoints (uint32_t count, uint32_t spacing, HANDLE stdoutHandle) // per breakpoint against page batched installation
+{
+	if (count == 0 || spacing == 0)
+	{
+		log ("Number of breakpoints and spacing must not be zero\n", logType::ERR, stdoutHandle);
+		return 1;
+	}
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	auto random = [&state] () { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return state; };
+	std::vector <uint8_t> image ((uint64_t) count * spacing);
+	for (auto & byte : image)
+	{
+		byte = (uint8_t) random ();
+	}
+	std::vector <breakpoint> pending;
+	for (uint32_t i = 0; i < count; i++) // one breakpoint in every spacing bytes, like function starts
+	{
+		pending.push_back (breakpoint ((void *) (FAKE_TARGET_BASE + (uint64_t) i * spacing + random () % spacing), breakpointType::SOFTWARE_TYPE, false));
+	}
+
+	fakeCodeTarget single (FAKE_TARGET_BASE, image);
+	std::vector <breakpoint> singleSet (pending);
+	auto start = std::chrono::steady_clock::now ();
+	for (auto & bp : singleSet)
+	{
+		bp.set (single);
+	}
+	double singleSetSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	log ("per breakpoint: set %u in %.3f ms, %llu reads, %llu writes, %llu flushes\n", logType::INFO, stdoutHandle,
+		count, singleSetSeconds * 1000, single.reads, single.writes, single.flushes);
+
+	fakeCodeTarget batched (FAKE_TARGET_BASE, image);
+	std::vector <breakpoint> batchSet (pending);
+	patchStats stats;
+	start = std::chrono::steady_clock::now ();
+	breakpointBatch::install (batched, batchSet, stats);
+	double batchSetSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	log ("batched by page: set %u in %.3f ms, %llu pages, %llu reads, %llu writes, %llu flushes\n", logType::INFO, stdoutHandle,
+		batchSet.size(), batchSetSeconds * 1000, stats.pages, batched.reads, batched.writes, batched.flushes);
+
+	bool same = single.getCode () == batched.getCode () && batchSet.size() == count && stats.failed == 0;
+
+	size_t singleCalls = single.reads + single.writes + single.flushes;
+	start = std::chrono::steady_clock::now ();
+	for (auto & bp : singleSet)
+	{
+		bp.restore (single);
+	}
+	double singleRemoveSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	std::vector <std::shared_ptr <breakpoint> > batchRemove;
+	for (const auto & bp : batchSet)
+	{
+		batchRemove.push_back (std::make_shared <breakpoint> (bp));
+	}
+	size_t batchCalls = batched.reads + batched.writes + batched.flushes;
+	start = std::chrono::steady_clock::now ();
+	breakpointBatch::remove (batched, batchRemove, stats);
+	double batchRemoveSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	log ("remove: per breakpoint %.3f ms, %llu calls, batched by page %.3f ms, %llu calls\n", logType::INFO, stdoutHandle,
+		singleRemoveSeconds * 1000, single.reads + single.writes + single.flushes - singleCalls,
+		batchRemoveSeconds * 1000, batched.reads + batched.writes + batched.flushes - batchCalls);
+
+	same = same && single.getCode () == image && batched.getCode () == image && stats.failed == 0;
+	if (!same)
+	{
+		log ("Batched and per breakpoint installation patched different bytes\n", logType::ERR, stdoutHandle);
+		return 1;
+	}
+	log ("Target calls reduced %.1fx, both ways left the same bytes in code\n", logType::INFO, stdoutHandle, (double) singleCalls / std::max <size_t> (batchCalls, 1));
+	return 0;
+}
+static int benchmarkSymbolCache (std::string path, uint32_t iterations, HANDLE stdoutHandle) // cold COFF parse against warm cache load
+{
+	PEparser parser (path);
+	if (!parser.isValid ()) // reason is logged by parser
+	{
+		return 1;
+	}
+	dataSpan<COFFentry> coffEntries;
+	if (parser.getCoffSymbolNumber () > 0 && parser.getCoffSymbolTableOffset () != 0)
+	{
+		coffEntries = parser.getCoffEntries ();
+	}
+	if (coffEntries.empty())
+	{
+		log ("%s has no COFF symbols\n", logType::ERR, stdoutHandle, path.c_str());
+		return 1;
+	}
+	iterations = std::max <uint32_t> (iterations, 1);
+
+	// cold start as debugger does it on cache miss, symbols parsed and named .pdata ranges collected
+	symbolTable symbols;
+	std::vector <functionRange> ranges;
+	auto start = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		coffSymbolParser symbolParser;
+		symbols = symbolParser.parseSymbols (coffEntries, parser.getCoffStringTable (), parser.getSectionHeaders ());
+		ranges.clear ();
+		for (const auto & range : parser.getPdataView ())
+		{
+			const symbolEntry * functionSymbol = symbols.find (range.BeginAddress);
+			if (functionSymbol)
+			{
+				ranges.push_back ( { range.BeginAddress, range.EndAddress, functionSymbol->nameOffset } );
+			}
+		}
+	}
+	double coldSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count () / iterations;
+
+	symbolCache cache (parser);
+	start = std::chrono::steady_clock::now ();
+	if (!cache.store (symbols, ranges))
+	{
+		return 1;
+	}
+	double storeSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+	symbolTable cachedSymbols;
+	std::vector <functionRange> cachedRanges;
+	start = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		if (!cache.load (cachedSymbols, cachedRanges))
+		{
+			log ("Symbol cache %s cannot be loaded back\n", logType::ERR, stdoutHandle, cache.getPath().c_str());
+			return 1;
+		}
+	}
+	double warmSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count () / iterations;
+
+	const auto & entries = symbols.getEntries ();
+	const auto & cachedEntries = cachedSymbols.getEntries ();
+	bool same = entries.size() == cachedEntries.size() && symbols.getNamePool () == cachedSymbols.getNamePool () &&
+		ranges.size() == cachedRanges.size() && (ranges.empty() || !memcmp (ranges.data(), cachedRanges.data(), ranges.size() * sizeof (functionRange)));
+	for (size_t i = 0; same && i < entries.size(); i++)
+	{
+		same = entries[i].rva == cachedEntries[i].rva && entries[i].nameOffset == cachedEntries[i].nameOffset &&
+			entries[i].sectionNumber == cachedEntries[i].sectionNumber && entries[i].type == cachedEntries[i].type;
+	}
+	if (!same)
+	{
+		log ("Symbols loaded from cache differ from parsed ones\n", logType::ERR, stdoutHandle);
+		return 1;
+	}
+	log ("%zu symbols and %zu functions, cache %s\n", logType::INFO, stdoutHandle, symbols.size(), ranges.size(), cache.getPath().c_str());
+	log ("cold parse %.3f ms, cache store %.3f ms, warm load %.3f ms (%.1fx)\n", logType::INFO, stdoutHandle,
+		coldSeconds * 1000, storeSeconds * 1000, warmSeconds * 1000, coldSeconds / std::max (warmSeconds, 1e-9));
+	return 0;
+}
+static int benchmarkFunctionIndex (uint32_t count, uint32_t lookups, HANDLE stdoutHandle) // index lookups against linear scan of ranges
+{
+	if (count == 0 || lookups == 0)
+	{
+		log ("Number of functions and lookups must not be zero\n", logType::ERR, stdoutHandle);
+		return 1;
+	}
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	auto random = [&state] () { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return state; };
+	std::vector <functionRange> ranges; // .pdata like, sorted with gaps of padding between functions
+	uint32_t rva = 0x1000;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t size = 0x10 + random () % 0x400;
+		ranges.push_back ( { rva, rva + size, functionIndex::NO_NAME } );
+		rva += size + random () % 0x10;
+	}
+	functionIndex index (FAKE_TARGET_BASE, ranges, nullptr);
+	std::vector <uint64_t> addresses (lookups);
+	for (auto & address : addresses)
+	{
+		address = FAKE_TARGET_BASE + 0x1000 + random () % (rva - 0x1000);
+	}
+
+	size_t found = 0;
+	auto start = std::chrono::steady_clock::now ();
+	for (uint64_t address : addresses)
+	{
+		found += index.containing (address) != nullptr;
+		found += index.startingAt (address) != nullptr;
+		found += index.endingAt (address) != nullptr;
+	}
+	double indexSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+	// linear scan is what lookups cost without index, it is checked against index and timed on fewer addresses
+	uint32_t scanned = std::min <uint32_t> (lookups, 1000);
+	size_t mismatches = 0;
+	start = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < scanned; i++)
+	{
+		uint32_t target = (uint32_t) (addresses[i] - FAKE_TARGET_BASE);
+		const functionRange * containing = nullptr;
+		const functionRange * startingAt = nullptr;
+		const functionRange * endingAt = nullptr;
+		for (const auto & range : ranges)
+		{
+			if (target >= range.start && target < range.end)
+			{
+				containing = &range;
+			}
+			if (target == range.start)
+			{
+				startingAt = &range;
+			}
+			if (target == range.end)
+			{
+				endingAt = &range;
+			}
+		}
+		const functionRange * indexed [] = { index.containing (addresses[i]), index.startingAt (addresses[i]), index.endingAt (addresses[i]) };
+		const functionRange * scannedRanges [] = { containing, startingAt, endingAt };
+		for (int j = 0; j < 3; j++)
+		{
+			if ((indexed[j] == nullptr) != (scannedRanges[j] == nullptr) || (indexed[j] && (indexed[j]->start != scannedRanges[j]->start || indexed[j]->end != scannedRanges[j]->end)))
+			{
+				mismatches++;
+			}
+		}
+	}
+	double scanSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+	double indexNs = indexSeconds * 1e9 / ((double) lookups * 3);
+	double scanNs = scanSeconds * 1e9 / ((double) scanned * 3);
+	log ("%u functions, %u lookups (%zu found): index %.1f ns, linear scan %.1f ns per lookup (%.0fx)\n", logType::INFO, stdoutHandle,
+		index.size(), lookups, found, indexNs, scanNs, scanNs / std::max (indexNs, 1e-3));
+	if (mismatches)
+	{
+		log ("%zu lookups differ between index and linear scan\n", logType::ERR, stdoutHandle, mismatches);
+		return 1;
+	}
+	return 0;
+}
+static void printUsage ()
+{
+	printf ("[!] Usage: maldbgtool <command> <arguments>\n");
+	printf ("    exportdb <dll directory> <output file> - build export database of DLLs (e.g. C:\\Windows\\System32)\n");
+	printf ("    pebench <file or directory> [iterations] - PE header parsing throughput\n");
+	printf ("    pecorpus <seed PE file> <count> - parse generated malformed variants of seed file\n");
+	printf ("    listing <PE file> <output file> [workers] - disassemble executable sections to text file\n");
+	printf ("    lengthcheck <PE file> [iterations] - compare instruction length decoder with capstone and time both\n");
+	printf ("    sigmake <PE file or directory> <output file> - build signature library from functions named by COFF symbols or exports\n");
+	printf ("    bpbench <count> [spacing] - set and remove breakpoints in fake target one by one and batched by page\n");
+	printf ("    fnbench <count> [lookups] - look up addresses in function index and by linear scan of ranges\n");
+	printf ("    symbench <PE file> [iterations] - parse COFF symbols cold and load them from symbol cache warm\n");
+}
+int main (int argc, char ** argv)
+{
+	HANDLE stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+	if (argc < 2)
+	{
+		printUsage ();
+		return 1;
+	}
+	std::string toolCommand (argv[1]);
+	if (toolCommand == "exportdb" && argc == 4)
+	{
+		std::vector <std::string> dlls = listFiles (argv[2], "*.dll");
+		if (dlls.size() == 0)
+		{
+			log ("No DLLs found in %s\n", logType::ERR, stdoutHandle, argv[2]);
+			return 1;
+		}
+		return exportDatabase::build (dlls, argv[3], stdoutHandle) ? 0 : 1;
+	}
+	if (toolCommand == "pebench" && (argc == 3 || argc == 4))
+	{
+		return benchmarkPE (argv[2], argc == 4 ? parseStringToNumber (argv[3], 10) : 1, stdoutHandle);
+	}
+	if (toolCommand == "pecorpus" && argc == 4)
+	{
+		return malformedCorpus (argv[2], parseStringToNumber (argv[3], 10), stdoutHandle);
+	}
+	if (toolCommand == "listing" && (argc == 4 || argc == 5))
+	{
+		return writeListing (argv[2], argv[3], argc == 5 ? parseStringToNumber (argv[4], 10) : std::thread::hardware_concurrency (), stdoutHandle);
+	}
+	if (toolCommand == "sigmake" && argc == 4)
+	{
+		std::vector <std::string> files = listPEFiles (argv[2]);
+		return signatureLibrary::build (files, argv[3], stdoutHandle) ? 0 : 1;
+	}
+	if (toolCommand == "lengthcheck" && (argc == 3 || argc == 4))
+	{
+		return checkLengthDecoder (argv[2], argc == 4 ? parseStringToNumber (argv[3], 10) : 10, stdoutHandle);
+	}
+	if (toolCommand == "bpbench" && (argc == 3 || argc == 4))
+	{
+		return benchmarkBreakpoints (parseStringToNumber (argv[2], 10), argc == 4 ? parseStringToNumber (argv[3], 10) : 0x40, stdoutHandle);
+	}
+	if (toolCommand == "fnbench" && (argc == 3 || argc == 4))
+	{
+		return benchmarkFunctionIndex (parseStringToNumber (argv[2], 10), argc == 4 ? parseStringToNumber (argv[3], 10) : 1000000, stdoutHandle);
+	}
+	if (toolCommand == "symbench" && (argc == 3 || argc == 4))
+	{
+		return benchmarkSymbolCache (argv[2], argc == 4 ? parseStringToNumber (argv[3], 10) : 10, stdoutHandle);
+	}
+	printUsage ();
+	return 1;
+}
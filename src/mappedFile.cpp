@@ -0,0 +1,117 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+mappedFile::~mappedFile ()
+{
+	close ();
+}
+#ifdef _WIN32
+bool mappedFile::open (std::string path)
+{
+	close ();
+	HANDLE file = CreateFileA (path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	fileHandle = (intptr_t) file;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx (file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close ();
+		return false;
+	}
+	size = fileSize.QuadPart;
+
+	HANDLE mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		close ();
+		return false;
+	}
+	mappingHandle = (intptr_t) mapping;
+	view = (const uint8_t *) MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		close ();
+		return false;
+	}
+	return true;
+}
+void mappedFile::close ()
+{
+	if (view)
+	{
+		UnmapViewOfFile (view);
+		view = nullptr;
+	}
+	if (mappingHandle)
+	{
+		CloseHandle ((HANDLE) mappingHandle);
+		mappingHandle = 0;
+	}
+	if (fileHandle != -1)
+	{
+		CloseHandle ((HANDLE) fileHandle);
+		fileHandle = -1;
+	}
+	size = 0;
+}
+#else
+bool mappedFile::open (std::string path)
+{
+	close ();
+	int file = ::open (path.c_str(), O_RDONLY);
+	if (file == -1)
+	{
+		return false;
+	}
+	fileHandle = file;
+	struct stat fileStat;
+	if (fstat (file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close ();
+		return false;
+	}
+	size = fileStat.st_size;
+
+	void * mapping = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close ();
+		return false;
+	}
+	view = (const uint8_t *) mapping;
+	return true;
+}
+void mappedFile::close ()
+{
+	if (view)
+	{
+		munmap ((void *) view, size);
+		view = nullptr;
+	}
+	if (fileHandle != -1)
+	{
+		::close ((int) fileHandle);
+		fileHandle = -1;
+	}
+	size = 0;
+}
+#endif
+const uint8_t * mappedFile::at (uint64_t offset, uint64_t count)
+{
+	if (view == nullptr || offset > size || count > size - offset)
+	{
+		return nullptr;
+	}
+	return view + offset;
+}
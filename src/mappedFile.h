@@ -0,0 +1,46 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string>
+
+#include "dataSpan.h"
+
+// Whole file mapped read only, Win32 file mapping on Windows and mmap on other hosts (PE parsing is tested there)
+
+class mappedFile
+{
+	private:
+	intptr_t fileHandle = -1; // HANDLE on Windows (-1 is INVALID_HANDLE_VALUE), file descriptor elsewhere
+	intptr_t mappingHandle = 0; // Windows only
+	const uint8_t * view = nullptr;
+	uint64_t size = 0;
+
+	public:
+	mappedFile () = default;
+	mappedFile (const mappedFile &) = delete;
+	mappedFile & operator= (const mappedFile &) = delete;
+	~mappedFile ();
+
+	bool open (std::string);
+	void close ();
+
+	bool isOpen () { return view != nullptr; }
+	const uint8_t * data () { return view; }
+	uint64_t getSize () { return size; }
+
+	const uint8_t * at (uint64_t, uint64_t); // nullptr if [offset, offset + size) is not inside mapping
+	template <class T>
+	dataSpan<T> spanAt (uint64_t offset, uint64_t count)
+	{
+		if (count > size / sizeof (T))
+		{
+			return {};
+		}
+		const uint8_t * p = at (offset, count * sizeof (T));
+		if (p == nullptr)
+		{
+			return {};
+		}
+		return { (const T *) p, (size_t) count };
+	}
+};
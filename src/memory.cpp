@@ -416,12 +416,45 @@ std::string memoryMap::getImageNameForAddress (uint64_t addr)
 	return "?";
 }
 
+uint64_t memoryMap::getImageBaseForAddress (uint64_t addr)
+{
+	for (const auto & i : baseRegions)
+	{
+		if (!i.isIMG)
+		{
+			continue;
+		}
+		for (const auto & j : i.memRegions)
+		{
+			if (addr >= j.start && addr < j.start + j.size)
+			{
+				return i.base;
+			}
+		}
+	}
+	return 0;
+}
+
 // ******************************************************************************************************************************************
 
-memoryHelper::memoryHelper (HANDLE processHandle, HANDLE stdoutHandle)
+bool processMemoryReader::read (uint64_t address, void * buffer, size_t size)
+{
+	SIZE_T bytesRead = 0;
+	if (!ReadProcessMemory (processHandle, (LPCVOID) address, buffer, size, &bytesRead) || bytesRead != size)
+	{
+		return false;
+	}
+	if (shadow)
+	{
+		shadow->apply (address, (uint8_t *) buffer, size);
+	}
+	return true;
+}
+memoryHelper::memoryHelper (HANDLE processHandle, HANDLE stdoutHandle, breakpointShadow const * shadow)
 {
 	this->processHandle = processHandle;
 	this->stdoutHandle = stdoutHandle;
+	this->shadow = shadow;
 }
 bool memoryHelper::printHexdump (void * address, uint32_t size)
 {
@@ -431,8 +464,10 @@ bool memoryHelper::printHexdump (void * address, uint32_t size)
 	if (!ReadProcessMemory (processHandle, (LPVOID) address, b, size, &bytesRead))
 	{
 		log ("Cannot read memory for hexdump\n", logType::ERR, stdoutHandle);
+		delete [] b;
 		return false;
 	}
+	shadow->apply (currentAddress, b, bytesRead); // show original bytes instead of int3 of breakpoints
 
 	uint32_t bytesLeft = bytesRead;
 
@@ -459,6 +494,7 @@ bool memoryHelper::printHexdump (void * address, uint32_t size)
 		bytesLeft -= hexdumpWidth;
 	}
 	delete [] b;
+	return true;
 }
 bool memoryHelper::writeIntAt (uint64_t value, void * addr, uint32_t size)
 {
@@ -6,6 +6,8 @@
 #include "utils.h"
 #include "structs.h"
 #include "peParser.h"
+#include "unwinder.h"
+#include "breakpointShadow.h"
 
 typedef struct _PROCESS_BASIC_INFORMATION 
 {
@@ -74,19 +76,31 @@ class memoryMap
 		void setProtection (uint64_t, uint64_t, memoryProtection);
 		std::string getSectionNameForAddress (uint64_t);
 		std::string getImageNameForAddress (uint64_t);
+		uint64_t getImageBaseForAddress (uint64_t); // 0 if address is not inside any image
 		memoryProtection protectionForAddr (uint64_t addr);
 		std::vector <uint64_t> getModulesAddr ();
 
 };
 
+class processMemoryReader : public memoryReader
+{
+	private:
+		HANDLE processHandle;
+		breakpointShadow const * shadow; // original bytes under breakpoints, may be null
+	public:
+		processMemoryReader (HANDLE processHandle, breakpointShadow const * shadow) : processHandle (processHandle), shadow (shadow) {}
+		bool read (uint64_t, void *, size_t) override;
+};
+
 class memoryHelper
 {
 	private:
 		HANDLE processHandle;
 		HANDLE stdoutHandle;
+		breakpointShadow const * shadow;
 		static constexpr int hexdumpWidth = 8;
 	public:
-		memoryHelper (HANDLE, HANDLE);
+		memoryHelper (HANDLE, HANDLE, breakpointShadow const *);
 		bool printHexdump (void *, uint32_t);
 		bool writeIntAt (uint64_t, void *, uint32_t);
 				
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
+// splits [0, count) into contiguous chunks and runs fn (chunkIndex, begin, end) for each one on its own thread
+// chunk results can be merged in chunkIndex order to keep the original order of work items
+
+inline unsigned parallelWorkers (size_t count, size_t minPerWorker)
+{
+	unsigned hw = std::thread::hardware_concurrency ();
+	if (hw == 0)
+	{
+		hw = 1;
+	}
+	size_t maxWorkers = (count + minPerWorker - 1) / minPerWorker;
+	if (maxWorkers == 0)
+	{
+		maxWorkers = 1;
+	}
+	return (unsigned) std::min <size_t> (hw, maxWorkers);
+}
+
+template <class F>
+void parallelFor (size_t count, unsigned workers, F fn)
+{
+	if (workers <= 1)
+	{
+		fn (0, (size_t) 0, count);
+		return;
+	}
+	std::vector <std::thread> threads;
+	size_t chunk = (count + workers - 1) / workers;
+	for (unsigned i = 0; i < workers; i++)
+	{
+		size_t begin = std::min (count, i * chunk);
+		size_t end = std::min (count, begin + chunk);
+		threads.emplace_back (fn, i, begin, end);
+	}
+	for (auto & t : threads)
+	{
+		t.join ();
+	}
+}
+
+// work items [0, count) are pulled from shared counter by worker threads, produce (worker, index) returns result of item
+// and consume (index, result) gets results on calling thread in index order; workers never run more than window items
+// ahead of consumer, so memory stays bounded when results are big (e.g. text written to file)
+template <class T, class P, class C>
+void parallelOrdered (size_t count, unsigned workers, size_t window, P produce, C consume)
+{
+	if (workers <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			T result = produce (0u, i);
+			consume (i, result);
+		}
+		return;
+	}
+	std::vector <T> results (count);
+	std::vector <char> done (count, 0);
+	std::mutex m;
+	std::condition_variable cv;
+	size_t nextIndex = 0;
+	size_t consumed = 0;
+
+	std::vector <std::thread> threads;
+	for (unsigned w = 0; w < workers; w++)
+	{
+		threads.emplace_back ([&, w] ()
+		{
+			while (true)
+			{
+				size_t index;
+				{
+					std::unique_lock <std::mutex> lock (m);
+					cv.wait (lock, [&] { return nextIndex >= count || nextIndex < consumed + window; });
+					if (nextIndex >= count)
+					{
+						return;
+					}
+					index = nextIndex++;
+				}
+				T result = produce (w, index);
+				{
+					std::lock_guard <std::mutex> lock (m);
+					results[index] = std::move (result);
+					done[index] = 1;
+				}
+				cv.notify_all ();
+			}
+		});
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		T result;
+		{
+			std::unique_lock <std::mutex> lock (m);
+			cv.wait (lock, [&] { return done[i] != 0; });
+			result = std::move (results[i]);
+			consumed = i + 1;
+		}
+		cv.notify_all ();
+		consume (i, result);
+	}
+	for (auto & t : threads)
+	{
+		t.join ();
+	}
+}
+
+// every worker starts with contiguous share of [0, count) and runs fn (worker, index) for its items from the front,
+// worker without items steals from the back of another share, which balances items of very different cost
+template <class F>
+void parallelSteal (size_t count, unsigned workers, F fn)
+{
+	if (workers <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			fn (0u, i);
+		}
+		return;
+	}
+	struct share
+	{
+		std::mutex m;
+		size_t begin;
+		size_t end;
+	};
+	std::vector <share> shares (workers);
+	size_t chunk = (count + workers - 1) / workers;
+	for (unsigned i = 0; i < workers; i++)
+	{
+		shares[i].begin = std::min (count, i * chunk);
+		shares[i].end = std::min (count, shares[i].begin + chunk);
+	}
+
+	std::vector <std::thread> threads;
+	for (unsigned w = 0; w < workers; w++)
+	{
+		threads.emplace_back ([&, w] ()
+		{
+			while (true)
+			{
+				size_t index = count;
+				{
+					std::lock_guard <std::mutex> lock (shares[w].m);
+					if (shares[w].begin < shares[w].end)
+					{
+						index = shares[w].begin++;
+					}
+				}
+				for (unsigned v = 1; index == count && v < workers; v++)
+				{
+					share & victim = shares[(w + v) % workers];
+					std::lock_guard <std::mutex> lock (victim.m);
+					if (victim.begin < victim.end)
+					{
+						index = --victim.end;
+					}
+				}
+				if (index == count)
+				{
+					return;
+				}
+				fn (w, index);
+			}
+		});
+	}
+	for (auto & t : threads)
+	{
+		t.join ();
+	}
+}
@@ -0,0 +1,290 @@
+#include "pdbParser.h"
+#include <algorithm>
+#include <string.h>
+
+constexpr char pdbParser::MSF_MAGIC [32];
+
+pdbParser::pdbParser ()
+{
+	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+}
+bool pdbParser::open (std::string path)
+{
+	if (!file.open (path))
+	{
+		return false;
+	}
+	const msfSuperBlock * superBlock = (const msfSuperBlock *) file.at (0, sizeof (msfSuperBlock));
+	if (superBlock == nullptr || memcmp (superBlock->magic, MSF_MAGIC, sizeof (MSF_MAGIC)))
+	{
+		log ("%s is not MSF 7.0 program database\n", logType::ERR, stdoutHandle, path.c_str());
+		file.close ();
+		return false;
+	}
+	blockSize = superBlock->blockSize;
+	blockCount = superBlock->blockCount;
+	directorySize = superBlock->directorySize;
+	blockMapAddress = superBlock->blockMapAddress;
+	if ((blockSize != 512 && blockSize != 1024 && blockSize != 2048 && blockSize != 4096) ||
+		(uint64_t) blockCount * blockSize > file.getSize () || blockMapAddress >= blockCount || directorySize < sizeof (uint32_t))
+	{
+		log ("%s has invalid MSF super block\n", logType::ERR, stdoutHandle, path.c_str());
+		file.close ();
+		return false;
+	}
+	return true;
+}
+bool pdbParser::readBlocks (const uint32_t * blocks, uint32_t count, uint32_t offset, void * buffer, uint32_t size)
+{
+	uint8_t * out = (uint8_t *) buffer;
+	while (size > 0)
+	{
+		uint32_t index = offset / blockSize;
+		uint32_t inBlock = offset % blockSize;
+		uint32_t chunk = std::min (size, blockSize - inBlock);
+		if (index >= count || blocks[index] >= blockCount)
+		{
+			return false;
+		}
+		const uint8_t * data = file.at ((uint64_t) blocks[index] * blockSize + inBlock, chunk);
+		if (data == nullptr)
+		{
+			return false;
+		}
+		memcpy (out, data, chunk);
+		out += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+	return true;
+}
+bool pdbParser::loadDirectory ()
+{
+	if (directoryLoaded)
+	{
+		return !streamSizes.empty();
+	}
+	directoryLoaded = true;
+
+	// directory: stream count, size of every stream, then block indexes of every stream
+	uint32_t directoryBlockCount = (directorySize + blockSize - 1) / blockSize;
+	dataSpan<uint32_t> blockMap = file.spanAt<uint32_t> ((uint64_t) blockMapAddress * blockSize, directoryBlockCount);
+	std::vector <uint8_t> directory (directorySize);
+	if (blockMap.empty() || !readBlocks (blockMap.data, directoryBlockCount, 0, directory.data(), directorySize))
+	{
+		log ("Cannot read MSF stream directory\n", logType::ERR, stdoutHandle);
+		return false;
+	}
+	const uint32_t * words = (const uint32_t *) directory.data();
+	uint64_t wordCount = directorySize / sizeof (uint32_t);
+	uint32_t streamCount = words[0];
+	if (streamCount >= wordCount)
+	{
+		log ("MSF stream directory is corrupted\n", logType::ERR, stdoutHandle);
+		return false;
+	}
+	std::vector <uint32_t> sizes (words + 1, words + 1 + streamCount);
+	std::vector <uint32_t> firstBlock (streamCount);
+	uint64_t blockIndex = 1 + streamCount;
+	for (uint32_t i = 0; i < streamCount; i++)
+	{
+		uint32_t size = sizes[i] == NIL_STREAM_SIZE ? 0 : sizes[i];
+		uint64_t blocks = (size + (uint64_t) blockSize - 1) / blockSize;
+		if (blockIndex + blocks > wordCount)
+		{
+			log ("MSF stream directory is corrupted\n", logType::ERR, stdoutHandle);
+			return false;
+		}
+		sizes[i] = size;
+		firstBlock[i] = blockIndex - 1 - streamCount;
+		blockIndex += blocks;
+	}
+	streamBlocks.assign (words + 1 + streamCount, words + blockIndex);
+	streamFirstBlock = std::move (firstBlock);
+	streamSizes = std::move (sizes);
+	return true;
+}
+uint32_t pdbParser::getStreamCount ()
+{
+	return loadDirectory () ? streamSizes.size() : 0;
+}
+uint32_t pdbParser::getStreamSize (uint32_t stream)
+{
+	if (!loadDirectory () || stream >= streamSizes.size())
+	{
+		return 0;
+	}
+	return streamSizes[stream];
+}
+bool pdbParser::readStream (uint32_t stream, uint32_t offset, void * buffer, uint32_t size)
+{
+	if (!loadDirectory () || stream >= streamSizes.size() || (uint64_t) offset + size > streamSizes[stream])
+	{
+		return false;
+	}
+	uint32_t blocks = (streamSizes[stream] + blockSize - 1) / blockSize;
+	return readBlocks (streamBlocks.data() + streamFirstBlock[stream], blocks, offset, buffer, size);
+}
+bool pdbParser::matches (const uint8_t * guid, uint32_t age)
+{
+	pdbInfoHeader info;
+	if (!readStream (PDB_INFO_STREAM, 0, &info, sizeof (info)))
+	{
+		return false;
+	}
+	return !memcmp (info.guid, guid, sizeof (info.guid)) && info.age == age;
+}
+bool pdbParser::loadDbi ()
+{
+	if (dbiLoaded)
+	{
+		return dbi.versionSignature == -1;
+	}
+	dbiLoaded = true;
+	if (!readStream (DBI_STREAM, 0, &dbi, sizeof (dbi)) || dbi.versionSignature != -1 ||
+		dbi.modInfoSize < 0 || dbi.sectionContributionSize < 0 || dbi.sectionMapSize < 0 || dbi.sourceInfoSize < 0 ||
+		dbi.typeServerMapSize < 0 || dbi.ecSubstreamSize < 0 || dbi.optionalDbgHeaderSize < 0)
+	{
+		log ("PDB has no valid DBI stream\n", logType::ERR, stdoutHandle);
+		dbi.versionSignature = 0;
+		return false;
+	}
+
+	// optional debug header is last substream of DBI, it is array of stream indexes
+	uint64_t optionalHeaderOffset = sizeof (dbi) + (uint64_t) dbi.modInfoSize + dbi.sectionContributionSize + dbi.sectionMapSize +
+		dbi.sourceInfoSize + dbi.typeServerMapSize + dbi.ecSubstreamSize;
+	uint16_t sectionStream;
+	if (dbi.optionalDbgHeaderSize >= (int32_t) ((DBI_SECTION_HEADERS_INDEX + 1) * sizeof (uint16_t)) &&
+		readStream (DBI_STREAM, optionalHeaderOffset + DBI_SECTION_HEADERS_INDEX * sizeof (uint16_t), &sectionStream, sizeof (sectionStream)))
+	{
+		uint32_t count = getStreamSize (sectionStream) / sizeof (IMAGE_SECTION_HEADER);
+		sections.resize (count);
+		if (count > 0 && !readStream (sectionStream, 0, sections.data(), count * sizeof (IMAGE_SECTION_HEADER)))
+		{
+			sections.clear ();
+		}
+	}
+	return true;
+}
+bool pdbParser::segmentToRVA (dataSpan<IMAGE_SECTION_HEADER> sectionHeaders, uint16_t segment, uint32_t offset, uint32_t & rva)
+{
+	if (segment == 0 || segment > sectionHeaders.size())
+	{
+		return false;
+	}
+	rva = sectionHeaders[segment - 1].VirtualAddress + offset;
+	return true;
+}
+const std::vector <pdbSectionContribution> & pdbParser::getSectionContributions ()
+{
+	if (contributionsLoaded || !loadDbi ())
+	{
+		return contributions;
+	}
+	contributionsLoaded = true;
+
+	uint32_t version;
+	uint32_t offset = sizeof (dbi) + dbi.modInfoSize;
+	if (dbi.sectionContributionSize < (int32_t) sizeof (version) || (uint64_t) offset + dbi.sectionContributionSize > getStreamSize (DBI_STREAM) ||
+		!readStream (DBI_STREAM, offset, &version, sizeof (version)) ||
+		(version != SECTION_CONTRIBUTION_V60 && version != SECTION_CONTRIBUTION_V2))
+	{
+		return contributions;
+	}
+	uint32_t entrySize = sizeof (pdbSectionContributionEntry) + (version == SECTION_CONTRIBUTION_V2 ? sizeof (uint32_t) : 0); // V2 adds COFF section index
+	uint32_t count = (dbi.sectionContributionSize - sizeof (version)) / entrySize;
+	std::vector <uint8_t> data ((uint64_t) count * entrySize);
+	if (count == 0 || !readStream (DBI_STREAM, offset + sizeof (version), data.data(), data.size()))
+	{
+		return contributions;
+	}
+	dataSpan<IMAGE_SECTION_HEADER> sectionHeaders = { sections.data(), sections.size() };
+	for (uint32_t i = 0; i < count; i++)
+	{
+		pdbSectionContributionEntry entry;
+		memcpy (&entry, data.data() + (uint64_t) i * entrySize, sizeof (entry));
+		uint32_t rva;
+		if (entry.size > 0 && entry.offset >= 0 && segmentToRVA (sectionHeaders, entry.section, entry.offset, rva))
+		{
+			contributions.push_back ( { rva, (uint32_t) entry.size, entry.characteristics, entry.moduleIndex } );
+		}
+	}
+	std::sort (contributions.begin(), contributions.end(), [] (const pdbSectionContribution & a, const pdbSectionContribution & b) { return a.rva < b.rva; });
+	return contributions;
+}
+symbolTable pdbParser::getPublicSymbols (dataSpan<IMAGE_SECTION_HEADER> imageSections)
+{
+	symbolTable table;
+	pdbPublicsHeader header;
+	if (!loadDbi () || !readStream (dbi.publicStreamIndex, 0, &header, sizeof (header)))
+	{
+		return table;
+	}
+	dataSpan<IMAGE_SECTION_HEADER> sectionHeaders = sections.empty() ? imageSections : dataSpan<IMAGE_SECTION_HEADER> { sections.data(), sections.size() };
+
+	// sizes come from file, they are checked against stream before anything is allocated from them
+	if ((uint64_t) sizeof (header) + header.symHashSize + header.addrMapSize > getStreamSize (dbi.publicStreamIndex))
+	{
+		log ("PDB publics stream is shorter than its header declares\n", logType::ERR, stdoutHandle);
+		return table;
+	}
+
+	// address map holds offsets of S_PUB32 records in symbol record stream, records are read one by one
+	std::vector <uint32_t> addressMap (header.addrMapSize / sizeof (uint32_t));
+	if (!readStream (dbi.publicStreamIndex, sizeof (header) + header.symHashSize, addressMap.data(), addressMap.size() * sizeof (uint32_t)))
+	{
+		log ("Cannot read address map of PDB publics stream\n", logType::ERR, stdoutHandle);
+		return table;
+	}
+
+	std::vector <symbolEntry> entries;
+	std::vector <char> namePool;
+	entries.reserve (addressMap.size());
+	uint8_t record [sizeof (uint32_t) * 2 + sizeof (uint16_t) + MAX_NAME_LENGTH]; // flags, offset, segment, name
+	for (uint32_t recordOffset : addressMap)
+	{
+		uint16_t recordHeader [2]; // length without length field, kind
+		if (!readStream (dbi.symRecordStream, recordOffset, recordHeader, sizeof (recordHeader)) || recordHeader[1] != S_PUB32 ||
+			recordHeader[0] <= sizeof (uint16_t) + 10)
+		{
+			continue;
+		}
+		uint32_t bodySize = std::min <uint32_t> (recordHeader[0] - sizeof (uint16_t), sizeof (record));
+		if (!readStream (dbi.symRecordStream, recordOffset + sizeof (recordHeader), record, bodySize))
+		{
+			continue;
+		}
+		uint32_t flags, offset;
+		uint16_t segment;
+		memcpy (&flags, record, sizeof (flags));
+		memcpy (&offset, record + 4, sizeof (offset));
+		memcpy (&segment, record + 8, sizeof (segment));
+		uint32_t rva;
+		if (!segmentToRVA (sectionHeaders, segment, offset, rva))
+		{
+			continue;
+		}
+		const char * name = (const char *) record + 10;
+		size_t nameLength = strnlen (name, bodySize - 10);
+
+		symbolEntry entry {};
+		entry.rva = rva;
+		entry.nameOffset = namePool.size();
+		entry.sectionNumber = segment;
+		entry.type = (flags & CVPSF_FUNCTION) ? FUNCTION_NAME : NAME;
+		if (entry.type == NAME) // assembler and some linker generated publics have no function flag, code contribution tells
+		{
+			const std::vector <pdbSectionContribution> & code = getSectionContributions ();
+			auto it = std::upper_bound (code.begin(), code.end(), rva, [] (uint32_t v, const pdbSectionContribution & c) { return v < c.rva; });
+			if (it != code.begin() && rva - (it - 1)->rva < (it - 1)->size && ((it - 1)->characteristics & IMAGE_SCN_CNT_CODE))
+			{
+				entry.type = FUNCTION_NAME;
+			}
+		}
+		namePool.insert (namePool.end(), name, name + nameLength);
+		namePool.push_back ('\0');
+		entries.push_back (entry);
+	}
+	table.build (std::move (entries), std::move (namePool));
+	return table;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "mappedFile.h"
+#include "symbolParse.h"
+
+// Program database (MSF 7.0 container) reader
+// file stays memory mapped, stream directory is read at first stream access and
+// DBI, publics and section contributions are decoded only when asked for, so big PDBs are never read in full
+
+#pragma pack(push)
+#pragma pack(1)
+struct msfSuperBlock
+{
+	char magic [32];
+	uint32_t blockSize;
+	uint32_t freeBlockMapBlock;
+	uint32_t blockCount;
+	uint32_t directorySize;
+	uint32_t unknown;
+	uint32_t blockMapAddress; // block holding indexes of directory blocks
+};
+struct pdbInfoHeader
+{
+	uint32_t version;
+	uint32_t signature;
+	uint32_t age;
+	uint8_t guid [16];
+};
+struct pdbDbiHeader
+{
+	int32_t versionSignature;
+	uint32_t versionHeader;
+	uint32_t age;
+	uint16_t globalStreamIndex;
+	uint16_t buildNumber;
+	uint16_t publicStreamIndex;
+	uint16_t pdbDllVersion;
+	uint16_t symRecordStream;
+	uint16_t pdbDllRbld;
+	int32_t modInfoSize;
+	int32_t sectionContributionSize;
+	int32_t sectionMapSize;
+	int32_t sourceInfoSize;
+	int32_t typeServerMapSize;
+	uint32_t mfcTypeServerIndex;
+	int32_t optionalDbgHeaderSize;
+	int32_t ecSubstreamSize;
+	uint16_t flags;
+	uint16_t machine;
+	uint32_t padding;
+};
+struct pdbPublicsHeader
+{
+	uint32_t symHashSize;
+	uint32_t addrMapSize;
+	uint32_t thunkCount;
+	uint32_t thunkSize;
+	uint16_t thunkTableSection;
+	uint16_t padding;
+	uint32_t thunkTableOffset;
+	uint32_t sectionCount;
+};
+struct pdbSectionContributionEntry
+{
+	uint16_t section;
+	uint16_t padding1;
+	int32_t offset;
+	int32_t size;
+	uint32_t characteristics;
+	uint16_t moduleIndex;
+	uint16_t padding2;
+	uint32_t dataCrc;
+	uint32_t relocCrc;
+};
+#pragma pack(pop)
+
+struct pdbSectionContribution
+{
+	uint32_t rva;
+	uint32_t size;
+	uint32_t characteristics;
+	uint16_t moduleIndex;
+};
+
+class pdbParser
+{
+	private:
+		static constexpr char MSF_MAGIC [32] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+		static constexpr uint32_t NIL_STREAM_SIZE = 0xFFFFFFFF;
+		static constexpr uint32_t PDB_INFO_STREAM = 1;
+		static constexpr uint32_t DBI_STREAM = 3;
+		static constexpr uint32_t DBI_SECTION_HEADERS_INDEX = 5; // in optional debug header
+		static constexpr uint32_t SECTION_CONTRIBUTION_V60 = 0xEFFE0000 + 19970605;
+		static constexpr uint32_t SECTION_CONTRIBUTION_V2 = 0xEFFE0000 + 20140516;
+		static constexpr uint16_t S_PUB32 = 0x110E;
+		static constexpr uint32_t CVPSF_FUNCTION = 2;
+		static constexpr uint32_t MAX_NAME_LENGTH = 0x1000;
+
+		mappedFile file;
+		HANDLE stdoutHandle;
+		uint32_t blockSize = 0;
+		uint32_t blockCount = 0;
+		uint32_t directorySize = 0;
+		uint32_t blockMapAddress = 0;
+
+		bool directoryLoaded = false;
+		std::vector <uint32_t> streamSizes;
+		std::vector <uint32_t> streamFirstBlock; // index into streamBlocks
+		std::vector <uint32_t> streamBlocks;
+
+		bool dbiLoaded = false;
+		pdbDbiHeader dbi;
+		std::vector <IMAGE_SECTION_HEADER> sections; // original section headers from PDB
+		std::vector <pdbSectionContribution> contributions; // sorted by RVA, loaded with first getSectionContributions
+		bool contributionsLoaded = false;
+
+		bool loadDirectory ();
+		bool loadDbi ();
+		bool readBlocks (const uint32_t *, uint32_t, uint32_t, void *, uint32_t);
+		static bool segmentToRVA (dataSpan<IMAGE_SECTION_HEADER>, uint16_t, uint32_t, uint32_t &);
+	public:
+		pdbParser ();
+		bool open (std::string);
+		uint32_t getStreamCount ();
+		uint32_t getStreamSize (uint32_t); // 0 for missing streams
+		bool readStream (uint32_t, uint32_t, void *, uint32_t); // whole range or nothing
+		bool matches (const uint8_t *, uint32_t); // GUID and age from RSDS record of image
+		const std::vector <pdbSectionContribution> & getSectionContributions ();
+		symbolTable getPublicSymbols (dataSpan<IMAGE_SECTION_HEADER>); // image sections are used when PDB has none
+};
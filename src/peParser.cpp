@@ -7,202 +7,140 @@ PEparser::PEparser (HANDLE processHandle, uint64_t baseAddress) // IN MEMORY
 	this->processHandle = processHandle;
 	this->baseAddress = (void *) baseAddress;
 
-	PEheaderAddr = getPEstructureVirtual ();
-	checkArchVirtual ();
-	readPEheaderVirtual ();	
+	if (!readHeadersVirtual ())
+	{
+		log ("Cannot read PE headers of module at 0x%.16llx\n", logType::ERR, stdoutHandle, baseAddress);
+		error = peError::UNREADABLE;
+		return;
+	}
+	error = view.parse ( { headerStorage.data(), headerStorage.size() }, true);
+	if (error != peError::OK)
+	{
+		log ("Module at 0x%.16llx is not supported PE image (%s)\n", logType::ERR, stdoutHandle, baseAddress, peErrorToString (error));
+		return;
+	}
+	loadHeaders ();
 }
 PEparser::PEparser (std::string exePath) // ON DISK
 {
 	virtualMode = false;
 	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-	f = fopen (exePath.c_str(), "rb");
-	if (!f)
+	baseAddress = nullptr;
+	if (!file.open (exePath))
 	{
 		log ("Cannot open PE file from path %s \n", logType::ERR, stdoutHandle, exePath.c_str());
-		throw std::exception ();
+		error = peError::UNREADABLE;
+		return;
 	}
-	PEheaderAddr = (void *) getPEstructureFile ();
-	checkArchFile ();
-	readPEheaderFile ();	
-}
-
-/* GET PE STRUCTURE */
-
-uint32_t PEparser::getPEstructureFile ()
-{
-	fseek (f, 0, 0);
-	IMAGE_DOS_HEADER * dosHeader = new IMAGE_DOS_HEADER;
-	size_t ret = fread (dosHeader, sizeof (IMAGE_DOS_HEADER), 1, f);
-	if (ret != 1) // one element of IMAGE_DOS_HEADER
+	error = view.parse ( { file.data(), (size_t) file.getSize() }, false);
+	if (error != peError::OK)
+	{
+		log ("%s is not supported PE file (%s)\n", logType::ERR, stdoutHandle, exePath.c_str(), peErrorToString (error));
+		return;
+	}
+	loadHeaders ();
+	if (wow64)
 	{
-		log ("Cannot read DOS header of executable\n", logType::ERR, stdoutHandle);
-		throw std::exception ();
+		baseAddress = (void *)((IMAGE_NT_HEADERS32*) ntHeaders)->OptionalHeader.ImageBase;
+	}
+	else 
+	{
+		baseAddress = (void *) ((IMAGE_NT_HEADERS64*) ntHeaders)->OptionalHeader.ImageBase;
 	}
-	delete dosHeader;
-	return dosHeader->e_lfanew;
 }
-void * PEparser::getPEstructureVirtual ()
+bool PEparser::readHeadersVirtual ()
 {
-	IMAGE_DOS_HEADER * dosHeader = new IMAGE_DOS_HEADER;
-	if (!ReadProcessMemory (processHandle, (LPCVOID) baseAddress, (uint8_t *) dosHeader, sizeof (IMAGE_DOS_HEADER), NULL))
+	// headers and full section table if they are readable, otherwise only first page
+	headerStorage.resize (MAX_VIRTUAL_HEADERS_SIZE);
+	SIZE_T bytesRead = 0;
+	if (ReadProcessMemory (processHandle, (LPCVOID) baseAddress, headerStorage.data(), headerStorage.size(), &bytesRead))
 	{
-		log ("Cannot read DOS header of this executable\n", logType::ERR, stdoutHandle);
-		throw std::exception ();
+		return true;
 	}
-	void * PEaddr = (void *)((uint64_t )baseAddress + (uint64_t) dosHeader->e_lfanew);
-	delete dosHeader;
-	return PEaddr;
+	headerStorage.resize (PAGE_SIZE);
+	return ReadProcessMemory (processHandle, (LPCVOID) baseAddress, headerStorage.data(), headerStorage.size(), &bytesRead);
+}
+void PEparser::loadHeaders () // headers were validated by view
+{
+	wow64 = !view.isPE64 ();
+	dataSpan<uint8_t> headers = view.getNtHeaders ();
+	memset (ntHeaders, 0, sizeof (ntHeaders)); // optional header can be shorter than structure
+	memcpy (ntHeaders, headers.data, std::min <size_t> (headers.size(), sizeof (ntHeaders)));
+	PEheaderAddr = (void *) ((uint64_t) (virtualMode ? baseAddress : 0) + view.getNtHeadersOffset ());
+	dataSpan<IMAGE_SECTION_HEADER> sections = view.getSections ();
+	sectionHeaders.assign (sections.begin(), sections.end());
+}
+dataSpan<IMAGE_SECTION_HEADER> PEparser::getSectionHeaders ()
+{
+	return { sectionHeaders.data(), sectionHeaders.size() };
 }
 
-/* END  GET PE STRUCTURE */
-
-/* CHECK ARCH */
+/* END GET SECTIONS */
 
-void PEparser::checkArchVirtual ()
+uint32_t PEparser::getNumberOfSections ()
 {
-	uint8_t machineType [2];
-	if (!ReadProcessMemory (processHandle, (uint8_t *) PEheaderAddr + 4, machineType, 2, NULL))
-	{
-		log ("Cannot read PE header signature\n", logType::ERR, stdoutHandle);
-		throw std::exception ();
-	}
-	if (!memcmp(machineType,"\x64\x86",2))
-	{
-		wow64 = false;
-	}
-	else if (!memcmp(machineType,"\x0c\x14",2))
+	if (wow64)
 	{
-		wow64 = true;
+		return ( (IMAGE_NT_HEADERS32*) ntHeaders)->FileHeader.NumberOfSections;
 	}
-	else 
+	else
 	{
-		log ("File not supported, how did you start this process ???\n", logType::ERR, stdoutHandle);
-		throw std::exception ();
+		return ( (IMAGE_NT_HEADERS64*) ntHeaders)->FileHeader.NumberOfSections;
 	}
 }
 
-void PEparser::checkArchFile ()
+uint32_t PEparser::getTimeDateStamp ()
 {
-	fseek (f, (uint64_t) PEheaderAddr, 0); // move file to PE header offset 
-	fseek (f, 4, 1); // move file ptr 4 bytes forward
-	uint8_t machineType [2];
-	if ( fread (machineType, 1, 2, f) != 2 )
-	{
-		log ("Cannot read PE header signature\n", logType::ERR, stdoutHandle);
-		throw std::exception ();
-	}
-	if (!memcmp(machineType,"\x64\x86",2))
-	{
-		wow64 = false;
-	}
-	else if (!memcmp(machineType,"\x0c\x14",2))
+	if (wow64)
 	{
-		wow64 = true;
+		return ((IMAGE_NT_HEADERS32*) ntHeaders)->FileHeader.TimeDateStamp;
 	}
 	else 
 	{
-		log ("File not supported, you are not gonna debug this program\n", logType::ERR, stdoutHandle);
-		throw std::exception ();
+		return ((IMAGE_NT_HEADERS64*) ntHeaders)->FileHeader.TimeDateStamp;
 	}
-	fseek (f, -6, 1); // go to PE header again
 }
-
-/* END CHECK ARCH */
-
-/* READ PE HEADER */
-
-void  PEparser::readPEheaderVirtual ()
+uint32_t PEparser::getSizeOfImage ()
 {
-	uint32_t size = (wow64 == 0 ? sizeof(IMAGE_NT_HEADERS64) : sizeof (IMAGE_NT_HEADERS32));
-	if (!ReadProcessMemory (processHandle, (LPCVOID) PEheaderAddr, ntHeaders, size, NULL))
-	{
-		log ("Cannot read Image NT headers \n", logType::ERR, stdoutHandle);
-		throw std::exception ();
-	}
-}
-void PEparser::readPEheaderFile ()
-{
-	fseek (f, (uint64_t) PEheaderAddr, 0);
-	uint32_t size = (wow64 == 0 ? sizeof(IMAGE_NT_HEADERS64) : sizeof (IMAGE_NT_HEADERS32));
-	if (fread (ntHeaders, 1, size, f) != size)
-	{
-		log ("Cannot read Image NT headers \n", logType::ERR, stdoutHandle);
-		throw std::exception ();
-	}
 	if (wow64)
 	{
-		baseAddress = (void *)((IMAGE_NT_HEADERS32*) ntHeaders)->OptionalHeader.ImageBase;
+		return ((IMAGE_NT_HEADERS32*) ntHeaders)->OptionalHeader.SizeOfImage;
 	}
 	else 
 	{
-		baseAddress = (void *) ((IMAGE_NT_HEADERS64*) ntHeaders)->OptionalHeader.ImageBase;
+		return ((IMAGE_NT_HEADERS64*) ntHeaders)->OptionalHeader.SizeOfImage;
 	}
-	sectionsHeadersOffset = ftell (f);
 }
-
-/* END READ PE HEADER */
-
-/* GET SECTIONS */
-
-std::vector<IMAGE_SECTION_HEADER> PEparser::getSectionsVirtual ()
+uint64_t PEparser::getImageBase () // preferred base from optional header
 {
-	uint32_t size = (wow64 == 0 ? sizeof(IMAGE_NT_HEADERS64) : sizeof(IMAGE_NT_HEADERS32));
-	WORD numberOfSections = getNumberOfSections();
-	uint64_t sectionsStartAddr =  (uint64_t) PEheaderAddr + size;
-
-	IMAGE_SECTION_HEADER * sections = new IMAGE_SECTION_HEADER [numberOfSections];
-
-	for (int i = 0 ; i < numberOfSections; i++)
+	if (wow64)
 	{
-		if (!ReadProcessMemory (processHandle, (LPCVOID) sectionsStartAddr + (sizeof(IMAGE_SECTION_HEADER) * i), &sections[i], sizeof (IMAGE_SECTION_HEADER), NULL))
-		{
-			log ("Cannot read section from PE module\n", logType::ERR, stdoutHandle);
-			throw std::exception ();
-		}	
+		return ((IMAGE_NT_HEADERS32*) ntHeaders)->OptionalHeader.ImageBase;
+	}
+	else 
+	{
+		return ((IMAGE_NT_HEADERS64*) ntHeaders)->OptionalHeader.ImageBase;
 	}
-	std::vector <IMAGE_SECTION_HEADER> toRet (sections, sections + numberOfSections);
-	delete [] sections;
-	return toRet;
 }
-
-std::vector<IMAGE_SECTION_HEADER> PEparser::getSectionsFile ()
+uint32_t PEparser::getCheckSum ()
 {
-	fseek (f, sectionsHeadersOffset, 0);
-	std::vector <IMAGE_SECTION_HEADER> toRet;
-
-	uint32_t size = (wow64 == 0 ? sizeof(IMAGE_NT_HEADERS64) : sizeof(IMAGE_NT_HEADERS32));
-	WORD numberOfSections = getNumberOfSections();
-	uint64_t sectionsStartAddr = (uint64_t) PEheaderAddr + size;
-
-	IMAGE_SECTION_HEADER * sections = new IMAGE_SECTION_HEADER [numberOfSections];
-
-	if (fread (sections, sizeof (IMAGE_SECTION_HEADER), numberOfSections, f) != numberOfSections)
+	if (wow64)
 	{
-		log ("Cannot read section headers from PE file\n", logType::ERR, stdoutHandle);
-		throw std::exception ();	
+		return ((IMAGE_NT_HEADERS32*) ntHeaders)->OptionalHeader.CheckSum;
 	}
-	for (int i = 0 ; i < numberOfSections; i++)
+	else 
 	{
-		toRet.push_back (sections[i]);
+		return ((IMAGE_NT_HEADERS64*) ntHeaders)->OptionalHeader.CheckSum;
 	}
-	delete [] sections;
-	return toRet;
 }
-
-/* END GET SECTIONS */
-
-uint32_t PEparser::getNumberOfSections ()
+dataSpan<uint8_t> PEparser::getFileView ()
 {
-	if (wow64)
-	{
-		return ( (IMAGE_NT_HEADERS32*) ntHeaders)->FileHeader.NumberOfSections;
-	}
-	else
+	if (virtualMode)
 	{
-		return ( (IMAGE_NT_HEADERS64*) ntHeaders)->FileHeader.NumberOfSections;
+		return {};
 	}
+	return { file.data(), (size_t) file.getSize() };
 }
-
 uint64_t PEparser::getCoffSymbolTableOffset ()
 {
 	if (wow64)
@@ -228,7 +166,7 @@ uint32_t PEparser::getCoffSymbolNumber ()
 
 uint64_t PEparser::fileOffsetToVirtualAddress (uint64_t fileOffset)
 {
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual () : getSectionsFile ());
+	const std::vector<IMAGE_SECTION_HEADER> & sections = sectionHeaders;
 	for (int i = 0 ; i < sections.size(); i++)
 	{
 		if (fileOffset>= sections[i].PointerToRawData && fileOffset < (sections[i].PointerToRawData + sections[i].SizeOfRawData))
@@ -237,12 +175,13 @@ uint64_t PEparser::fileOffsetToVirtualAddress (uint64_t fileOffset)
 			return virtualAddress;
 		}
 	}
+	return 0; // offset is not inside any section (headers, overlay)
 }
 std::map <uint64_t, section> PEparser::getPESections ()
 {
 	std::map <uint64_t, section> toRet;
 
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual () : getSectionsFile ());
+	const std::vector<IMAGE_SECTION_HEADER> & sections = sectionHeaders;
 	for (int i = 0 ; i < sections.size(); i++)
 	{
 		const char * a = (const char *) sections[i].Name; 
@@ -267,18 +206,20 @@ bool PEparser::isAddrInSection (uint64_t addr, IMAGE_SECTION_HEADER * section)
 	}
 	return false;
 }
-IMAGE_SECTION_HEADER PEparser::getEntryPointSection ()
+bool PEparser::getEntryPointSection (IMAGE_SECTION_HEADER & entryPointSection)
 {
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual () : getSectionsFile ());
+	std::vector<IMAGE_SECTION_HEADER> & sections = sectionHeaders;
+	entryPoint = getEntryPoint ();
 	for (int i = 0; i < sections.size(); i++)
 	{
 		if (isAddrInSection((uint64_t) entryPoint, &sections[i]))
 		{
-			return sections[i];
+			entryPointSection = sections[i];
+			return true;
 		}
 	}
 	log ("Cannot get section within entrypoint, something very nasty \n", logType::ERR, stdoutHandle);
-	throw std::exception ();
+	return false;
 }
 void * PEparser::getEntryPoint ()
 {
@@ -293,31 +234,27 @@ void * PEparser::getEntryPoint ()
 }
 void PEparser::showSections ()
 {
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual () : getSectionsFile ());
+	const std::vector<IMAGE_SECTION_HEADER> & sections = sectionHeaders;
 	for (int i = 0 ; i < sections.size(); i++)
 	{
 		printf ("%s --> %.16llx VIRT[%.16llx] RAW[%.16llx]\n", sections[i].Name, sections[i].VirtualAddress + (uint64_t) baseAddress, sections[i].Misc.VirtualSize, sections[i].SizeOfRawData);
 	}
 }
-std::vector <COFFentry> PEparser::getCoffEntries ()
+dataSpan<COFFentry> PEparser::getCoffEntries ()
 {
 	if (virtualMode)
 	{
 		log ("You cannot read COFF symbols table within virtual memory\n", logType::ERR, stdoutHandle);
-		throw std::exception();
+		return {};
 	}
-	fseek (f,getCoffSymbolTableOffset(),0);
 	uint32_t quantinity = getCoffSymbolNumber();
-	COFFentry * entires = new COFFentry [quantinity];
-	if (fread(entires, sizeof (COFFentry), quantinity, f) != quantinity)
+	dataSpan<COFFentry> entries = file.spanAt<COFFentry> (getCoffSymbolTableOffset(), quantinity);
+	if (entries.size() != quantinity)
 	{
 		log ("Couldnt read COFF symbol table from file\n", logType::ERR, stdoutHandle);
-		throw std::exception();
+		return {};
 	}
-
-	std::vector <COFFentry> toRet (entires, entires + quantinity);
-	delete [] entires;
-	return toRet;
+	return entries;
 }
 uint64_t PEparser::getCoffExtendedNamesOffset ()
 {
@@ -325,35 +262,39 @@ uint64_t PEparser::getCoffExtendedNamesOffset ()
 	uint64_t symbolsSize = sizeof (COFFentry) * getCoffSymbolNumber ();
 	return symbolsOffset + symbolsSize;
 }
-std::unique_ptr<uint8_t []> PEparser::getCoffExtendedNames ()
+dataSpan<uint8_t> PEparser::getCoffStringTable ()
 {
+	if (virtualMode)
+	{
+		log ("You cannot read COFF string table within virtual memory\n", logType::ERR, stdoutHandle);
+		return {};
+	}
 	uint64_t extendedNamesOffset = getCoffExtendedNamesOffset ();
-	fseek (f, 0 , 2);
-	uint64_t imageSize = ftell (f);
-	fseek (f, extendedNamesOffset, 0);
-	uint64_t toRead = imageSize - extendedNamesOffset; // we suppose that extended strings are rest of PE file
-
-	auto extendedNamesBuff =std::make_unique<uint8_t []>(toRead); 
-	if (fread (extendedNamesBuff.get(), 1, toRead, f) != toRead)
+	const uint32_t * tableSize = (const uint32_t *) file.at (extendedNamesOffset, sizeof (uint32_t)); // size field includes itself
+	if (tableSize == nullptr)
 	{
-		log ("Couldnt read COFF extended symbol names from file\n", logType::ERR, stdoutHandle);
-		throw std::exception();
+		return {};
 	}
-	return extendedNamesBuff;
+	uint64_t size = *tableSize;
+	if (size < sizeof (uint32_t) || file.at (extendedNamesOffset, size) == nullptr)
+	{
+		size = file.getSize() - extendedNamesOffset; // broken size field, clamp to the end of file
+	}
+	return file.spanAt<uint8_t> (extendedNamesOffset, size);
 }
 uint64_t PEparser::getSectionAddressForIndex (int idx)
 {
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual() : getSectionsFile () );
-	if (idx < 0 && idx >= sections.size())
+	const std::vector<IMAGE_SECTION_HEADER> & sections = sectionHeaders;
+	if (idx < 0 || idx >= (int) sections.size())
 	{
 		log ("Couldnt get section nr %i\n", logType::ERR, stdoutHandle, idx);
-		throw std::exception();
+		return 0;
 	}
 	return sections[idx].VirtualAddress;
 }
 std::string PEparser::getSectionNameForAddress (uint64_t addr) // RVA for file, VA for module
 {
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual() : getSectionsFile());
+	const std::vector<IMAGE_SECTION_HEADER> & sections = sectionHeaders;
 	for (int i = 0 ; i < sections.size() ; i++)
 	{
 		if (addr >= sections[i].VirtualAddress && addr < sections[i].VirtualAddress + alignMemoryPageSize(sections[i].Misc.VirtualSize))
@@ -364,205 +305,295 @@ std::string PEparser::getSectionNameForAddress (uint64_t addr) // RVA for file,
 	}
 	return "?";
 }
-std::vector <RUNTIME_FUNCTION> PEparser::getPdataEntries ()
+bool PEparser::rvaToFileOffset (uint64_t rva, uint64_t & fileOffset)
 {
-	uint64_t addrToRead = 0;
-	uint64_t size = 0;
-	std::vector<IMAGE_SECTION_HEADER> sections = (virtualMode == 1 ? getSectionsVirtual () : getSectionsFile ());
-	for (const auto & section : sections)
+	return !virtualMode && view.rvaToOffset (rva, 1, fileOffset) == peError::OK;
+}
+dataSpan<RUNTIME_FUNCTION> PEparser::getPdataView ()
+{
+	if (virtualMode)
 	{
-		if (!strncmp ( (const char *) section.Name, ".pdata\x00\x00", 8))
-		{
-			size = section.SizeOfRawData;
-			if (virtualMode)
-			{
-				addrToRead = (uint64_t) baseAddress + section.VirtualAddress;
-			}
-			else
-			{
-				addrToRead = section.PointerToRawData;
-			}
-		}
+		log ("Cannot get view of .pdata in virtual memory\n", logType::ERR, stdoutHandle);
+		return {};
 	}
-
-	std::vector <RUNTIME_FUNCTION> pdataEntries ( (size / sizeof(RUNTIME_FUNCTION)) + sizeof(RUNTIME_FUNCTION) ); // because /3 is truncating result
-
-	if (virtualMode)
+	IMAGE_DATA_DIRECTORY directory = getDataDirectory (IMAGE_DIRECTORY_ENTRY_EXCEPTION); // section may be renamed or merged
+	uint64_t count = directory.Size / sizeof (RUNTIME_FUNCTION);
+	uint64_t fileOffset;
+	if (directory.VirtualAddress == 0 || count == 0 || view.rvaToOffset (directory.VirtualAddress, count * sizeof (RUNTIME_FUNCTION), fileOffset) != peError::OK)
 	{
-		if (!ReadProcessMemory (processHandle, (LPCVOID) addrToRead, (uint8_t *) pdataEntries.data(), size, NULL))
-		{
-			log ("Cannot read .pdata contents from module to get functions start and end addresses\n", logType::ERR, stdoutHandle);
-			throw std::exception ();
-		}
+		return {};
 	}
-	else
+	return file.spanAt<RUNTIME_FUNCTION> (fileOffset, count);
+}
+std::vector <RUNTIME_FUNCTION> PEparser::getPdataEntries ()
+{
+	if (!virtualMode)
 	{
-		fseek (f, addrToRead ,0);
-		if (fread (pdataEntries.data(), 1, size, f) != size)
-		{
-			log ("Cannot read .pdata contents from file to get functions start and end addresses\n", logType::ERR, stdoutHandle);
-			throw std::exception ();
-		}
+		dataSpan<RUNTIME_FUNCTION> pdata = getPdataView ();
+		return std::vector <RUNTIME_FUNCTION> (pdata.begin(), pdata.end());
+	}
+	IMAGE_DATA_DIRECTORY directory = getDataDirectory (IMAGE_DIRECTORY_ENTRY_EXCEPTION);
+	uint64_t count = directory.Size / sizeof (RUNTIME_FUNCTION);
+	std::vector <uint8_t> storage;
+	const uint8_t * data;
+	if (directory.VirtualAddress == 0 || count == 0 || !readRVA (directory.VirtualAddress, count * sizeof (RUNTIME_FUNCTION), storage, data))
+	{
+		return {}; // module without exception directory (or with unreadable one) has no function ranges
 	}
+	std::vector <RUNTIME_FUNCTION> pdataEntries (count);
+	memcpy (pdataEntries.data(), data, count * sizeof (RUNTIME_FUNCTION));
 	return pdataEntries;
 }
-uint8_t * PEparser::readDataFromDirectory (uint32_t index, uint64_t & address, uint32_t & size)
+std::map <std::string, std::vector<uint64_t> > PEparser::getFunctionAddressesFromIAT ()
 {
-	uint32_t directoryCount = ((IMAGE_NT_HEADERS64 *) ntHeaders)->OptionalHeader.NumberOfRvaAndSizes;
-	if (index < 0 && index < directoryCount)
+	std::map <std::string, std::vector<uint64_t> > toRet;
+
+	if (!virtualMode) 
 	{
-		log ("Directory index invalid \n", logType::ERR, stdoutHandle);
-		return NULL;
+		log ("Cannot parse import names from file \n", logType::UNKNOWN_EVENT, stdoutHandle);
+		return toRet; 
 	}
-
-	IMAGE_DATA_DIRECTORY dataDirectory = ((IMAGE_NT_HEADERS64 *) ntHeaders)->OptionalHeader.DataDirectory[index];
-	if (dataDirectory.VirtualAddress == 0)
+	IMAGE_DATA_DIRECTORY directory = getDataDirectory (IMAGE_DIRECTORY_ENTRY_IMPORT);
+	std::vector <uint8_t> directoryStorage;
+	const uint8_t * directoryData;
+	if (directory.VirtualAddress == 0 || !readRVA (directory.VirtualAddress, directory.Size, directoryStorage, directoryData))
 	{
-		log ("Directory nr %i is not used \n", logType::ERR, stdoutHandle, index);
-		return NULL; // PE has no import table ???
+		return toRet;
 	}
 
-	address = (uint64_t) baseAddress + dataDirectory.VirtualAddress;
-	size = dataDirectory.Size;
-
-	uint8_t * data = new uint8_t [size];
-
-	if (!ReadProcessMemory (processHandle, (LPCVOID) address, data, size, NULL ))
+	uint32_t thunkSize = wow64 ? sizeof (uint32_t) : sizeof (uint64_t);
+	for (uint32_t i = 0; (i + 1) * sizeof (IMAGE_IMPORT_DESCRIPTOR) <= directory.Size; i++)
 	{
-		log ("Cannot read Import Data\n", logType::ERR, stdoutHandle);
-		return nullptr;
+		IMAGE_IMPORT_DESCRIPTOR descriptor;
+		memcpy (&descriptor, directoryData + i * sizeof (IMAGE_IMPORT_DESCRIPTOR), sizeof (descriptor));
+		if (descriptor.Name == 0)
+		{
+			break;
+		}
+		std::vector <uint8_t> nameStorage;
+		const uint8_t * name;
+		if (!readRVA (descriptor.Name, MAX_EXPORT_NAME_LENGTH, nameStorage, name))
+		{
+			continue;
+		}
+		std::string moduleName ((const char *) name, strnlen ((const char *) name, MAX_EXPORT_NAME_LENGTH));
+
+		// IAT is read in chunks, it ends with zero thunk
+		std::vector <uint8_t> thunkStorage;
+		const uint8_t * thunks;
+		uint32_t chunk = IAT_READ_CHUNK;
+		uint32_t j = 0;
+		while (j < MAX_IMPORTS_PER_MODULE)
+		{
+			if (!readRVA (descriptor.FirstThunk + (uint64_t) j * thunkSize, chunk * thunkSize, thunkStorage, thunks))
+			{
+				if (chunk == 1)
+				{
+					break;
+				}
+				chunk = 1; // chunk crosses end of readable memory, go on thunk by thunk
+				continue;
+			}
+			uint32_t k = 0;
+			for (; k < chunk; k++)
+			{
+				uint64_t thunk = 0;
+				memcpy (&thunk, thunks + k * thunkSize, thunkSize);
+				if (thunk == 0)
+				{
+					break;
+				}
+				toRet[moduleName].push_back (thunk);
+			}
+			if (k < chunk)
+			{
+				break;
+			}
+			j += chunk;
+		}
 	}
-	return data;
+	return toRet;
 }
-uint8_t * PEparser::getPEMemory ()
+IMAGE_DATA_DIRECTORY PEparser::getDataDirectory (uint32_t index)
 {
-	if (!virtualMode)
+	return view.getDirectory (index);
+}
+bool PEparser::readRVA (uint64_t rva, uint64_t size, std::vector <uint8_t> & storage, const uint8_t * & data)
+{
+	if (virtualMode)
 	{
-		log ("Cannot get PE memory from file \n", logType::UNKNOWN_EVENT, stdoutHandle);
-		return nullptr;
+		if (size > MAX_VIRTUAL_READ_SIZE || rva + size > getSizeOfImage ())
+		{
+			return false;
+		}
+		storage.resize (size);
+		if (!ReadProcessMemory (processHandle, (LPCVOID) ((uint64_t) baseAddress + rva), storage.data(), size, NULL))
+		{
+			return false;
+		}
+		data = storage.data();
+		return true;
 	}
-	uint64_t PEsize = getPESizeInMemory();
-	uint8_t * PE = new uint8_t [PEsize];
-	if (!ReadProcessMemory (processHandle, (LPCVOID) baseAddress, PE, PEsize, NULL ))
+	uint64_t fileOffset;
+	if (!rvaToFileOffset (rva, fileOffset))
 	{
-		log ("Cannot read whole PE memory \n", logType::ERR, stdoutHandle);
-		return nullptr;
+		return false;
 	}
-	return PE;
+	data = file.at (fileOffset, size); // file mode needs no copy
+	return data != nullptr;
 }
-uint64_t PEparser::getPESizeInMemory ()
+relocationTable PEparser::getRelocationTable ()
 {
-	if (!virtualMode)
+	IMAGE_DATA_DIRECTORY directory = getDataDirectory (IMAGE_DIRECTORY_ENTRY_BASERELOC);
+	std::vector <uint8_t> storage;
+	const uint8_t * data;
+	if (directory.VirtualAddress == 0 || directory.Size == 0 || !readRVA (directory.VirtualAddress, directory.Size, storage, data))
 	{
-		return 0;
+		return relocationTable ();
 	}
-	uint64_t toRet = ((IMAGE_NT_HEADERS64 *) ntHeaders)->OptionalHeader.SectionAlignment; // for first page of memory (headers)
-	std::vector<IMAGE_SECTION_HEADER> sections = getSectionsVirtual ();
-	for (const auto & i : sections)
+	return relocationTable (data, directory.Size);
+}
+bool PEparser::getCodeViewInfo (codeViewInfo & info)
+{
+	IMAGE_DATA_DIRECTORY directory = getDataDirectory (IMAGE_DIRECTORY_ENTRY_DEBUG);
+	std::vector <uint8_t> directoryStorage;
+	const uint8_t * directoryData;
+	if (directory.VirtualAddress == 0 || !readRVA (directory.VirtualAddress, directory.Size, directoryStorage, directoryData))
 	{
-		toRet += alignMemoryPageSize(i.Misc.VirtualSize);
+		return false;
 	}
-	return toRet;
+	for (uint32_t i = 0; i < directory.Size / sizeof (IMAGE_DEBUG_DIRECTORY); i++)
+	{
+		IMAGE_DEBUG_DIRECTORY entry;
+		memcpy (&entry, directoryData + i * sizeof (IMAGE_DEBUG_DIRECTORY), sizeof (entry));
+		// RSDS signature, GUID, age, null terminated path
+		if (entry.Type != IMAGE_DEBUG_TYPE_CODEVIEW || entry.SizeOfData <= 24 || entry.SizeOfData > MAX_CODEVIEW_SIZE || entry.AddressOfRawData == 0)
+		{
+			continue;
+		}
+		std::vector <uint8_t> storage;
+		const uint8_t * data;
+		uint32_t signature;
+		if (!readRVA (entry.AddressOfRawData, entry.SizeOfData, storage, data))
+		{
+			continue;
+		}
+		memcpy (&signature, data, sizeof (signature));
+		if (signature != CODEVIEW_RSDS_SIGNATURE)
+		{
+			continue;
+		}
+		memcpy (info.guid, data + 4, sizeof (info.guid));
+		memcpy (&info.age, data + 20, sizeof (info.age));
+		info.pdbPath = std::string ((const char *) data + 24, strnlen ((const char *) data + 24, entry.SizeOfData - 24));
+		return true;
+	}
+	return false;
 }
-std::map <std::string, std::vector<uint64_t> > PEparser::getFunctionAddressesFromIAT ()
+exportTable PEparser::getExportTable ()
 {
-	std::map <std::string, std::vector<uint64_t> > toRet;
-
-	if (!virtualMode) 
+	IMAGE_DATA_DIRECTORY directory = getDataDirectory (IMAGE_DIRECTORY_ENTRY_EXPORT);
+	if (directory.VirtualAddress == 0 || directory.Size < sizeof (IMAGE_EXPORT_DIRECTORY))
 	{
-		log ("Cannot parse import names from file \n", logType::UNKNOWN_EVENT, stdoutHandle);
-		return toRet; 
+		return exportTable ();
 	}
-	uint8_t * PEmemory = getPEMemory ();
-	if (PEmemory == nullptr)
+	// whole export directory (with tables and names produced by linkers) is read at once
+	std::vector <uint8_t> directoryStorage;
+	const uint8_t * directoryData;
+	if (!readRVA (directory.VirtualAddress, directory.Size, directoryStorage, directoryData))
 	{
-		return toRet;
+		log ("Cannot read export directory\n", logType::ERR, stdoutHandle);
+		return exportTable ();
 	}
-
-	uint64_t address;
-	uint32_t size;
-	uint8_t * importData = readDataFromDirectory (IMAGE_DIRECTORY_ENTRY_IMPORT, address, size);
-	if (importData == NULL)
+	auto insideDirectory = [&] (uint64_t rva, uint64_t size) 
 	{
-		return toRet;
-	}
-
-	IMAGE_IMPORT_DESCRIPTOR * dllImported = (IMAGE_IMPORT_DESCRIPTOR *) importData;
-
-	for (int i = 0; dllImported[i].Name != 0; i++)
+		return rva >= directory.VirtualAddress && size <= directory.Size && rva - directory.VirtualAddress <= directory.Size - size;
+	};
+	auto view = [&] (uint64_t rva, uint64_t size, std::vector <uint8_t> & storage) -> const uint8_t *
 	{
-		uint32_t nameOffset = dllImported[i].Name;
-		const char * moduleName = (const char *) (PEmemory + nameOffset);
-		std::string moduleNameStr (moduleName);
-
-		uint32_t IAToffset = dllImported[i].FirstThunk;
-		uint64_t * IATpointer = (uint64_t *) (IAToffset + (uint64_t) PEmemory);
+		if (insideDirectory (rva, size))
+		{
+			return directoryData + (rva - directory.VirtualAddress);
+		}
+		const uint8_t * data; // tables placed outside of directory, read them separately
+		return readRVA (rva, size, storage, data) ? data : nullptr;
+	};
 
-		for (int j = 0; IATpointer[j] != 0; j++)
+	std::vector <char> pool;
+	auto addString = [&] (uint64_t rva) -> uint32_t
+	{
+		const char * str;
+		size_t maxLength;
+		std::vector <uint8_t> storage;
+		if (insideDirectory (rva, 1))
 		{
-			toRet[moduleNameStr].push_back (IATpointer[j]);
+			str = (const char *) directoryData + (rva - directory.VirtualAddress);
+			maxLength = directory.VirtualAddress + directory.Size - rva;
 		}
-	}
+		else
+		{
+			const uint8_t * data;
+			if (!readRVA (rva, MAX_EXPORT_NAME_LENGTH, storage, data))
+			{
+				return exportTable::NO_NAME;
+			}
+			str = (const char *) data;
+			maxLength = MAX_EXPORT_NAME_LENGTH;
+		}
+		uint32_t offset = pool.size();
+		pool.insert (pool.end(), str, str + strnlen (str, maxLength));
+		pool.push_back ('\0');
+		return offset;
+	};
 
-	delete [] importData;
-	delete [] PEmemory;
-	return toRet;
-}
-void PEparser::parseExportFunctionsVirtual ()
-{
-	if (!virtualMode) 
+	const IMAGE_EXPORT_DIRECTORY * exportDirectory = (const IMAGE_EXPORT_DIRECTORY *) directoryData;
+	uint32_t functionCount = exportDirectory->NumberOfFunctions;
+	uint32_t nameCount = exportDirectory->NumberOfNames;
+	if (functionCount > 0x10000 || nameCount > 0x10000) // ordinals are 16 bit
 	{
-		log ("Cannot parse export names from file \n", logType::UNKNOWN_EVENT, stdoutHandle);
-		return; 
+		log ("Export directory has invalid number of functions (%u) or names (%u)\n", logType::ERR, stdoutHandle, functionCount, nameCount);
+		return exportTable ();
 	}
-	uint64_t address;
-	uint32_t size;
-	uint8_t * exportData = readDataFromDirectory (IMAGE_DIRECTORY_ENTRY_EXPORT, address, size);
-	if (exportData == NULL)
+
+	std::vector <uint8_t> functionsStorage, namesStorage, ordinalsStorage;
+	const uint32_t * functions = (const uint32_t *) view (exportDirectory->AddressOfFunctions, functionCount * sizeof (uint32_t), functionsStorage);
+	const uint32_t * names = (const uint32_t *) view (exportDirectory->AddressOfNames, nameCount * sizeof (uint32_t), namesStorage);
+	const uint16_t * ordinals = (const uint16_t *) view (exportDirectory->AddressOfNameOrdinals, nameCount * sizeof (uint16_t), ordinalsStorage);
+	if (functions == nullptr || (nameCount > 0 && (names == nullptr || ordinals == nullptr)))
 	{
-		return;
+		log ("Cannot read export address, name or ordinal table\n", logType::ERR, stdoutHandle);
+		return exportTable ();
 	}
 
-	uint32_t functionNumber = ((IMAGE_EXPORT_DIRECTORY *)exportData)->NumberOfFunctions;
-	uint32_t nameNumber = ((IMAGE_EXPORT_DIRECTORY *)exportData)->NumberOfNames;
-
-	uint32_t functionAddressesOffset = ((IMAGE_EXPORT_DIRECTORY *)exportData)->AddressOfFunctions - (address - (uint64_t) baseAddress);
-	uint32_t functionNamesOffset = ((IMAGE_EXPORT_DIRECTORY *)exportData)->AddressOfNames - (address - (uint64_t) baseAddress);
-	uint32_t functionOrdinalsOffset = ((IMAGE_EXPORT_DIRECTORY *)exportData)->AddressOfNameOrdinals - (address - (uint64_t) baseAddress);
-	
-	int i = functionAddressesOffset;
-	int j = functionNamesOffset;
-	int k = functionOrdinalsOffset;
-	uint32_t base = ((IMAGE_EXPORT_DIRECTORY *)exportData)->Base;
-	int l = ((IMAGE_EXPORT_DIRECTORY *)exportData)->Base;
-
-	uint32_t functionAddressesEndOffset = (functionNumber * sizeof (uint32_t) + functionAddressesOffset);
-
-	for (;i < functionAddressesEndOffset ; i += sizeof (uint32_t))
+	std::vector <exportEntry> entries (functionCount);
+	for (uint32_t i = 0; i < functionCount; i++)
 	{
-		bool isForwared = false;
-		uint64_t addr = *((uint32_t *)(exportData + i)) + (uint64_t) baseAddress;
-
-		// if func pointer points into export data then it is forwarded
-
-		uint32_t nameOffset = (*((uint32_t *)(exportData + j)) - (address - (uint64_t) baseAddress));
-		char * name = (char *)((uint32_t) nameOffset + (uint64_t) exportData);
-		uint16_t ordinalToName = *((uint32_t *)(exportData + k));
-
-		if ( (addr - (uint64_t) baseAddress) >= (address - (uint64_t) baseAddress) &&
-			 (addr - (uint64_t) baseAddress) < (address + size - (uint64_t) baseAddress)) 
+		entries[i] = { functions[i], exportTable::NO_NAME, exportTable::NO_NAME, (uint16_t) (exportDirectory->Base + i) };
+		if (insideDirectory (functions[i], 1)) // if func pointer points into export data then it is forwarded
 		{
-			isForwared = true;
-			printf ("Ordinal [%i] forwarded to %s \n", ordinalToName + base, (char *) addr );
+			entries[i].forwarderOffset = addString (functions[i]);
+			entries[i].rva = 0;
 		}
-
-		printf ("%.16llx --> %s ordinal [%i] \n", addr, ((ordinalToName + base) == l ? name : "Ordinal Only"), l);
-		if (ordinalToName + base == l)
+	}
+	// name table is parallel to ordinal table, ordinal table holds index into address table (unbiased ordinal)
+	for (uint32_t i = 0; i < nameCount; i++)
+	{
+		uint16_t functionIndex = ordinals[i];
+		if (functionIndex < functionCount && entries[functionIndex].nameOffset == exportTable::NO_NAME)
 		{
-			j+= sizeof (uint32_t);
-			k+= sizeof (uint16_t);
+			entries[functionIndex].nameOffset = addString (names[i]);
 		}
-		l++;
 	}
-	delete [] exportData;
-}
\ No newline at end of file
+	entries.erase (std::remove_if (entries.begin(), entries.end(), [] (const exportEntry & e) 
+	{
+		return e.rva == 0 && e.forwarderOffset == exportTable::NO_NAME; // unused ordinal
+	}), entries.end());
+
+	std::string moduleName = "?";
+	uint32_t moduleNameOffset = addString (exportDirectory->Name);
+	if (moduleNameOffset != exportTable::NO_NAME)
+	{
+		moduleName = pool.data() + moduleNameOffset;
+	}
+	return exportTable (moduleName, std::move (entries), std::move (pool));
+}
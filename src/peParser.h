@@ -7,6 +7,10 @@
 
 #include "utils.h"
 #include "structs.h"
+#include "mappedFile.h"
+#include "exportTable.h"
+#include "relocationTable.h"
+#include "peView.h"
 
 struct section
 {
@@ -15,6 +19,13 @@ struct section
 	std::string name;
 };
 
+struct codeViewInfo // RSDS record of debug directory, identifies matching .pdb
+{
+	uint8_t guid [16];
+	uint32_t age;
+	std::string pdbPath;
+};
+
 class PEparser 
 {
 	private:
@@ -25,54 +36,68 @@ class PEparser
 	HANDLE stdoutHandle;
 	HANDLE processHandle;
 
-	uint8_t ntHeaders [sizeof(IMAGE_NT_HEADERS64)];
+	uint8_t ntHeaders [sizeof(IMAGE_NT_HEADERS64)] = {};
+	peError error = peError::OK; // constructors do not throw, every getter of invalid parser returns zero or empty
 
 	int wow64 = false;
-	int nSections;
 	bool virtualMode = false;
-	uint64_t sectionsHeadersOffset;
-
-	FILE * f;
 
-	void * getPEstructureVirtual ();
-	uint32_t getPEstructureFile ();
-	
-	void checkArchVirtual ();
-	void checkArchFile ();
-
-	void readPEheaderVirtual ();
-	void readPEheaderFile ();
+	mappedFile file; // whole PE file mapped read only, headers are parsed once
+	std::vector <uint8_t> headerStorage; // virtual mode, copy of header pages
+	peView view; // validated headers over file mapping or headerStorage
+	std::vector<IMAGE_SECTION_HEADER> sectionHeaders; // cached at construction for both modes
 
-	std::vector<IMAGE_SECTION_HEADER> getSectionsVirtual ();
-	std::vector<IMAGE_SECTION_HEADER> getSectionsFile ();
+	bool readHeadersVirtual ();
+	void loadHeaders ();
 	
 	bool isAddrInSection (uint64_t, IMAGE_SECTION_HEADER *);
-	IMAGE_SECTION_HEADER getEntryPointSection ();
-
-	uint8_t * readDataFromDirectory (uint32_t, uint64_t &, uint32_t &);
-	uint64_t getPESizeInMemory ();
-	uint8_t * getPEMemory ();
+	bool getEntryPointSection (IMAGE_SECTION_HEADER &);
+
+	static constexpr uint32_t MAX_EXPORT_NAME_LENGTH = 256;
+	static constexpr uint32_t CODEVIEW_RSDS_SIGNATURE = 0x53445352; // "RSDS"
+	static constexpr uint32_t MAX_CODEVIEW_SIZE = 0x1000;
+	static constexpr uint32_t PAGE_SIZE = 0x1000;
+	static constexpr uint32_t MAX_VIRTUAL_HEADERS_SIZE = 0x2000; // enough for any e_lfanew in first page and 96 sections
+	static constexpr uint64_t MAX_VIRTUAL_READ_SIZE = 0x4000000; // directory sizes come from untrusted headers
+	static constexpr uint32_t MAX_IMPORTS_PER_MODULE = 0x10000;
+	static constexpr uint32_t IAT_READ_CHUNK = 64;
+
+	IMAGE_DATA_DIRECTORY getDataDirectory (uint32_t);
+	bool readRVA (uint64_t, uint64_t, std::vector <uint8_t> &, const uint8_t * &); // file mode points into mapping, virtual mode reads into storage
 	
 	public:
 	PEparser (HANDLE, uint64_t); // in virtual memory
 	PEparser (std::string); // exe file
 
+	bool isValid () { return error == peError::OK; }
+	peError getError () { return error; }
+
 	void * getEntryPoint (); 
 	uint64_t getCoffSymbolTableOffset (); 
 	uint32_t getCoffSymbolNumber (); 
 	uint64_t getCoffExtendedNamesOffset ();
-	std::vector <COFFentry> getCoffEntries ();
-	std::unique_ptr<uint8_t []> getCoffExtendedNames ();
-	uint64_t getSectionAddressForIndex (int);
+	dataSpan<COFFentry> getCoffEntries (); // file mode only, spans point into mapped file, empty when table is not inside file
+	dataSpan<uint8_t> getCoffStringTable ();
+	dataSpan<RUNTIME_FUNCTION> getPdataView (); // exception directory, empty when there is none
+	dataSpan<IMAGE_SECTION_HEADER> getSectionHeaders ();
+	bool rvaToFileOffset (uint64_t, uint64_t &);
+	uint64_t getSectionAddressForIndex (int); // 0 for invalid index
 	uint32_t getNumberOfSections ();
+	uint32_t getTimeDateStamp ();
+	uint32_t getSizeOfImage ();
+	uint64_t getImageBase ();
+	uint32_t getCheckSum ();
+	dataSpan<uint8_t> getFileView (); // whole mapped file
 
 	std::string getSectionNameForAddress (uint64_t); 
 
 	void showSections ();
 	std::map <uint64_t, section> getPESections ();
 	uint64_t fileOffsetToVirtualAddress (uint64_t); 
-	std::vector <RUNTIME_FUNCTION> getPdataEntries ();
+	std::vector <RUNTIME_FUNCTION> getPdataEntries (); // works in both modes, empty when there is no exception directory
 
-	void parseExportFunctionsVirtual ();
+	exportTable getExportTable (); // works in both modes
+	bool getCodeViewInfo (codeViewInfo &);
+	relocationTable getRelocationTable (); // works in both modes
 	std::map <std::string, std::vector<uint64_t> > getFunctionAddressesFromIAT ();
 };
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "peView.h"
+#include <algorithm>
+#include <stddef.h>
+
+static constexpr uint16_t DOS_SIGNATURE = 0x5A4D; // MZ
+static constexpr uint32_t NT_SIGNATURE = 0x00004550; // PE\0\0
+static constexpr uint16_t MACHINE_AMD64 = 0x8664;
+static constexpr uint16_t MACHINE_I386 = 0x014C;
+static constexpr uint16_t OPTIONAL_MAGIC_64 = 0x20B;
+static constexpr uint16_t OPTIONAL_MAGIC_32 = 0x10B;
+static constexpr uint32_t FILE_HEADER_OFFSET = 4;
+static constexpr uint32_t OPTIONAL_HEADER_OFFSET = 24;
+static constexpr uint32_t SIZE_OF_HEADERS_OFFSET = 60; // same in both optional header variants
+static constexpr uint32_t RAW_DATA_ALIGNMENT = 0x200; // loader rounds PointerToRawData down to this
+
+const char * peErrorToString (peError error)
+{
+	switch (error)
+	{
+		case peError::OK: return "no error";
+		case peError::TRUNCATED: return "headers truncated";
+		case peError::BAD_DOS_SIGNATURE: return "invalid DOS signature";
+		case peError::BAD_LFANEW: return "invalid e_lfanew";
+		case peError::BAD_PE_SIGNATURE: return "invalid PE signature";
+		case peError::UNSUPPORTED_MACHINE: return "unsupported machine";
+		case peError::BAD_OPTIONAL_HEADER: return "invalid optional header";
+		case peError::TOO_MANY_SECTIONS: return "too many sections";
+		case peError::BAD_SECTION_TABLE: return "section table outside of headers";
+		case peError::BAD_RVA: return "RVA outside of file";
+		case peError::UNREADABLE: return "file or memory cannot be read";
+		default: return "unknown error";
+	}
+}
+peError peView::parse (dataSpan<uint8_t> data, bool imageLayout)
+{
+	*this = peView ();
+	bytes = data;
+	this->imageLayout = imageLayout;
+
+	IMAGE_DOS_HEADER dosHeader;
+	if (!readAt (0, dosHeader))
+	{
+		return peError::TRUNCATED;
+	}
+	if (dosHeader.e_magic != DOS_SIGNATURE)
+	{
+		return peError::BAD_DOS_SIGNATURE;
+	}
+	if (dosHeader.e_lfanew < 0 || (uint32_t) dosHeader.e_lfanew > MAX_LFANEW)
+	{
+		return peError::BAD_LFANEW;
+	}
+	ntHeadersOffset = dosHeader.e_lfanew;
+
+	uint32_t signature;
+	IMAGE_FILE_HEADER fileHeader;
+	if (!readAt (ntHeadersOffset, signature) || !readAt (ntHeadersOffset + FILE_HEADER_OFFSET, fileHeader))
+	{
+		return peError::TRUNCATED;
+	}
+	if (signature != NT_SIGNATURE)
+	{
+		return peError::BAD_PE_SIGNATURE;
+	}
+	if (fileHeader.Machine != MACHINE_AMD64 && fileHeader.Machine != MACHINE_I386)
+	{
+		return peError::UNSUPPORTED_MACHINE;
+	}
+	is64 = fileHeader.Machine == MACHINE_AMD64;
+
+	// data directories are last member of both optional header variants
+	uint64_t optionalHeader = (uint64_t) ntHeadersOffset + OPTIONAL_HEADER_OFFSET;
+	uint32_t directoriesStart = is64 ? offsetof (IMAGE_OPTIONAL_HEADER64, DataDirectory) : offsetof (IMAGE_OPTIONAL_HEADER32, DataDirectory);
+	uint16_t magic;
+	uint32_t declaredDirectoryCount;
+	if (fileHeader.SizeOfOptionalHeader < directoriesStart)
+	{
+		return peError::BAD_OPTIONAL_HEADER;
+	}
+	if (!readAt (optionalHeader, magic) || !readAt (optionalHeader + directoriesStart - sizeof (uint32_t), declaredDirectoryCount) ||
+		!readAt (optionalHeader + SIZE_OF_HEADERS_OFFSET, sizeOfHeaders) || optionalHeader + fileHeader.SizeOfOptionalHeader > bytes.size())
+	{
+		return peError::TRUNCATED;
+	}
+	if (magic != (is64 ? OPTIONAL_MAGIC_64 : OPTIONAL_MAGIC_32))
+	{
+		return peError::BAD_OPTIONAL_HEADER;
+	}
+	ntHeadersSize = OPTIONAL_HEADER_OFFSET + fileHeader.SizeOfOptionalHeader;
+	directoriesOffset = optionalHeader + directoriesStart;
+	directoryCount = std::min <uint32_t> ({ declaredDirectoryCount, (uint32_t) IMAGE_NUMBEROF_DIRECTORY_ENTRIES,
+		(uint32_t) ((fileHeader.SizeOfOptionalHeader - directoriesStart) / sizeof (IMAGE_DATA_DIRECTORY)) });
+
+	// section table follows optional header of declared size, not of structure size
+	if (fileHeader.NumberOfSections > MAX_SECTIONS)
+	{
+		return peError::TOO_MANY_SECTIONS;
+	}
+	uint64_t sectionTable = optionalHeader + fileHeader.SizeOfOptionalHeader;
+	uint64_t sectionTableSize = (uint64_t) fileHeader.NumberOfSections * sizeof (IMAGE_SECTION_HEADER);
+	if (sectionTable + sectionTableSize > bytes.size())
+	{
+		return peError::BAD_SECTION_TABLE;
+	}
+	sections = { (const IMAGE_SECTION_HEADER *) (bytes.data + sectionTable), fileHeader.NumberOfSections };
+	return peError::OK;
+}
+IMAGE_DATA_DIRECTORY peView::getDirectory (uint32_t index) const
+{
+	IMAGE_DATA_DIRECTORY directory = {0, 0};
+	if (index < directoryCount)
+	{
+		readAt (directoriesOffset + index * sizeof (IMAGE_DATA_DIRECTORY), directory);
+	}
+	return directory;
+}
+peError peView::rvaToOffset (uint64_t rva, uint64_t size, uint64_t & offset) const
+{
+	uint64_t end = rva + size;
+	if (end < rva)
+	{
+		return peError::BAD_RVA;
+	}
+	if (imageLayout || end <= std::min <uint64_t> (sizeOfHeaders, bytes.size()))
+	{
+		offset = rva;
+		return end <= bytes.size() ? peError::OK : peError::BAD_RVA;
+	}
+	for (const auto & section : sections)
+	{
+		uint64_t start = section.VirtualAddress;
+		uint64_t rawSize = section.SizeOfRawData;
+		if (rva >= start && rva < start + rawSize)
+		{
+			uint64_t rawStart = section.PointerToRawData & ~(uint64_t) (RAW_DATA_ALIGNMENT - 1);
+			offset = rva - start + rawStart;
+			if (end > start + rawSize || offset + size > bytes.size())
+			{
+				return peError::BAD_RVA;
+			}
+			return peError::OK;
+		}
+	}
+	return peError::BAD_RVA;
+}
+peError peView::getRVA (uint64_t rva, uint64_t size, dataSpan<uint8_t> & data) const
+{
+	uint64_t offset;
+	peError error = rvaToOffset (rva, size, offset);
+	if (error == peError::OK)
+	{
+		data = { bytes.data + offset, (size_t) size };
+	}
+	return error;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "peFormat.h"
+#include "dataSpan.h"
+
+// Non-throwing, allocation free validation of PE headers over a byte span.
+// Every header field used for addressing is checked against the span before it is trusted,
+// errors are reported as peError codes so callers decide whether to log, throw or just count them.
+
+enum class peError : uint8_t
+{
+	OK = 0,
+	TRUNCATED,
+	BAD_DOS_SIGNATURE,
+	BAD_LFANEW,
+	BAD_PE_SIGNATURE,
+	UNSUPPORTED_MACHINE,
+	BAD_OPTIONAL_HEADER,
+	TOO_MANY_SECTIONS,
+	BAD_SECTION_TABLE,
+	BAD_RVA,
+	UNREADABLE,
+	COUNT
+};
+const char * peErrorToString (peError);
+
+class peView
+{
+	private:
+		static constexpr uint32_t MAX_SECTIONS = 96; // limit of Windows loader
+		static constexpr uint32_t MAX_LFANEW = 0x10000000;
+
+		dataSpan<uint8_t> bytes;
+		bool imageLayout = false; // bytes are mapped image (RVA == offset), not file
+		bool is64 = false;
+		uint32_t ntHeadersOffset = 0;
+		uint32_t ntHeadersSize = 0; // signature, file header and optional header as declared by SizeOfOptionalHeader
+		uint32_t sizeOfHeaders = 0;
+		uint32_t directoryCount = 0; // clamped to what optional header really holds
+		uint64_t directoriesOffset = 0;
+		dataSpan<IMAGE_SECTION_HEADER> sections;
+
+		template <class T> bool readAt (uint64_t offset, T & value) const
+		{
+			if (offset > bytes.size() || sizeof (T) > bytes.size() - offset)
+			{
+				return false;
+			}
+			memcpy (&value, bytes.data + offset, sizeof (T));
+			return true;
+		}
+	public:
+		peError parse (dataSpan<uint8_t>, bool imageLayout);
+
+		bool isPE64 () const { return is64; }
+		uint32_t getNtHeadersOffset () const { return ntHeadersOffset; }
+		dataSpan<uint8_t> getNtHeaders () const { return { bytes.data + ntHeadersOffset, ntHeadersSize }; }
+		dataSpan<IMAGE_SECTION_HEADER> getSections () const { return sections; }
+		IMAGE_DATA_DIRECTORY getDirectory (uint32_t) const; // {0, 0} for missing directory
+
+		peError rvaToOffset (uint64_t, uint64_t, uint64_t &) const; // [rva, rva + size) has to lie in one section
+		peError getRVA (uint64_t, uint64_t, dataSpan<uint8_t> &) const;
+};
@@ -0,0 +1,97 @@
+#include "relocationTable.h"
+#include <algorithm>
+#include <string.h>
+
+relocationTable::relocationTable (const uint8_t * data, uint32_t size)
+{
+	std::vector <std::pair <uint32_t, std::vector <uint16_t> > > pages;
+	uint32_t offset = 0;
+	while (offset + sizeof (IMAGE_BASE_RELOCATION) <= size)
+	{
+		IMAGE_BASE_RELOCATION block;
+		memcpy (&block, data + offset, sizeof (block));
+		if (block.SizeOfBlock < sizeof (IMAGE_BASE_RELOCATION) || block.SizeOfBlock > size - offset)
+		{
+			break; // corrupted block, keep what was parsed so far
+		}
+		uint32_t entryCount = (block.SizeOfBlock - sizeof (IMAGE_BASE_RELOCATION)) / sizeof (uint16_t);
+		std::vector <uint16_t> pageSlots;
+		for (uint32_t i = 0; i < entryCount; i++)
+		{
+			uint16_t entry;
+			memcpy (&entry, data + offset + sizeof (IMAGE_BASE_RELOCATION) + i * sizeof (uint16_t), sizeof (entry));
+			uint8_t type = entry >> 12;
+			if (type == IMAGE_REL_BASED_DIR64 || type == IMAGE_REL_BASED_HIGHLOW)
+			{
+				pageSlots.push_back (entry);
+			}
+		}
+		if (!pageSlots.empty())
+		{
+			pages.emplace_back (block.VirtualAddress & ~(PAGE_SIZE - 1), std::move (pageSlots));
+		}
+		offset += block.SizeOfBlock;
+	}
+
+	// linkers emit pages in order, but one page can appear in more blocks
+	std::stable_sort (pages.begin(), pages.end(), [] (const auto & a, const auto & b) { return a.first < b.first; });
+	for (auto & page : pages)
+	{
+		if (pageRVAs.empty() || pageRVAs.back() != page.first)
+		{
+			pageRVAs.push_back (page.first);
+			pageFirst.push_back (slots.size());
+		}
+		slots.insert (slots.end(), page.second.begin(), page.second.end());
+	}
+	pageFirst.push_back (slots.size());
+	for (size_t i = 0; i < pageRVAs.size(); i++)
+	{
+		auto compareOffset = [] (uint16_t a, uint16_t b) { return (a & 0xFFF) < (b & 0xFFF); };
+		std::sort (slots.begin() + pageFirst[i], slots.begin() + pageFirst[i + 1], compareOffset);
+	}
+}
+size_t relocationTable::findPage (uint32_t rva) const
+{
+	uint32_t page = rva & ~(PAGE_SIZE - 1);
+	auto it = std::lower_bound (pageRVAs.begin(), pageRVAs.end(), page);
+	if (it == pageRVAs.end() || *it != page)
+	{
+		return pageRVAs.size();
+	}
+	return it - pageRVAs.begin();
+}
+dataSpan<uint16_t> relocationTable::getPage (uint32_t rva) const
+{
+	size_t page = findPage (rva);
+	if (page == pageRVAs.size())
+	{
+		return {};
+	}
+	return { slots.data() + pageFirst[page], pageFirst[page + 1] - pageFirst[page] };
+}
+uint32_t relocationTable::getPointerSlotWidth (uint32_t rva) const
+{
+	dataSpan<uint16_t> page = getPage (rva);
+	uint16_t offset = rva & (PAGE_SIZE - 1);
+	auto it = std::lower_bound (page.begin(), page.end(), offset, [] (uint16_t slot, uint16_t v) { return (slot & 0xFFF) < v; });
+	return it != page.end() && (*it & 0xFFF) == offset ? getSlotWidth (*it) : 0;
+}
+std::vector <relocationSlot> relocationTable::getSlotsInRange (uint32_t start, uint32_t end) const
+{
+	std::vector <relocationSlot> toRet;
+	auto it = std::lower_bound (pageRVAs.begin(), pageRVAs.end(), start & ~(PAGE_SIZE - 1));
+	for (; it != pageRVAs.end() && *it < end; ++it)
+	{
+		size_t page = it - pageRVAs.begin();
+		for (uint32_t i = pageFirst[page]; i < pageFirst[page + 1]; i++)
+		{
+			uint32_t rva = *it + (slots[i] & 0xFFF);
+			if (rva >= start && rva < end)
+			{
+				toRet.push_back ({ rva, getSlotWidth (slots[i]) });
+			}
+		}
+	}
+	return toRet;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <windows.h>
+#include <vector>
+#include <inttypes.h>
+
+#include "utils.h"
+
+// Base relocations of one image kept per 4 KB page: sorted page RVAs, each with its sorted slot offsets.
+// Only slots holding absolute addresses (DIR64, HIGHLOW) are kept, they are what rebasing changes.
+
+struct relocationSlot
+{
+	uint32_t rva;
+	uint32_t width; // 8 for DIR64, 4 for HIGHLOW
+};
+
+class relocationTable
+{
+	private:
+		std::vector <uint32_t> pageRVAs; // sorted
+		std::vector <uint32_t> pageFirst; // index of first slot of page in slots, one extra entry at the end
+		std::vector <uint16_t> slots; // type << 12 | offset in page, sorted within page
+
+		size_t findPage (uint32_t) const; // pageRVAs.size() when page has no relocations
+	public:
+		static constexpr uint32_t PAGE_SIZE = 0x1000;
+
+		relocationTable () = default;
+		relocationTable (const uint8_t *, uint32_t); // raw IMAGE_BASE_RELOCATION blocks
+
+		size_t size () const { return slots.size(); }
+		bool empty () const { return slots.empty(); }
+		size_t getPageCount () const { return pageRVAs.size(); }
+		dataSpan<uint16_t> getPage (uint32_t) const; // slots of page containing RVA
+		bool isPointerSlot (uint32_t rva) const { return getPointerSlotWidth (rva) != 0; } // absolute address is stored at this RVA
+		uint32_t getPointerSlotWidth (uint32_t) const; // 0 when no slot starts at RVA
+		static uint32_t getSlotWidth (uint16_t slot) { return (slot >> 12) == IMAGE_REL_BASED_DIR64 ? 8 : 4; }
+		std::vector <relocationSlot> getSlotsInRange (uint32_t, uint32_t) const; // slots starting in [start, end)
+};
@@ -0,0 +1,396 @@
+#include "signatureLibrary.h"
+#include "peParser.h"
+#include "symbolParse.h"
+#include "instructionLength.h"
+#include "parallel.h"
+#include <algorithm>
+#include <queue>
+
+constexpr char signatureLibrary::MAGIC [8];
+
+namespace
+{
+	struct functionPattern
+	{
+		std::vector <uint8_t> bytes;
+		std::vector <uint8_t> mask; // 0 where byte is relocated
+		std::string name;
+	};
+
+	int keyAt (const functionPattern & pattern, size_t depth) // -1 after end of pattern, 256 for wildcard
+	{
+		if (depth >= pattern.bytes.size())
+		{
+			return -1;
+		}
+		return pattern.mask[depth] ? pattern.bytes[depth] : 256;
+	}
+	bool keysLess (const functionPattern & a, const functionPattern & b)
+	{
+		for (size_t depth = 0; depth < std::max (a.bytes.size(), b.bytes.size()); depth++)
+		{
+			int keyA = keyAt (a, depth);
+			int keyB = keyAt (b, depth);
+			if (keyA != keyB)
+			{
+				return keyA < keyB;
+			}
+		}
+		return false;
+	}
+	bool keysEqual (const functionPattern & a, const functionPattern & b)
+	{
+		return !keysLess (a, b) && !keysLess (b, a);
+	}
+
+	// whole instructions of function start, rel32 and RIP relative displacements and base relocation slots are wildcards
+	uint32_t makePattern (const uint8_t * code, size_t size, uint32_t rva, const relocationTable & relocations, functionPattern & pattern)
+	{
+		pattern.bytes.assign (code, code + size);
+		pattern.mask.assign (size, 1);
+		size_t offset = 0;
+		while (offset < size)
+		{
+			instructionLength instruction = getInstructionLength (code + offset, size - offset);
+			if (instruction.length == 0)
+			{
+				break;
+			}
+			if (instruction.relativeOffset)
+			{
+				std::fill_n (pattern.mask.begin() + offset + instruction.relativeOffset, 4, 0);
+			}
+			offset += instruction.length;
+		}
+		pattern.bytes.resize (offset);
+		pattern.mask.resize (offset);
+		for (const relocationSlot & slot : relocations.getSlotsInRange (rva, rva + offset))
+		{
+			std::fill (pattern.mask.begin() + (slot.rva - rva), pattern.mask.begin() + std::min <size_t> (slot.rva - rva + slot.width, offset), 0);
+		}
+		return std::count (pattern.mask.begin(), pattern.mask.end(), 1);
+	}
+}
+
+signatureLibrary::signatureLibrary ()
+{
+	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+}
+bool signatureLibrary::load (std::string path)
+{
+	if (!file.open (path))
+	{
+		return false;
+	}
+	const sigHeader * header = (const sigHeader *) file.at (0, sizeof (sigHeader));
+	if (header == nullptr || memcmp (header->magic, MAGIC, sizeof (MAGIC)) || header->version != VERSION || header->prefixLength != PREFIX_LENGTH)
+	{
+		log ("Signature library %s has invalid header\n", logType::ERR, stdoutHandle, path.c_str());
+		file.close ();
+		return false;
+	}
+	uint64_t offset = sizeof (sigHeader);
+	nodes = file.spanAt<sigNode> (offset, header->nodeCount);
+	offset += (uint64_t) header->nodeCount * sizeof (sigNode);
+	signatures = file.spanAt<sigEntry> (offset, header->signatureCount);
+	offset += (uint64_t) header->signatureCount * sizeof (sigEntry);
+	patterns = file.spanAt<uint8_t> (offset, header->patternSize);
+	offset += header->patternSize;
+	pool = file.spanAt<char> (offset, header->poolSize);
+
+	bool valid = nodes.size() == header->nodeCount && header->nodeCount > 0 && signatures.size() == header->signatureCount &&
+		patterns.size() == header->patternSize && pool.size() == header->poolSize && !pool.empty() && pool[pool.size() - 1] == '\0';
+	for (size_t i = 0; valid && i < nodes.size(); i++) // children always follow their parent, matching cannot loop
+	{
+		valid = (nodes[i].childCount == 0 || (nodes[i].firstChild > i && nodes[i].firstChild <= nodes.size() && nodes[i].childCount <= nodes.size() - nodes[i].firstChild)) &&
+			nodes[i].firstSignature <= signatures.size() && nodes[i].signatureCount <= signatures.size() - nodes[i].firstSignature;
+	}
+	for (size_t i = 0; valid && i < signatures.size(); i++)
+	{
+		valid = signatures[i].nameOffset < pool.size() && signatures[i].patternOffset <= patterns.size() &&
+			(uint64_t) signatures[i].length * 2 <= patterns.size() - signatures[i].patternOffset;
+	}
+	if (!valid)
+	{
+		log ("Signature library %s is corrupted\n", logType::ERR, stdoutHandle, path.c_str());
+		nodes = {};
+		file.close ();
+		return false;
+	}
+	return true;
+}
+bool signatureLibrary::matchesPattern (const sigEntry & signature, const uint8_t * code, size_t size) const
+{
+	if (signature.length > size)
+	{
+		return false;
+	}
+	const uint8_t * bytes = patterns.data + signature.patternOffset;
+	const uint8_t * mask = bytes + signature.length;
+	for (uint32_t i = 0; i < signature.length; i++)
+	{
+		if (mask[i] && bytes[i] != code[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+const sigEntry * signatureLibrary::matchAt (const uint8_t * code, size_t size) const
+{
+	const sigEntry * best = nullptr;
+	bool ambiguous = false;
+	std::vector <std::pair <uint32_t, uint32_t> > stack = { { 0, 0 } }; // node, depth
+	while (!stack.empty())
+	{
+		uint32_t nodeIndex = stack.back().first;
+		uint32_t depth = stack.back().second;
+		stack.pop_back ();
+		const sigNode & node = nodes[nodeIndex];
+		for (uint32_t i = node.firstSignature; i < node.firstSignature + node.signatureCount; i++)
+		{
+			const sigEntry & signature = signatures[i];
+			if (!matchesPattern (signature, code, size))
+			{
+				continue;
+			}
+			if (!best || signature.length > best->length) // longer pattern is more specific
+			{
+				best = &signature;
+				ambiguous = false;
+			}
+			else if (signature.length == best->length && strcmp (getName (signature.nameOffset), getName (best->nameOffset)))
+			{
+				ambiguous = true;
+			}
+		}
+		if (depth >= size || node.childCount == 0)
+		{
+			continue;
+		}
+		const sigNode * first = nodes.data + node.firstChild;
+		const sigNode * last = first + node.childCount;
+		if ((last - 1)->wildcard)
+		{
+			stack.push_back ( { (uint32_t) (last - 1 - nodes.data), depth + 1 } );
+			last--;
+		}
+		const sigNode * literal = std::lower_bound (first, last, code[depth], [] (const sigNode & n, uint8_t v) { return n.value < v; });
+		if (literal != last && literal->value == code[depth])
+		{
+			stack.push_back ( { (uint32_t) (literal - nodes.data), depth + 1 } );
+		}
+	}
+	return ambiguous ? nullptr : best;
+}
+std::vector <signatureMatch> signatureLibrary::match (dataSpan<uint8_t> image, const std::vector <uint32_t> & functionStarts) const
+{
+	if (!isLoaded ())
+	{
+		return {};
+	}
+	unsigned workers = parallelWorkers (functionStarts.size(), MIN_FUNCTIONS_PER_WORKER);
+	std::vector <std::vector <signatureMatch> > chunkMatches (workers);
+	parallelFor (functionStarts.size(), workers, [&] (unsigned chunk, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t rva = functionStarts[i];
+			if (rva >= image.size())
+			{
+				continue;
+			}
+			const sigEntry * signature = matchAt (image.data + rva, image.size() - rva);
+			if (signature)
+			{
+				chunkMatches[chunk].push_back ( { rva, signature->nameOffset } );
+			}
+		}
+	});
+	std::vector <signatureMatch> toRet;
+	for (const auto & matches : chunkMatches)
+	{
+		toRet.insert (toRet.end(), matches.begin(), matches.end());
+	}
+	return toRet;
+}
+bool signatureLibrary::build (std::vector <std::string> const & paths, std::string outputPath, HANDLE stdoutHandle)
+{
+	std::vector <functionPattern> functions;
+	for (const auto & path : paths)
+	{
+		try
+		{
+			PEparser parser (path);
+			if (!parser.isValid ())
+			{
+				log ("Skipping %s, it is not a supported PE file\n", logType::WARNING, stdoutHandle, path.c_str());
+				continue;
+			}
+			dataSpan<uint8_t> fileView = parser.getFileView ();
+			relocationTable relocations = parser.getRelocationTable ();
+			dataSpan<RUNTIME_FUNCTION> pdata = parser.getPdataView ();
+
+			std::vector <std::pair <uint32_t, std::string> > named; // statically linked library code is named by COFF symbols, DLLs by exports
+			if (parser.getCoffSymbolNumber () > 0 && parser.getCoffSymbolTableOffset () != 0)
+			{
+				coffSymbolParser symbolParser;
+				symbolTable symbols = symbolParser.parseSymbols (parser.getCoffEntries (), parser.getCoffStringTable (), parser.getSectionHeaders ());
+				for (const auto & entry : symbols.getEntries ())
+				{
+					if (entry.type == symbolType::FUNCTION_NAME)
+					{
+						named.push_back ( { entry.rva, symbols.getName (&entry) } );
+					}
+				}
+			}
+			else
+			{
+				exportTable exports = parser.getExportTable ();
+				for (const auto & entry : exports.getEntries ())
+				{
+					if (entry.forwarderOffset == exportTable::NO_NAME && exports.findByRVA (entry.rva) == &entry)
+					{
+						named.push_back ( { entry.rva, exports.getDisplayName (&entry) } );
+					}
+				}
+			}
+			std::sort (named.begin(), named.end());
+
+			size_t added = 0;
+			for (size_t i = 0; i < named.size(); i++)
+			{
+				uint32_t rva = named[i].first;
+				uint64_t end = i + 1 < named.size() ? named[i + 1].first : rva + MAX_PATTERN_LENGTH;
+				auto range = std::lower_bound (pdata.begin(), pdata.end(), rva, [] (const RUNTIME_FUNCTION & f, uint32_t v) { return f.BeginAddress < v; });
+				if (range != pdata.end() && range->BeginAddress == rva)
+				{
+					end = range->EndAddress;
+				}
+				uint64_t fileOffset;
+				if (end <= rva || !parser.rvaToFileOffset (rva, fileOffset) || fileOffset >= fileView.size())
+				{
+					continue;
+				}
+				size_t size = (size_t) std::min <uint64_t> ( { end - rva, MAX_PATTERN_LENGTH, fileView.size() - fileOffset } );
+				functionPattern pattern;
+				if (makePattern (fileView.data + fileOffset, size, rva, relocations, pattern) >= MIN_FIXED_BYTES)
+				{
+					pattern.name = named[i].second;
+					functions.push_back (std::move (pattern));
+					added++;
+				}
+			}
+			log ("%s: %zu functions, %zu signatures\n", logType::INFO, stdoutHandle, path.c_str(), named.size(), added);
+		}
+		catch (std::exception &)
+		{
+			log ("Skipping %s, it is not a supported PE file\n", logType::WARNING, stdoutHandle, path.c_str());
+		}
+	}
+
+	std::sort (functions.begin(), functions.end(), [] (const functionPattern & a, const functionPattern & b)
+	{
+		return keysLess (a, b) || (!keysLess (b, a) && a.name < b.name);
+	});
+	std::vector <functionPattern> unique; // same pattern under different names says nothing, it is dropped
+	size_t ambiguous = 0;
+	for (size_t i = 0; i < functions.size(); )
+	{
+		size_t j = i + 1;
+		bool sameName = true;
+		for (; j < functions.size() && keysEqual (functions[i], functions[j]); j++)
+		{
+			sameName = sameName && functions[j].name == functions[i].name;
+		}
+		if (sameName)
+		{
+			unique.push_back (std::move (functions[i]));
+		}
+		else
+		{
+			ambiguous += j - i;
+		}
+		i = j;
+	}
+
+	std::vector <sigNode> nodes;
+	std::vector <sigEntry> entries;
+	std::vector <uint8_t> patternBytes;
+	std::vector <char> pool;
+	struct pendingNode
+	{
+		uint32_t node;
+		size_t begin;
+		size_t end;
+		uint32_t depth;
+	};
+	std::queue <pendingNode> pending; // breadth first, so children of every node are created together
+	nodes.push_back ( { 0, 0, 0, 0, 0, 0, 0 } );
+	pending.push ( { 0, 0, unique.size(), 0 } );
+	while (!pending.empty())
+	{
+		pendingNode current = pending.front();
+		pending.pop ();
+		size_t i = current.begin;
+		nodes[current.node].firstSignature = entries.size();
+		while (i < current.end && (current.depth == PREFIX_LENGTH || keyAt (unique[i], current.depth) == -1)) // pattern prefix ends here
+		{
+			const functionPattern & pattern = unique[i++];
+			entries.push_back ( { patternBytes.size(), (uint32_t) pattern.bytes.size(), (uint32_t) pool.size() } );
+			patternBytes.insert (patternBytes.end(), pattern.bytes.begin(), pattern.bytes.end());
+			patternBytes.insert (patternBytes.end(), pattern.mask.begin(), pattern.mask.end());
+			pool.insert (pool.end(), pattern.name.begin(), pattern.name.end());
+			pool.push_back ('\0');
+		}
+		nodes[current.node].signatureCount = entries.size() - nodes[current.node].firstSignature;
+		nodes[current.node].firstChild = nodes.size();
+		while (i < current.end) // patterns are sorted by keys, every key is one child, wildcard (256) comes last
+		{
+			int key = keyAt (unique[i], current.depth);
+			size_t j = i + 1;
+			while (j < current.end && keyAt (unique[j], current.depth) == key)
+			{
+				j++;
+			}
+			pending.push ( { (uint32_t) nodes.size(), i, j, current.depth + 1 } );
+			nodes.push_back ( { 0, 0, 0, 0, (uint8_t) (key == 256 ? 0 : key), (uint8_t) (key == 256), 0 } );
+			i = j;
+		}
+		nodes[current.node].childCount = nodes.size() - nodes[current.node].firstChild;
+	}
+	if (pool.empty())
+	{
+		pool.push_back ('\0');
+	}
+
+	sigHeader header;
+	memcpy (header.magic, MAGIC, sizeof (MAGIC));
+	header.version = VERSION;
+	header.prefixLength = PREFIX_LENGTH;
+	header.nodeCount = nodes.size();
+	header.signatureCount = entries.size();
+	header.patternSize = patternBytes.size();
+	header.poolSize = pool.size();
+
+	FILE * f = fopen (outputPath.c_str(), "wb");
+	if (!f)
+	{
+		log ("Cannot create signature library %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+		return false;
+	}
+	bool written = fwrite (&header, sizeof (header), 1, f) == 1 &&
+		fwrite (nodes.data(), sizeof (sigNode), nodes.size(), f) == nodes.size() &&
+		fwrite (entries.data(), sizeof (sigEntry), entries.size(), f) == entries.size() &&
+		fwrite (patternBytes.data(), 1, patternBytes.size(), f) == patternBytes.size() &&
+		fwrite (pool.data(), 1, pool.size(), f) == pool.size();
+	fclose (f);
+	if (!written)
+	{
+		log ("Cannot write signature library %s\n", logType::ERR, stdoutHandle, outputPath.c_str());
+		return false;
+	}
+	log ("Signature library %s written, %zu signatures (%zu ambiguous dropped), %zu trie nodes\n", logType::INFO, stdoutHandle,
+		outputPath.c_str(), entries.size(), ambiguous, nodes.size());
+	return true;
+}
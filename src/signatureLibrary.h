@@ -0,0 +1,83 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "mappedFile.h"
+
+// Library function signatures (FLIRT like) matched at function starts of images without symbols.
+// Signature library layout (little endian):
+// sigHeader | sigNode [nodeCount] | sigEntry [signatureCount] | uint8_t patterns [patternSize] | char pool [poolSize]
+// Nodes form trie over first PREFIX_LENGTH bytes of patterns, node 0 is root. Children of node are contiguous,
+// literal children sorted by value, wildcard child (relocated byte, matches anything) is the last one.
+// Pattern of signature is its bytes followed by the same number of mask bytes (0 for wildcard).
+
+#pragma pack(push)
+#pragma pack(1)
+struct sigHeader
+{
+	char magic [8];
+	uint32_t version;
+	uint32_t prefixLength;
+	uint32_t nodeCount;
+	uint32_t signatureCount;
+	uint64_t patternSize;
+	uint64_t poolSize;
+};
+struct sigNode
+{
+	uint32_t firstChild;
+	uint32_t childCount;
+	uint32_t firstSignature; // signatures whose prefix ends in this node
+	uint32_t signatureCount;
+	uint8_t value;
+	uint8_t wildcard;
+	uint16_t reserved;
+};
+struct sigEntry
+{
+	uint64_t patternOffset;
+	uint32_t length;
+	uint32_t nameOffset;
+};
+#pragma pack(pop)
+
+struct signatureMatch
+{
+	uint32_t rva;
+	uint32_t nameOffset; // into pool of library
+};
+
+class signatureLibrary
+{
+	private:
+		static constexpr char MAGIC [8] = {'M','D','B','G','S','I','G','S'};
+		static constexpr uint32_t VERSION = 1;
+		static constexpr uint32_t PREFIX_LENGTH = 32;
+		static constexpr uint32_t MAX_PATTERN_LENGTH = 0x100;
+		static constexpr uint32_t MIN_FIXED_BYTES = 16; // shorter functions (thunks, stubs) match too much
+		static constexpr size_t MIN_FUNCTIONS_PER_WORKER = 512;
+
+		mappedFile file;
+		HANDLE stdoutHandle;
+		dataSpan<sigNode> nodes;
+		dataSpan<sigEntry> signatures;
+		dataSpan<uint8_t> patterns;
+		dataSpan<char> pool;
+
+		bool matchesPattern (const sigEntry &, const uint8_t *, size_t) const;
+		const sigEntry * matchAt (const uint8_t *, size_t) const; // longest matching signature, nullptr when none or ambiguous
+	public:
+		signatureLibrary ();
+		bool load (std::string);
+		bool isLoaded () const { return !nodes.empty(); }
+		size_t size () const { return signatures.size(); }
+		const char * getName (uint32_t offset) const { return pool.data + offset; }
+
+		// image in memory layout, function starts are RVAs, runs on all cores
+		std::vector <signatureMatch> match (dataSpan<uint8_t>, const std::vector <uint32_t> &) const;
+
+		static bool build (std::vector <std::string> const &, std::string, HANDLE); // from PE files with COFF symbols or exports
+};
@@ -10,11 +10,11 @@ typedef struct
     char e_name[8];
     struct 
     {
-      unsigned long e_zeroes;
-      unsigned long e_offset;
+      uint32_t e_zeroes;
+      uint32_t e_offset;
     } e;
   } e;
-  unsigned long e_value;
+  uint32_t e_value;
   short e_scnum;
   unsigned short e_type;
   unsigned char e_sclass;
@@ -182,11 +182,11 @@ struct exceptionData
     DWORD rip;
     bool oneHitBreakpoint;
 };
-struct function
+struct functionRange // RVA based, name is offset into name pool of symbolTable
 {
-    std::string name;
-    uint64_t start;
-    uint64_t end;
+    uint32_t start;
+    uint32_t end;
+    uint32_t nameOffset;
 };
  
 typedef _LDR_DATA_TABLE_ENTRY<DWORD> LDR_TABLE32;
@@ -0,0 +1,122 @@
+#include "symbolCache.h"
+
+constexpr char symbolCache::MAGIC [8];
+
+symbolCache::symbolCache (PEparser & pe)
+{
+	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+	dataSpan<uint8_t> fileView = pe.getFileView ();
+	memset (&identity, 0, sizeof (identity));
+	memcpy (identity.magic, MAGIC, sizeof (MAGIC));
+	identity.version = VERSION;
+	identity.timeDateStamp = pe.getTimeDateStamp ();
+	identity.sizeOfImage = pe.getSizeOfImage ();
+	identity.checkSum = pe.getCheckSum ();
+	identity.fileSize = fileView.size ();
+	identity.fileHash = hashBytes (fileView.data, fileView.size());
+
+	char name [64];
+	snprintf (name, sizeof (name), "%.16llx_%.8x.symcache", identity.fileHash, identity.timeDateStamp);
+	cachePath = getCacheDirectory () + name;
+}
+std::string symbolCache::getCacheDirectory ()
+{
+	char tempPath [MAX_PATH + 1];
+	DWORD size = GetTempPathA (MAX_PATH + 1, tempPath);
+	if (size == 0 || size > MAX_PATH)
+	{
+		return "";
+	}
+	std::string directory = std::string (tempPath) + "maldbg\\";
+	CreateDirectoryA (directory.c_str(), NULL); // fails harmlessly when it already exists
+	return directory;
+}
+bool symbolCache::load (symbolTable & symbols, std::vector <functionRange> & ranges)
+{
+	mappedFile cacheFile;
+	if (!cacheFile.open (cachePath))
+	{
+		return false;
+	}
+	const symbolCacheHeader * header = (const symbolCacheHeader *) cacheFile.at (0, sizeof (symbolCacheHeader));
+	if (header == nullptr ||
+		memcmp (header->magic, identity.magic, sizeof (MAGIC)) ||
+		header->version != identity.version ||
+		header->timeDateStamp != identity.timeDateStamp ||
+		header->sizeOfImage != identity.sizeOfImage ||
+		header->checkSum != identity.checkSum ||
+		header->fileSize != identity.fileSize ||
+		header->fileHash != identity.fileHash)
+	{
+		log ("Symbol cache %s does not match this image, ignoring it\n", logType::WARNING, stdoutHandle, cachePath.c_str());
+		return false;
+	}
+
+	uint64_t offset = sizeof (symbolCacheHeader);
+	dataSpan<symbolEntry> cachedSymbols = cacheFile.spanAt<symbolEntry> (offset, header->symbolCount);
+	offset += (uint64_t) header->symbolCount * sizeof (symbolEntry);
+	dataSpan<functionRange> cachedRanges = cacheFile.spanAt<functionRange> (offset, header->rangeCount);
+	offset += (uint64_t) header->rangeCount * sizeof (functionRange);
+	dataSpan<char> cachedPool = cacheFile.spanAt<char> (offset, header->poolSize);
+
+	if (cachedSymbols.size() != header->symbolCount || cachedRanges.size() != header->rangeCount || cachedPool.size() != header->poolSize)
+	{
+		log ("Symbol cache %s is truncated, ignoring it\n", logType::WARNING, stdoutHandle, cachePath.c_str());
+		return false;
+	}
+	for (const auto & entry : cachedSymbols)
+	{
+		if (entry.nameOffset >= cachedPool.size())
+		{
+			log ("Symbol cache %s is corrupted, ignoring it\n", logType::WARNING, stdoutHandle, cachePath.c_str());
+			return false;
+		}
+	}
+	for (const auto & range : cachedRanges)
+	{
+		if (range.nameOffset >= cachedPool.size())
+		{
+			log ("Symbol cache %s is corrupted, ignoring it\n", logType::WARNING, stdoutHandle, cachePath.c_str());
+			return false;
+		}
+	}
+	if (!cachedPool.empty() && cachedPool[cachedPool.size() - 1] != '\0')
+	{
+		log ("Symbol cache %s is corrupted, ignoring it\n", logType::WARNING, stdoutHandle, cachePath.c_str());
+		return false;
+	}
+
+	symbols.build (std::vector <symbolEntry> (cachedSymbols.begin(), cachedSymbols.end()), std::vector <char> (cachedPool.begin(), cachedPool.end()));
+	ranges.assign (cachedRanges.begin(), cachedRanges.end());
+	return true;
+}
+bool symbolCache::store (symbolTable const & symbols, std::vector <functionRange> const & ranges)
+{
+	symbolCacheHeader header = identity;
+	header.symbolCount = symbols.size ();
+	header.rangeCount = ranges.size ();
+	header.poolSize = symbols.getNamePool().size ();
+
+	std::string temporaryPath = cachePath + ".tmp";
+	FILE * f = fopen (temporaryPath.c_str(), "wb");
+	if (!f)
+	{
+		log ("Cannot create symbol cache file %s\n", logType::WARNING, stdoutHandle, temporaryPath.c_str());
+		return false;
+	}
+	bool written = fwrite (&header, sizeof (header), 1, f) == 1 &&
+		fwrite (symbols.getEntries().data(), sizeof (symbolEntry), header.symbolCount, f) == header.symbolCount &&
+		fwrite (ranges.data(), sizeof (functionRange), header.rangeCount, f) == header.rangeCount &&
+		fwrite (symbols.getNamePool().data(), 1, header.poolSize, f) == header.poolSize;
+	fclose (f);
+
+	// write under temporary name first so a crash never leaves half written cache under the real name
+	if (!written || !MoveFileExA (temporaryPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		log ("Cannot write symbol cache file %s\n", logType::WARNING, stdoutHandle, cachePath.c_str());
+		DeleteFileA (temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "structs.h"
+#include "peParser.h"
+#include "symbolParse.h"
+#include "mappedFile.h"
+
+// Cache file layout (little endian, no padding between parts):
+// symbolCacheHeader | symbolEntry [symbolCount] | functionRange [rangeCount] | char namePool [poolSize]
+
+#pragma pack(push)
+#pragma pack(1)
+struct symbolCacheHeader
+{
+	char magic [8];
+	uint32_t version;
+	uint32_t timeDateStamp;
+	uint32_t sizeOfImage;
+	uint32_t checkSum;
+	uint64_t fileSize;
+	uint64_t fileHash;
+	uint32_t symbolCount;
+	uint32_t rangeCount;
+	uint64_t poolSize;
+};
+#pragma pack(pop)
+
+class symbolCache
+{
+	private:
+		static constexpr char MAGIC [8] = {'M','D','B','G','S','Y','M','C'};
+		static constexpr uint32_t VERSION = 1;
+
+		HANDLE stdoutHandle;
+		symbolCacheHeader identity; // counts are filled when storing
+		std::string cachePath;
+
+		std::string getCacheDirectory ();
+	public:
+		symbolCache (PEparser &);
+		bool load (symbolTable &, std::vector <functionRange> &);
+		bool store (symbolTable const &, std::vector <functionRange> const &);
+		std::string getPath () { return cachePath; }
+};
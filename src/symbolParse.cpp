@@ -1,47 +1,144 @@
 #include "symbolParse.h"
+#include "parallel.h"
 
 coffSymbolParser::coffSymbolParser ()
 {
 	stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
 }
-std::map <uint64_t, symbol> coffSymbolParser::parseSymbols (
-	std::vector <COFFentry> COFFTable,
-	std::unique_ptr<uint8_t []> & extendedNames,
-	uint64_t extendedCoffNamesOffset,
-	PEparser & pe)
-{	
-	std::map <uint64_t, symbol> toRet; // RVA
-	for (const auto & entry : COFFTable)
-	{	
-		// types 0x20, 0x02, 0x3, 0x0
-		int sectionIdx = entry.e_scnum-1;
-		if (sectionIdx < 0 || sectionIdx > pe.getNumberOfSections())
+void symbolTable::build (std::vector <symbolEntry> && newEntries, std::vector <char> && newPool)
+{
+	entries = std::move (newEntries);
+	namePool = std::move (newPool);
+
+	// same RVA can be defined many times, the last definition in table order wins
+	auto byRVA = [] (const symbolEntry & a, const symbolEntry & b) { return a.rva < b.rva; };
+	if (!std::is_sorted (entries.begin(), entries.end(), byRVA))
+	{
+		std::stable_sort (entries.begin(), entries.end(), byRVA);
+	}
+	size_t out = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (i + 1 < entries.size() && entries[i + 1].rva == entries[i].rva)
 		{
 			continue;
 		}
-		uint64_t RVA = pe.getSectionAddressForIndex(sectionIdx);
-		uint32_t nameSize = strlen (entry.e.e_name);
+		entries[out++] = entries[i];
+	}
+	entries.resize (out);
+	entries.shrink_to_fit ();
+}
+void symbolTable::clear ()
+{
+	entries.clear ();
+	namePool.clear ();
+}
+const symbolEntry * symbolTable::find (uint64_t rva) const
+{
+	auto it = std::lower_bound (entries.begin(), entries.end(), rva, [] (const symbolEntry & e, uint64_t v) { return e.rva < v; });
+	if (it == entries.end() || it->rva != rva)
+	{
+		return nullptr;
+	}
+	return &(*it);
+}
+const symbolEntry * symbolTable::findNearest (uint64_t rva) const
+{
+	auto it = std::upper_bound (entries.begin(), entries.end(), rva, [] (uint64_t v, const symbolEntry & e) { return v < e.rva; });
+	if (it == entries.begin())
+	{
+		return nullptr;
+	}
+	return &(*(it - 1));
+}
+symbolTable coffSymbolParser::parseSymbols (
+	dataSpan<COFFentry> COFFTable,
+	dataSpan<uint8_t> extendedNames,
+	dataSpan<IMAGE_SECTION_HEADER> sections)
+{
+	// auxiliary records follow their primary record, find primary ones first so table can be split anywhere
+	std::vector <uint32_t> primary;
+	primary.reserve (COFFTable.size());
+	for (size_t i = 0; i < COFFTable.size(); i += 1 + COFFTable[i].e_numaux)
+	{
+		primary.push_back ((uint32_t) i);
+	}
+
+	unsigned workers = parallelWorkers (primary.size(), MIN_SYMBOLS_PER_WORKER);
+	std::vector <std::vector <symbolEntry> > chunkEntries (workers);
+	std::vector <std::vector <char> > chunkPools (workers);
+
+	parallelFor (primary.size(), workers, [&] (unsigned chunk, size_t begin, size_t end)
+	{
+		std::vector <symbolEntry> & localEntries = chunkEntries[chunk];
+		std::vector <char> & localPool = chunkPools[chunk];
+		localEntries.reserve (end - begin);
 
-		if (entry.e.e.e_zeroes != 0  && entry.e_scnum != 0) // function to 8 chars
+		for (size_t i = begin; i < end; i++)
 		{
-			toRet [RVA + entry.e_value] = 
+			const COFFentry & entry = COFFTable[primary[i]];
+			// types 0x20, 0x02, 0x3, 0x0
+			int sectionIdx = entry.e_scnum-1;
+			if (sectionIdx < 0 || sectionIdx >= sections.size())
+			{
+				continue;
+			}
+			const char * name;
+			size_t nameSize;
+			if (entry.e.e.e_zeroes != 0) // function to 8 chars
+			{
+				name = entry.e.e_name;
+				nameSize = strnlen (entry.e.e_name, 8);
+			}
+			else if (entry.e.e.e_offset != 0 && entry.e.e.e_offset < extendedNames.size()) // function with extended name
+			{
+				name = (const char *) &extendedNames[entry.e.e.e_offset];
+				nameSize = strnlen (name, extendedNames.size() - entry.e.e.e_offset);
+			}
+			else
 			{
-				std::string (entry.e.e_name, (nameSize > 8 ? 8 : nameSize)),
-				entry.e_scnum,
-				(entry.e_type == 0x20 ? symbolType::FUNCTION_NAME : symbolType::NAME)
-			};
-			//printf ("FUNC %.8s\n", entry.e.e_name);
+				continue;
+			}
+			symbolEntry newEntry {};
+			newEntry.rva = sections[sectionIdx].VirtualAddress + entry.e_value;
+			newEntry.nameOffset = localPool.size();
+			newEntry.sectionNumber = entry.e_scnum;
+			newEntry.type = (entry.e_type == 0x20 ? symbolType::FUNCTION_NAME : symbolType::NAME);
+			localPool.insert (localPool.end(), name, name + nameSize);
+			localPool.push_back ('\0');
+			localEntries.push_back (newEntry);
 		}
-		else if (entry.e.e.e_zeroes == 0 && entry.e.e.e_offset != 0  && entry.e_scnum != 0) // function with extended name
+		std::stable_sort (localEntries.begin(), localEntries.end(), [] (const symbolEntry & a, const symbolEntry & b) { return a.rva < b.rva; });
+	});
+
+	size_t totalEntries = 0;
+	size_t totalPool = 0;
+	for (unsigned i = 0; i < workers; i++)
+	{
+		totalEntries += chunkEntries[i].size();
+		totalPool += chunkPools[i].size();
+	}
+	std::vector <symbolEntry> entries;
+	std::vector <char> pool;
+	entries.reserve (totalEntries);
+	pool.reserve (totalPool);
+	for (unsigned i = 0; i < workers; i++)
+	{
+		uint32_t poolBase = pool.size();
+		for (auto e : chunkEntries[i])
+		{
+			e.nameOffset += poolBase;
+			entries.push_back (e);
+		}
+		pool.insert (pool.end(), chunkPools[i].begin(), chunkPools[i].end());
+		if (i > 0) // chunks are sorted already, merging keeps earlier chunks first for equal RVAs
 		{
-			toRet [RVA + entry.e_value] =
-			{ 
-				std::string ((const char *)&extendedNames[entry.e.e.e_offset]),
-				entry.e_scnum,
-				(entry.e_type == 0x20 ? symbolType::FUNCTION_NAME : symbolType::NAME)
-			};
-			//printf ("FUNC %s\n", &extendedNames[entry.e.e.e_offset]);		
+			std::inplace_merge (entries.begin(), entries.end() - chunkEntries[i].size(), entries.end(),
+				[] (const symbolEntry & a, const symbolEntry & b) { return a.rva < b.rva; });
 		}
 	}
+
+	symbolTable toRet; // RVA
+	toRet.build (std::move (entries), std::move (pool));
 	return toRet;
-}
\ No newline at end of file
+}
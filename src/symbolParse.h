@@ -14,19 +14,39 @@ enum symbolType
     NAME = 1
 };
 
-struct symbol
+struct symbolEntry
 {
-	std::string name;
-	int sectionNumber;
-	symbolType type;
+	uint32_t rva;
+	uint32_t nameOffset; // offset into name pool of symbolTable
+	int16_t sectionNumber;
+	uint8_t type; // symbolType
+	uint8_t reserved; // zero, entries are written to symbol cache as they are and must have no padding
 };
 
-class coffSymbolParser 
+class symbolTable // RVA sorted, names kept in one pool
+{
+	private:
+		std::vector <symbolEntry> entries;
+		std::vector <char> namePool;
+	public:
+		void build (std::vector <symbolEntry> &&, std::vector <char> &&);
+		void clear ();
+		const symbolEntry * find (uint64_t rva) const; // exact match
+		const symbolEntry * findNearest (uint64_t rva) const; // nearest preceding or equal
+		const char * getName (const symbolEntry * entry) const { return namePool.data() + entry->nameOffset; }
+		size_t size () const { return entries.size(); }
+		bool empty () const { return entries.empty(); }
+		const std::vector <symbolEntry> & getEntries () const { return entries; }
+		const std::vector <char> & getNamePool () const { return namePool; }
+};
+
+class coffSymbolParser
 {
 	private:
 		HANDLE processHandle;
 		HANDLE stdoutHandle;
+		static constexpr size_t MIN_SYMBOLS_PER_WORKER = 16384;
 	public:
 		coffSymbolParser ();
-		std::map <uint64_t, symbol> parseSymbols (std::vector <COFFentry>, std::unique_ptr<uint8_t []> &, uint64_t, PEparser &);
+		symbolTable parseSymbols (dataSpan<COFFentry>, dataSpan<uint8_t>, dataSpan<IMAGE_SECTION_HEADER>);
 };
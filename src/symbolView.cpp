@@ -0,0 +1,62 @@
+#include "symbolView.h"
+
+symbolView::symbolView (symbolTable const * symbols, functionIndex const * functions, relocationTable const * relocations)
+{
+	this->symbols = symbols;
+	this->functions = functions;
+	this->relocations = relocations;
+}
+const symbolEntry * symbolView::find (uint64_t address) const
+{
+	uint32_t rva;
+	if (!symbols || !toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return symbols->find (rva);
+}
+const symbolEntry * symbolView::findNearest (uint64_t address) const
+{
+	uint32_t rva;
+	if (!symbols || !toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return symbols->findNearest (rva);
+}
+const functionRange * symbolView::functionContaining (uint64_t address) const
+{
+	uint32_t rva;
+	if (!functions || !toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return functions->containingRVA (rva);
+}
+const functionRange * symbolView::functionStartingAt (uint64_t address) const
+{
+	uint32_t rva;
+	if (!functions || !toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return functions->startingAtRVA (rva);
+}
+const functionRange * symbolView::functionEndingAt (uint64_t address) const
+{
+	uint32_t rva;
+	if (!functions || !toRVA (address, rva))
+	{
+		return nullptr;
+	}
+	return functions->endingAtRVA (rva);
+}
+uint32_t symbolView::getPointerSlotWidth (uint64_t address) const
+{
+	uint32_t rva;
+	if (!relocations || !toRVA (address, rva))
+	{
+		return 0;
+	}
+	return relocations->getPointerSlotWidth (rva);
+}
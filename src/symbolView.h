@@ -0,0 +1,48 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string>
+
+#include "symbolParse.h"
+#include "functionIndex.h"
+#include "relocationTable.h"
+
+// Symbols, functions and relocations of one image are RVA keyed and built once per image (or loaded from cache).
+// symbolView puts them at the address the image is loaded at now, rebasing after ASLR or rerun only changes the base.
+
+class symbolView
+{
+	private:
+		symbolTable const * symbols = nullptr;
+		functionIndex const * functions = nullptr;
+		relocationTable const * relocations = nullptr;
+		uint64_t imageBase = 0;
+		uint32_t imageSize = 0;
+	public:
+		symbolView () = default;
+		symbolView (symbolTable const *, functionIndex const *, relocationTable const *);
+
+		void rebase (uint64_t base, uint32_t size) { imageBase = base; imageSize = size; }
+		uint64_t getBase () const { return imageBase; }
+		bool toRVA (uint64_t address, uint32_t & rva) const
+		{
+			if (address < imageBase || address - imageBase >= imageSize)
+			{
+				return false;
+			}
+			rva = address - imageBase;
+			return true;
+		}
+
+		const symbolEntry * find (uint64_t) const; // exact, by virtual address
+		const symbolEntry * findNearest (uint64_t) const;
+		const char * getName (const symbolEntry * entry) const { return symbols->getName (entry); }
+
+		const functionRange * functionContaining (uint64_t) const;
+		const functionRange * functionStartingAt (uint64_t) const;
+		const functionRange * functionEndingAt (uint64_t) const;
+		std::string getFunctionName (const functionRange * range) const { return functions->getName (range); }
+
+		bool isPointerSlot (uint64_t address) const { return getPointerSlotWidth (address) != 0; } // image stores absolute address here, it is not code or plain data
+		uint32_t getPointerSlotWidth (uint64_t) const; // 0 when there is no pointer slot at address
+};
@@ -0,0 +1,120 @@
+#include "threadContext.h"
+#include <string.h>
+
+bool threadContextAccessor::get (DWORD threadId, CONTEXT & context)
+{
+	HANDLE threadHandle = OpenThread (THREAD_GET_CONTEXT, FALSE, threadId);
+	if (threadHandle == NULL)
+	{
+		return false;
+	}
+	bool result = GetThreadContext (threadHandle, &context);
+	CloseHandle (threadHandle);
+	return result;
+}
+bool threadContextAccessor::set (DWORD threadId, const CONTEXT & context)
+{
+	HANDLE threadHandle = OpenThread (THREAD_SET_CONTEXT, FALSE, threadId);
+	if (threadHandle == NULL)
+	{
+		return false;
+	}
+	bool result = SetThreadContext (threadHandle, &context);
+	CloseHandle (threadHandle);
+	return result;
+}
+
+void threadContext::copyParts (CONTEXT & to, const CONTEXT & from, DWORD parts) // field sets of CONTEXT_* flags on x64
+{
+	if ((parts & CONTEXT_CONTROL) == CONTEXT_CONTROL)
+	{
+		to.SegCs = from.SegCs;
+		to.SegSs = from.SegSs;
+		to.EFlags = from.EFlags;
+		to.Rsp = from.Rsp;
+		to.Rip = from.Rip;
+	}
+	if ((parts & CONTEXT_INTEGER) == CONTEXT_INTEGER)
+	{
+		to.Rax = from.Rax;
+		to.Rcx = from.Rcx;
+		to.Rdx = from.Rdx;
+		to.Rbx = from.Rbx;
+		to.Rbp = from.Rbp;
+		to.Rsi = from.Rsi;
+		to.Rdi = from.Rdi;
+		to.R8 = from.R8;
+		to.R9 = from.R9;
+		to.R10 = from.R10;
+		to.R11 = from.R11;
+		to.R12 = from.R12;
+		to.R13 = from.R13;
+		to.R14 = from.R14;
+		to.R15 = from.R15;
+	}
+	if ((parts & CONTEXT_SEGMENTS) == CONTEXT_SEGMENTS)
+	{
+		to.SegDs = from.SegDs;
+		to.SegEs = from.SegEs;
+		to.SegFs = from.SegFs;
+		to.SegGs = from.SegGs;
+	}
+	if ((parts & CONTEXT_FLOATING_POINT) == CONTEXT_FLOATING_POINT)
+	{
+		to.MxCsr = from.MxCsr;
+		to.FltSave = from.FltSave;
+	}
+	if ((parts & CONTEXT_DEBUG_REGISTERS) == CONTEXT_DEBUG_REGISTERS)
+	{
+		to.Dr0 = from.Dr0;
+		to.Dr1 = from.Dr1;
+		to.Dr2 = from.Dr2;
+		to.Dr3 = from.Dr3;
+		to.Dr6 = from.Dr6;
+		to.Dr7 = from.Dr7;
+	}
+}
+void threadContext::reset (DWORD threadId)
+{
+	this->threadId = threadId;
+	fetched = 0;
+	dirty = 0;
+	memset (&context, 0, sizeof (context));
+}
+bool threadContext::read (DWORD flags)
+{
+	DWORD missing = flags & CONTEXT_PARTS & ~fetched;
+	if (missing == 0)
+	{
+		return true;
+	}
+	CONTEXT part; // parts already read may be changed, they are never read again
+	memset (&part, 0, sizeof (part));
+	part.ContextFlags = CONTEXT_AMD64 | missing;
+	reads++;
+	if (!accessor->get (threadId, part))
+	{
+		return false;
+	}
+	copyParts (context, part, CONTEXT_AMD64 | missing);
+	fetched |= missing;
+	return true;
+}
+CONTEXT & threadContext::modify (DWORD flags)
+{
+	read (flags);
+	dirty |= flags & CONTEXT_PARTS & fetched; // part that could not be read is never written with zeroes
+	return context;
+}
+bool threadContext::flush ()
+{
+	if (dirty == 0)
+	{
+		return true;
+	}
+	context.ContextFlags = CONTEXT_AMD64 | dirty;
+	writes++;
+	bool result = accessor->set (threadId, context);
+	dirty = 0;
+	return result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <windows.h>
+#include <inttypes.h>
+
+// Context of thread that caused current debug event. Parts of CONTEXT (control, integer, segments, floating point,
+// debug registers) are read from the thread only when something asks for them, changed parts are tracked
+// and only those are written back before the event is continued, nothing is written when no register changed.
+
+class contextAccessor // reads and writes context of thread by its id, parts are selected by ContextFlags
+{
+	public:
+		virtual ~contextAccessor () = default;
+		virtual bool get (DWORD threadId, CONTEXT & context) = 0;
+		virtual bool set (DWORD threadId, const CONTEXT & context) = 0;
+};
+
+class threadContextAccessor : public contextAccessor // threads of debugged process, all of them are stopped while debug event is handled
+{
+	public:
+		bool get (DWORD, CONTEXT &) override;
+		bool set (DWORD, const CONTEXT &) override;
+};
+
+class threadContext
+{
+	private:
+		static constexpr DWORD CONTEXT_PARTS = CONTEXT_ALL & ~CONTEXT_AMD64;
+
+		contextAccessor * accessor;
+		DWORD threadId = 0;
+		CONTEXT context;
+		DWORD fetched = 0; // parts read from thread since reset
+		DWORD dirty = 0; // parts changed since they were read
+		uint64_t reads = 0;
+		uint64_t writes = 0;
+
+		static void copyParts (CONTEXT &, const CONTEXT &, DWORD);
+	public:
+		threadContext (contextAccessor * accessor) : accessor (accessor) {}
+
+		void reset (DWORD); // new debug event of given thread, nothing is read yet
+		bool read (DWORD); // reads parts not read yet, CONTEXT_CONTROL for RIP, RSP and flags, CONTEXT_INTEGER for the rest
+		const CONTEXT & get () const { return context; }
+		CONTEXT & modify (DWORD); // parts already read are written back at flush
+		bool flush (); // writes changed parts back, true when nothing had to be written
+
+		DWORD getThreadId () const { return threadId; }
+		bool isDirty () const { return dirty != 0; }
+		uint64_t getReads () const { return reads; }
+		uint64_t getWrites () const { return writes; }
+};
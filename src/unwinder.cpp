@@ -0,0 +1,423 @@
+#include "unwinder.h"
+#include <algorithm>
+#include <string.h>
+
+// PE32+ header offsets, unwinder reads images through memoryReader only
+static constexpr uint32_t DOS_LFANEW_OFFSET = 0x3C;
+static constexpr uint32_t PE_SIGNATURE = 0x00004550;
+static constexpr uint32_t OPTIONAL_HEADER_OFFSET = 24; // signature + IMAGE_FILE_HEADER
+static constexpr uint16_t PE32PLUS_MAGIC = 0x20B;
+static constexpr uint32_t SIZE_OF_IMAGE_OFFSET = 56;
+static constexpr uint32_t RVA_AND_SIZES_COUNT_OFFSET = 108;
+static constexpr uint32_t DATA_DIRECTORY_OFFSET = 112;
+static constexpr uint32_t EXCEPTION_DIRECTORY_INDEX = 3;
+
+static constexpr uint8_t UNW_FLAG_CHAININFO = 4;
+static constexpr uint32_t UNWIND_INFO_HEADER_SIZE = 4;
+static constexpr uint32_t EPILOG_MAX_SIZE = 32;
+
+template <class T> static bool readValue (memoryReader & reader, uint64_t address, T & value)
+{
+	return reader.read (address, &value, sizeof (T));
+}
+
+unwinder::unwinder (memoryReader & reader, std::function <uint64_t (uint64_t)> moduleBaseForAddress) : reader (reader)
+{
+	this->moduleBaseForAddress = moduleBaseForAddress;
+}
+bool unwinder::loadModule (uint64_t base, unwindModule & module)
+{
+	module.base = base;
+	module.size = 0;
+
+	uint32_t lfanew, signature, sizeOfImage, directoryCount;
+	uint16_t magic;
+	if (!readValue (reader, base + DOS_LFANEW_OFFSET, lfanew) || !readValue (reader, base + lfanew, signature) || signature != PE_SIGNATURE)
+	{
+		return false;
+	}
+	uint64_t optionalHeader = base + lfanew + OPTIONAL_HEADER_OFFSET;
+	if (!readValue (reader, optionalHeader, magic) || magic != PE32PLUS_MAGIC ||
+		!readValue (reader, optionalHeader + SIZE_OF_IMAGE_OFFSET, sizeOfImage) ||
+		!readValue (reader, optionalHeader + RVA_AND_SIZES_COUNT_OFFSET, directoryCount) || directoryCount <= EXCEPTION_DIRECTORY_INDEX)
+	{
+		return false;
+	}
+	module.size = sizeOfImage;
+
+	uint32_t exceptionDirectory [2]; // VirtualAddress, Size
+	if (!readValue (reader, optionalHeader + DATA_DIRECTORY_OFFSET + EXCEPTION_DIRECTORY_INDEX * 8, exceptionDirectory) ||
+		exceptionDirectory[0] == 0 || exceptionDirectory[0] >= sizeOfImage)
+	{
+		return false;
+	}
+	uint32_t count = std::min <uint32_t> (exceptionDirectory[1] / sizeof (unwindFunction), MAX_PDATA_ENTRIES);
+	module.functions.resize (count);
+	if (count == 0 || !reader.read (base + exceptionDirectory[0], module.functions.data(), count * sizeof (unwindFunction)))
+	{
+		module.functions.clear ();
+		return false;
+	}
+	module.functions.erase (std::remove_if (module.functions.begin(), module.functions.end(),
+		[sizeOfImage] (const unwindFunction & f) { return f.begin >= f.end || f.end > sizeOfImage; }), module.functions.end());
+	if (!std::is_sorted (module.functions.begin(), module.functions.end(), [] (const unwindFunction & a, const unwindFunction & b) { return a.begin < b.begin; }))
+	{
+		std::sort (module.functions.begin(), module.functions.end(), [] (const unwindFunction & a, const unwindFunction & b) { return a.begin < b.begin; });
+	}
+	return true;
+}
+unwinder::unwindModule * unwinder::getModule (uint64_t address)
+{
+	auto it = modules.upper_bound (address);
+	if (it != modules.begin() && address - std::prev (it)->first < std::prev (it)->second.size)
+	{
+		return &std::prev (it)->second;
+	}
+	uint64_t base = moduleBaseForAddress ? moduleBaseForAddress (address) : 0;
+	if (base == 0 || base > address)
+	{
+		return nullptr;
+	}
+	it = modules.find (base);
+	if (it == modules.end())
+	{
+		// remembered even when image has no usable .pdata so it is not read again at every frame
+		unwindModule module;
+		loadModule (base, module);
+		it = modules.emplace (base, std::move (module)).first;
+	}
+	return address - base < it->second.size ? &it->second : nullptr;
+}
+const unwindFunction * unwinder::findFunction (unwindModule & module, uint32_t rva)
+{
+	auto it = std::upper_bound (module.functions.begin(), module.functions.end(), rva, [] (uint32_t v, const unwindFunction & f) { return v < f.begin; });
+	if (it == module.functions.begin() || rva >= (it - 1)->end)
+	{
+		return nullptr;
+	}
+	return &*(it - 1);
+}
+bool unwinder::decodeUnwindInfo (uint64_t base, uint32_t infoRVA, bool primary, unwindProgram & program)
+{
+	for (uint32_t depth = 0; depth < MAX_CHAIN_DEPTH; depth++)
+	{
+		if (infoRVA & 1) // entry points to another RUNTIME_FUNCTION instead of UNWIND_INFO
+		{
+			unwindFunction indirect;
+			if (!readValue (reader, base + (infoRVA & ~1u), indirect))
+			{
+				return false;
+			}
+			infoRVA = indirect.unwindInfo;
+			continue;
+		}
+		uint8_t header [UNWIND_INFO_HEADER_SIZE];
+		if (!readValue (reader, base + infoRVA, header))
+		{
+			return false;
+		}
+		uint8_t version = header[0] & 7;
+		uint8_t flags = header[0] >> 3;
+		uint8_t codeCount = header[2];
+		if (version != 1 && version != 2)
+		{
+			return false;
+		}
+		if (primary)
+		{
+			program.prologSize = header[1];
+			program.frameRegister = header[3] & 0xF;
+			program.frameOffset = (header[3] >> 4) * 16;
+		}
+		else if (program.frameRegister == 0)
+		{
+			program.frameRegister = header[3] & 0xF;
+			program.frameOffset = (header[3] >> 4) * 16;
+		}
+
+		uint32_t slots = (codeCount + 1) & ~1u; // codes are padded to even count
+		std::vector <uint8_t> codes (slots * 2 + ((flags & UNW_FLAG_CHAININFO) ? sizeof (unwindFunction) : 0));
+		if (!codes.empty() && !reader.read (base + infoRVA + UNWIND_INFO_HEADER_SIZE, codes.data(), codes.size()))
+		{
+			return false;
+		}
+		auto slot16 = [&codes] (uint32_t i) -> uint32_t { return codes[i * 2] | (codes[i * 2 + 1] << 8); };
+
+		for (uint32_t i = 0; i < codeCount; )
+		{
+			unwindOp op = { codes[i * 2], (uint8_t) (codes[i * 2 + 1] & 0xF), (uint8_t) (codes[i * 2 + 1] >> 4), 0 };
+			uint32_t size = 1;
+			bool keep = true;
+			switch (op.op)
+			{
+				case UWOP_PUSH_NONVOL:
+				case UWOP_SET_FPREG:
+					break;
+				case UWOP_ALLOC_LARGE:
+					size = op.info == 0 ? 2 : 3;
+					if (i + size <= codeCount)
+					{
+						op.value = op.info == 0 ? slot16 (i + 1) * 8 : slot16 (i + 1) | (slot16 (i + 2) << 16);
+					}
+					break;
+				case UWOP_ALLOC_SMALL:
+					op.value = op.info * 8 + 8;
+					break;
+				case UWOP_SAVE_NONVOL:
+					size = 2;
+					if (i + size <= codeCount)
+					{
+						op.value = slot16 (i + 1) * 8;
+					}
+					break;
+				case UWOP_SAVE_NONVOL_FAR:
+					size = 3;
+					if (i + size <= codeCount)
+					{
+						op.value = slot16 (i + 1) | (slot16 (i + 2) << 16);
+					}
+					break;
+				case UWOP_EPILOG: // epilogs are recognized from code, XMM registers are not restored
+				case UWOP_SAVE_XMM128:
+					size = 2;
+					keep = false;
+					break;
+				case UWOP_SPARE_CODE:
+				case UWOP_SAVE_XMM128_FAR:
+					size = 3;
+					keep = false;
+					break;
+				case UWOP_PUSH_MACHFRAME:
+					op.value = op.info; // 1 when error code was pushed
+					break;
+				default:
+					return false;
+			}
+			if (i + size > codeCount)
+			{
+				return false;
+			}
+			if (keep)
+			{
+				program.ops.push_back (op);
+			}
+			i += size;
+		}
+		if (primary)
+		{
+			program.primaryCount = program.ops.size();
+			primary = false;
+		}
+		if (!(flags & UNW_FLAG_CHAININFO))
+		{
+			return true;
+		}
+		unwindFunction chained;
+		memcpy (&chained, codes.data() + slots * 2, sizeof (chained));
+		infoRVA = chained.unwindInfo;
+	}
+	return false;
+}
+const unwindProgram & unwinder::getProgram (unwindModule & module, const unwindFunction * function)
+{
+	auto it = module.programs.find (function->begin);
+	if (it != module.programs.end())
+	{
+		return it->second;
+	}
+	unwindProgram program;
+	program.valid = decodeUnwindInfo (module.base, function->unwindInfo, true, program);
+	return module.programs.emplace (function->begin, std::move (program)).first->second;
+}
+bool unwinder::popRegister (unwindContext & context, uint64_t & value)
+{
+	if (!readValue (reader, context.regs[UNW_RSP], value))
+	{
+		return false;
+	}
+	context.regs[UNW_RSP] += 8;
+	return true;
+}
+bool unwinder::emulateEpilog (unwindContext & context)
+{
+	// epilog is "add rsp, imm" or "lea rsp, [frame register + disp]", then pops of nonvolatile registers and ret
+	uint8_t code [EPILOG_MAX_SIZE];
+	if (!reader.read (context.rip, code, sizeof (code)))
+	{
+		return false;
+	}
+	unwindContext result = context;
+	uint32_t i = 0;
+	if (code[0] == 0x48 && (code[1] == 0x83 || code[1] == 0x81) && code[2] == 0xC4)
+	{
+		if (code[1] == 0x83)
+		{
+			result.regs[UNW_RSP] += (int8_t) code[3];
+			i = 4;
+		}
+		else
+		{
+			int32_t imm;
+			memcpy (&imm, code + 3, sizeof (imm));
+			result.regs[UNW_RSP] += imm;
+			i = 7;
+		}
+	}
+	else if ((code[0] & 0xFE) == 0x48 && code[1] == 0x8D && ((code[2] >> 3) & 7) == UNW_RSP &&
+		(code[2] >> 6) != 0 && (code[2] >> 6) != 3 && (code[2] & 7) != 4)
+	{
+		uint8_t base = (code[2] & 7) | ((code[0] & 1) << 3);
+		int32_t disp;
+		if ((code[2] >> 6) == 1)
+		{
+			disp = (int8_t) code[3];
+			i = 4;
+		}
+		else
+		{
+			memcpy (&disp, code + 3, sizeof (disp));
+			i = 7;
+		}
+		result.regs[UNW_RSP] = result.regs[base] + disp;
+	}
+	while (i < sizeof (code))
+	{
+		if ((code[i] & 0xF8) == 0x58)
+		{
+			if (!popRegister (result, result.regs[code[i] & 7]))
+			{
+				return false;
+			}
+			i += 1;
+		}
+		else if (code[i] == 0x41 && i + 1 < sizeof (code) && (code[i + 1] & 0xF8) == 0x58)
+		{
+			if (!popRegister (result, result.regs[8 + (code[i + 1] & 7)]))
+			{
+				return false;
+			}
+			i += 2;
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (i < sizeof (code) && (code[i] == 0xC3 || (code[i] == 0xF3 && i + 1 < sizeof (code) && code[i + 1] == 0xC3)))
+	{
+		if (!popRegister (result, result.rip))
+		{
+			return false;
+		}
+		context = result;
+		return true;
+	}
+	return false;
+}
+bool unwinder::step (unwindContext & context, unwindFrame & frame)
+{
+	frame.rip = context.rip;
+	frame.rsp = context.regs[UNW_RSP];
+	frame.moduleBase = 0;
+	frame.leaf = false;
+
+	unwindModule * module = getModule (context.rip);
+	const unwindFunction * function = module ? findFunction (*module, context.rip - module->base) : nullptr;
+	const unwindProgram * program = function ? &getProgram (*module, function) : nullptr;
+	if (module)
+	{
+		frame.moduleBase = module->base;
+	}
+	if (!program || !program->valid)
+	{
+		// leaf function does not touch rsp and has no .pdata entry
+		frame.leaf = true;
+		return popRegister (context, context.rip);
+	}
+
+	uint64_t prologOffset = context.rip - module->base - function->begin;
+	if (prologOffset >= program->prologSize && emulateEpilog (context))
+	{
+		return true;
+	}
+
+	uint64_t frameBase = context.regs[UNW_RSP];
+	if (program->frameRegister != 0)
+	{
+		bool frameEstablished = prologOffset >= program->prologSize;
+		for (uint32_t i = 0; i < program->ops.size() && !frameEstablished; i++)
+		{
+			frameEstablished = program->ops[i].op == UWOP_SET_FPREG && (i >= program->primaryCount || program->ops[i].codeOffset <= prologOffset);
+		}
+		if (frameEstablished)
+		{
+			frameBase = context.regs[program->frameRegister] - program->frameOffset;
+		}
+	}
+
+	bool machineFrame = false;
+	for (uint32_t i = 0; i < program->ops.size(); i++)
+	{
+		const unwindOp & op = program->ops[i];
+		if (i < program->primaryCount && op.codeOffset > prologOffset)
+		{
+			continue; // this part of prolog has not executed yet
+		}
+		switch (op.op)
+		{
+			case UWOP_PUSH_NONVOL:
+				if (!popRegister (context, context.regs[op.info]))
+				{
+					return false;
+				}
+				break;
+			case UWOP_ALLOC_LARGE:
+			case UWOP_ALLOC_SMALL:
+				context.regs[UNW_RSP] += op.value;
+				break;
+			case UWOP_SET_FPREG:
+				context.regs[UNW_RSP] = frameBase;
+				break;
+			case UWOP_SAVE_NONVOL:
+			case UWOP_SAVE_NONVOL_FAR:
+				if (!readValue (reader, frameBase + op.value, context.regs[op.info]))
+				{
+					return false;
+				}
+				break;
+			case UWOP_PUSH_MACHFRAME:
+			{
+				uint64_t trapFrame = context.regs[UNW_RSP] + (op.value ? 8 : 0); // RIP, CS, EFLAGS, old RSP, SS
+				if (!readValue (reader, trapFrame, context.rip) || !readValue (reader, trapFrame + 24, context.regs[UNW_RSP]))
+				{
+					return false;
+				}
+				machineFrame = true;
+				break;
+			}
+		}
+	}
+	return machineFrame ? true : popRegister (context, context.rip);
+}
+std::vector <unwindFrame> unwinder::walk (unwindContext context, size_t maxFrames)
+{
+	std::vector <unwindFrame> frames;
+	while (frames.size() < maxFrames && context.rip != 0)
+	{
+		unwindFrame frame;
+		if (!step (context, frame))
+		{
+			break;
+		}
+		frames.push_back (frame);
+		if (context.regs[UNW_RSP] <= frame.rsp) // stack has to grow towards callers, otherwise it is corrupted
+		{
+			break;
+		}
+	}
+	return frames;
+}
+void unwinder::removeModule (uint64_t base)
+{
+	modules.erase (base);
+}
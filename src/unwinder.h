@@ -0,0 +1,109 @@
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+
+// x64 stack unwinder driven by .pdata (RUNTIME_FUNCTION) and UNWIND_INFO of loaded images
+// it does not depend on DbgHelp or on live process, all memory goes through memoryReader
+
+class memoryReader
+{
+	public:
+		virtual ~memoryReader () = default;
+		virtual bool read (uint64_t address, void * buffer, size_t size) = 0; // whole range or nothing
+};
+
+enum unwindRegister // numbering used by UNWIND_CODE
+{
+	UNW_RAX = 0, UNW_RCX, UNW_RDX, UNW_RBX, UNW_RSP, UNW_RBP, UNW_RSI, UNW_RDI,
+	UNW_R8, UNW_R9, UNW_R10, UNW_R11, UNW_R12, UNW_R13, UNW_R14, UNW_R15
+};
+
+struct unwindContext
+{
+	uint64_t rip;
+	uint64_t regs [16]; // indexed by unwindRegister
+};
+
+struct unwindFunction // same layout as RUNTIME_FUNCTION
+{
+	uint32_t begin;
+	uint32_t end;
+	uint32_t unwindInfo;
+};
+
+struct unwindOp
+{
+	uint8_t codeOffset; // prolog offset after this operation, meaningful only for primary function
+	uint8_t op;
+	uint8_t info; // register number for push/save operations
+	uint32_t value; // decoded size or offset in bytes
+};
+
+struct unwindProgram // UNWIND_INFO with all chained entries decoded into one list
+{
+	bool valid = false;
+	uint8_t prologSize = 0;
+	uint8_t frameRegister = 0;
+	uint32_t frameOffset = 0; // in bytes
+	uint32_t primaryCount = 0; // operations [primaryCount, ops.size()) come from chained entries and are always executed
+	std::vector <unwindOp> ops;
+};
+
+struct unwindFrame
+{
+	uint64_t rip;
+	uint64_t rsp;
+	uint64_t moduleBase; // 0 when frame is outside any known image
+	bool leaf; // no .pdata entry, return address was taken from top of stack
+};
+
+class unwinder
+{
+	private:
+		static constexpr uint32_t MAX_CHAIN_DEPTH = 32;
+		static constexpr uint32_t MAX_PDATA_ENTRIES = 0x200000;
+
+		enum unwindOpCode
+		{
+			UWOP_PUSH_NONVOL = 0,
+			UWOP_ALLOC_LARGE,
+			UWOP_ALLOC_SMALL,
+			UWOP_SET_FPREG,
+			UWOP_SAVE_NONVOL,
+			UWOP_SAVE_NONVOL_FAR,
+			UWOP_EPILOG, // UWOP_SAVE_XMM in version 1
+			UWOP_SPARE_CODE, // UWOP_SAVE_XMM_FAR in version 1
+			UWOP_SAVE_XMM128,
+			UWOP_SAVE_XMM128_FAR,
+			UWOP_PUSH_MACHFRAME
+		};
+		struct unwindModule
+		{
+			uint64_t base;
+			uint64_t size;
+			std::vector <unwindFunction> functions; // sorted by begin
+			std::unordered_map <uint32_t, unwindProgram> programs; // by function begin RVA
+		};
+
+		memoryReader & reader;
+		std::function <uint64_t (uint64_t)> moduleBaseForAddress; // 0 if address is not in image
+		std::map <uint64_t, unwindModule> modules;
+
+		unwindModule * getModule (uint64_t);
+		bool loadModule (uint64_t, unwindModule &);
+		const unwindFunction * findFunction (unwindModule &, uint32_t);
+		const unwindProgram & getProgram (unwindModule &, const unwindFunction *);
+		bool decodeUnwindInfo (uint64_t, uint32_t, bool, unwindProgram &);
+		bool emulateEpilog (unwindContext &);
+		bool popRegister (unwindContext &, uint64_t &);
+	public:
+		unwinder (memoryReader &, std::function <uint64_t (uint64_t)>);
+		bool step (unwindContext &, unwindFrame &); // context becomes caller context
+		std::vector <unwindFrame> walk (unwindContext, size_t maxFrames);
+		void removeModule (uint64_t);
+		void clear () { modules.clear (); }
+};
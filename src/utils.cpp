@@ -86,16 +86,26 @@ command * parseCommand (std::string c)
     std::regex exitRegex ("^(e|exit)\\s*$");
     std::regex softBreakpointRegex ("^(b|br|bp|breakpoint)\\s+(0x)?([0-9a-fA-F]+)\\s*$");
     std::regex disasmRegex ("^(disasm|disassembly)\\s+(0x)?([0-9a-fA-F]+)\\s+((0x[0-9a-fA-F]+)|([0-9]+))$");
+    std::regex disasmBackwardRegex ("^(disasm|disassembly)\\s+-([0-9]+)\\s+(0x)?([0-9a-fA-F]+)\\s*$");
     std::regex stepInRegex ("^(si|step in|s i)\\s*$");
     std::regex nextInstructionRegex ("^(ni|next instruction|n i)\\s*$");
     std::regex showBreakpointsRegex ("^(bl|show breakpoints|b l|b list)\\s*$");
     std::regex removeBreakpointRegex ("^(bd|b delete|breakpoint delete)\\s+(([0-9]+)|0x([0-9a-fA-F]+))$");
+    std::regex hardBreakpointRegex ("^(hb|hardware breakpoint)\\s+(0x)?([0-9a-fA-F]+)(\\s+(x|w|rw))?(\\s+(1|2|4|8))?\\s*$");
+    std::regex hardBreakpointDeleteRegex ("^(hd|hardware delete)\\s+([0-3])\\s*$");
+    std::regex breakpointFunctionsRegex ("^(bf|break functions)\\s*$");
+    std::regex clearBreakpointsRegex ("^(bc|b clear|breakpoint clear)\\s*$");
     std::regex memoryMappingsRegex ("^(vmmap|memory mappings|map)\\s*$");
     std::regex hexdumpRegex ("^(h|hexdump|hex)\\s+0x([0-9a-fA-F]+)\\s+([0-9]+)\\s*$");
     std::regex setRegistersRegex ("^(sr|set register)\\s+((R|r)(ax|AX|bx|BX|cx|CX|dx|DX|bp|BP|sp|SP|si|SI|di|DI|8|9|10|11|12|13|14|15|flags|FLAGS))\\s+(0x)?([0-9a-fA-F]+)\\s*$");
     std::regex writeMemoryRegex ("^(wm|write memory)\\s+((0x)([0-9a-fA-F]+))\\s+([0-9]+)\\s+((0x)?([0-9a-fA-F]+))");
     std::regex helpRegex ("^help\\s*$");
     std::regex backtraceRegex ("^(bt|backtrace)\\s*$");
+    std::regex listingRegex ("^(listing|sweep)\\s+(\\S+)\\s*$");
+    std::regex controlFlowGraphRegex ("^(cfg|blocks)\\s+(0x)?([0-9a-fA-F]+)\\s*$");
+    std::regex xrefsRegex ("^(xrefs|xr)\\s+(0x)?([0-9a-fA-F]+)\\s*$");
+    std::regex exceptionPolicyRegex ("^(policy|ep)(\\s+(\\S+)\\s+(stop|log|pass))?\\s*$");
+    std::regex eventStatsRegex ("^(events|ev)\\s*$");
     std::smatch match;
 
     if (std::regex_search(c, match, helpRegex))
@@ -183,6 +193,37 @@ command * parseCommand (std::string c)
         }
         return comm;
     }
+    else if (std::regex_match (c, match, hardBreakpointRegex))
+    {
+        comm->type = commandType::HARD_BREAKPOINT;
+        comm->arguments.push_back ( {argumentType::ADDRESS, match[3].str()} );
+        comm->arguments.push_back ( {argumentType::STRING, match[5].matched ? match[5].str() : "x"} );
+        comm->arguments.push_back ( {argumentType::NUMBER, match[7].matched ? match[7].str() : "1"} );
+        return comm;
+    }
+    else if (std::regex_match (c, match, hardBreakpointDeleteRegex))
+    {
+        comm->type = commandType::HARD_BREAKPOINT_DELETE;
+        comm->arguments.push_back ( {argumentType::NUMBER, match[2].str()} );
+        return comm;
+    }
+    else if (std::regex_match (c, match, breakpointFunctionsRegex))
+    {
+        comm->type = commandType::BREAKPOINT_FUNCTIONS;
+        return comm;
+    }
+    else if (std::regex_match (c, match, clearBreakpointsRegex))
+    {
+        comm->type = commandType::BREAKPOINT_CLEAR;
+        return comm;
+    }
+    else if (std::regex_match (c, match, disasmBackwardRegex))
+    {
+        comm->type = commandType::DISASM;
+        comm->arguments.push_back ( {argumentType::ADDRESS, match[4].str()} );
+        comm->arguments.push_back ( {argumentType::NUMBER, "-" + match[2].str()} );
+        return comm;
+    }
     else if (std::regex_match (c, match, disasmRegex))
     {
         comm->type = commandType::DISASM;
@@ -190,6 +231,39 @@ command * parseCommand (std::string c)
         comm->arguments.push_back ( {argumentType::NUMBER, match[4].str()} );
         return comm;
     }
+    else if (std::regex_match (c, match, exceptionPolicyRegex))
+    {
+        comm->type = commandType::EXCEPTION_POLICY;
+        if (match[2].matched)
+        {
+            comm->arguments.push_back ( {argumentType::STRING, match[3].str()} );
+            comm->arguments.push_back ( {argumentType::STRING, match[4].str()} );
+        }
+        return comm;
+    }
+    else if (std::regex_match (c, match, eventStatsRegex))
+    {
+        comm->type = commandType::EVENT_STATS;
+        return comm;
+    }
+    else if (std::regex_match (c, match, xrefsRegex))
+    {
+        comm->type = commandType::XREFS;
+        comm->arguments.push_back ( {argumentType::ADDRESS, match[3].str()} );
+        return comm;
+    }
+    else if (std::regex_match (c, match, controlFlowGraphRegex))
+    {
+        comm->type = commandType::CONTROL_FLOW_GRAPH;
+        comm->arguments.push_back ( {argumentType::ADDRESS, match[3].str()} );
+        return comm;
+    }
+    else if (std::regex_match (c, match, listingRegex))
+    {
+        comm->type = commandType::LISTING;
+        comm->arguments.push_back ( {argumentType::STRING, match[2].str()} );
+        return comm;
+    }
     else if (std::regex_match (c, match, hexdumpRegex))
     {
         comm->type = commandType::HEXDUMP;
@@ -233,17 +307,27 @@ void printHelp ()
     puts ("breakpoint, b, bp, br <hex address> - place int3 breakpoint\n");
     puts ("context - show context of current thread\n");
     puts ("disasm, disassembly <hex address> <count_decimal> - disassembly code at given address\n");
+    puts ("disasm, disassembly -<count_decimal> <hex address> - disassembly code ending at given address\n");
     puts ("continue, c - continue execution of program\n");
     puts ("exit, e - exit from debugger\n");
     puts ("step in, si, s i - step in by single instruction\n");
     puts ("next instruction, ni, n i - go to next instruction\n");
     puts ("show breakpoints, bl, breakpoint list - show active breakpoints\n");
-    puts ("breakpoint delete, bd, b delete <index/hex address> - delete breakpoint by index (obtained by bl) or address\n");
+    puts ("breakpoint delete, bd, b delete <id/hex address> - delete breakpoint by id (obtained by bl) or address\n");
+    puts ("break functions, bf - place int3 breakpoint at every function start of debugged image\n");
+    puts ("breakpoint clear, bc, b clear - delete all breakpoints\n");
+    puts ("hardware breakpoint, hb <hex address> [x/w/rw] [1/2/4/8] - break on execution, write or access in debug register\n");
+    puts ("hardware delete, hd <0-3> - delete hardware breakpoint in DR0-DR3\n");
     puts ("memory mappings, vmmap, map - show map of whole virtual memory for this process\n");
     puts ("hexdump, hex, h <hex address> <size_decimal>\n");
     puts ("set register, sr <register name> <hex value> - sets specified register with given value\n");
     puts ("write memory, wm <hex address> <size_decimal> <hex value> - write value to memory\n");
-    puts ("backtrace, bt - show call stack of current thread");
+    puts ("backtrace, bt - show call stack of current thread\n");
+    puts ("listing, sweep <file> - disassemble executable sections of debugged image to file\n");
+    puts ("cfg, blocks <hex address> - basic blocks of function containing address with their successors\n");
+    puts ("xrefs, xr <hex address> - calls, jumps and RIP relative references to address in debugged image\n");
+    puts ("policy, ep [<exception name/hex code/default> <stop/log/pass>] - show or set what happens on exception\n");
+    puts ("events, ev - number of debug events and events per second");
 }
 void centerText (const char *text, int fieldWidth) 
 {
@@ -284,6 +368,25 @@ uint64_t alignMemoryPageSize (uint64_t size)
     return size;
 }
 
+uint64_t hashBytes (const uint8_t * data, uint64_t size) // fast non cryptographic hash, 8 bytes per step
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15;
+    uint64_t h = size ^ 0xcbf29ce484222325;
+    uint64_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy (&word, data + i, 8);
+        h = (h ^ (word * prime)) * 0xff51afd7ed558ccd;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++)
+    {
+        h = (h ^ data[i]) * prime;
+    }
+    h ^= h >> 32;
+    return h;
+}
 std::string intToHex( uint64_t i )
 {
   std::stringstream stream;
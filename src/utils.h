@@ -8,6 +8,8 @@
 #include <iomanip>
 #include <sstream>
 
+#include "dataSpan.h"
+
 enum logType
 {
     THREAD = 2,
@@ -41,6 +43,14 @@ enum class commandType
     WRITE_MEMORY_INT = 16,
     HELP = 17,
     BACKTRACE = 18,
+    LISTING = 19,
+    CONTROL_FLOW_GRAPH = 20,
+    XREFS = 21,
+    EXCEPTION_POLICY = 22,
+    EVENT_STATS = 23,
+    BREAKPOINT_FUNCTIONS = 24,
+    BREAKPOINT_CLEAR = 25,
+    HARD_BREAKPOINT_DELETE = 26,
     UNKNOWN = 0xFF
 };
 
@@ -62,6 +72,16 @@ struct command
     std::vector <commandArgument> arguments;
 };
 
+struct latencyStats // microseconds
+{
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+
+    void add (uint64_t value) { count++; total += value; maximum = value > maximum ? value : maximum; }
+    double average () const { return count ? (double) total / count : 0.0; }
+};
+
 DWORD getCurrentPromptColor (HANDLE);
 void printfColor (const char *, DWORD, HANDLE, ... );
 void log (const char *, logType, HANDLE,  ...);
@@ -73,4 +93,5 @@ void centerText(const char *, int);
 void centerTextColor (const char *, int , DWORD, HANDLE); 
 void centerTextColorDecorate (const char *, int, DWORD, HANDLE );
 uint64_t alignMemoryPageSize (uint64_t);
+uint64_t hashBytes (const uint8_t *, uint64_t);
 std::string intToHex( uint64_t i );
\ No newline at end of file
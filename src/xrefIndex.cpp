@@ -0,0 +1,161 @@
+#include "xrefIndex.h"
+#include "disassembly.h"
+#include "parallel.h"
+
+void xrefIndex::collectUnit (csh handle, cs_insn * insn, dataSpan<uint8_t> image, uint64_t base, const unitTask & task,
+	const std::function <uint32_t (uint64_t)> & pointerSlotWidth, std::vector <reference> & references)
+{
+	spanMemoryReader reader (image, base);
+	uint64_t streamSize = std::min (task.unit.end + MAX_INSTRUCTION_LENGTH, task.range.size) - task.unit.begin; // last instruction may cross unit end
+	instructionStream stream (handle, reader, task.range.address + task.unit.begin, streamSize);
+	auto inImage = [&] (uint64_t address) { return address >= base && address - base < image.size(); };
+
+	while (stream.getAddress() < task.range.address + task.unit.end)
+	{
+		uint64_t current = stream.getAddress();
+		uint32_t slotWidth = pointerSlotWidth ? pointerSlotWidth (current) : 0;
+		if (slotWidth)
+		{
+			uint64_t target = 0;
+			if (slotWidth <= image.size() && current - base <= image.size() - slotWidth)
+			{
+				memcpy (&target, image.data + (current - base), slotWidth);
+			}
+			if (!stream.skip (slotWidth))
+			{
+				break;
+			}
+			if (inImage (target))
+			{
+				references.push_back ( { target, { current, XREF_DATA } } );
+			}
+			continue;
+		}
+		const cs_insn * decoded = stream.next ();
+		if (!decoded)
+		{
+			if (!stream.skipByte ())
+			{
+				break;
+			}
+			continue;
+		}
+		const cs_x86 & x86 = decoded->detail->x86;
+		instructionType type = disassembler::getInstructionType (*decoded, decoded->detail);
+		if ((type.X86_GRP_CALL || type.X86_GRP_JUMP) && x86.op_count == 1 && x86.operands[0].type == X86_OP_IMM)
+		{
+			if (inImage (x86.operands[0].imm))
+			{
+				references.push_back ( { (uint64_t) x86.operands[0].imm, { decoded->address, (uint8_t) (type.X86_GRP_CALL ? XREF_CALL : XREF_JUMP) } } );
+			}
+			continue;
+		}
+		for (uint8_t i = 0; i < x86.op_count; i++) // at most one operand can be RIP relative
+		{
+			if (x86.operands[i].type == X86_OP_MEM && x86.operands[i].mem.base == X86_REG_RIP)
+			{
+				uint64_t target = X86_REL_ADDR (*decoded);
+				uint8_t referenceType = type.X86_GRP_CALL ? XREF_CALL : (type.X86_GRP_JUMP ? XREF_JUMP : XREF_DATA);
+				if (inImage (target))
+				{
+					references.push_back ( { target, { decoded->address, referenceType } } );
+				}
+				break;
+			}
+		}
+	}
+}
+bool xrefIndex::build (dataSpan<uint8_t> image, uint64_t base, const std::vector <xrefCodeRange> & ranges, const std::vector <uint64_t> & functionStarts, unsigned workers,
+	std::function <uint32_t (uint64_t)> pointerSlotWidth)
+{
+	clear ();
+	std::vector <unitTask> tasks;
+	for (const auto & range : ranges)
+	{
+		if (range.address < base || range.address - base > image.size() || range.size > image.size() - (range.address - base))
+		{
+			continue;
+		}
+		for (const auto & unit : splitSweepUnits (range.size, range.address, functionStarts, UNIT_SIZE))
+		{
+			tasks.push_back ( { range, unit } );
+		}
+	}
+	workers = std::max (1u, std::min <unsigned> (workers, tasks.size()));
+
+	std::vector <csh> handles (workers);
+	std::vector <cs_insn *> insns (workers, nullptr);
+	unsigned opened = 0;
+	for (; opened < workers; opened++)
+	{
+		if (cs_open (CS_ARCH_X86, CS_MODE_64, &handles[opened]) != CS_ERR_OK)
+		{
+			break;
+		}
+		cs_option (handles[opened], CS_OPT_DETAIL, CS_OPT_ON);
+		insns[opened] = cs_malloc (handles[opened]);
+	}
+	std::vector <std::vector <reference> > results (tasks.size());
+	if (opened == workers)
+	{
+		parallelSteal (tasks.size(), workers, [&] (unsigned worker, size_t index)
+		{
+			collectUnit (handles[worker], insns[worker], image, base, tasks[index], pointerSlotWidth, results[index]);
+		});
+	}
+	for (unsigned i = 0; i < opened; i++)
+	{
+		cs_free (insns[i], 1);
+		cs_close (&handles[i]);
+	}
+	if (opened != workers)
+	{
+		return false;
+	}
+
+	std::vector <reference> all;
+	size_t total = 0;
+	for (const auto & result : results)
+	{
+		total += result.size();
+	}
+	all.reserve (total);
+	for (auto & result : results)
+	{
+		all.insert (all.end(), result.begin(), result.end());
+		std::vector <reference> ().swap (result);
+	}
+	std::sort (all.begin(), all.end(), [] (const reference & a, const reference & b)
+	{
+		return a.target < b.target || (a.target == b.target && a.source.address < b.source.address);
+	});
+
+	sources.reserve (all.size());
+	for (const auto & r : all)
+	{
+		if (targets.empty() || targets.back() != r.target)
+		{
+			targets.push_back (r.target);
+			offsets.push_back ((uint32_t) sources.size());
+		}
+		sources.push_back (r.source);
+	}
+	offsets.push_back ((uint32_t) sources.size());
+	return true;
+}
+void xrefIndex::clear ()
+{
+	targets.clear ();
+	offsets.clear ();
+	sources.clear ();
+}
+dataSpan<xrefSource> xrefIndex::referencesTo (uint64_t target) const
+{
+	auto it = std::lower_bound (targets.begin(), targets.end(), target);
+	if (it == targets.end() || *it != target)
+	{
+		return {};
+	}
+	size_t i = it - targets.begin();
+	return { sources.data() + offsets[i], offsets[i + 1] - offsets[i] };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+#include <functional>
+
+#include <capstone/capstone.h>
+#include "utils.h"
+#include "linearSweep.h"
+
+// Cross references of one module found by linear sweep of its executable sections: targets of direct calls and jumps
+// and RIP relative memory operands. Stored like CSR matrix, sorted unique targets with offsets into one array of sources,
+// so all references to address are one binary search away.
+
+enum xrefType : uint8_t
+{
+	XREF_CALL = 0, // call rel32 or call [rip + x] (target is pointer slot)
+	XREF_JUMP = 1, // jmp, jcc or jmp [rip + x]
+	XREF_DATA = 2 // any other instruction with RIP relative operand (lea, mov, cmp ...) or pointer slot in code
+};
+
+struct xrefSource
+{
+	uint64_t address; // referencing instruction
+	uint8_t type; // xrefType
+};
+
+struct xrefCodeRange
+{
+	uint64_t address; // executable section as mapped
+	uint64_t size;
+};
+
+class xrefIndex
+{
+	private:
+		static constexpr uint64_t UNIT_SIZE = 0x40000;
+		static constexpr uint64_t MAX_INSTRUCTION_LENGTH = 15;
+
+		struct reference
+		{
+			uint64_t target;
+			xrefSource source;
+		};
+		struct unitTask
+		{
+			xrefCodeRange range;
+			sweepUnit unit;
+		};
+
+		std::vector <uint64_t> targets; // sorted, unique
+		std::vector <uint32_t> offsets; // sources of targets [i] are sources [offsets [i], offsets [i + 1])
+		std::vector <xrefSource> sources; // sorted by address for every target
+
+		static void collectUnit (csh, cs_insn *, dataSpan<uint8_t>, uint64_t, const unitTask &, const std::function <uint32_t (uint64_t)> &, std::vector <reference> &);
+	public:
+		// image in memory layout at base, function starts (sorted) are used to split sections for workers,
+		// pointer slots (base relocations) inside code are not decoded, address stored in them is data reference
+		bool build (dataSpan<uint8_t>, uint64_t, const std::vector <xrefCodeRange> &, const std::vector <uint64_t> &, unsigned,
+			std::function <uint32_t (uint64_t)> pointerSlotWidth = nullptr);
+		void clear ();
+
+		dataSpan<xrefSource> referencesTo (uint64_t) const; // empty when nothing references address
+		size_t targetCount () const { return targets.size(); }
+		size_t size () const { return sources.size(); }
+};
@@ -0,0 +1,115 @@
+// DR7 encoding and slot allocation of hardware breakpoints against fake context, runs on any host
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "debugRegisterSlots.h"
+
+struct fakeContext // debug register fields as CONTEXT names them
+{
+	uint64_t Dr0, Dr1, Dr2, Dr3, Dr6, Dr7;
+	uint64_t Rax; // must not be touched
+};
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf ("FAILED %s:%d %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static void testValidation ()
+{
+	CHECK (debugRegisterSlots::isValid (0x1001, hardwareCondition::EXECUTE, 1));
+	CHECK (!debugRegisterSlots::isValid (0x1000, hardwareCondition::EXECUTE, 4)); // execute watches one byte
+	CHECK (debugRegisterSlots::isValid (0x1008, hardwareCondition::WRITE, 8));
+	CHECK (!debugRegisterSlots::isValid (0x1004, hardwareCondition::WRITE, 8)); // unaligned
+	CHECK (!debugRegisterSlots::isValid (0x1001, hardwareCondition::READ_WRITE, 2));
+	CHECK (!debugRegisterSlots::isValid (0x1000, hardwareCondition::READ_WRITE, 3));
+}
+static void testAllocation ()
+{
+	debugRegisterSlots slots;
+	CHECK (slots.empty () && slots.getDr7 () == 0);
+	CHECK (slots.allocate (0x1000, hardwareCondition::EXECUTE, 1) == 0);
+	CHECK (slots.allocate (0x2000, hardwareCondition::WRITE, 8) == 1);
+	CHECK (slots.allocate (0x1000, hardwareCondition::EXECUTE, 1) == debugRegisterSlots::NO_SLOT); // already set
+	CHECK (slots.allocate (0x1000, hardwareCondition::WRITE, 1) == 2); // same address, other condition
+	CHECK (slots.allocate (0x3002, hardwareCondition::READ_WRITE, 2) == 3);
+	CHECK (slots.allocate (0x5000, hardwareCondition::WRITE, 1) == debugRegisterSlots::NO_SLOT); // all used
+	CHECK (slots.find (0x2000, hardwareCondition::WRITE) == 1);
+	CHECK (slots.find (0x2000, hardwareCondition::EXECUTE) == debugRegisterSlots::NO_SLOT);
+
+	CHECK (slots.release (1) && !slots.release (1) && !slots.release (4) && !slots.release (debugRegisterSlots::NO_SLOT));
+	CHECK (slots.allocate (0x6000, hardwareCondition::EXECUTE, 1) == 1); // freed slot is reused
+	for (int i = 0; i < debugRegisterSlots::SLOT_COUNT; i++)
+	{
+		slots.release (i);
+	}
+	CHECK (slots.empty ());
+}
+static void testDr7Encoding ()
+{
+	debugRegisterSlots slots;
+	slots.allocate (0x1000, hardwareCondition::EXECUTE, 1); // L0, R/W 00, LEN 00
+	slots.allocate (0x2000, hardwareCondition::WRITE, 8); // L1, R/W 01, LEN 10
+	slots.allocate (0x3000, hardwareCondition::READ_WRITE, 4); // L2, R/W 11, LEN 11
+	slots.allocate (0x4002, hardwareCondition::WRITE, 2); // L3, R/W 01, LEN 01
+	uint64_t expected = (1 << 0) | (1 << 2) | (1 << 4) | (1 << 6) |
+		(1ull << 20) | (2ull << 22) |
+		(3ull << 24) | (3ull << 26) |
+		(1ull << 28) | (1ull << 30);
+	CHECK (slots.getDr7 () == expected);
+
+	slots.release (1);
+	CHECK (slots.getDr7 () == (expected & ~((1ull << 2) | (0xFull << 20))));
+}
+static void testApply ()
+{
+	debugRegisterSlots slots;
+	slots.allocate (0x1000, hardwareCondition::EXECUTE, 1);
+	slots.allocate (0x2000, hardwareCondition::WRITE, 4);
+
+	fakeContext context;
+	memset (&context, 0, sizeof (context));
+	context.Dr3 = 0xdead; // stale address of slot not used any more
+	context.Dr6 = 0x4001;
+	context.Dr7 = 0x400 | 0xFF | 0xFFFF0000; // reserved bit 10 and slot bits of somebody else
+	context.Rax = 7;
+	slots.applyTo (context);
+	CHECK (context.Dr0 == 0x1000 && context.Dr1 == 0x2000 && context.Dr2 == 0 && context.Dr3 == 0);
+	CHECK (context.Dr7 == (0x400 | slots.getDr7 ()));
+	CHECK (context.Dr6 == 0x4001 && context.Rax == 7);
+
+	for (int i = 0; i < debugRegisterSlots::SLOT_COUNT; i++)
+	{
+		slots.release (i);
+	}
+	slots.applyTo (context);
+	CHECK (context.Dr0 == 0 && context.Dr1 == 0 && context.Dr7 == 0x400);
+}
+static void testHitSlot ()
+{
+	CHECK (debugRegisterSlots::hitSlot (0) == debugRegisterSlots::NO_SLOT);
+	CHECK (debugRegisterSlots::hitSlot (0x4000) == debugRegisterSlots::NO_SLOT); // BS, single step only
+	CHECK (debugRegisterSlots::hitSlot (0x4000 | 4) == 2);
+	CHECK (debugRegisterSlots::hitSlot (0xFFFF0FF8) == 3);
+	CHECK (debugRegisterSlots::hitSlot (0x3) == 0);
+}
+static void testConditionNames ()
+{
+	hardwareCondition condition;
+	CHECK (debugRegisterSlots::parseCondition ("x", condition) && condition == hardwareCondition::EXECUTE);
+	CHECK (debugRegisterSlots::parseCondition ("w", condition) && condition == hardwareCondition::WRITE);
+	CHECK (debugRegisterSlots::parseCondition ("rw", condition) && condition == hardwareCondition::READ_WRITE);
+	CHECK (!debugRegisterSlots::parseCondition ("r", condition));
+	CHECK (!strcmp (debugRegisterSlots::getConditionName (hardwareCondition::READ_WRITE), "read/write"));
+}
+
+int main ()
+{
+	testValidation ();
+	testAllocation ();
+	testDr7Encoding ();
+	testApply ();
+	testHitSlot ();
+	testConditionNames ();
+	printf ("%s\n", failures ? "debugRegistersTest failed" : "debugRegistersTest passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+// Table length decoder on hand picked instructions, prefix order cases capstone agrees on
+#include <stdio.h>
+#include <vector>
+#include "instructionLength.h"
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf ("FAILED %s:%d %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+struct lengthCase
+{
+	const char * name;
+	std::vector <uint8_t> code;
+	uint8_t length;
+	uint8_t branch;
+};
+
+static const lengthCase cases [] =
+{
+	{ "ret", { 0xC3 }, 1, BRANCH_RETURN },
+	{ "call rel32", { 0xE8, 0, 0, 0, 0 }, 5, BRANCH_CALL },
+	{ "jz rel32", { 0x0F, 0x84, 0x10, 0, 0, 0 }, 6, BRANCH_CONDITIONAL },
+	{ "call [rip + disp32]", { 0xFF, 0x15, 0, 0x10, 0, 0 }, 6, BRANCH_INDIRECT_CALL },
+	{ "mov rax, imm64", { 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, 10, BRANCH_NONE },
+	{ "mov ax, imm16", { 0x66, 0xB8, 0x34, 0x12 }, 4, BRANCH_NONE },
+	{ "mov eax, [eax]", { 0x67, 0x8B, 0x00 }, 3, BRANCH_NONE },
+	// REX is ignored when legacy prefix or another REX follows it, only the one right before opcode counts
+	{ "rex.w 66 mov ax, imm16", { 0x48, 0x66, 0xB8, 0x34, 0x12 }, 5, BRANCH_NONE },
+	{ "rex.w 66 mov word [rax], imm16", { 0x48, 0x66, 0xC7, 0x00, 0x34, 0x12 }, 6, BRANCH_NONE },
+	{ "rex.w f3 mov eax, imm32", { 0x48, 0xF3, 0xB8, 1, 2, 3, 4 }, 7, BRANCH_NONE },
+	{ "66 rex.w mov rax, imm64", { 0x66, 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, 11, BRANCH_NONE },
+	{ "66 rex.w mov qword [rax], imm32", { 0x66, 0x48, 0xC7, 0x00, 1, 2, 3, 4 }, 8, BRANCH_NONE },
+	{ "rex.w rex mov eax, imm32", { 0x48, 0x40, 0xB8, 1, 2, 3, 4 }, 7, BRANCH_NONE },
+	{ "rex rex.w mov rax, imm64", { 0x40, 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, 11, BRANCH_NONE },
+	// not instructions
+	{ "prefixes only", { 0x66, 0x48 }, 0, BRANCH_NONE },
+	{ "truncated call", { 0xE8, 0, 0 }, 0, BRANCH_NONE },
+	{ "longer than 15 bytes", { 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, 0, BRANCH_NONE },
+};
+
+static void testCases ()
+{
+	for (const auto & c : cases)
+	{
+		instructionLength decoded = getInstructionLength (c.code.data(), c.code.size());
+		if (decoded.length != c.length || decoded.branch != c.branch)
+		{
+			printf ("FAILED %s: length %u branch %u, expected %u %u\n", c.name, decoded.length, decoded.branch, c.length, c.branch);
+			failures++;
+		}
+	}
+}
+static void testRelative ()
+{
+	const uint8_t jump [] = { 0xEB, 0xFE };
+	instructionLength decoded = getInstructionLength (jump, sizeof (jump));
+	CHECK (decoded.branch == BRANCH_JUMP && decoded.displacement == -2 && decoded.getTarget (0x1000) == 0x1000);
+
+	const uint8_t load [] = { 0x48, 0x8B, 0x05, 0x78, 0x56, 0x34, 0x12 }; // mov rax, [rip + 0x12345678]
+	decoded = getInstructionLength (load, sizeof (load));
+	CHECK (decoded.length == 7 && decoded.relativeOffset == 3);
+
+	const uint8_t prefixedLoad [] = { 0x48, 0x66, 0x8B, 0x05, 0x78, 0x56, 0x34, 0x12 }; // mov ax, [rip + 0x12345678]
+	decoded = getInstructionLength (prefixedLoad, sizeof (prefixedLoad));
+	CHECK (decoded.length == 8 && decoded.relativeOffset == 4);
+}
+
+int main ()
+{
+	testCases ();
+	testRelative ();
+	printf ("%s\n", failures ? "instructionLengthTest failed" : "instructionLengthTest passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+// PE header validation of peView on well formed and malformed headers, and file mapping it runs over
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <vector>
+#include "peView.h"
+#include "mappedFile.h"
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf ("FAILED %s:%d %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static constexpr uint32_t LFANEW = 0x80;
+static constexpr uint32_t FILE_HEADER = LFANEW + 4;
+static constexpr uint32_t OPTIONAL_HEADER = LFANEW + 24;
+static constexpr uint32_t FILE_SIZE = 0x1000;
+
+// headers, .text at RVA 0x1000 (file 0x400) and .data at RVA 0x2000 (file 0x800), import directory in .data
+struct peFile
+{
+	std::vector <uint8_t> bytes;
+	bool is64;
+
+	peFile (bool is64 = true) : bytes (FILE_SIZE), is64 (is64)
+	{
+		put <uint16_t> (0, 0x5A4D);
+		put <int32_t> (offsetof (IMAGE_DOS_HEADER, e_lfanew), LFANEW);
+		put <uint32_t> (LFANEW, 0x00004550);
+		put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, Machine), is64 ? 0x8664 : 0x014C);
+		put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, NumberOfSections), 2);
+		put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, SizeOfOptionalHeader), optionalSize ());
+		put <uint16_t> (OPTIONAL_HEADER, is64 ? 0x20B : 0x10B);
+		put <uint32_t> (OPTIONAL_HEADER + (is64 ? offsetof (IMAGE_OPTIONAL_HEADER64, SizeOfHeaders) : offsetof (IMAGE_OPTIONAL_HEADER32, SizeOfHeaders)), 0x400);
+		put <uint32_t> (directoryCountOffset (), IMAGE_NUMBEROF_DIRECTORY_ENTRIES);
+		put <IMAGE_DATA_DIRECTORY> (directoryOffset (1), { 0x2010, 0x28 });
+		addSection (0, 0x1000, 0x400, 0x400);
+		addSection (1, 0x2000, 0x200, 0x800);
+	}
+	template <class T> void put (uint32_t offset, T value) { memcpy (bytes.data() + offset, &value, sizeof (T)); }
+	uint32_t optionalSize () const { return is64 ? sizeof (IMAGE_OPTIONAL_HEADER64) : sizeof (IMAGE_OPTIONAL_HEADER32); }
+	uint32_t directoriesStart () const { return is64 ? offsetof (IMAGE_OPTIONAL_HEADER64, DataDirectory) : offsetof (IMAGE_OPTIONAL_HEADER32, DataDirectory); }
+	uint32_t directoryCountOffset () const { return OPTIONAL_HEADER + directoriesStart () - 4; }
+	uint32_t directoryOffset (uint32_t index) const { return OPTIONAL_HEADER + directoriesStart () + index * sizeof (IMAGE_DATA_DIRECTORY); }
+	uint32_t sectionOffset (uint32_t index) const { return OPTIONAL_HEADER + optionalSize () + index * sizeof (IMAGE_SECTION_HEADER); }
+	void addSection (uint32_t index, uint32_t rva, uint32_t rawSize, uint32_t rawOffset)
+	{
+		IMAGE_SECTION_HEADER section;
+		memset (&section, 0, sizeof (section));
+		section.Misc.VirtualSize = rawSize;
+		section.VirtualAddress = rva;
+		section.SizeOfRawData = rawSize;
+		section.PointerToRawData = rawOffset;
+		put (sectionOffset (index), section);
+	}
+	peError parse (peView & view, size_t size = FILE_SIZE, bool imageLayout = false) const { return view.parse ( { bytes.data(), size }, imageLayout); }
+	peError parse () const
+	{
+		peView view;
+		return parse (view);
+	}
+};
+
+static void testWellFormed ()
+{
+	for (bool is64 : { true, false })
+	{
+		peFile file (is64);
+		peView view;
+		CHECK (file.parse (view) == peError::OK);
+		CHECK (view.isPE64 () == is64 && view.getNtHeadersOffset () == LFANEW);
+		CHECK (view.getNtHeaders ().size() == 24 + file.optionalSize ());
+		CHECK (view.getSections ().size() == 2 && view.getSections ()[1].VirtualAddress == 0x2000);
+		CHECK (view.getDirectory (1).VirtualAddress == 0x2010 && view.getDirectory (1).Size == 0x28);
+		CHECK (view.getDirectory (IMAGE_NUMBEROF_DIRECTORY_ENTRIES).VirtualAddress == 0);
+		dataSpan<uint8_t> data;
+		CHECK (view.getRVA (0x2010, 0x28, data) == peError::OK && data.data == file.bytes.data() + 0x810 && data.size() == 0x28);
+	}
+}
+static void testTruncated ()
+{
+	peFile file;
+	peView view;
+	CHECK (file.parse (view, 0) == peError::TRUNCATED);
+	CHECK (file.parse (view, sizeof (IMAGE_DOS_HEADER) - 1) == peError::TRUNCATED);
+	CHECK (file.parse (view, LFANEW + 8) == peError::TRUNCATED); // file header cut
+	CHECK (file.parse (view, OPTIONAL_HEADER + 0x20) == peError::TRUNCATED); // optional header cut
+	CHECK (file.parse (view, OPTIONAL_HEADER + file.optionalSize () - 1) == peError::TRUNCATED); // declared size is not there
+	CHECK (file.parse (view, file.sectionOffset (1) + 8) == peError::BAD_SECTION_TABLE); // second section header cut
+
+	file.put <int32_t> (offsetof (IMAGE_DOS_HEADER, e_lfanew), FILE_SIZE - 2);
+	CHECK (file.parse () == peError::TRUNCATED);
+}
+static void testSignatures ()
+{
+	peFile file;
+	file.put <uint16_t> (0, 0x5A4E);
+	CHECK (file.parse () == peError::BAD_DOS_SIGNATURE);
+
+	file = peFile ();
+	file.put <int32_t> (offsetof (IMAGE_DOS_HEADER, e_lfanew), -4);
+	CHECK (file.parse () == peError::BAD_LFANEW);
+	file.put <int32_t> (offsetof (IMAGE_DOS_HEADER, e_lfanew), 0x10000004);
+	CHECK (file.parse () == peError::BAD_LFANEW);
+
+	file = peFile ();
+	file.put <uint32_t> (LFANEW, 0x00004551);
+	CHECK (file.parse () == peError::BAD_PE_SIGNATURE);
+
+	file = peFile ();
+	file.put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, Machine), 0xAA64); // ARM64
+	CHECK (file.parse () == peError::UNSUPPORTED_MACHINE);
+}
+static void testOptionalHeader ()
+{
+	peFile file;
+	file.put <uint16_t> (OPTIONAL_HEADER, 0x10B); // PE32 magic on AMD64 machine
+	CHECK (file.parse () == peError::BAD_OPTIONAL_HEADER);
+
+	file = peFile ();
+	file.put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, SizeOfOptionalHeader), 0x10); // ends before data directories
+	CHECK (file.parse () == peError::BAD_OPTIONAL_HEADER);
+
+	// directory count is clamped to what optional header holds, not to declared NumberOfRvaAndSizes
+	file = peFile ();
+	file.put <uint32_t> (file.directoryCountOffset (), 0xFFFFFFFF);
+	peView view;
+	CHECK (file.parse (view) == peError::OK);
+	CHECK (view.getDirectory (1).VirtualAddress == 0x2010 && view.getDirectory (0xFFFFFFFF).VirtualAddress == 0);
+
+	file = peFile ();
+	file.put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, SizeOfOptionalHeader), file.directoriesStart () + sizeof (IMAGE_DATA_DIRECTORY));
+	CHECK (file.parse (view) == peError::OK); // section table is read where declared size puts it
+	CHECK (view.getDirectory (0).VirtualAddress == 0 && view.getDirectory (1).VirtualAddress == 0);
+}
+static void testSectionTable ()
+{
+	peFile file;
+	file.put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, NumberOfSections), 97);
+	CHECK (file.parse () == peError::TOO_MANY_SECTIONS);
+	file.put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, NumberOfSections), 96); // allowed, but runs past end of file
+	CHECK (file.parse () == peError::BAD_SECTION_TABLE);
+	file.put <uint16_t> (FILE_HEADER + offsetof (IMAGE_FILE_HEADER, NumberOfSections), 0);
+	peView view;
+	CHECK (file.parse (view) == peError::OK && view.getSections ().empty());
+}
+static void testRVA ()
+{
+	peFile file;
+	file.addSection (1, 0x2000, 0x200, 0x810); // loader rounds raw offset down to 0x200
+	peView view;
+	CHECK (file.parse (view) == peError::OK);
+	uint64_t offset = 0;
+	CHECK (view.rvaToOffset (0x2010, 0x28, offset) == peError::OK && offset == 0x810);
+	CHECK (view.rvaToOffset (0x10, 0x10, offset) == peError::OK && offset == 0x10); // headers
+	CHECK (view.rvaToOffset (0x3000, 1, offset) == peError::BAD_RVA); // between sections
+	CHECK (view.rvaToOffset (0x21F0, 0x20, offset) == peError::BAD_RVA); // crosses end of section
+	CHECK (view.rvaToOffset (0xFFFFFFFFFFFFFFF0ull, 0x20, offset) == peError::BAD_RVA); // wraps around
+
+	file.addSection (1, 0x2000, 0x1000, 0x800); // raw data claims more than file has
+	CHECK (file.parse (view) == peError::OK);
+	CHECK (view.rvaToOffset (0x2700, 0x200, offset) == peError::BAD_RVA);
+
+	CHECK (file.parse (view, FILE_SIZE, true) == peError::OK); // mapped image, RVA is offset
+	CHECK (view.rvaToOffset (0x800, 0x10, offset) == peError::OK && offset == 0x800);
+	CHECK (view.rvaToOffset (FILE_SIZE - 8, 0x10, offset) == peError::BAD_RVA);
+}
+static void testMappedFile ()
+{
+	const char * path = "peViewTest.tmp";
+	peFile file;
+	FILE * f = fopen (path, "wb");
+	CHECK (f != nullptr);
+	if (f == nullptr)
+	{
+		return;
+	}
+	fwrite (file.bytes.data(), 1, file.bytes.size(), f);
+	fclose (f);
+
+	mappedFile mapping;
+	CHECK (mapping.open (path) && mapping.getSize () == FILE_SIZE);
+	peView view;
+	CHECK (view.parse ( { mapping.data (), (size_t) mapping.getSize () }, false) == peError::OK);
+	CHECK (mapping.at (FILE_SIZE - 4, 4) != nullptr && mapping.at (FILE_SIZE - 4, 5) == nullptr);
+	CHECK (mapping.spanAt<IMAGE_SECTION_HEADER> (file.sectionOffset (0), 2).size() == 2);
+	CHECK (mapping.spanAt<uint64_t> (0, 0xFFFFFFFFFFFFFFFull).empty());
+	mapping.close ();
+	CHECK (!mapping.isOpen ());
+	remove (path);
+
+	fclose (fopen (path, "wb"));
+	CHECK (!mapping.open (path)); // empty file
+	remove (path);
+	CHECK (!mapping.open (path)); // missing file
+}
+
+int main ()
+{
+	testWellFormed ();
+	testTruncated ();
+	testSignatures ();
+	testOptionalHeader ();
+	testSectionTable ();
+	testRVA ();
+	testMappedFile ();
+	printf ("%s\n", failures ? "peViewTest failed" : "peViewTest passed");
+	return failures ? 1 : 0;
+}
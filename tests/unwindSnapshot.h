@@ -0,0 +1,139 @@
+// Captured memory of process (image with .pdata and UNWIND_INFO, stack) for unwinder tests and benchmark, runs on any host
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include <vector>
+#include "unwinder.h"
+
+enum unwindOpCodes // UNWIND_CODE operations as PE specification numbers them
+{
+	OP_PUSH_NONVOL = 0,
+	OP_ALLOC_LARGE,
+	OP_ALLOC_SMALL,
+	OP_SET_FPREG,
+	OP_SAVE_NONVOL,
+	OP_SAVE_NONVOL_FAR,
+	OP_EPILOG,
+	OP_SPARE_CODE,
+	OP_SAVE_XMM128,
+	OP_SAVE_XMM128_FAR,
+	OP_PUSH_MACHFRAME
+};
+
+inline uint16_t unwindCode (uint8_t codeOffset, uint8_t op, uint8_t info)
+{
+	return codeOffset | ((op | (info << 4)) << 8);
+}
+
+class snapshotReader : public memoryReader
+{
+	private:
+		struct region
+		{
+			uint64_t base;
+			std::vector <uint8_t> bytes;
+		};
+		std::vector <region> regions;
+
+		uint8_t * at (uint64_t address, size_t size)
+		{
+			for (auto & r : regions)
+			{
+				if (address >= r.base && size <= r.bytes.size() && address - r.base <= r.bytes.size() - size)
+				{
+					return r.bytes.data() + (address - r.base);
+				}
+			}
+			return nullptr;
+		}
+	public:
+		void addRegion (uint64_t base, size_t size, uint8_t fill = 0) { regions.push_back ( { base, std::vector <uint8_t> (size, fill) } ); }
+		bool read (uint64_t address, void * buffer, size_t size) override
+		{
+			const uint8_t * p = at (address, size);
+			if (p == nullptr)
+			{
+				return false;
+			}
+			memcpy (buffer, p, size);
+			return true;
+		}
+		bool write (uint64_t address, const void * buffer, size_t size)
+		{
+			uint8_t * p = at (address, size);
+			if (p == nullptr)
+			{
+				return false;
+			}
+			memcpy (p, buffer, size);
+			return true;
+		}
+		template <class T> bool write (uint64_t address, T value) { return write (address, &value, sizeof (T)); }
+};
+
+// PE32+ headers with exception directory only, code is filled with nops so it never looks like epilog
+class syntheticImage
+{
+	private:
+		static constexpr uint32_t LFANEW = 0x80;
+		static constexpr uint32_t OPTIONAL_HEADER = LFANEW + 24;
+		static constexpr uint32_t EXCEPTION_DIRECTORY = OPTIONAL_HEADER + 112 + 3 * 8;
+
+		snapshotReader & memory;
+		uint64_t base;
+		uint32_t functionCount = 0;
+		uint32_t nextInfo = INFO_RVA;
+	public:
+		static constexpr uint32_t SIZE = 0x100000;
+		static constexpr uint32_t PDATA_RVA = 0x1000;
+		static constexpr uint32_t INFO_RVA = 0x20000;
+		static constexpr uint32_t CODE_RVA = 0x40000;
+
+		syntheticImage (snapshotReader & memory, uint64_t base) : memory (memory), base (base)
+		{
+			memory.addRegion (base, CODE_RVA);
+			memory.addRegion (base + CODE_RVA, SIZE - CODE_RVA, 0x90);
+			memory.write <uint32_t> (base + 0x3C, LFANEW);
+			memory.write <uint32_t> (base + LFANEW, 0x00004550);
+			memory.write <uint16_t> (base + OPTIONAL_HEADER, 0x20B);
+			memory.write <uint32_t> (base + OPTIONAL_HEADER + 56, SIZE);
+			memory.write <uint32_t> (base + OPTIONAL_HEADER + 108, 16);
+			memory.write <uint32_t> (base + EXCEPTION_DIRECTORY, PDATA_RVA);
+		}
+		uint64_t getBase () const { return base; }
+		bool contains (uint64_t address) const { return address >= base && address - base < SIZE; }
+
+		// returns RVA of UNWIND_INFO, codes are in the order they are stored (last prolog operation first)
+		uint32_t addUnwindInfo (uint8_t prologSize, uint8_t frameRegister, uint8_t scaledFrameOffset, std::vector <uint16_t> codes, const unwindFunction * chained = nullptr)
+		{
+			uint32_t rva = nextInfo;
+			uint8_t header [4] = { (uint8_t) (1 | ((chained ? 4 : 0) << 3)), prologSize, (uint8_t) codes.size(), (uint8_t) (frameRegister | (scaledFrameOffset << 4)) };
+			memory.write (base + rva, header, sizeof (header));
+			if (codes.size() % 2)
+			{
+				codes.push_back (0);
+			}
+			if (!codes.empty())
+			{
+				memory.write (base + rva + sizeof (header), codes.data(), codes.size() * sizeof (uint16_t));
+			}
+			uint32_t size = sizeof (header) + codes.size() * sizeof (uint16_t);
+			if (chained)
+			{
+				memory.write (base + rva + size, chained, sizeof (unwindFunction));
+				size += sizeof (unwindFunction);
+			}
+			nextInfo += (size + 3) & ~3u;
+			return rva;
+		}
+		unwindFunction addFunction (uint32_t begin, uint32_t end, uint32_t unwindInfo) // in order of begin
+		{
+			unwindFunction function = { begin, end, unwindInfo };
+			memory.write (base + PDATA_RVA + functionCount * sizeof (unwindFunction), function);
+			functionCount++;
+			memory.write <uint32_t> (base + EXCEPTION_DIRECTORY + 4, functionCount * sizeof (unwindFunction));
+			return function;
+		}
+		void writeCode (uint32_t rva, std::vector <uint8_t> code) { memory.write (base + rva, code.data(), code.size()); }
+};
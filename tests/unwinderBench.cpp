@@ -0,0 +1,80 @@
+// Backtrace throughput over synthetic stack snapshot: cold walks decode unwind info, warm walks use decoded programs
+// unwinderBench [frames] [walks]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "unwindSnapshot.h"
+
+static constexpr uint64_t IMAGE_BASE = 0x140000000;
+static constexpr uint64_t STACK_BASE = 0x100000;
+static constexpr uint32_t FUNCTION_SIZE = 0x80;
+static constexpr uint32_t FRAME_SIZE = 0x30; // return address, saved rbx, 0x20 bytes of locals
+static constexpr uint32_t MAX_FUNCTIONS = 4096;
+
+int main (int argc, char ** argv)
+{
+	uint32_t frameCount = argc > 1 ? strtoul (argv[1], nullptr, 0) : 10000;
+	uint32_t walks = argc > 2 ? strtoul (argv[2], nullptr, 0) : 100;
+	if (frameCount == 0 || walks == 0)
+	{
+		printf ("usage: unwinderBench [frames] [walks]\n");
+		return 1;
+	}
+
+	// every other function continues in chained entry, every frame is push rbx; sub rsp, 0x20
+	snapshotReader memory;
+	syntheticImage image (memory, IMAGE_BASE);
+	uint32_t primaryInfo = image.addUnwindInfo (5, 0, 0, { unwindCode (5, OP_ALLOC_SMALL, 3), unwindCode (1, OP_PUSH_NONVOL, UNW_RBX) });
+	for (uint32_t i = 0; i < MAX_FUNCTIONS; i += 2)
+	{
+		uint32_t begin = syntheticImage::CODE_RVA + i * FUNCTION_SIZE;
+		unwindFunction primary = image.addFunction (begin, begin + FUNCTION_SIZE, primaryInfo);
+		image.addFunction (begin + FUNCTION_SIZE, begin + 2 * FUNCTION_SIZE, image.addUnwindInfo (0, 0, 0, {}, &primary));
+	}
+
+	uint64_t stackSize = (uint64_t) frameCount * FRAME_SIZE + 0x100;
+	memory.addRegion (STACK_BASE, stackSize);
+	uint64_t rsp = STACK_BASE;
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		uint32_t caller = (i + 1) * 7 % MAX_FUNCTIONS;
+		uint64_t returnAddress = i + 1 < frameCount ? IMAGE_BASE + syntheticImage::CODE_RVA + caller * FUNCTION_SIZE + 0x20 : 0;
+		memory.write <uint64_t> (rsp + FRAME_SIZE - 0x10, i); // saved rbx
+		memory.write <uint64_t> (rsp + FRAME_SIZE - 8, returnAddress);
+		rsp += FRAME_SIZE;
+	}
+	unwindContext start;
+	memset (&start, 0, sizeof (start));
+	start.rip = IMAGE_BASE + syntheticImage::CODE_RVA + 0x20;
+	start.regs[UNW_RSP] = STACK_BASE;
+	auto moduleBase = [&image] (uint64_t address) { return image.contains (address) ? image.getBase () : 0; };
+
+	size_t frames = 0;
+	auto coldStart = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < walks; i++)
+	{
+		unwinder coldUnwinder (memory, moduleBase);
+		frames += coldUnwinder.walk (start, frameCount).size();
+	}
+	double cold = std::chrono::duration<double> (std::chrono::steady_clock::now () - coldStart).count ();
+	if (frames != (size_t) frameCount * walks)
+	{
+		printf ("walk stopped after %zu of %u frames\n", frames / walks, frameCount);
+		return 1;
+	}
+
+	unwinder warmUnwinder (memory, moduleBase);
+	warmUnwinder.walk (start, frameCount);
+	auto warmStart = std::chrono::steady_clock::now ();
+	for (uint32_t i = 0; i < walks; i++)
+	{
+		frames += warmUnwinder.walk (start, frameCount).size();
+	}
+	double warm = std::chrono::duration<double> (std::chrono::steady_clock::now () - warmStart).count ();
+
+	printf ("%u walks of %u frames\n", walks, frameCount);
+	printf ("    cold %.3f ms per walk, %.1f M frames/s\n", cold * 1000 / walks, (double) frameCount * walks / cold / 1e6);
+	printf ("    warm %.3f ms per walk, %.1f M frames/s\n", warm * 1000 / walks, (double) frameCount * walks / warm / 1e6);
+	return 0;
+}
@@ -0,0 +1,186 @@
+// Unwinding of synthetic image and stack snapshot, one step per prolog shape the unwinder has to handle
+#include <stdio.h>
+#include <string.h>
+#include "unwindSnapshot.h"
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf ("FAILED %s:%d %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static constexpr uint64_t IMAGE_BASE = 0x140000000;
+static constexpr uint64_t STACK_BASE = 0x10000;
+static constexpr uint64_t STACK_SIZE = 0x2000;
+static constexpr uint64_t CALLER_RSP = STACK_BASE + 0x1000; // rsp before call instruction of frame being unwound
+static constexpr uint64_t RETURN_ADDRESS = IMAGE_BASE + 0x7FFF0; // no .pdata there
+
+// push rbp; sub rsp, 0x20; lea rbp, [rsp + 0x20]
+static constexpr uint32_t FRAME_POINTER_RVA = syntheticImage::CODE_RVA;
+// push rbx; sub rsp, 0x28, second part of function is described by chained entry
+static constexpr uint32_t CHAINED_PRIMARY_RVA = syntheticImage::CODE_RVA + 0x100;
+static constexpr uint32_t CHAINED_RVA = syntheticImage::CODE_RVA + 0x180;
+// sub rsp, 0x28; mov [rsp + 0x30], rsi
+static constexpr uint32_t SAVE_NONVOL_RVA = syntheticImage::CODE_RVA + 0x200;
+// interrupt handler entered with error code
+static constexpr uint32_t MACHINE_FRAME_RVA = syntheticImage::CODE_RVA + 0x300;
+// push rbx; sub rsp, 0x20, epilog at +0x40: add rsp, 0x20; pop rbx; ret
+static constexpr uint32_t EPILOG_RVA = syntheticImage::CODE_RVA + 0x400;
+
+struct fixture
+{
+	snapshotReader memory;
+	syntheticImage image {memory, IMAGE_BASE};
+	unwinder stackUnwinder {memory, [this] (uint64_t address) { return image.contains (address) ? image.getBase () : 0; }};
+
+	fixture ()
+	{
+		memory.addRegion (STACK_BASE, STACK_SIZE);
+
+		image.addFunction (FRAME_POINTER_RVA, FRAME_POINTER_RVA + 0x100, image.addUnwindInfo (9, UNW_RBP, 2,
+			{ unwindCode (9, OP_SET_FPREG, 0), unwindCode (5, OP_ALLOC_SMALL, 3), unwindCode (1, OP_PUSH_NONVOL, UNW_RBP) }));
+
+		unwindFunction primary = image.addFunction (CHAINED_PRIMARY_RVA, CHAINED_RVA, image.addUnwindInfo (5, 0, 0,
+			{ unwindCode (5, OP_ALLOC_SMALL, 4), unwindCode (1, OP_PUSH_NONVOL, UNW_RBX) }));
+		image.addFunction (CHAINED_RVA, CHAINED_RVA + 0x80, image.addUnwindInfo (0, 0, 0, {}, &primary));
+
+		image.addFunction (SAVE_NONVOL_RVA, SAVE_NONVOL_RVA + 0x100, image.addUnwindInfo (9, 0, 0,
+			{ unwindCode (9, OP_SAVE_NONVOL, UNW_RSI), 0x30 / 8, unwindCode (4, OP_ALLOC_SMALL, 4) }));
+
+		image.addFunction (MACHINE_FRAME_RVA, MACHINE_FRAME_RVA + 0x100, image.addUnwindInfo (0, 0, 0,
+			{ unwindCode (0, OP_PUSH_MACHFRAME, 1) }));
+
+		image.addFunction (EPILOG_RVA, EPILOG_RVA + 0x100, image.addUnwindInfo (5, 0, 0,
+			{ unwindCode (5, OP_ALLOC_SMALL, 3), unwindCode (1, OP_PUSH_NONVOL, UNW_RBX) }));
+		image.writeCode (EPILOG_RVA + 0x40, { 0x48, 0x83, 0xC4, 0x20, 0x5B, 0xC3 });
+
+		memory.write <uint64_t> (CALLER_RSP - 8, RETURN_ADDRESS);
+	}
+	unwindContext contextAt (uint64_t rip, uint64_t rsp)
+	{
+		unwindContext context;
+		memset (&context, 0, sizeof (context));
+		context.rip = rip;
+		context.regs[UNW_RSP] = rsp;
+		return context;
+	}
+};
+
+static void testFramePointer ()
+{
+	fixture f;
+	f.memory.write <uint64_t> (CALLER_RSP - 0x10, 0x1111); // saved rbp
+	unwindContext context = f.contextAt (IMAGE_BASE + FRAME_POINTER_RVA + 0x40, CALLER_RSP - 0x80); // alloca moved rsp below fixed frame
+	context.regs[UNW_RBP] = CALLER_RSP - 0x10;
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (!frame.leaf && frame.moduleBase == IMAGE_BASE);
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RBP] == 0x1111);
+}
+static void testMidProlog ()
+{
+	fixture f;
+	f.memory.write <uint64_t> (CALLER_RSP - 0x10, 0x2222);
+	unwindContext context = f.contextAt (IMAGE_BASE + FRAME_POINTER_RVA + 1, CALLER_RSP - 0x10); // only push rbp executed
+	context.regs[UNW_RBP] = 0xBAD; // frame pointer is not set yet, it must not be used
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RBP] == 0x2222);
+
+	context = f.contextAt (IMAGE_BASE + FRAME_POINTER_RVA, CALLER_RSP - 8); // first instruction, nothing to undo
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP);
+}
+static void testChained ()
+{
+	fixture f;
+	f.memory.write <uint64_t> (CALLER_RSP - 0x10, 0x3333); // saved rbx
+	unwindContext context = f.contextAt (IMAGE_BASE + CHAINED_RVA + 0x10, CALLER_RSP - 0x38);
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RBX] == 0x3333);
+}
+static void testSaveNonvolatile ()
+{
+	fixture f;
+	f.memory.write <uint64_t> (CALLER_RSP, 0x4444); // home space of caller
+	unwindContext context = f.contextAt (IMAGE_BASE + SAVE_NONVOL_RVA + 0x20, CALLER_RSP - 0x30);
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RSI] == 0x4444);
+
+	context = f.contextAt (IMAGE_BASE + SAVE_NONVOL_RVA + 4, CALLER_RSP - 0x30); // allocated, rsi not saved yet
+	context.regs[UNW_RSI] = 0x5555;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RSI] == 0x5555);
+}
+static void testMachineFrame ()
+{
+	fixture f;
+	uint64_t rsp = STACK_BASE + 0x800;
+	f.memory.write <uint64_t> (rsp, 0xE); // error code
+	f.memory.write <uint64_t> (rsp + 8, RETURN_ADDRESS); // RIP, CS, EFLAGS, RSP, SS
+	f.memory.write <uint64_t> (rsp + 8 + 24, CALLER_RSP);
+	unwindContext context = f.contextAt (IMAGE_BASE + MACHINE_FRAME_RVA + 0x10, rsp);
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP);
+}
+static void testEpilog ()
+{
+	fixture f;
+	f.memory.write <uint64_t> (CALLER_RSP - 0x10, 0x6666);
+	unwindContext context = f.contextAt (IMAGE_BASE + EPILOG_RVA + 0x44, CALLER_RSP - 0x10); // add rsp executed, pop rbx is next
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RBX] == 0x6666);
+
+	context = f.contextAt (IMAGE_BASE + EPILOG_RVA + 0x40, CALLER_RSP - 0x30); // at add rsp
+	CHECK (f.stackUnwinder.step (context, frame));
+	CHECK (context.rip == RETURN_ADDRESS && context.regs[UNW_RSP] == CALLER_RSP && context.regs[UNW_RBX] == 0x6666);
+}
+static void testWalk ()
+{
+	fixture f;
+	// chained function called frame pointer function, it was called from code without .pdata, that one from nothing
+	uint64_t chainedRsp = CALLER_RSP - 0x38;
+	uint64_t innerRsp = chainedRsp - 0x30;
+	f.memory.write <uint64_t> (chainedRsp - 8, IMAGE_BASE + CHAINED_RVA + 0x20);
+	f.memory.write <uint64_t> (chainedRsp - 0x10, chainedRsp + 0x100); // saved rbp
+	f.memory.write <uint64_t> (CALLER_RSP, 0); // return address of leaf
+	unwindContext context = f.contextAt (IMAGE_BASE + FRAME_POINTER_RVA + 0x40, innerRsp);
+	context.regs[UNW_RBP] = chainedRsp - 0x10;
+
+	std::vector <unwindFrame> frames = f.stackUnwinder.walk (context, 16);
+	CHECK (frames.size() == 3);
+	if (frames.size() == 3)
+	{
+		CHECK (frames[0].rip == IMAGE_BASE + FRAME_POINTER_RVA + 0x40 && frames[0].rsp == innerRsp);
+		CHECK (frames[1].rip == IMAGE_BASE + CHAINED_RVA + 0x20 && frames[1].rsp == chainedRsp);
+		CHECK (frames[2].rip == RETURN_ADDRESS && frames[2].leaf);
+	}
+	CHECK (f.stackUnwinder.walk (context, 1).size() == 1);
+}
+static void testBrokenUnwindInfo ()
+{
+	fixture f;
+	uint32_t rva = syntheticImage::CODE_RVA + 0x600;
+	uint32_t info = f.image.addUnwindInfo (0, 0, 0, { unwindCode (0, OP_SAVE_NONVOL, UNW_RBX) }); // operand slot is missing
+	f.image.addFunction (rva, rva + 0x100, info);
+	unwindContext context = f.contextAt (IMAGE_BASE + rva + 0x10, CALLER_RSP - 8);
+	unwindFrame frame;
+	CHECK (f.stackUnwinder.step (context, frame)); // treated as leaf
+	CHECK (frame.leaf && context.rip == RETURN_ADDRESS);
+}
+
+int main ()
+{
+	testFramePointer ();
+	testMidProlog ();
+	testChained ();
+	testSaveNonvolatile ();
+	testMachineFrame ();
+	testEpilog ();
+	testWalk ();
+	testBrokenUnwindInfo ();
+	printf ("%s\n", failures ? "unwinderTest failed" : "unwinderTest passed");
+	return failures ? 1 : 0;
+}